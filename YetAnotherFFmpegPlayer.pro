@@ -1,5 +1,8 @@
 QT       += core gui multimedia multimediawidgets
 
+# QAbstractVideoBuffer is a private API before Qt 6.8
+lessThan(QT_MAJOR_VERSION, 7): lessThan(QT_MINOR_VERSION, 8): QT += multimedia-private
+
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
@@ -25,17 +28,40 @@ SOURCES += \
     logger/logger.cpp \
     main.cpp \
     mainwindow.cpp \
+    player/activepicturedetector.cpp \
     player/audiodecoder.cpp \
     player/audioframe.cpp \
+    player/avframevideobuffer.cpp \
+    player/bitratehistory.cpp \
+    player/clockrecovery.cpp \
     player/decoder.cpp \
+    player/decoderthreadingpolicy.cpp \
     player/demuxer.cpp \
     player/ffmpegfilter.cpp \
+    player/mosaiccompositor.cpp \
+    player/mosaictiledecoder.cpp \
     player/frame.cpp \
+    player/latencymeter.cpp \
+    player/loadgovernor.cpp \
+    player/mappedfileinput.cpp \
+    player/pixelrepack.cpp \
+    player/psicache.cpp \
+    player/recorder.cpp \
+    player/rtpinput.cpp \
+    player/seekindex.cpp \
+    player/sessionmanager.cpp \
+    player/timeshiftbuffer.cpp \
+    player/tsanalyzer.cpp \
     player/utils.cpp \
+    player/videobufferpool.cpp \
+    player/videoconverter.cpp \
     player/videodecoder.cpp \
     player/videoframe.cpp \
+    player/workerpool.cpp \
+    ui/bitratehistorywidget.cpp \
     ui/detailsdockwidget.cpp \
-    ui/openstreamdialog.cpp
+    ui/openstreamdialog.cpp \
+    ui/settingsdockwidget.cpp
 
 HEADERS += \
     audio/averagelevelcalculator.h \
@@ -48,17 +74,41 @@ HEADERS += \
     logger/loggable.h \
     logger/logger.h \
     mainwindow.h \
+    player/activepicturedetector.h \
     player/audiodecoder.h \
     player/audioframe.h \
+    player/avframevideobuffer.h \
+    player/bitratehistory.h \
+    player/clockrecovery.h \
     player/decoder.h \
+    player/decoderthreadingpolicy.h \
     player/demuxer.h \
     player/ffmpegfilter.h \
+    player/mosaiccompositor.h \
+    player/mosaictiledecoder.h \
     player/frame.h \
+    player/latencymeter.h \
+    player/loadgovernor.h \
+    player/mappedfileinput.h \
+    player/pixelrepack.h \
+    player/psicache.h \
+    player/recorder.h \
+    player/rtpinput.h \
+    player/seekindex.h \
+    player/sessionmanager.h \
+    player/simd.h \
+    player/timeshiftbuffer.h \
+    player/tsanalyzer.h \
     player/utils.h \
+    player/videobufferpool.h \
+    player/videoconverter.h \
     player/videodecoder.h \
     player/videoframe.h \
+    player/workerpool.h \
+    ui/bitratehistorywidget.h \
     ui/detailsdockwidget.h \
-    ui/openstreamdialog.h
+    ui/openstreamdialog.h \
+    ui/settingsdockwidget.h
 
 FORMS += \
     mainwindow.ui \
@@ -9,9 +9,12 @@
 
 
 #include "openstreamdialog.h"
+#include "sessionmanager.h"
 
 #include "utils.h"
 
+static const int TimeshiftJumpSeconds = 10;
+
 //---------------------------------------------------------------------------------------
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -27,8 +30,17 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(detailsButton, &QPushButton::clicked, detailsDockWidget, &DetailsDockWidget::setVisible);
     connect(detailsDockWidget, &DetailsDockWidget::visibilityChanged, detailsButton, &QPushButton::setChecked);
+    connect(settingsButton, &QPushButton::clicked, settingsDockWidget, &SettingsDockWidget::setVisible);
+    connect(settingsDockWidget, &SettingsDockWidget::visibilityChanged, settingsButton, &QPushButton::setChecked);
+
+    DecoderThreadingPolicy *threadingPolicy = DecoderThreadingPolicy::getInstance();
+    settingsDockWidget->setCoreBudget(threadingPolicy->getCoreBudget());
+    connect(settingsDockWidget, &SettingsDockWidget::coreBudgetChanged,
+            threadingPolicy, &DecoderThreadingPolicy::setCoreBudget, Qt::DirectConnection);
+
+    settingsDockWidget->setDeinterlacers(VideoDecoder::getDeinterlacers());
 
-    demuxer = new Demuxer();
+    demuxer = SessionManager::getInstance()->createSession();
     demuxer->setVideoSink(videoWidget->videoSink());
 
     connect(this, &MainWindow::configureAndStartPlayer, demuxer, &Demuxer::setSourceAndStart, Qt::QueuedConnection);
@@ -41,22 +53,50 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(demuxer, &Demuxer::streamsFound, this, &MainWindow::updateStreamLists, Qt::QueuedConnection);
     connect(demuxer, &Demuxer::programsFound, this, &MainWindow::updateProgramList, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::streamsChanged, this, &MainWindow::updateStreamListsPartially, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::programsChanged, this, &MainWindow::updateProgramListPartially, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::streamScramblingChanged, this, &MainWindow::updateStreamScrambling, Qt::QueuedConnection);
     connect(demuxer, &Demuxer::currentAudioChannelsCountUpdated, this, &MainWindow::updateAudioIndicatorsCount);
     connect(demuxer, &Demuxer::audioLevelsCalculated, this, &MainWindow::updateAudioIndicatorLevels);
+    connect(demuxer, &Demuxer::detailsUpdated, detailsDockWidget, &DetailsDockWidget::updateSection, Qt::QueuedConnection);
+    detailsDockWidget->setBitrateHistory(demuxer->getBitrateHistory());
 
     connect(this, &MainWindow::selectedStreamChanged, demuxer, &Demuxer::changeSelectedStream, Qt::QueuedConnection);
-
-    demuxer->moveToThread(&demuxThread);
-    connect(&demuxThread, &QThread::finished, demuxer, &QObject::deleteLater);
-    demuxThread.start();
+    connect(settingsDockWidget, &SettingsDockWidget::videoFiltersChanged, demuxer, &Demuxer::setVideoFilters, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::deinterlacerChanged, demuxer, &Demuxer::setDeinterlacer, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::activePictureDetectionChanged,
+            demuxer, &Demuxer::setActivePictureDetection, Qt::QueuedConnection);
+    connect(this, &MainWindow::videoOutputSizeChanged, demuxer, &Demuxer::setVideoOutputSize, Qt::QueuedConnection);
+    connect(this, &MainWindow::videoOutputVisibilityChanged,
+            demuxer, &Demuxer::setVideoOutputVisible, Qt::QueuedConnection);
+    connect(this, &MainWindow::mosaicModeChanged, demuxer, &Demuxer::setMosaicMode, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::loadGovernorChanged,
+            demuxer, &Demuxer::setLoadGovernorEnabled, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::decodingLevelChanged, this, &MainWindow::updateDecodingLevel, Qt::QueuedConnection);
+    connect(this, &MainWindow::recordingStartRequested, demuxer, &Demuxer::startRecording, Qt::QueuedConnection);
+    connect(this, &MainWindow::recordingStopRequested, demuxer, &Demuxer::stopRecording, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::recordingStateChanged, this, &MainWindow::updateRecordingState, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::timeshiftChanged, demuxer, &Demuxer::setTimeshift, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::fastStartChanged, demuxer, &Demuxer::setFastStart, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::tsAnalysisChanged,
+            demuxer, &Demuxer::setTsAnalysisEnabled, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::clockRecoveryChanged,
+            demuxer, &Demuxer::setClockRecovery, Qt::QueuedConnection);
+    connect(settingsDockWidget, &SettingsDockWidget::lowLatencyChanged,
+            demuxer, &Demuxer::setLowLatency, Qt::QueuedConnection);
+    connect(this, &MainWindow::timeshiftSeekRequested, demuxer, &Demuxer::seekTimeshift, Qt::QueuedConnection);
+    connect(this, &MainWindow::timeshiftLiveRequested, demuxer, &Demuxer::returnToLive, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::timeshiftUpdated, this, &MainWindow::updateTimeshift, Qt::QueuedConnection);
+    connect(this, &MainWindow::seekRequested, demuxer, &Demuxer::seek, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::seekRangeChanged, this, &MainWindow::updateSeekRange, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::positionChanged, this, &MainWindow::updatePosition, Qt::QueuedConnection);
+    connect(demuxer, &Demuxer::preparingProgress, this, &MainWindow::updatePreparingProgress, Qt::QueuedConnection);
 }
 
 //---------------------------------------------------------------------------------------
 MainWindow::~MainWindow()
 {
-    demuxer->stop();
-    demuxThread.quit();
-    demuxThread.wait();
+    SessionManager::getInstance()->closeSession(demuxer);
 
     delete ui;
 }
@@ -99,6 +139,16 @@ void MainWindow::openMediaStream()
     }
 }
 
+//---------------------------------------------------------------------------------------
+//   Each window plays its own source; all windows share the decoder core budget and
+// the worker pool.
+void MainWindow::openNewWindow()
+{
+    MainWindow *window = new MainWindow();
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    window->show();
+}
+
 //---------------------------------------------------------------------------------------
 void MainWindow::processStartPauseButtonClick()
 {
@@ -120,56 +170,91 @@ void MainWindow::updateStreamLists(const std::vector<std::shared_ptr<StreamInfo>
     videoStreamsComboBox->clear();
     audioStreamsComboBox->clear();
 
-    if (streams.empty())
-        return;
-
-    // key - stream id (if not 0), else stream index;
-    // value:
-    // - first - stream index;
-    // - second - string for the representation in the combobox.
-    std::map<int, std::pair<int, std::string>> videoStreams;
-    std::map<int, std::pair<int, std::string>> audioStreams;
+    for (const std::shared_ptr<StreamInfo> &streamInfo : streams)
+    {
+        if (!streamInfo->removed)
+            insertStreamItem(*streamInfo);
+    }
+}
 
-    for (int idx = 0; idx < streams.size(); ++idx)
+//---------------------------------------------------------------------------------------
+//   Only the changed items are touched, the selection of the other streams is kept.
+// If the selected stream is removed, the combobox selects its neighbour and that
+// stream is played instead.
+void MainWindow::updateStreamListsPartially(const std::vector<std::shared_ptr<StreamInfo>> &added,
+                                            const std::vector<int> &removed)
+{
+    for (int streamIndex : removed)
     {
-        std::shared_ptr<StreamInfo> streamInfo = streams[idx];
-        std::string txt = streamInfo->id ? std::to_string(streamInfo->id) : "";
-        auto it = streamInfo->properties.find(AVStrings::Language);
-        if (it != streamInfo->properties.end())
+        for (QComboBox *comboBox : {videoStreamsComboBox, audioStreamsComboBox})
         {
-            if (!txt.empty())
-                txt.append(" - ");
-            txt.append(it->second);
+            int itemIndex = comboBox->findData(streamIndex);
+            if (itemIndex != -1)
+                comboBox->removeItem(itemIndex);
         }
+    }
 
-        it = streamInfo->properties.find(AVStrings::Title);
-        if (it != streamInfo->properties.end())
-        {
-            if (!txt.empty())
-                txt.append(" - ");
-            txt.append(it->second);
-        }
+    for (const std::shared_ptr<StreamInfo> &streamInfo : added)
+        insertStreamItem(*streamInfo);
+}
 
-        if (txt.empty())
-            txt = std::to_string(streamInfo->index);
+//---------------------------------------------------------------------------------------
+//   The item is inserted at the position of its key (PID, or the stream index).
+void MainWindow::insertStreamItem(const StreamInfo &streamInfo)
+{
+    QComboBox *comboBox = nullptr;
+    switch (streamInfo.type)
+    {
+    case AVMEDIA_TYPE_VIDEO: comboBox = videoStreamsComboBox; break;
+    case AVMEDIA_TYPE_AUDIO: comboBox = audioStreamsComboBox; break;
+    default:
+        return;
+    }
 
-        int key = streamInfo->id ? streamInfo->id : streamInfo->index;
-        std::pair<int, std::string> val{idx, txt};
-        switch(streamInfo->type)
-        {
-        case AVMEDIA_TYPE_VIDEO: videoStreams[key] = val; break;
-        case AVMEDIA_TYPE_AUDIO: audioStreams[key] = val; break;
-        default:
-            break;
-        }
+    std::string txt = streamInfo.id ? std::to_string(streamInfo.id) : "";
+    auto it = streamInfo.properties.find(AVStrings::Language);
+    if (it != streamInfo.properties.end())
+    {
+        if (!txt.empty())
+            txt.append(" - ");
+        txt.append(it->second);
     }
 
-    for (auto& [key, val] : videoStreams)
-        videoStreamsComboBox->addItem(QString::fromStdString(val.second), val.first);
+    it = streamInfo.properties.find(AVStrings::Title);
+    if (it != streamInfo.properties.end())
+    {
+        if (!txt.empty())
+            txt.append(" - ");
+        txt.append(it->second);
+    }
 
-    for (auto& [key, val] : audioStreams)
-        audioStreamsComboBox->addItem(QString::fromStdString(val.second), val.first);
+    if (txt.empty())
+        txt = std::to_string(streamInfo.index);
 
+    int key = streamInfo.id ? streamInfo.id : streamInfo.index;
+    int position = 0;
+    while (position < comboBox->count() && comboBox->itemData(position, SortKeyRole).toInt() < key)
+        ++position;
+
+    QString text = QString::fromStdString(txt);
+    comboBox->insertItem(position, streamInfo.scrambled ? tr("%1 (scrambled)").arg(text) : text, streamInfo.index);
+    comboBox->setItemData(position, key, SortKeyRole);
+    comboBox->setItemData(position, text, BaseTextRole);
+}
+
+//---------------------------------------------------------------------------------------
+//   The scrambled stream stays selectable, it's played as soon as it's clear.
+void MainWindow::updateStreamScrambling(int streamIndex, bool scrambled)
+{
+    for (QComboBox *comboBox : {videoStreamsComboBox, audioStreamsComboBox})
+    {
+        int itemIndex = comboBox->findData(streamIndex);
+        if (itemIndex == -1)
+            continue;
+
+        QString text = comboBox->itemData(itemIndex, BaseTextRole).toString();
+        comboBox->setItemText(itemIndex, scrambled ? tr("%1 (scrambled)").arg(text) : text);
+    }
 }
 
 //---------------------------------------------------------------------------------------
@@ -187,14 +272,51 @@ void MainWindow::updateProgramList(const std::map<int, std::shared_ptr<ProgramIn
 
     for (auto& [id, programInfo] : programs)
     {
-        std::string txt = std::to_string(id);
-        auto it = programInfo->properties.find(AVStrings::ServiceName);
-        if (it != programInfo->properties.end())
-            txt += " - " + it->second;
-        programsComboBox->addItem(QString::fromStdString(txt), id);
+        if (!programInfo->removed)
+            programsComboBox->addItem(getProgramItemText(id, *programInfo), id);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The changed programs are renamed in place, the new ones are inserted by their id and
+// the removed ones are taken out (as the removed streams, the neighbour of the selected
+// one is selected then).
+void MainWindow::updateProgramListPartially(const std::map<int, std::shared_ptr<ProgramInfo>> &changed)
+{
+    for (auto& [id, programInfo] : changed)
+    {
+        int itemIndex = programsComboBox->findData(id);
+        if (programInfo->removed)
+        {
+            if (itemIndex != -1)
+                programsComboBox->removeItem(itemIndex);
+            continue;
+        }
+
+        QString txt = getProgramItemText(id, *programInfo);
+        if (itemIndex != -1)
+        {
+            programsComboBox->setItemText(itemIndex, txt);
+            continue;
+        }
+
+        int position = 0;
+        while (position < programsComboBox->count() && programsComboBox->itemData(position).toInt() < id)
+            ++position;
+        programsComboBox->insertItem(position, txt, id);
     }
 }
 
+//---------------------------------------------------------------------------------------
+QString MainWindow::getProgramItemText(int id, const ProgramInfo &programInfo)
+{
+    std::string txt = std::to_string(id);
+    auto it = programInfo.properties.find(AVStrings::ServiceName);
+    if (it != programInfo.properties.end())
+        txt += " - " + it->second;
+    return QString::fromStdString(txt);
+}
+
 //---------------------------------------------------------------------------------------
 void MainWindow::updateAudioIndicatorsCount(int audioChannelsCount)
 {
@@ -288,18 +410,122 @@ void MainWindow::processStartLockRequirement(bool locked)
     playPauseButton->setEnabled(!locked);
 }
 
+//---------------------------------------------------------------------------------------
+//   The opening of the source can be cancelled by the stop.
+void MainWindow::updatePreparingProgress(bool preparing, const QString &stage)
+{
+    if (preparing)
+    {
+        stopAction->setEnabled(true);
+        statusBar()->showMessage(tr("%1...").arg(stage));
+    }
+    else
+    {
+        stopAction->setEnabled(demuxer->getCurrentState() != QMediaPlayer::StoppedState);
+        statusBar()->clearMessage();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   Shown only while the video decoding is degraded.
+void MainWindow::updateDecodingLevel(int level, const QString &description)
+{
+    decodingLevelLabel->setText(level ? tr("Video: %1").arg(description) : QString());
+    decodingLevelLabel->setToolTip(level ? tr("The video decoding is reduced due to the CPU load") : QString());
+}
+
+//---------------------------------------------------------------------------------------
+void MainWindow::updateRecordingState(bool recording, const QString &path)
+{
+    recordProgramAction->setEnabled(!recording);
+    recordMultiplexAction->setEnabled(!recording);
+    stopRecordingAction->setEnabled(recording);
+
+    recordingLabel->setText(recording ? tr("REC: %1").arg(QFileInfo(path).fileName()) : QString());
+    recordingLabel->setToolTip(recording ? path : QString());
+}
+
+//---------------------------------------------------------------------------------------
+//   The timeshift controls are available only while the source is read through
+// the timeshift buffer.
+void MainWindow::updateTimeshift(bool active, qint64 bufferedMs, qint64 lagMs)
+{
+    timeshiftBackAction->setEnabled(active);
+    catchUpAction->setEnabled(active);
+    liveAction->setEnabled(active);
+
+    auto toString = [](qint64 ms){
+        qint64 seconds = ms / 1000;
+        return QString("%1:%2").arg(seconds / 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+    };
+    timeshiftLabel->setText(active ? tr("-%1 / %2").arg(toString(lagMs), toString(bufferedMs)) : QString());
+    timeshiftLabel->setToolTip(active ? tr("Behind the live / buffered") : QString());
+}
+
+//---------------------------------------------------------------------------------------
+//   The slider is shown only for the seekable file sources.
+void MainWindow::updateSeekRange(bool seekable, qint64 durationMs)
+{
+    this->durationMs = seekable ? durationMs : 0;
+
+    positionSlider->setRange(0, int(this->durationMs));
+    positionSlider->setValue(0);
+    positionSlider->setVisible(seekable);
+    positionLabel->setVisible(seekable);
+    updatePosition(0);
+}
+
+//---------------------------------------------------------------------------------------
+void MainWindow::updatePosition(qint64 positionMs)
+{
+    if (durationMs <= 0)
+        return;
+
+    auto toString = [](qint64 ms){
+        qint64 seconds = ms / 1000;
+        return QString("%1:%2:%3")
+                .arg(seconds / 3600, 2, 10, QChar('0'))
+                .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+                .arg(seconds % 60, 2, 10, QChar('0'));
+    };
+    positionLabel->setText(tr("%1 / %2").arg(toString(positionMs), toString(durationMs)));
+
+    // the position isn't moved under the user's hand
+    if (!positionSlider->isSliderDown())
+        positionSlider->setValue(int(positionMs));
+}
+
 //---------------------------------------------------------------------------------------
 void MainWindow::createMenu()
 {
     openFileAction = new QAction(tr("Open file..."), this);
     openStreamAction = new QAction(tr("Open stream.."), this);
+    newWindowAction = new QAction(tr("New window"), this);
+    mosaicAction = new QAction(tr("Multiviewer (all services)"), this);
+    mosaicAction->setCheckable(true);
+    recordProgramAction = new QAction(tr("Record service..."), this);
+    recordMultiplexAction = new QAction(tr("Record multiplex..."), this);
+    stopRecordingAction = new QAction(tr("Stop recording"), this);
+    stopRecordingAction->setEnabled(false);
 
     mediaMenu = menuBar()->addMenu(tr("Media"));
     mediaMenu->addAction(openFileAction);
     mediaMenu->addAction(openStreamAction);
+    mediaMenu->addAction(newWindowAction);
+    mediaMenu->addSeparator();
+    mediaMenu->addAction(mosaicAction);
+    mediaMenu->addSeparator();
+    mediaMenu->addAction(recordProgramAction);
+    mediaMenu->addAction(recordMultiplexAction);
+    mediaMenu->addAction(stopRecordingAction);
 
     connect(openFileAction, &QAction::triggered, this, &MainWindow::openMediaFile);
     connect(openStreamAction, &QAction::triggered, this, &MainWindow::openMediaStream);
+    connect(newWindowAction, &QAction::triggered, this, &MainWindow::openNewWindow);
+    connect(mosaicAction, &QAction::toggled, this, &MainWindow::processMosaicModeChange);
+    connect(recordProgramAction, &QAction::triggered, this, [this](){startRecording(false);});
+    connect(recordMultiplexAction, &QAction::triggered, this, [this](){startRecording(true);});
+    connect(stopRecordingAction, &QAction::triggered, this, &MainWindow::recordingStopRequested);
 }
 
 //---------------------------------------------------------------------------------------
@@ -315,8 +541,7 @@ void MainWindow::createMainUiLayout()
     settingsButton = new QPushButton(tr("Settings ❯❯"));
 
     detailsButton->setCheckable(true);
-    detailsButton->setEnabled(false);
-    settingsButton->setEnabled(false);
+    settingsButton->setCheckable(true);
 
     QGridLayout *ctrlLayout = new QGridLayout();
 
@@ -336,6 +561,7 @@ void MainWindow::createMainUiLayout()
     ctrlLayout->setColumnStretch(3, 1);
 
     videoWidget = new QVideoWidget(this);
+    videoWidget->installEventFilter(this);
 
     mediaLayout = new QHBoxLayout();
 
@@ -345,9 +571,28 @@ void MainWindow::createMainUiLayout()
     pauseAction = new QAction(QIcon(":/icons/pause"), tr("Pause"), this);
     stopAction = new QAction(QIcon(":/icons/stop"), tr("Stop"), this);
     stopAction->setEnabled(false);
+    timeshiftBackAction = new QAction(tr("-%1 s").arg(TimeshiftJumpSeconds), this);
+    timeshiftBackAction->setToolTip(tr("Jump back in the timeshift buffer"));
+    catchUpAction = new QAction(tr("Catch up"), this);
+    catchUpAction->setToolTip(tr("Play faster until the live is reached"));
+    liveAction = new QAction(tr("Live"), this);
+    liveAction->setToolTip(tr("Jump to the live"));
+    timeshiftBackAction->setEnabled(false);
+    catchUpAction->setEnabled(false);
+    liveAction->setEnabled(false);
 
     playPauseButton = new QToolButton();
     stopButton = new QToolButton();
+    timeshiftBackButton = new QToolButton();
+    catchUpButton = new QToolButton();
+    liveButton = new QToolButton();
+    timeshiftLabel = new QLabel();
+
+    positionSlider = new QSlider(Qt::Horizontal);
+    positionSlider->setPageStep(60000);
+    positionSlider->setVisible(false);
+    positionLabel = new QLabel();
+    positionLabel->setVisible(false);
 
     QSize ctrlButtonSize{32, 32};
     playPauseButton->setMinimumSize(ctrlButtonSize);
@@ -355,18 +600,30 @@ void MainWindow::createMainUiLayout()
 
     playPauseButton->setDefaultAction(playAction);
     stopButton->setDefaultAction(stopAction);
+    timeshiftBackButton->setDefaultAction(timeshiftBackAction);
+    catchUpButton->setDefaultAction(catchUpAction);
+    liveButton->setDefaultAction(liveAction);
 
     QHBoxLayout *btnLayout = new QHBoxLayout();
 
     btnLayout->addStretch(1);
     btnLayout->addWidget(playPauseButton);
     btnLayout->addWidget(stopButton);
+    btnLayout->addSpacing(16);
+    btnLayout->addWidget(timeshiftBackButton);
+    btnLayout->addWidget(catchUpButton);
+    btnLayout->addWidget(liveButton);
+    btnLayout->addWidget(timeshiftLabel);
     btnLayout->addStretch(1);
 
+    QHBoxLayout *seekLayout = new QHBoxLayout();
+    seekLayout->addWidget(positionSlider, 1);
+    seekLayout->addWidget(positionLabel);
 
     QVBoxLayout *vertLayout = new QVBoxLayout();
     vertLayout->addLayout(ctrlLayout);
     vertLayout->addLayout(mediaLayout, 1);
+    vertLayout->addLayout(seekLayout);
     vertLayout->addLayout(btnLayout);
 
     QWidget *wgt = new QWidget(this);
@@ -374,12 +631,23 @@ void MainWindow::createMainUiLayout()
 
     setCentralWidget(wgt);
 
+    decodingLevelLabel = new QLabel();
+    statusBar()->addPermanentWidget(decodingLevelLabel);
+    recordingLabel = new QLabel();
+    statusBar()->addPermanentWidget(recordingLabel);
+
     comboBoxToMediaTypeMap[videoStreamsComboBox] = AVMEDIA_TYPE_VIDEO;
     comboBoxToMediaTypeMap[audioStreamsComboBox] = AVMEDIA_TYPE_AUDIO;
 
     connect(videoStreamsComboBox, &QComboBox::currentIndexChanged, this, &MainWindow::processStreamChange);
     connect(audioStreamsComboBox, &QComboBox::currentIndexChanged, this, &MainWindow::processStreamChange);
     connect(programsComboBox, &QComboBox::currentIndexChanged, this, &MainWindow::processProgramChange);
+    connect(timeshiftBackAction, &QAction::triggered, this, [this](){
+        emit timeshiftSeekRequested(-TimeshiftJumpSeconds);
+    });
+    connect(catchUpAction, &QAction::triggered, this, [this](){emit timeshiftLiveRequested(true);});
+    connect(liveAction, &QAction::triggered, this, [this](){emit timeshiftLiveRequested(false);});
+    connect(positionSlider, &QSlider::sliderReleased, this, [this](){emit seekRequested(positionSlider->value());});
 }
 
 //---------------------------------------------------------------------------------------
@@ -393,7 +661,90 @@ void MainWindow::createDetailsWidget()
 //---------------------------------------------------------------------------------------
 void MainWindow::createSettingsWidget()
 {
+    settingsDockWidget = new SettingsDockWidget(this);
+    settingsDockWidget->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, settingsDockWidget);
+}
+
+//---------------------------------------------------------------------------------------
+//   The decoder scales the pictures down to the size of the video widget and doesn't
+// convert them at all while the widget isn't visible.
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == videoWidget)
+    {
+        switch (event->type())
+        {
+        case QEvent::Resize:
+        {
+            qreal ratio = videoWidget->devicePixelRatioF();
+            emit videoOutputSizeChanged(QSize(qRound(videoWidget->width() * ratio),
+                                              qRound(videoWidget->height() * ratio)));
+            updateVideoOutputVisibility();
+            break;
+        }
+        case QEvent::Show:
+        case QEvent::Hide:
+            updateVideoOutputVisibility();
+            break;
+        default:
+            break;
+        }
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
+//---------------------------------------------------------------------------------------
+void MainWindow::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::WindowStateChange)
+        updateVideoOutputVisibility();
+
+    QMainWindow::changeEvent(event);
+}
+
+//---------------------------------------------------------------------------------------
+void MainWindow::updateVideoOutputVisibility()
+{
+    bool visible = videoWidget->isVisible()
+            && !isMinimized()
+            && videoWidget->width() > 0
+            && videoWidget->height() > 0;
+
+    if (visible == videoOutputVisible)
+        return;
+
+    videoOutputVisible = visible;
+    emit videoOutputVisibilityChanged(videoOutputVisible);
+}
+
+//---------------------------------------------------------------------------------------
+//   The multiviewer shows the video of all services, the selected service gives only
+// the audio.
+void MainWindow::processMosaicModeChange(bool enabled)
+{
+    videoStreamsComboBox->setEnabled(!enabled);
+    emit mosaicModeChanged(enabled);
+}
+
+//---------------------------------------------------------------------------------------
+//   The selected service or the whole multiplex is recorded as it's received (without
+// the transcoding); the format is chosen by the extension of the file.
+void MainWindow::startRecording(bool wholeMultiplex)
+{
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Record to file"), QString(),
+                                                    tr("MPEG-TS (*.ts);;Matroska (*.mkv)"));
+    if (filePath.isEmpty())
+        return;
+
+    bool ok = false;
+    int programId = programsComboBox->currentData().toInt(&ok);
+    if (wholeMultiplex || !ok)
+        programId = -1;
 
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Record to file: %1").arg(filePath));
+    emit recordingStartRequested(filePath, programId);
 }
 
 //---------------------------------------------------------------------------------------
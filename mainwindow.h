@@ -12,6 +12,7 @@
 #include <QMenu>
 #include <QPushButton>
 #include <QRadioButton>
+#include <QSlider>
 #include <QSpinBox>
 #include <QToolButton>
 
@@ -21,6 +22,7 @@
 #include <QVideoSink>
 
 #include "detailsdockwidget.h"
+#include "settingsdockwidget.h"
 #include "loggable.h"
 
 #include "demuxer.h"
@@ -41,11 +43,16 @@ public:
 public slots:
     void openMediaFile();
     void openMediaStream();
+    void openNewWindow();
 
     void processStartPauseButtonClick();
 
     void updateStreamLists(const std::vector<std::shared_ptr<StreamInfo>> &streams);
     void updateProgramList(const std::map<int, std::shared_ptr<ProgramInfo>> &programs);
+    void updateStreamListsPartially(const std::vector<std::shared_ptr<StreamInfo>> &added,
+                                    const std::vector<int> &removed);
+    void updateProgramListPartially(const std::map<int, std::shared_ptr<ProgramInfo>> &changed);
+    void updateStreamScrambling(int streamIndex, bool scrambled);
     void updateAudioIndicatorsCount(int audioChannelsCount);
     void updateAudioIndicatorLevels(const std::vector<double> &levels);
 
@@ -53,9 +60,27 @@ public slots:
     void processStreamChange(int index);
     void processPlayerStateChange(QMediaPlayer::PlaybackState state);
     void processStartLockRequirement(bool locked);
+    void updateDecodingLevel(int level, const QString &description);
+    void updateRecordingState(bool recording, const QString &path);
+    void updateTimeshift(bool active, qint64 bufferedMs, qint64 lagMs);
+    void updateSeekRange(bool seekable, qint64 durationMs);
+    void updatePosition(qint64 positionMs);
+    void updatePreparingProgress(bool preparing, const QString &stage);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void changeEvent(QEvent *event) override;
 
 signals:
     void configureAndStartPlayer(const QString &path, Demuxer::SourceType type);
+    void videoOutputSizeChanged(const QSize &size);
+    void videoOutputVisibilityChanged(bool visible);
+    void mosaicModeChanged(bool enabled);
+    void recordingStartRequested(const QString &path, int programId);
+    void recordingStopRequested();
+    void timeshiftSeekRequested(int seconds);
+    void timeshiftLiveRequested(bool catchUp);
+    void seekRequested(qint64 positionMs);
 
     void selectedStreamChanged(AVMediaType type, int streamIndex);
 
@@ -67,6 +92,17 @@ private:
 
     void openMedia(const QString& uri, Demuxer::SourceType type);
 
+    void insertStreamItem(const StreamInfo &streamInfo);
+    static QString getProgramItemText(int id, const ProgramInfo &programInfo);
+
+    void updateVideoOutputVisibility();
+    void processMosaicModeChange(bool enabled);
+    void startRecording(bool wholeMultiplex);
+
+    // the data of the stream items: the key which keeps them sorted by PID, the text
+    // without the scrambling mark
+    enum { SortKeyRole = Qt::UserRole + 1, BaseTextRole = Qt::UserRole + 2 };
+
     Ui::MainWindow *ui;
 
     QComboBox *programsComboBox;
@@ -77,27 +113,45 @@ private:
     QPushButton *detailsButton;
     QPushButton *settingsButton;
 
+    QLabel *decodingLevelLabel;
+    QLabel *recordingLabel;
+
     QHBoxLayout *mediaLayout;
     QVideoWidget *videoWidget;
+    bool videoOutputVisible{true};
 
     QToolButton *playPauseButton;
     QToolButton *stopButton;
+    QToolButton *timeshiftBackButton;
+    QToolButton *catchUpButton;
+    QToolButton *liveButton;
+    QLabel *timeshiftLabel;
+    QSlider *positionSlider;
+    QLabel *positionLabel;
+    qint64 durationMs{0};
 
     DetailsDockWidget *detailsDockWidget;
-    QDockWidget *settingsDockWidget;
+    SettingsDockWidget *settingsDockWidget;
 
     QMenu *mediaMenu;
 
     QAction *openFileAction;
     QAction *openStreamAction;
+    QAction *newWindowAction;
+    QAction *mosaicAction;
+    QAction *recordProgramAction;
+    QAction *recordMultiplexAction;
+    QAction *stopRecordingAction;
     QAction *playAction;
     QAction *pauseAction;
     QAction *stopAction;
+    QAction *timeshiftBackAction;
+    QAction *catchUpAction;
+    QAction *liveAction;
 
     QString mediaSourceUri;
 
     Demuxer *demuxer;
-    QThread demuxThread;
 
     std::vector<AudioLevelWidget*> audioIndicators;
 
@@ -0,0 +1,205 @@
+#include "activepicturedetector.h"
+
+#include <algorithm>
+
+#include "simd.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+//---------------------------------------------------------------------------------------
+//   Updates the column maxima with the row and returns the maximum of the row.
+static uint8_t accumulateRowMax(const uint8_t *row, uint8_t *columnMax, int width)
+{
+    int x = 0;
+    uint8_t rowMax = 0;
+
+#ifdef PLAYER_SIMD_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        __m128i columns = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columnMax + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(columnMax + x), _mm_max_epu8(columns, pixels));
+        acc = _mm_max_epu8(acc, pixels);
+    }
+    // horizontal maximum of 16 bytes
+    acc = _mm_max_epu8(acc, _mm_srli_si128(acc, 8));
+    acc = _mm_max_epu8(acc, _mm_srli_si128(acc, 4));
+    acc = _mm_max_epu8(acc, _mm_srli_si128(acc, 2));
+    acc = _mm_max_epu8(acc, _mm_srli_si128(acc, 1));
+    rowMax = static_cast<uint8_t>(_mm_cvtsi128_si32(acc) & 0xFF);
+#endif
+
+    for (; x < width; ++x)
+    {
+        columnMax[x] = std::max(columnMax[x], row[x]);
+        rowMax = std::max(rowMax, row[x]);
+    }
+    return rowMax;
+}
+
+//---------------------------------------------------------------------------------------
+ActivePictureDetector::ActivePictureDetector()
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+//   Returns true if the active area was changed by this frame.
+bool ActivePictureDetector::analyse(const AVFrame *frame)
+{
+    if (frame->width != width || frame->height != height || frame->format != format)
+    {
+        reset();
+        width = frame->width;
+        height = frame->height;
+        format = frame->format;
+
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(format));
+        alignX = desc ? 1 << desc->log2_chroma_w : 2;
+    }
+
+    if (frameCounter++ < nextSampleFrame)
+        return false;
+    nextSampleFrame = frameCounter + SampleInterval;
+
+    QRect area;
+    if (measure(frame, area))
+    {
+        roundArea = measuredSamples ? roundArea.united(area) : area;
+        measuredSamples++;
+    }
+
+    if (++samples < SamplesPerRound)
+        return false;
+
+    return finishRound();
+}
+
+//---------------------------------------------------------------------------------------
+void ActivePictureDetector::reset()
+{
+    width = 0;
+    height = 0;
+    format = -1;
+    frameCounter = 0;
+    nextSampleFrame = 0;
+    samples = 0;
+    measuredSamples = 0;
+    roundArea = QRect();
+    candidateArea = QRect();
+    activeArea = QRect();
+    detected = false;
+}
+
+//---------------------------------------------------------------------------------------
+bool ActivePictureDetector::hasActiveArea() const
+{
+    return detected && activeArea != QRect(0, 0, width, height);
+}
+
+//---------------------------------------------------------------------------------------
+QRect ActivePictureDetector::getActiveArea() const
+{
+    return detected ? activeArea : QRect(0, 0, width, height);
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the planar formats with 8-bit luma are measured (other formats are left
+// as is). Returns false for the black frames.
+bool ActivePictureDetector::measure(const AVFrame *frame, QRect &area)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if (!desc
+            || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))
+            || desc->comp[0].depth != 8
+            || desc->comp[0].step != 1
+            || !frame->data[0])
+        return false;
+
+    // black is 0 for the full range, 16 for the limited range; leave a margin for noise
+    int blackLevel = frame->color_range == AVCOL_RANGE_JPEG ? 16 : 32;
+
+    columnMax.assign(frame->width, 0);
+
+    int top = -1;
+    int bottom = -1;
+    for (int y = 0; y < frame->height; y += RowStep)
+    {
+        const uint8_t *row = frame->data[0] + int64_t(y) * frame->linesize[0];
+        if (accumulateRowMax(row, columnMax.data(), frame->width) > blackLevel)
+        {
+            if (top < 0)
+                top = y;
+            bottom = std::min(y + RowStep - 1, frame->height - 1);
+        }
+    }
+
+    if (top < 0)
+        return false;
+
+    int left = 0;
+    while (left < frame->width && columnMax[left] <= blackLevel)
+        left++;
+
+    int right = frame->width - 1;
+    while (right > left && columnMax[right] <= blackLevel)
+        right--;
+
+    area = QRect(QPoint(left, top), QPoint(right, bottom));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool ActivePictureDetector::finishRound()
+{
+    bool measured = measuredSamples > 0;
+    QRect area = alignArea(roundArea);
+
+    samples = 0;
+    measuredSamples = 0;
+    roundArea = QRect();
+
+    if (!measured)
+    {   // only black frames, try again soon
+        nextSampleFrame = frameCounter + SampleInterval;
+        return false;
+    }
+    nextSampleFrame = frameCounter + ReevaluationInterval;
+
+    bool accepted = !detected || area == candidateArea;
+    candidateArea = area;
+    if (!accepted || (detected && area == activeArea))
+        return false;
+
+    activeArea = area;
+    detected = true;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+QRect ActivePictureDetector::alignArea(const QRect &area) const
+{
+    QRect fullFrame(0, 0, width, height);
+
+    // a small bright object in the dark scene isn't the active picture
+    if (area.width() < width / 2 || area.height() < height / 2)
+        return fullFrame;
+
+    int left = area.left() < MinBlanking ? 0 : area.left();
+    int top = area.top() < MinBlanking ? 0 : area.top();
+    int right = width - 1 - area.right() < MinBlanking ? width : area.right() + 1;
+    int bottom = height - 1 - area.bottom() < MinBlanking ? height : area.bottom() + 1;
+
+    // expand to the chroma subsampling and to the even lines (field parity)
+    left = left / alignX * alignX;
+    right = std::min(width, (right + alignX - 1) / alignX * alignX);
+    top = top / 2 * 2;
+    bottom = std::min(height, (bottom + 1) / 2 * 2);
+
+    return QRect(left, top, right - left, bottom - top);
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,65 @@
+#ifndef ACTIVEPICTUREDETECTOR_H
+#define ACTIVEPICTUREDETECTOR_H
+
+#include <QRect>
+
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+//---------------------------------------------------------------------------------------
+//   Detects the blanking (black borders) around the active picture.
+//   Every SampleInterval-th frame is measured on the luma plane decimated by RowStep
+// vertically: the maximum of each sampled row and of each column is compared with the
+// black level. The active area of the round is the union of SamplesPerRound measured
+// frames, so dark scenes don't shrink it; completely black frames are skipped.
+//   The first round sets the active area, then the detection is repeated every
+// ReevaluationInterval frames and a new area is accepted only when two consecutive
+// rounds agree. The area is aligned to the chroma subsampling and to the field
+// parity (even lines).
+class ActivePictureDetector
+{
+public:
+    ActivePictureDetector();
+
+    bool analyse(const AVFrame *frame);
+    void reset();
+
+    bool hasActiveArea() const;
+    QRect getActiveArea() const;
+
+private:
+    bool measure(const AVFrame *frame, QRect &area);
+    bool finishRound();
+    QRect alignArea(const QRect &area) const;
+
+    enum {
+        SampleInterval = 12,
+        SamplesPerRound = 8,
+        ReevaluationInterval = 1500,
+        RowStep = 2,
+        // blanking narrower than this is ignored
+        MinBlanking = 4
+    };
+
+    int width{0};
+    int height{0};
+    int format{-1};
+    int alignX{2};
+
+    int64_t frameCounter{0};
+    int64_t nextSampleFrame{0};
+    int samples{0};
+    int measuredSamples{0};
+
+    QRect roundArea;
+    QRect candidateArea;
+    QRect activeArea;
+    bool detected{false};
+
+    std::vector<uint8_t> columnMax;
+};
+
+#endif // ACTIVEPICTUREDETECTOR_H
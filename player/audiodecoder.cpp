@@ -8,6 +8,12 @@ AudioDecoder::AudioDecoder(const QString &name, QObject *parent)
 
 }
 
+//---------------------------------------------------------------------------------------
+AudioDecoder::~AudioDecoder()
+{
+    releaseResampler();
+}
+
 //---------------------------------------------------------------------------------------
 void AudioDecoder::setAudioLevelMeter(const std::shared_ptr<AudioLevelMeter> &meter)
 {
@@ -77,7 +83,12 @@ int AudioDecoder::outputFrame(AVFrame *avFrame)
 {
     std::shared_ptr<AudioFrame> audioFrame(new AudioFrame(avFrame->pts));
 
-    int size = audioFrame->fromAvFrame(avFrame);
+    int size = 0;
+    if (prepareResampler(avFrame))
+    {
+        int samples = compensate(avFrame);
+        size = audioFrame->fromAvFrame(avFrame, swrContext, samples + ExtraOutputSamples);
+    }
 
     if (size)
         emit audioSampleReady(audioFrame);
@@ -89,3 +100,86 @@ int AudioDecoder::outputFrame(AVFrame *avFrame)
 }
 
 //---------------------------------------------------------------------------------------
+void AudioDecoder::flush()
+{
+    Decoder::flush();
+    releaseResampler();
+}
+
+//---------------------------------------------------------------------------------------
+void AudioDecoder::setClockRatio(double ratio)
+{
+    clockRatio.store(ratio);
+}
+
+//---------------------------------------------------------------------------------------
+//   The context is created again when the format of the frames is changed.
+bool AudioDecoder::prepareResampler(const AVFrame *avFrame)
+{
+    if (swrContext && swrSampleRate == avFrame->sample_rate && swrSampleFormat == avFrame->format
+            && av_channel_layout_compare(&swrChannelLayout, &avFrame->ch_layout) == 0)
+        return true;
+
+    releaseResampler();
+
+    AVSampleFormat inSampleFormat = static_cast<AVSampleFormat>(avFrame->format);
+    AVSampleFormat outSampleFormat = av_get_packed_sample_fmt(inSampleFormat);
+    int result = swr_alloc_set_opts2(&swrContext,
+                                     &avFrame->ch_layout, outSampleFormat, avFrame->sample_rate,
+                                     &avFrame->ch_layout, inSampleFormat, avFrame->sample_rate,
+                                     0, nullptr);
+    if (result >= 0)
+        result = swr_init(swrContext);
+    if (result < 0)
+    {
+        loggable.logAvError(objectName(), QtWarningMsg, "Could not create the audio resampler.", result);
+        releaseResampler();
+        return false;
+    }
+
+    swrSampleRate = avFrame->sample_rate;
+    swrSampleFormat = avFrame->format;
+    av_channel_layout_copy(&swrChannelLayout, &avFrame->ch_layout);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   The drift is a few samples per second at most: the whole samples are added or
+// removed over the frame (the resampler spreads them), the fraction is carried to the
+// next frames. Returns the number of the output samples.
+int AudioDecoder::compensate(const AVFrame *avFrame)
+{
+    double ratio = clockRatio.load();
+    if (ratio == 1.0)
+    {
+        compensationRemainder = 0.0;
+        return avFrame->nb_samples;
+    }
+
+    compensationRemainder += avFrame->nb_samples * (ratio - 1.0);
+    int delta = int(compensationRemainder);
+    if (delta == 0)
+        return avFrame->nb_samples;
+
+    compensationRemainder -= delta;
+    int result = swr_set_compensation(swrContext, delta, avFrame->nb_samples + delta);
+    if (result < 0)
+    {
+        loggable.logAvError(objectName(), QtWarningMsg, "Could not compensate the clock drift.", result);
+        return avFrame->nb_samples;
+    }
+    return avFrame->nb_samples + delta;
+}
+
+//---------------------------------------------------------------------------------------
+void AudioDecoder::releaseResampler()
+{
+    if (swrContext)
+        swr_free(&swrContext);
+    av_channel_layout_uninit(&swrChannelLayout);
+    swrSampleRate = 0;
+    swrSampleFormat = AV_SAMPLE_FMT_NONE;
+    compensationRemainder = 0.0;
+}
+
+//---------------------------------------------------------------------------------------
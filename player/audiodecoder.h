@@ -14,6 +14,7 @@ class AudioDecoder : public Decoder
     Q_OBJECT
 public:
     explicit AudioDecoder(const QString& name, QObject *parent = nullptr);
+    virtual ~AudioDecoder();
 
     void setAudioLevelMeter(const std::shared_ptr<AudioLevelMeter> &meter);
 
@@ -23,11 +24,25 @@ public:
     int inputChannelCount() const;
 
     int outputFrame(AVFrame *avFrame) override;
+    void flush() override;
+
+    // the local time per the time of the stream (of the recovered sender clock): the
+    // samples are stretched or shrunk by it
+    void setClockRatio(double ratio);
 
 signals:
      void audioSampleReady(const std::shared_ptr<AudioFrame> audioFrame);
 
 private:
+     bool prepareResampler(const AVFrame *avFrame);
+     int compensate(const AVFrame *avFrame);
+     void releaseResampler();
+
+     enum {
+         // the margin of the output buffer for the compensation
+         ExtraOutputSamples = 256
+     };
+
      int inChannelCount{0};
 
      int outChannelCount{0};
@@ -36,6 +51,15 @@ private:
      AVChannelLayout outChannelLayout;
 
      std::shared_ptr<AudioLevelMeter> levelMeter;
+
+     // the resampler is kept between the frames, so the compensation is continuous
+     SwrContext *swrContext{nullptr};
+     int swrSampleRate{0};
+     int swrSampleFormat{AV_SAMPLE_FMT_NONE};
+     AVChannelLayout swrChannelLayout{};
+     std::atomic<double> clockRatio{1.0};
+     // the fraction of the sample not compensated yet
+     double compensationRemainder{0.0};
 };
 
 #endif // AUDIODECODER_H
@@ -47,6 +47,26 @@ int AudioFrame::fromAvFrame(const AVFrame *avFrame)
     return size;
 }
 
+//---------------------------------------------------------------------------------------
+int AudioFrame::fromAvFrame(const AVFrame *avFrame, SwrContext *swrContext, int maxSamples)
+{
+    if (!avFrame || !swrContext)
+        return size;
+
+    AVSampleFormat outSampleFormat = av_get_packed_sample_fmt(static_cast<AVSampleFormat>(avFrame->format));
+    int channels = avFrame->ch_layout.nb_channels;
+    int bufferSize = av_samples_get_buffer_size(nullptr, channels, maxSamples, outSampleFormat, 0);
+    if (bufferSize <= 0)
+        return 0;
+
+    data = new uint8_t[bufferSize];
+    int samples = swr_convert(swrContext, &data, maxSamples,
+                              const_cast<const uint8_t**>(avFrame->data), avFrame->nb_samples);
+    size = samples > 0 ? samples * channels * av_get_bytes_per_sample(outSampleFormat) : 0;
+
+    return size;
+}
+
 //---------------------------------------------------------------------------------------
 int AudioFrame::getSize() const
 {
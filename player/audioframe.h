@@ -21,6 +21,9 @@ public:
     virtual ~AudioFrame();
 
     int fromAvFrame(const AVFrame *avFrame) override;
+    // converted by the context of the caller (which keeps the resampling state between
+    // the frames), up to maxSamples
+    int fromAvFrame(const AVFrame *avFrame, SwrContext *swrContext, int maxSamples);
 
     int getSize() const;
     const char* getData() const;
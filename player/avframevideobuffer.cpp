@@ -0,0 +1,87 @@
+#include "avframevideobuffer.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+//---------------------------------------------------------------------------------------
+AvFrameVideoBuffer::AvFrameVideoBuffer(const AVFrame *avFrame, const QVideoFrameFormat &format)
+#if QT_VERSION < QT_VERSION_CHECK(6, 8, 0)
+    : QAbstractVideoBuffer(QVideoFrame::NoHandle)
+    , frameFormat(format)
+#else
+    : frameFormat(format)
+#endif
+{
+    frame = av_frame_clone(avFrame);
+}
+
+//---------------------------------------------------------------------------------------
+AvFrameVideoBuffer::~AvFrameVideoBuffer()
+{
+    if (frame)
+        av_frame_free(&frame);
+}
+
+//---------------------------------------------------------------------------------------
+bool AvFrameVideoBuffer::isValid() const
+{
+    return frame != nullptr;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+//---------------------------------------------------------------------------------------
+QVideoFrameFormat AvFrameVideoBuffer::format() const
+{
+    return frameFormat;
+}
+#else
+//---------------------------------------------------------------------------------------
+QVideoFrame::MapMode AvFrameVideoBuffer::mapMode() const
+{
+    return currentMapMode;
+}
+
+//---------------------------------------------------------------------------------------
+void AvFrameVideoBuffer::unmap()
+{
+    currentMapMode = QVideoFrame::NotMapped;
+}
+#endif
+
+//---------------------------------------------------------------------------------------
+AvFrameVideoBuffer::MapData AvFrameVideoBuffer::map(QVideoFrame::MapMode mode)
+{
+    MapData mapData;
+
+    // the decoded picture may be referenced by the decoder, it must not be modified
+    if (!frame || mode != QVideoFrame::ReadOnly)
+        return mapData;
+
+    currentMapMode = mode;
+
+    int planes = av_pix_fmt_count_planes(static_cast<AVPixelFormat>(frame->format));
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    for (int i = 0; i < planes && i < 4; ++i)
+    {
+        int height = frame->height;
+        if (i > 0 && desc && (desc->flags & AV_PIX_FMT_FLAG_PLANAR))
+            height = AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+        mapData.data[i] = frame->data[i];
+        mapData.bytesPerLine[i] = frame->linesize[i];
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+        mapData.dataSize[i] = frame->linesize[i] * height;
+#else
+        mapData.size[i] = frame->linesize[i] * height;
+#endif
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    mapData.planeCount = planes;
+#else
+    mapData.nPlanes = planes;
+#endif
+
+    return mapData;
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+#ifndef AVFRAMEVIDEOBUFFER_H
+#define AVFRAMEVIDEOBUFFER_H
+
+#include <QVideoFrame>
+#include <QVideoFrameFormat>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QAbstractVideoBuffer>
+#else
+#include <private/qabstractvideobuffer_p.h>
+#endif
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+//---------------------------------------------------------------------------------------
+//   Video buffer which exposes the planes of the decoded AVFrame to the Qt without
+// copying. It holds a reference to the frame, so the picture buffer returns to the
+// decoder's pool only when the video sink releases the QVideoFrame.
+class AvFrameVideoBuffer : public QAbstractVideoBuffer
+{
+public:
+    AvFrameVideoBuffer(const AVFrame *avFrame, const QVideoFrameFormat &format);
+    ~AvFrameVideoBuffer();
+
+    bool isValid() const;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    MapData map(QVideoFrame::MapMode mode) override;
+    QVideoFrameFormat format() const override;
+#else
+    QVideoFrame::MapMode mapMode() const override;
+    MapData map(QVideoFrame::MapMode mode) override;
+    void unmap() override;
+#endif
+
+private:
+    AVFrame *frame{nullptr};
+    QVideoFrameFormat frameFormat;
+    QVideoFrame::MapMode currentMapMode{QVideoFrame::NotMapped};
+};
+
+#endif // AVFRAMEVIDEOBUFFER_H
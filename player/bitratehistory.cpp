@@ -0,0 +1,125 @@
+#include "bitratehistory.h"
+
+#include <algorithm>
+
+static const int BucketCounts[BitrateHistory::ResolutionCount] = {300, 180, 240};
+static const int BucketSeconds[BitrateHistory::ResolutionCount] = {1, 10, 60};
+
+//---------------------------------------------------------------------------------------
+void BitrateHistory::addSamples(const std::vector<std::pair<int, int64_t>> &samples)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    for (const auto &[pid, bitrate] : samples)
+    {
+        auto it = pids.find(pid);
+        if (it == pids.end())
+        {
+            if (int(pids.size()) >= MaxPids)
+                continue;
+
+            it = pids.emplace(pid, PidHistory{}).first;
+            for (int resolution = 0; resolution < ResolutionCount; ++resolution)
+                it->second.rings[resolution].buckets.resize(size_t(BucketCounts[resolution]));
+        }
+
+        addBucket(it->second, Seconds, BitrateBucket{bitrate, bitrate, bitrate});
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void BitrateHistory::clear()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    pids.clear();
+}
+
+//---------------------------------------------------------------------------------------
+std::vector<int> BitrateHistory::getPids() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    std::vector<int> result;
+    result.reserve(pids.size());
+    for (const auto &[pid, history] : pids)
+        result.push_back(pid);
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+std::vector<BitrateBucket> BitrateHistory::getBuckets(int pid, int resolution) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    std::vector<BitrateBucket> result;
+    auto it = pids.find(pid);
+    if (it == pids.end() || resolution < 0 || resolution >= ResolutionCount)
+        return result;
+
+    const Ring &ring = it->second.rings[resolution];
+    int size = int(ring.buckets.size());
+    result.reserve(size_t(ring.count));
+    for (int i = 0; i < ring.count; ++i)
+        result.push_back(ring.buckets[size_t((ring.head - ring.count + i + size) % size)]);
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+BitrateBucket BitrateHistory::getLastBucket(int pid, int resolution) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    auto it = pids.find(pid);
+    if (it == pids.end() || resolution < 0 || resolution >= ResolutionCount)
+        return BitrateBucket{};
+
+    const Ring &ring = it->second.rings[resolution];
+    if (ring.count == 0)
+        return BitrateBucket{};
+
+    int size = int(ring.buckets.size());
+    return ring.buckets[size_t((ring.head - 1 + size) % size)];
+}
+
+//---------------------------------------------------------------------------------------
+int BitrateHistory::getBucketCount(int resolution)
+{
+    return BucketCounts[std::clamp(resolution, 0, ResolutionCount - 1)];
+}
+
+//---------------------------------------------------------------------------------------
+int BitrateHistory::getBucketSeconds(int resolution)
+{
+    return BucketSeconds[std::clamp(resolution, 0, ResolutionCount - 1)];
+}
+
+//---------------------------------------------------------------------------------------
+//   The bucket is stored in its ring and collected for the next resolution; when
+// enough of them are collected, the coarser bucket is completed in the same way.
+void BitrateHistory::addBucket(PidHistory &history, int resolution, const BitrateBucket &bucket)
+{
+    Ring &ring = history.rings[resolution];
+    int size = int(ring.buckets.size());
+    ring.buckets[size_t(ring.head)] = bucket;
+    ring.head = (ring.head + 1) % size;
+    ring.count = std::min(ring.count + 1, size);
+
+    if (resolution + 1 >= ResolutionCount)
+        return;
+
+    Accumulator &accumulator = history.accumulators[resolution];
+    accumulator.min = accumulator.count ? std::min(accumulator.min, bucket.min) : bucket.min;
+    accumulator.max = accumulator.count ? std::max(accumulator.max, bucket.max) : bucket.max;
+    accumulator.sum += bucket.avg;
+    accumulator.count++;
+
+    int ratio = BucketSeconds[resolution + 1] / BucketSeconds[resolution];
+    if (accumulator.count < ratio)
+        return;
+
+    BitrateBucket coarse{accumulator.min, accumulator.sum / accumulator.count, accumulator.max};
+    accumulator = Accumulator{};
+    addBucket(history, resolution + 1, coarse);
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+#ifndef BITRATEHISTORY_H
+#define BITRATEHISTORY_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct BitrateBucket
+{
+    int64_t min{0};
+    int64_t avg{0};
+    int64_t max{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   History of the bitrate of each PID at several resolutions: the last 5 minutes by
+// 1 second, the last 30 minutes by 10 seconds and the last 4 hours by 1 minute. Each
+// resolution is the fixed ring of min/avg/max buckets, the coarser buckets are
+// aggregated from the finer ones; the number of PIDs is limited too, so the memory
+// doesn't grow however long the source is played.
+//   Fed by the transport stream analyser once per second of the stream, read by
+// the views from the GUI thread.
+class BitrateHistory
+{
+public:
+    enum Resolution {
+        Seconds,
+        TenSeconds,
+        Minutes,
+        ResolutionCount
+    };
+
+    // pairs of PID and bitrate (bit/s) of the last second
+    void addSamples(const std::vector<std::pair<int, int64_t>> &samples);
+    void clear();
+
+    std::vector<int> getPids() const;
+    // the oldest first
+    std::vector<BitrateBucket> getBuckets(int pid, int resolution) const;
+    BitrateBucket getLastBucket(int pid, int resolution) const;
+
+    static int getBucketCount(int resolution);
+    static int getBucketSeconds(int resolution);
+
+private:
+    struct Ring
+    {
+        std::vector<BitrateBucket> buckets;
+        int head{0};
+        int count{0};
+    };
+
+    // the finer buckets collected for the next coarser one
+    struct Accumulator
+    {
+        int64_t min{0};
+        int64_t max{0};
+        int64_t sum{0};
+        int count{0};
+    };
+
+    struct PidHistory
+    {
+        std::array<Ring, ResolutionCount> rings;
+        std::array<Accumulator, ResolutionCount - 1> accumulators;
+    };
+
+    void addBucket(PidHistory &history, int resolution, const BitrateBucket &bucket);
+
+    enum {
+        MaxPids = 256
+    };
+
+    mutable std::mutex mutex;
+    std::map<int, PidHistory> pids;
+};
+
+#endif // BITRATEHISTORY_H
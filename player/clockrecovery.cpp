@@ -0,0 +1,136 @@
+#include "clockrecovery.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const int64_t PcrMask = (int64_t(1) << 33) - 1;
+static const double TicksPerUs = 0.09;
+static const double Damping = 0.707;
+
+//---------------------------------------------------------------------------------------
+ClockRecovery::ClockRecovery(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("ClockRecovery");
+}
+
+//---------------------------------------------------------------------------------------
+void ClockRecovery::reset()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    ratio.store(1.0);
+    lastPcr = -1;
+    baseUs = 0.0;
+    loopRatio = 1.0;
+    ticks = 0;
+    windowMinErrorUs = 0.0;
+    windowEmpty = true;
+    goodWindows = 0;
+    locked = false;
+    status = ClockRecoveryStatus{};
+}
+
+//---------------------------------------------------------------------------------------
+void ClockRecovery::addReference(int64_t pcr, int64_t arrivalUs)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    status.references++;
+    if (lastPcr < 0)
+    {
+        lastPcr = pcr;
+        relock(arrivalUs);
+        return;
+    }
+
+    // the backward step is the discontinuity as well
+    int64_t delta = (pcr - lastPcr) & PcrMask;
+    lastPcr = pcr;
+    ticks += delta;
+
+    double errorUs = double(arrivalUs) - (baseUs + double(ticks) / TicksPerUs * loopRatio);
+    if (delta > PcrMask / 2 || std::fabs(errorUs) > RelockErrorUs)
+    {
+        status.relocks++;
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Discontinuity of the sender clock (%1 ms), relock.").arg(errorUs / 1000.0, 0, 'f', 1));
+        relock(arrivalUs);
+        return;
+    }
+
+    if (windowEmpty || errorUs < windowMinErrorUs)
+        windowMinErrorUs = errorUs;
+    windowEmpty = false;
+
+    if (ticks >= int64_t(DetectorWindowMs) * 90)
+    {
+        // the model is moved to the end of the window, so the new ratio applies only
+        // to the following sender time
+        baseUs += double(ticks) / TicksPerUs * loopRatio;
+        ticks = 0;
+        updateLoop(windowMinErrorUs);
+        windowEmpty = true;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+double ClockRecovery::getRatio() const
+{
+    return ratio.load(std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------------------
+ClockRecoveryStatus ClockRecovery::getStatus() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return status;
+}
+
+//---------------------------------------------------------------------------------------
+//   The model starts from the reference, the ratio found so far is kept.
+void ClockRecovery::relock(int64_t arrivalUs)
+{
+    baseUs = double(arrivalUs);
+    ticks = 0;
+    windowEmpty = true;
+    goodWindows = 0;
+}
+
+//---------------------------------------------------------------------------------------
+//   PI filter: the phase is corrected by the proportional part, the ratio by the
+// integral one (the gains are of the critically damped loop of the given period).
+void ClockRecovery::updateLoop(double errorUs)
+{
+    const double pi = 3.14159265358979323846;
+    double windowSeconds = DetectorWindowMs / 1000.0;
+    double naturalFrequency = 2.0 * pi / (locked ? TrackingPeriodSeconds : AcquisitionPeriodSeconds);
+    double proportionalGain = 2.0 * Damping * naturalFrequency * windowSeconds;
+    double integralGain = naturalFrequency * naturalFrequency * windowSeconds * windowSeconds;
+
+    baseUs += proportionalGain * errorUs;
+    loopRatio += integralGain * errorUs / (windowSeconds * 1000000.0);
+    loopRatio = std::clamp(loopRatio, 1.0 - MaxDriftPpm / 1000000.0, 1.0 + MaxDriftPpm / 1000000.0);
+
+    goodWindows = std::fabs(errorUs) < LockErrorUs ? goodWindows + 1 : 0;
+    if (!locked && goodWindows >= LockWindows)
+    {
+        locked = true;
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Sender clock is locked, drift %1 ppm.").arg((1.0 / loopRatio - 1.0) * 1000000.0, 0, 'f', 2));
+    }
+    else if (locked && std::fabs(errorUs) > UnlockErrorUs)
+    {
+        locked = false;
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Sender clock lock is lost (error %1 ms).").arg(errorUs / 1000.0, 0, 'f', 1));
+    }
+
+    ratio.store(locked ? loopRatio : 1.0, std::memory_order_relaxed);
+
+    status.locked = locked;
+    status.driftPpm = (1.0 / loopRatio - 1.0) * 1000000.0;
+    status.phaseErrorUs = int64_t(errorUs);
+}
+
+//---------------------------------------------------------------------------------------
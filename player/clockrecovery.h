@@ -0,0 +1,86 @@
+#ifndef CLOCKRECOVERY_H
+#define CLOCKRECOVERY_H
+
+#include <QObject>
+
+#include <atomic>
+#include <mutex>
+
+#include "loggable.h"
+
+struct ClockRecoveryStatus
+{
+    bool locked{false};
+    // the sender clock against the local one (positive - the sender is faster)
+    double driftPpm{0.0};
+    // the minimum arrival error of the last detector window
+    int64_t phaseErrorUs{0};
+    int64_t references{0};
+    int64_t relocks{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Recovery of the sender clock of the live stream from its PCR and the local arrival
+// time of the packets which carry it.
+//   The clock is modelled by the line (the local time of the sender time) which is
+// corrected by the second order loop (PI filter, like the PLL of the hardware decoder)
+// once per detector window. The network delays only add to the arrival time, so the
+// phase detector takes the minimum error of the window: the model follows the packets
+// which arrived with the least delay, the jitter doesn't move it. The loop is wide
+// while acquiring and is narrowed when it's locked.
+//   The references are added by the receiving thread, the ratio is read lock-free by
+// the pacing.
+class ClockRecovery : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ClockRecovery(QObject *parent = nullptr);
+
+    void reset();
+    // PCR base (33 bits of 90 kHz) and the arrival time (av_gettime_relative)
+    void addReference(int64_t pcr, int64_t arrivalUs);
+
+    // the local microseconds per the sender microsecond (1.0 until the lock)
+    double getRatio() const;
+    ClockRecoveryStatus getStatus() const;
+
+private:
+    void relock(int64_t arrivalUs);
+    void updateLoop(double errorUs);
+
+    enum {
+        DetectorWindowMs = 1000,
+        // the loop periods (2 pi / natural frequency)
+        AcquisitionPeriodSeconds = 20,
+        TrackingPeriodSeconds = 300,
+        // the windows with the small errors which lock the loop
+        LockWindows = 30,
+        LockErrorUs = 2000,
+        UnlockErrorUs = 20000,
+        // the larger errors are the discontinuities of PCR (or of the network)
+        RelockErrorUs = 500000,
+        MaxDriftPpm = 200
+    };
+
+    mutable std::mutex mutex;
+    // published only while locked
+    std::atomic<double> ratio{1.0};
+
+    int64_t lastPcr{-1};
+    // the model: the local time of the base and the ratio
+    double baseUs{0.0};
+    double loopRatio{1.0};
+    // 90 kHz ticks from the base
+    int64_t ticks{0};
+
+    double windowMinErrorUs{0.0};
+    bool windowEmpty{true};
+    int goodWindows{0};
+    bool locked{false};
+
+    ClockRecoveryStatus status;
+
+    Loggable loggable;
+};
+
+#endif // CLOCKRECOVERY_H
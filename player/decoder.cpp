@@ -13,33 +13,101 @@ Decoder::~Decoder()
 {
     loggable.logMessage(objectName(), QtDebugMsg, "Destroy decoder...");
 
+    if (codec)
+        DecoderThreadingPolicy::getInstance()->unregisterDecoder(this);
+
     if (codecContext)
         avcodec_free_context(&codecContext);
     if (frame)
         av_frame_free(&frame);
+    if (codecParameters)
+        avcodec_parameters_free(&codecParameters);
 }
 
 //---------------------------------------------------------------------------------------
 bool Decoder::open(AVStream *stream)
 {
-    int result;
     int streamIndex = stream->index;
     int streamId = stream->id;
 
     QString msg = QString("Open decoder for stream (index %1, id %2)...").arg(streamIndex).arg(streamId);
     loggable.logMessage(objectName(), QtDebugMsg, msg);
 
-    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
-    if (!codec)
+    this->stream = stream;
+    const AVCodec* foundCodec = avcodec_find_decoder(getCodecParameters()->codec_id);
+    if (!foundCodec)
     {
         loggable.logMessage(objectName(), QtCriticalMsg, "Unable find decoder.");
         return false;
     }
 
     msg = QString("Found decoder for stream (index %1, id %2) => %3 / %4")
-            .arg(streamIndex).arg(streamId).arg(codec->name, codec->long_name);
+            .arg(streamIndex).arg(streamId).arg(foundCodec->name, foundCodec->long_name);
     loggable.logMessage(objectName(), QtDebugMsg, msg);
 
+    codec = foundCodec;
+
+    DecoderThreading settings = DecoderThreadingPolicy::getInstance()->registerDecoder(this, codec, getCodecParameters(),
+                                                                                       lowDelay.load());
+    {
+        std::lock_guard<std::mutex> guard(threadingMutex);
+        // the policy might have already rebalanced the threads after the registration
+        if (!threadingChanged.load())
+            threading = settings;
+    }
+
+    if (!reopenCodecContext())
+        return false;
+
+    loggable.logMessage(objectName(), QtDebugMsg, "Allocate frame and packet for decoding.");
+    frame = av_frame_alloc();
+    if (!frame)
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate frame.");
+        return false;
+    }
+
+    decodingTimeNs.store(0);
+    decodedFrames.store(0);
+    openTimer.start();
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void Decoder::setCodecParameters(const AVCodecParameters *parameters)
+{
+    if (!codecParameters)
+        codecParameters = avcodec_parameters_alloc();
+    if (codecParameters && avcodec_parameters_copy(codecParameters, parameters) < 0)
+        avcodec_parameters_free(&codecParameters);
+}
+
+//---------------------------------------------------------------------------------------
+void Decoder::releaseCodecParameters()
+{
+    if (codecParameters)
+        avcodec_parameters_free(&codecParameters);
+}
+
+//---------------------------------------------------------------------------------------
+const AVCodecParameters *Decoder::getCodecParameters() const
+{
+    return codecParameters ? codecParameters : stream->codecpar;
+}
+
+//---------------------------------------------------------------------------------------
+//   (Re)creates the codec context with the current threading settings.
+//   The threading parameters of the libavcodec can't be changed for the opened codec,
+// so the new settings from the policy are applied by reopening of the context.
+bool Decoder::reopenCodecContext()
+{
+    if (!stream || !codec)
+        return false;
+
+    if (codecContext)
+        avcodec_free_context(&codecContext);
+
     codecContext = avcodec_alloc_context3(codec);
     if (!codecContext)
     {
@@ -47,30 +115,53 @@ bool Decoder::open(AVStream *stream)
         return false;
     }
 
-    result = avcodec_parameters_to_context(codecContext, stream->codecpar);
+    int result = avcodec_parameters_to_context(codecContext, getCodecParameters());
     if (result < 0)
     {
         loggable.logAvError(objectName(), QtCriticalMsg, "Unable fill codec context.", result);
         return false;
     }
 
-    if (avcodec_open2(codecContext, codec, NULL) < 0)
+    codecContext->pkt_timebase = stream->time_base;
+    if (lowDelay.load())
+        codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
     {
-        loggable.logMessage(objectName(), QtCriticalMsg, "Could not open codec.");
-        return false;
+        std::lock_guard<std::mutex> guard(threadingMutex);
+        codecContext->thread_count = threading.threadCount;
+        codecContext->thread_type = threading.threadType;
+        threadingChanged.store(false);
     }
+    reopenRequested.store(false);
 
-    loggable.logMessage(objectName(), QtDebugMsg, "Allocate frame and packet for decoding.");
-    frame = av_frame_alloc();
-    if (!frame)
+    configureCodecContext();
+
+    if (avcodec_open2(codecContext, codec, NULL) < 0)
     {
-        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate frame.");
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not open codec.");
         return false;
     }
 
+    QString msg = QString("Codec opened with %1 thread(s), threading type '%2'.")
+            .arg(codecContext->thread_count)
+            .arg(DecoderThreadingPolicy::threadTypeToString(codecContext->active_thread_type));
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
     return true;
 }
 
+//---------------------------------------------------------------------------------------
+void Decoder::configureCodecContext()
+{
+}
+
+//---------------------------------------------------------------------------------------
+//   Called in the decoding thread before each packet: the settings which may be changed
+// for the open context are applied here.
+void Decoder::updateCodecContext()
+{
+}
+
 //---------------------------------------------------------------------------------------
 bool Decoder::isOpen() const
 {
@@ -80,14 +171,27 @@ bool Decoder::isOpen() const
 //---------------------------------------------------------------------------------------
 int Decoder::decodePacket(const AVPacket *pkt)
 {
+    int result = 0;
 
+    updateCodecContext();
 
-    int result = 0;
+    // new threading settings are applied at the random access point only
+    if ((threadingChanged.load() || reopenRequested.load())
+            && (codec->type != AVMEDIA_TYPE_VIDEO || (pkt && (pkt->flags & AV_PKT_FLAG_KEY))))
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "Reopen codec to apply new settings...");
+        if (!reopenCodecContext())
+            return AVERROR(EINVAL);
+    }
+
+    QElapsedTimer decodingTimer;
+    decodingTimer.start();
 
     // submit the packet to the decoder
     result = avcodec_send_packet(codecContext, pkt);
     if (result < 0)
     {
+        decodingTimeNs += decodingTimer.nsecsElapsed();
         loggable.logAvError(objectName(), QtWarningMsg, "Error submitting a packet for decoding.", result);
         return result;
     }
@@ -96,6 +200,7 @@ int Decoder::decodePacket(const AVPacket *pkt)
     while (result >= 0)
     {
         result = avcodec_receive_frame(codecContext, frame);
+        decodingTimeNs += decodingTimer.nsecsElapsed();
         if (result < 0)
         {
             // those two return values are special and mean there is no output
@@ -121,14 +226,78 @@ int Decoder::decodePacket(const AVPacket *pkt)
         av_frame_unref(frame);
         if (result < 0)
             return result;
+
+        decodedFrames++;
+        decodingTimer.restart();
     }
 
     return 0;
 }
 
+//---------------------------------------------------------------------------------------
+void Decoder::flush()
+{
+    if (codecContext && avcodec_is_open(codecContext) > 0)
+        avcodec_flush_buffers(codecContext);
+}
+
+//---------------------------------------------------------------------------------------
+void Decoder::setLowDelay(bool enabled)
+{
+    if (lowDelay.exchange(enabled) == enabled)
+        return;
+
+    reopenRequested.store(true);
+    DecoderThreadingPolicy::getInstance()->setLowDelay(this, enabled);
+}
+
+//---------------------------------------------------------------------------------------
+void Decoder::setThreading(const DecoderThreading &settings)
+{
+    std::lock_guard<std::mutex> guard(threadingMutex);
+
+    if (settings == threading)
+        return;
+
+    threading = settings;
+    threadingChanged.store(true);
+}
+
+//---------------------------------------------------------------------------------------
+DecoderStatistics Decoder::getStatistics() const
+{
+    DecoderStatistics stat;
+    stat.codecName = codec ? codec->name : "";
+    {
+        std::lock_guard<std::mutex> guard(threadingMutex);
+        stat.threading = threading;
+    }
+    stat.decodingTimeUs = decodingTimeNs.load() / 1000;
+    stat.decodedFrames = decodedFrames.load();
+    stat.elapsedTimeUs = openTimer.isValid() ? openTimer.nsecsElapsed() / 1000 : 0;
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
+DecodedFormat Decoder::getFirstFrameFormat() const
+{
+    std::lock_guard<std::mutex> guard(firstFrameMutex);
+    return firstFrameFormat;
+}
+
 //---------------------------------------------------------------------------------------
 void Decoder::retrieveFrameParams()
 {
+    {
+        std::lock_guard<std::mutex> guard(firstFrameMutex);
+        firstFrameFormat.valid = true;
+        firstFrameFormat.format = frame->format;
+        firstFrameFormat.width = frame->width;
+        firstFrameFormat.height = frame->height;
+        firstFrameFormat.sampleRate = frame->sample_rate;
+        firstFrameFormat.channels = frame->ch_layout.nb_channels;
+    }
+
     frameParams["width"] = QString::number(frame->width);
     frameParams["height"] = QString::number(frame->height);
     frameParams["nb_samples"] = QString::number(frame->nb_samples);
@@ -3,6 +3,12 @@
 
 #include <QObject>
 
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <mutex>
+
+#include "decoderthreadingpolicy.h"
 #include "loggable.h"
 
 extern "C" {
@@ -16,6 +22,26 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+struct DecoderStatistics
+{
+    QString codecName;
+    DecoderThreading threading;
+    int64_t decodingTimeUs{0};
+    int64_t decodedFrames{0};
+    int64_t elapsedTimeUs{0};
+};
+
+// the format of the first decoded frame
+struct DecodedFormat
+{
+    bool valid{false};
+    int format{-1};
+    int width{0};
+    int height{0};
+    int sampleRate{0};
+    int channels{0};
+};
+
 class Decoder : public QObject
 {
     Q_OBJECT
@@ -24,21 +50,59 @@ public:
     virtual ~Decoder();
 
     virtual bool open(AVStream *stream);
+    // the decoder is opened with the copy of these parameters instead of the stream's
+    // ones (which may be changed meanwhile by the probing of the demuxer)
+    void setCodecParameters(const AVCodecParameters *parameters);
+    // the copy is dropped when the probing is over (the later reopening of the codec
+    // context uses the probed parameters of the stream)
+    void releaseCodecParameters();
     bool isOpen() const;
 
     int decodePacket(const AVPacket *pkt);
     virtual int outputFrame(AVFrame *avFrame) = 0;
+    // drops the buffered data after the jump in the input (must be called in the
+    // decoding thread)
+    virtual void flush();
+
+    void setThreading(const DecoderThreading &settings);
+    // AV_CODEC_FLAG_LOW_DELAY (it also disables the frame threading, which delays the
+    // output by a frame per thread, so the policy gives the slice threads instead); the
+    // open context is reopened at the key frame
+    void setLowDelay(bool enabled);
+    DecoderStatistics getStatistics() const;
+    DecodedFormat getFirstFrameFormat() const;
 
 protected:
+    virtual void configureCodecContext();
+    virtual void updateCodecContext();
+    bool reopenCodecContext();
+
     void retrieveFrameParams();
     void logFrameParams();
+    const AVCodecParameters *getCodecParameters() const;
 
+    AVStream *stream{nullptr};
+    AVCodecParameters *codecParameters{nullptr};
+    const AVCodec *codec{nullptr};
     AVCodecContext *codecContext{nullptr};
     AVFrame *frame{nullptr};
 
+    mutable std::mutex threadingMutex;
+    DecoderThreading threading;
+    std::atomic_bool threadingChanged{false};
+    // the settings which need the new context (e.g. lowres) were changed
+    std::atomic_bool reopenRequested{false};
+    std::atomic_bool lowDelay{false};
+
+    std::atomic<int64_t> decodingTimeNs{0};
+    std::atomic<int64_t> decodedFrames{0};
+    QElapsedTimer openTimer;
+
     Loggable loggable;
 
     std::map<QString, QString> frameParams;
+    mutable std::mutex firstFrameMutex;
+    DecodedFormat firstFrameFormat;
 };
 
 #endif // DECODER_H
@@ -0,0 +1,258 @@
+#include "decoderthreadingpolicy.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+#include "decoder.h"
+
+DecoderThreadingPolicy *DecoderThreadingPolicy::instance = nullptr;
+std::once_flag DecoderThreadingPolicy::initInstanceFlag;
+
+//---------------------------------------------------------------------------------------
+bool DecoderThreading::operator==(const DecoderThreading &other) const
+{
+    return threadCount == other.threadCount && threadType == other.threadType;
+}
+
+//---------------------------------------------------------------------------------------
+bool DecoderThreading::operator!=(const DecoderThreading &other) const
+{
+    return !(*this == other);
+}
+
+//---------------------------------------------------------------------------------------
+DecoderThreadingPolicy *DecoderThreadingPolicy::getInstance()
+{
+    std::call_once(initInstanceFlag, &DecoderThreadingPolicy::initInstance);
+
+    return instance;
+}
+
+//---------------------------------------------------------------------------------------
+DecoderThreadingPolicy::DecoderThreadingPolicy(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("DecoderThreadingPolicy");
+    coreBudget = std::max(1, QThread::idealThreadCount());
+}
+
+//---------------------------------------------------------------------------------------
+void DecoderThreadingPolicy::initInstance()
+{
+    instance = new DecoderThreadingPolicy();
+}
+
+//---------------------------------------------------------------------------------------
+int DecoderThreadingPolicy::getCoreBudget() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return coreBudget;
+}
+
+//---------------------------------------------------------------------------------------
+int DecoderThreadingPolicy::getFilterThreadCount(Decoder *decoder) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    auto it = decoders.find(decoder);
+    return it != decoders.end() ? it->second.filterThreadCount : 1;
+}
+
+//---------------------------------------------------------------------------------------
+QString DecoderThreadingPolicy::threadTypeToString(int threadType)
+{
+    switch (threadType)
+    {
+    case FF_THREAD_FRAME: return "frame";
+    case FF_THREAD_SLICE: return "slice";
+    case FF_THREAD_FRAME | FF_THREAD_SLICE: return "frame+slice";
+    default:
+        return "none";
+    }
+}
+
+//---------------------------------------------------------------------------------------
+DecoderThreading DecoderThreadingPolicy::registerDecoder(Decoder *decoder, const AVCodec *codec,
+                                                         const AVCodecParameters *params, bool lowDelay)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    Entry entry;
+    entry.codec = codec;
+    entry.lowDelay = lowDelay;
+    if (codec && codec->type == AVMEDIA_TYPE_VIDEO)
+    {
+        // unknown picture size is counted as SD
+        int64_t pixels = params ? int64_t(params->width) * params->height : 0;
+        entry.weight = pixels > 0 ? pixels : 720 * 576;
+    }
+    decoders[decoder] = entry;
+
+    rebalance(decoder);
+
+    return decoders[decoder].threading;
+}
+
+//---------------------------------------------------------------------------------------
+void DecoderThreadingPolicy::unregisterDecoder(Decoder *decoder)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (decoders.erase(decoder))
+        rebalance(nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+void DecoderThreadingPolicy::setLowDelay(Decoder *decoder, bool lowDelay)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    auto it = decoders.find(decoder);
+    if (it == decoders.end() || it->second.lowDelay == lowDelay)
+        return;
+
+    it->second.lowDelay = lowDelay;
+    rebalance(nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+void DecoderThreadingPolicy::setFiltering(Decoder *decoder, bool filtering)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    auto it = decoders.find(decoder);
+    if (it == decoders.end() || it->second.filtering == filtering)
+        return;
+
+    it->second.filtering = filtering;
+    rebalance(nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+void DecoderThreadingPolicy::setCoreBudget(int cores)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    cores = std::max(1, cores);
+    if (cores == coreBudget)
+        return;
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Change decoder core budget: %1 -> %2.").arg(coreBudget).arg(cores));
+    coreBudget = cores;
+    rebalance(nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+bool DecoderThreadingPolicy::isThreadable(const Entry &entry) const
+{
+    return entry.weight > 0
+            && entry.codec
+            && (entry.codec->capabilities & (AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS));
+}
+
+//---------------------------------------------------------------------------------------
+//   Frame threading gives the best throughput, but adds one frame of latency per thread,
+// so slice threading is preferred for low delay decoders if the codec supports it.
+int DecoderThreadingPolicy::chooseThreadType(const Entry &entry, int threadCount) const
+{
+    if (threadCount <= 1 || !entry.codec)
+        return FF_THREAD_SLICE;
+
+    bool frameThreads = entry.codec->capabilities & AV_CODEC_CAP_FRAME_THREADS;
+    bool sliceThreads = entry.codec->capabilities & AV_CODEC_CAP_SLICE_THREADS;
+
+    if (sliceThreads && (entry.lowDelay || !frameThreads))
+        return FF_THREAD_SLICE;
+
+    return frameThreads ? FF_THREAD_FRAME : FF_THREAD_SLICE;
+}
+
+//---------------------------------------------------------------------------------------
+void DecoderThreadingPolicy::rebalance(Decoder *registeredDecoder)
+{
+    int64_t totalWeight = 0;
+    int threadableCount = 0;
+    for (auto& [decoder, entry] : decoders)
+    {
+        if (isThreadable(entry))
+        {
+            totalWeight += entry.weight;
+            threadableCount++;
+        }
+    }
+
+    // the decoders run on the pool workers, the worker is counted in the share of its
+    // decoder (it's one of the slice threads, or it waits for the frame threads); the
+    // workers of the decoders without threading take one core each
+    int budget = std::max<int>(threadableCount, coreBudget - (int(decoders.size()) - threadableCount));
+
+    // proportional shares, at least one thread per decoder
+    std::map<Decoder*, int> shares;
+    int distributed = 0;
+    for (auto& [decoder, entry] : decoders)
+    {
+        int share = 1;
+        if (isThreadable(entry) && totalWeight > 0)
+            share = std::max<int64_t>(1, budget * entry.weight / totalWeight);
+        shares[decoder] = share;
+        if (isThreadable(entry))
+            distributed += share;
+    }
+
+    // the remainder after rounding goes to the heaviest decoders
+    while (threadableCount && distributed < budget)
+    {
+        Decoder *heaviest = nullptr;
+        double maxDeficit = -1.0;
+        for (auto& [decoder, entry] : decoders)
+        {
+            if (!isThreadable(entry) || shares[decoder] >= MaxThreadsPerDecoder)
+                continue;
+            double deficit = double(budget) * entry.weight / totalWeight - shares[decoder];
+            if (deficit > maxDeficit)
+            {
+                maxDeficit = deficit;
+                heaviest = decoder;
+            }
+        }
+        if (!heaviest)
+            break;
+        shares[heaviest]++;
+        distributed++;
+    }
+
+    QString msg = QString("Rebalance decoder threads (budget %1 cores, %2 for the threaded decoders, %3 decoders):")
+            .arg(coreBudget).arg(budget).arg(decoders.size());
+
+    for (auto& [decoder, entry] : decoders)
+    {
+        // the graph filters the pictures of the codec in the same pipeline, both run
+        // within the decoder's share (one thread of each is the worker itself)
+        int share = std::min<int>(shares[decoder], MaxThreadsPerDecoder);
+        entry.filterThreadCount = entry.filtering ? std::max(1, share / 2) : 1;
+
+        DecoderThreading threading;
+        threading.threadCount = entry.filtering ? std::max(1, share - entry.filterThreadCount) : share;
+        threading.threadType = chooseThreadType(entry, threading.threadCount);
+
+        msg.append(QString("\n- %1 (%2): %3 thread(s), %4")
+                   .arg(decoder->objectName(), entry.codec ? entry.codec->name : "unknown")
+                   .arg(threading.threadCount)
+                   .arg(threadTypeToString(threading.threadType)));
+        if (entry.filtering)
+            msg.append(QString(", filter %1 thread(s)").arg(entry.filterThreadCount));
+
+        if (threading == entry.threading && decoder != registeredDecoder)
+            continue;
+
+        entry.threading = threading;
+        if (decoder != registeredDecoder)
+            decoder->setThreading(threading);
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,91 @@
+#ifndef DECODERTHREADINGPOLICY_H
+#define DECODERTHREADINGPOLICY_H
+
+#include <QObject>
+
+#include <map>
+#include <mutex>
+
+#include "loggable.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+class Decoder;
+
+struct DecoderThreading
+{
+    bool operator==(const DecoderThreading &other) const;
+    bool operator!=(const DecoderThreading &other) const;
+
+    int threadCount{1};
+    int threadType{FF_THREAD_SLICE};
+};
+
+//---------------------------------------------------------------------------------------
+//   Shares the global core budget among all open decoders.
+//   Audio decoders and codecs without threading capabilities always get one thread,
+// the pool worker which runs them is taken from the budget. The rest is split among
+// the remaining (video) decoders proportionally to their picture size, at least one
+// thread per decoder; the worker running the decoder is counted in its share. The
+// share of the decoder which runs a filter graph is split between the codec and the
+// graph. The allocation is recalculated every time when a decoder is registered or
+// unregistered, or when the budget is changed; the decoders whose settings were
+// changed are notified by Decoder::setThreading().
+class DecoderThreadingPolicy : public QObject
+{
+    Q_OBJECT
+public:
+    static DecoderThreadingPolicy *getInstance();
+
+    int getCoreBudget() const;
+    // the part of the decoder's share given to its filter graph
+    int getFilterThreadCount(Decoder *decoder) const;
+    static QString threadTypeToString(int threadType);
+
+    DecoderThreading registerDecoder(Decoder *decoder, const AVCodec *codec,
+                                     const AVCodecParameters *params, bool lowDelay = false);
+    void unregisterDecoder(Decoder *decoder);
+    void setLowDelay(Decoder *decoder, bool lowDelay);
+    void setFiltering(Decoder *decoder, bool filtering);
+
+public slots:
+    void setCoreBudget(int cores);
+
+private:
+    explicit DecoderThreadingPolicy(QObject *parent = nullptr);
+
+    DecoderThreadingPolicy(const DecoderThreadingPolicy&) = delete;
+    DecoderThreadingPolicy& operator=(const DecoderThreadingPolicy&) = delete;
+
+    struct Entry
+    {
+        const AVCodec *codec{nullptr};
+        int64_t weight{0};
+        bool lowDelay{false};
+        bool filtering{false};
+        DecoderThreading threading;
+        int filterThreadCount{1};
+    };
+
+    bool isThreadable(const Entry &entry) const;
+    int chooseThreadType(const Entry &entry, int threadCount) const;
+    void rebalance(Decoder *registeredDecoder);
+
+    static void initInstance();
+    static DecoderThreadingPolicy *instance;
+    static std::once_flag initInstanceFlag;
+
+    enum {
+        MaxThreadsPerDecoder = 16
+    };
+
+    mutable std::mutex mutex;
+    int coreBudget{1};
+    std::map<Decoder*, Entry> decoders;
+
+    Loggable loggable;
+};
+
+#endif // DECODERTHREADINGPOLICY_H
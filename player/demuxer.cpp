@@ -3,11 +3,41 @@
 #include <QCoreApplication>
 #include <QAudioDevice>
 #include <QMediaDevices>
+#include <QTimer>
+#include <QUrlQuery>
 
+#include <algorithm>
+#include <cstring>
 #include <optional>
 
+#include "sessionmanager.h"
 #include "utils.h"
 
+static const int StatisticsUpdateIntervalMs = 1000;
+static const int MosaicFrameIntervalMs = 40;
+static const int MaxQueuedTilePackets = 100;
+static const int MaxQueuedPackets = 200;
+static const double CatchUpSpeed = 1.5;
+static const int64_t CatchUpFinishLagUs = 1000000;
+// the ring of the timeshift buffer used only as the receive FIFO of the clock recovery
+static const int ReceiveFifoSeconds = 10;
+static const int ReceiveFifoMegabytes = 32;
+// the receive FIFO lag is restored within this time, by the clamped trim of the rate
+static const double LatencyTimeConstantUs = 300000000.0;
+static const double MaxLatencyTrimPpm = 50.0;
+// the low latency profile
+static const int LowLatencyMaxQueuedPackets = 16;
+static const int LowLatencyReceiveFifoSeconds = 2;
+static const int LowLatencyReceiveFifoMegabytes = 8;
+// FIFO of the UDP protocol (in 188 byte packets) of the socket opened for the source
+static const int LowLatencyUdpFifoPackets = 1024;
+static const int64_t LowLatencyAudioBufferUs = 40000;
+// the samples waiting for the room in the sink (the older ones are dropped beyond it)
+static const int64_t MaxPendingAudioUs = 200000;
+static const int PendingAudioRetryMs = 5;
+// the PSI cache is validated by the first decoded frames within this time
+static const int PsiCacheValidationTimeoutMs = 10000;
+
 //---------------------------------------------------------------------------------------
 constexpr std::optional<const char*> getSourceTypeString(Demuxer::SourceType type)
 {
@@ -25,7 +55,11 @@ int interruptCallback(void *ctx)
 {
     Demuxer *demuxer = reinterpret_cast<Demuxer*>(ctx);
 
-    if (demuxer->rwTimeoutInMilliseconds == 0)
+    // the opening of the source is cancelled by the stop
+    if (demuxer->preparing.load() && demuxer->desiredState.load() == QMediaPlayer::StoppedState)
+        return 1;
+
+    if (demuxer->sourceType != Demuxer::SourceType::Stream || demuxer->rwTimeoutInMilliseconds == 0)
         return 0;
 
     bool isTimeout = demuxer->timer.elapsed() > demuxer->rwTimeoutInMilliseconds;
@@ -46,6 +80,18 @@ Demuxer::Demuxer(QObject *parent)
 
     audioLevelMeter = std::make_shared<AudioLevelMeter>(new AudioLevelMeter());
     connect(audioLevelMeter.get(), &AudioLevelMeter::audioLevelsCalculated, this, &Demuxer::audioLevelsCalculated);
+
+    WorkerPool *pool = WorkerPool::getInstance();
+    videoStrand = pool->createStrand("Video Decoder");
+    audioStrand = pool->createStrand("Audio Decoder");
+
+    for (auto &time : startupTimesMs)
+        time.store(-1);
+
+    bitrateHistory = std::make_shared<BitrateHistory>();
+    tsAnalyzer.setBitrateHistory(bitrateHistory);
+
+    connect(this, &Demuxer::mosaicFrameComposed, this, &Demuxer::writeMosaicFrameToSink, Qt::QueuedConnection);
 }
 
 //---------------------------------------------------------------------------------------
@@ -66,6 +112,12 @@ QMediaPlayer::PlaybackState Demuxer::getCurrentState() const
     return currentState;
 }
 
+//---------------------------------------------------------------------------------------
+std::shared_ptr<const BitrateHistory> Demuxer::getBitrateHistory() const
+{
+    return bitrateHistory;
+}
+
 //---------------------------------------------------------------------------------------
 void Demuxer::setVideoSink(QVideoSink *sink)
 {
@@ -87,7 +139,7 @@ int Demuxer::getFirstProgramStreamByType(int programId, AVMediaType type)
 int Demuxer::getFirstStreamByType(AVMediaType type)
 {
     auto it = std::find_if(streams.begin(), streams.end(), [&type](const auto& item){
-        return item->type == type;
+        return item->type == type && !item->removed;
     });
 
     int idx = (it != streams.end()) ? std::distance(streams.begin(), it) : -1;
@@ -108,13 +160,14 @@ void Demuxer::setSourceAndStart(const QString &path, Demuxer::SourceType type)
     QString msg = QString("Start with source '%1', type '%2'.").arg(path, typeString.value());
     loggable.logMessage(objectName(), QtDebugMsg, msg);
 
-    sourcePath = path;
-    sourceType = type;
-
-    if (currentState.load() != QMediaPlayer::StoppedState)
+    // the source being opened is cancelled too
+    if (currentState.load() != QMediaPlayer::StoppedState || prepareThread.joinable())
     {
         stop();
     }
+
+    sourcePath = path;
+    sourceType = type;
     initPlaybackThread();
 }
 
@@ -158,6 +211,12 @@ void Demuxer::stop()
     loggable.logMessage(objectName(), QtDebugMsg, "Switch state to stop...");
     desiredState.store(QMediaPlayer::StoppedState);
 
+    if (prepareThread.joinable())
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "Cancel opening of the source...");
+        finishPreparing(prepareGeneration);
+    }
+
     if (playbackThread.joinable())
     {
         playbackThread.join();
@@ -183,6 +242,12 @@ void Demuxer::changeSelectedStream(AVMediaType type, int streamIndex)
     switch (type)
     {
     case AVMEDIA_TYPE_VIDEO:
+        selectedVideoStreamIndex = streamIndex;
+        if (mosaicMode)
+        {
+            loggable.logMessage(objectName(), QtDebugMsg, "Multiviewer is shown, the stream will be opened later.");
+            return;
+        }
         if (activeVideoStreamIndex.load() == streamIndex)
         {
             loggable.logMessage(objectName(), QtDebugMsg, "Requested stream and current stream area same.");
@@ -226,394 +291,1997 @@ void Demuxer::changeSelectedStream(AVMediaType type, int streamIndex)
 }
 
 //---------------------------------------------------------------------------------------
-void Demuxer::writeVideoFrameToSink(const std::shared_ptr<VideoFrame> videoFrame)
+void Demuxer::setVideoFilters(const QString &filters)
 {
-    videoSink->setVideoFrame(*videoFrame->getVideoFrame());
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Set video filters: \"%1\".").arg(filters));
+
+    videoFilters = filters;
+    if (videoDecoder)
+        videoDecoder->setUserFilters(videoFilters);
 }
 
 //---------------------------------------------------------------------------------------
-void Demuxer::writeAudioSampleToSink(const std::shared_ptr<AudioFrame> audioFrame)
+void Demuxer::setDeinterlacer(const QString &algorithm, bool fieldRate)
 {
-    if (audioOutput && audioSink)
-        audioOutput->write(audioFrame->getData(), audioFrame->getSize());
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Set deinterlacer: %1, %2 rate.").arg(algorithm, fieldRate ? "field" : "frame"));
+
+    deinterlacer = algorithm;
+    deinterlaceToFieldRate = fieldRate;
+    if (videoDecoder)
+        videoDecoder->setDeinterlacer(deinterlacer, deinterlaceToFieldRate);
 }
 
 //---------------------------------------------------------------------------------------
-void Demuxer::initPlaybackThread()
+void Demuxer::setActivePictureDetection(bool enabled)
 {
-    loggable.logMessage(objectName(), QtDebugMsg, "Init playback thread.");
-
-    std::unique_lock<std::mutex> locker(stateMutex);
-    while (currentState.load() != QMediaPlayer::StoppedState)
-    {
-        currentStateChanged.wait(locker, [this](){return currentState.load() == QMediaPlayer::StoppedState;});
-    }
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Active picture detection %1.").arg(enabled ? "enabled" : "disabled"));
 
-    if (!ready)
-        ready = prepare();
+    activePictureDetection = enabled;
+    if (videoDecoder)
+        videoDecoder->setActivePictureDetection(activePictureDetection);
+}
 
-    if (!ready)
-    {
-        loggable.logMessage(objectName(), QtCriticalMsg, "Preparing of the demuxer and decoders was failed!");
-        return;
-    }
+//---------------------------------------------------------------------------------------
+void Demuxer::setVideoOutputSize(const QSize &size)
+{
+    videoOutputSize = size;
+    if (videoDecoder)
+        videoDecoder->setOutputSize(videoOutputSize);
+    mosaicCompositor.setOutputSize(videoOutputSize);
+}
 
-    loggable.logMessage(objectName(), QtDebugMsg, "Start playback thread...");
-    desiredState.store(QMediaPlayer::PlayingState, std::memory_order_seq_cst);
-    playbackThread = std::thread{&Demuxer::playing, this};
-    playbackThread.detach();
+//---------------------------------------------------------------------------------------
+void Demuxer::setVideoOutputVisible(bool visible)
+{
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Video output %1.").arg(visible ? "visible" : "hidden"));
 
+    videoOutputVisible = visible;
+    if (videoDecoder)
+        videoDecoder->setOutputVisible(videoOutputVisible);
+    mosaicCompositor.setVisible(videoOutputVisible);
 }
 
 //---------------------------------------------------------------------------------------
-bool Demuxer::prepare()
+//   The governor degrades only the video decoding of the selected stream; when it's
+// disabled, the full decoding is restored.
+void Demuxer::setLoadGovernorEnabled(bool enabled)
 {
-    [[maybe_unused]] bool ok{true};
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Load governor %1.").arg(enabled ? "enabled" : "disabled"));
 
-    emit startLockRequired(true);
-    loggable.logMessage(objectName(), QtDebugMsg, QString("Load media source: %1").arg(sourcePath));
+    loadGovernorEnabled.store(enabled);
+}
 
-    try
+//---------------------------------------------------------------------------------------
+//   The recording gets the packets before the decoding, so the file contains all
+// streams of the program (including the ones which aren't decoded) as they were
+// received. The reading is paused while the output is created, because the list of
+// the streams can be changed by the reading thread.
+void Demuxer::startRecording(const QString &path, int programId)
+{
+    if (!ready || !inputFormatContext)
     {
-        loggable.logMessage(objectName(), QtDebugMsg, "Allocate packet for receiving...");
-        receivedPacket = av_packet_alloc();
-        if (!receivedPacket)
-        {
-            loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate packet.");
-            throw false;
-        }
-
-        loggable.logMessage(objectName(), QtDebugMsg, "Allocate input context...");
-        inputFormatContext = avformat_alloc_context();
-        if (!inputFormatContext)
-        {
-            loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate AVFormatContext.");
-            throw false;
-        }
-
-        AVDictionary *options = nullptr;
-        if (sourceType == SourceType::Stream && rwTimeoutInMilliseconds > 0)
-        {
-            QString msg = QString("Set interrupt callback and blocking RW operations timeout: "
-                                  "%1 milliseconds.").arg(rwTimeoutInMilliseconds);
-            loggable.logMessage(objectName(), QtDebugMsg, msg);
-
-            inputFormatContext->interrupt_callback.callback = interruptCallback;
-            inputFormatContext->interrupt_callback.opaque = this;// inputFormatContext;
-        }
-
-        timer.restart();
-        loggable.logMessage(objectName(), QtDebugMsg, "Open input context...");
-        if (avformat_open_input(&inputFormatContext, sourcePath.toUtf8().data(), NULL, &options) < 0)
-        {
-            loggable.logMessage(objectName(), QtCriticalMsg, QString("Could not open source: %1").arg(sourcePath));
-            throw false;
-        }
+        loggable.logMessage(objectName(), QtWarningMsg, "Recording is requested without the source.");
+        emit recordingStateChanged(false, QString());
+        return;
+    }
 
-        loggable.logMessage(objectName(), QtDebugMsg, "Find stream info...");
-        if (avformat_find_stream_info(inputFormatContext, NULL) < 0)
-        {
-            loggable.logMessage(objectName(), QtCriticalMsg, "Could not find stream information.");
-            throw false;
-        }
+    std::vector<int> streamIndexes;
+    auto it = programs.find(programId);
+    if (it != programs.end())
+    {
+        for (auto& [index, streamInfo] : it->second->streams)
+            streamIndexes.push_back(index);
+        std::sort(streamIndexes.begin(), streamIndexes.end());
+    }
+    else
+    {
+        // the whole multiplex (or the source without programs)
+        for (const auto &streamInfo : streams)
+            streamIndexes.push_back(streamInfo->index);
+    }
 
-        if (!findStreams())
-        {
-            loggable.logMessage(objectName(), QtWarningMsg, "Valid streams does not found.");
-            throw false;
-        }
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Record %1 to '%2'.")
+                        .arg(it != programs.end() ? QString("program %1").arg(programId) : QString("multiplex"), path));
 
-        findPrograms();
+    bool needResume = false;
+    if (currentState.load() == QMediaPlayer::PlayingState)
+    {
+        needResume = true;
+        pause();
+    }
 
-        // it's left for debugging
-        //    int videoIndex = getFirstStreamByType(AVMEDIA_TYPE_VIDEO);
-        //    if (videoIndex != -1)
-        //    {
-        //        ok = prepareVideoDecoder(videoIndex);
-        //        if (!ok)
-        //            throw false;
-        //    }
+    bool ok = recorder.start(path, inputFormatContext, streamIndexes);
 
-        //    int audioIndex = getFirstStreamByType(AVMEDIA_TYPE_AUDIO);
-        //    if (audioIndex != -1)
-        //    {
-        //        ok = prepareAudioDecoder(audioIndex);
-        //        if (!ok)
-        //            throw false;
-        //    }
-    }
-    catch (const bool &e)
+    if (needResume)
     {
-        ok = e;
+        desiredState.store(QMediaPlayer::PlayingState);
+        desiredStateChanged.notify_all();
     }
 
-    emit startLockRequired(false);
-    return ok;
+    emit recordingStateChanged(ok, ok ? path : QString());
 }
 
 //---------------------------------------------------------------------------------------
-bool Demuxer::findStreams()
+void Demuxer::stopRecording()
 {
-    loggable.logMessage(objectName(), QtDebugMsg, "Find streams...");
-
-    streams.clear();
-
-    if (!inputFormatContext)
-        return false;
+    if (!recorder.isRecording())
+        return;
 
-    streams.resize(inputFormatContext->nb_streams);
+    recorder.stop();
+    emit recordingStateChanged(false, QString());
+}
 
-    QString msg;
-    QString msgPattern = QString("Stream: index - %1, id - %2, type - %3.");
+//---------------------------------------------------------------------------------------
+void Demuxer::setTimeshift(bool enabled, int durationSeconds, int capacityMegabytes, bool fileStorage)
+{
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Timeshift %1: %2 s, %3 MB in %4.")
+                        .arg(enabled ? "enabled" : "disabled")
+                        .arg(durationSeconds)
+                        .arg(capacityMegabytes)
+                        .arg(fileStorage ? "file" : "RAM"));
+
+    timeshiftSettings.enabled = enabled;
+    timeshiftSettings.durationSeconds = durationSeconds;
+    timeshiftSettings.capacityMegabytes = capacityMegabytes;
+    timeshiftSettings.fileStorage = fileStorage;
+}
 
-    std::unordered_map<AVMediaType, int> streamsCounts;
+//---------------------------------------------------------------------------------------
+void Demuxer::setFastStart(bool enabled, int probeSizeKilobytes, int analyzeDurationMs)
+{
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Fast start %1: probe size %2 KB, analyze duration %3 ms.")
+                        .arg(enabled ? "enabled" : "disabled")
+                        .arg(probeSizeKilobytes)
+                        .arg(analyzeDurationMs));
+
+    fastStartSettings.enabled = enabled;
+    fastStartSettings.probeSizeKilobytes = probeSizeKilobytes;
+    fastStartSettings.analyzeDurationMs = analyzeDurationMs;
+}
 
-    for (unsigned int i = 0; i < inputFormatContext->nb_streams; ++i)
-    {
-        AVStream *stream = inputFormatContext->streams[i];
-        AVMediaType type = stream->codecpar->codec_type;
-        int idx = stream->index;
+//---------------------------------------------------------------------------------------
+void Demuxer::setTsAnalysisEnabled(bool enabled)
+{
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Transport stream analysis %1.").arg(enabled ? "enabled" : "disabled"));
+    tsAnalysisEnabled = enabled;
+}
 
-        auto streamInfo = std::make_shared<StreamInfo>();
-        streamInfo->index = idx;
-        streamInfo->stream = stream;
-        streamInfo->type = type;
-        streamInfo->id = stream->id;
+//---------------------------------------------------------------------------------------
+void Demuxer::setClockRecovery(bool enabled)
+{
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Clock recovery %1.").arg(enabled ? "enabled" : "disabled"));
+    clockRecoveryEnabled = enabled;
+}
 
-        streamsCounts[type]++;
+//---------------------------------------------------------------------------------------
+//   The decoders are reopened at the next key frame; the audio output is recreated
+// with the other buffer size (the buffered samples are dropped).
+void Demuxer::setLowLatency(bool enabled)
+{
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Low latency profile %1.").arg(enabled ? "enabled" : "disabled"));
+    if (lowLatency.exchange(enabled) == enabled)
+        return;
 
-        msg = msgPattern.arg(idx).arg(stream->id).arg(mapAvMediaTypeToString(type));
+    if (videoDecoder)
+        videoDecoder->setLowDelay(enabled);
+    if (audioDecoder)
+        audioDecoder->setLowDelay(enabled);
 
-        AVDictionary *meta = stream->metadata;
-        AVDictionaryEntry *entry = av_dict_get(meta, "", nullptr, AV_DICT_IGNORE_SUFFIX);
-        if (entry)
-        {
-            msg.append("\nMetadata:");
-            while (entry)
-            {
-                streamInfo->properties[entry->key] = entry->value;
-                QString str = QString("\n%1 = %2");
-                msg.append(str.arg(entry->key, entry->value));
-                entry = av_dict_get(meta, "", entry, AV_DICT_IGNORE_SUFFIX);
-            }
-        }
-        streams[idx] = streamInfo;
-        loggable.logMessage(objectName(), QtDebugMsg, msg);
+    if (audioSink && audioDecoder)
+    {
+        closeAudioSink();
+        openAudioSink(audioDecoder->audioFormat());
     }
+}
 
-    msg = QString("Found %1 video and %2 audio streams")
-            .arg(streamsCounts[AVMEDIA_TYPE_VIDEO])
-            .arg(streamsCounts[AVMEDIA_TYPE_AUDIO]);
-    loggable.logMessage(objectName(), QtDebugMsg, msg);
-
-    emit streamsFound(streams);
+//---------------------------------------------------------------------------------------
+void Demuxer::seekTimeshift(int seconds)
+{
+    if (!ready || !timeshiftBuffer.isOpen() || receiveFifoOnly)
+        return;
 
-    return streamsCounts[AVMEDIA_TYPE_VIDEO] + streamsCounts[AVMEDIA_TYPE_AUDIO];
+    int64_t lagUs = timeshiftBuffer.getStatus().lagUs - int64_t(seconds) * AV_TIME_BASE;
+    moveTimeshiftPosition(std::max<int64_t>(0, lagUs));
 }
 
 //---------------------------------------------------------------------------------------
-bool Demuxer::findPrograms()
+//   The jump goes to the last key frame received; the catching up plays the buffered
+// content faster until the live is reached.
+void Demuxer::returnToLive(bool catchUp)
 {
-    loggable.logMessage(objectName(), QtDebugMsg, "Find programs...");
+    if (!ready || !timeshiftBuffer.isOpen() || receiveFifoOnly)
+        return;
 
-    programs.clear();
+    if (!catchUp)
+    {
+        moveTimeshiftPosition(0);
+        return;
+    }
 
-    if (!inputFormatContext)
-        return false;
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Catch up the live at %1x speed.").arg(CatchUpSpeed));
+    playbackSpeed.store(CatchUpSpeed);
+}
 
-    QString msg;
-    QString msgPattern = QString("Program: id - %1, program number - %2, PMT PID - %3, PCR PID - %4.");
+//---------------------------------------------------------------------------------------
+//   The reading is moved to the key frame before the position (found by the seek index
+// or by the demuxer itself); the frames between the key frame and the position are
+// decoded without the pacing and aren't shown, the audio is skipped.
+void Demuxer::seek(qint64 positionMs)
+{
+    if (!ready || sourceType != SourceType::File || seekIndex.getMethod() == SeekIndex::None)
+        return;
 
-    AVProgram *avProgram;
-    for (unsigned int i = 0; i < inputFormatContext->nb_programs; ++i)
+    bool needResume = false;
+    if (currentState.load() == QMediaPlayer::PlayingState)
     {
-        avProgram = inputFormatContext->programs[i];
-
-        auto programInfo = std::make_shared<ProgramInfo>();
-        programInfo->avProgram = avProgram;
-        programInfo->lastPmtVersion = avProgram->pmt_version;
+        needResume = true;
+        pause();
+    }
 
-        msg = msgPattern.arg(avProgram->id)
-                .arg(avProgram->program_num)
-                .arg(avProgram->pmt_pid)
-                .arg(avProgram->pcr_pid);
+    QElapsedTimer seekTimer;
+    seekTimer.start();
 
-        AVDictionary *meta = avProgram->metadata;
-        AVDictionaryEntry *entry = av_dict_get(meta, "", nullptr, AV_DICT_IGNORE_SUFFIX);
-        if (entry)
-        {
-            msg.append("\nMetadata:");
-            while (entry)
-            {
-                programInfo->properties[entry->key] = entry->value;
-                QString str = QString("\n%1 = %2");
-                msg.append(str.arg(entry->key, entry->value));
-                entry = av_dict_get(meta, "", entry, AV_DICT_IGNORE_SUFFIX);
-            }
-            loggable.logMessage(objectName(), QtDebugMsg, msg);
-        }
+    int64_t positionUs = std::max<int64_t>(0, positionMs * 1000);
+    if (inputFormatContext->duration != AV_NOPTS_VALUE)
+        positionUs = std::min(positionUs, inputFormatContext->duration);
+    int64_t targetUs = getInputStartTime() + positionUs;
 
-        fillProgramStreamsData(programInfo);
-        programs[avProgram->id] = programInfo;
+    int64_t position = seekIndex.findPosition(targetUs);
+    int result = position >= 0
+            ? av_seek_frame(inputFormatContext, -1, position, AVSEEK_FLAG_BYTE)
+            : av_seek_frame(inputFormatContext, -1, targetUs, AVSEEK_FLAG_BACKWARD);
+    if (result < 0)
+        loggable.logAvError(objectName(), QtWarningMsg, "Could not seek.", result);
 
+    flushDecoders();
+    int videoIndex = activeVideoStreamIndex.load();
+    if (videoDecoder && videoIndex != -1)
+    {
+        int64_t pts = av_rescale_q(targetUs, AVRational{1, AV_TIME_BASE}, streams[videoIndex]->stream->time_base);
+        WorkerPool::getInstance()->post(videoStrand, [decoder = videoDecoder, pts](){
+            decoder->setPresentationStart(pts);
+        });
     }
+    seekTargetUs.store(targetUs);
+    currentPositionUs.store(positionUs);
+    startDTS = -1;
+    startTime = -1;
 
-    msg = QString("Found %1 programs").arg(programs.size());
-    loggable.logMessage(objectName(), QtDebugMsg, msg);
-
-    emit programsFound(programs);
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Seek to %1 s (%2) in %3 ms.")
+                        .arg(positionUs / 1000000.0, 0, 'f', 1)
+                        .arg(position >= 0 ? QString("offset %1").arg(position) : QString("by timestamp"))
+                        .arg(seekTimer.elapsed()));
+    emit positionChanged(positionUs / 1000);
 
-    return !programs.empty();
+    if (needResume)
+    {
+        desiredState.store(QMediaPlayer::PlayingState);
+        desiredStateChanged.notify_all();
+    }
 }
 
 //---------------------------------------------------------------------------------------
-void Demuxer::fillProgramStreamsData(std::shared_ptr<ProgramInfo> program)
+//   The multiviewer replaces the selected video stream by the mosaic of all programs;
+// the selected audio stream is still played.
+void Demuxer::setMosaicMode(bool enabled)
 {
-    QString msg = QString("Fill the stream data for the program %1").arg(program->avProgram->id);
-    loggable.logMessage(objectName(), QtDebugMsg, msg);
-
-    AVProgram *avProgram = program->avProgram;
-    QString msgPattern = QString("Program %1: stream #%2 - PID %3, type '%4'");
-    for (unsigned int i = 0; i < avProgram->nb_stream_indexes; ++i)
-    {
-        int idx = avProgram->stream_index[i];
-        AVStream *stream = inputFormatContext->streams[idx];
-        AVMediaType type = stream->codecpar->codec_type;
+    if (enabled == mosaicMode)
+        return;
 
-        program->streams[idx] = streams[idx];
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Multiviewer %1.").arg(enabled ? "enabled" : "disabled"));
 
-        msg = msgPattern
-                .arg(avProgram->id)
-                .arg(i+1)
-                .arg(stream->id)
-                .arg(QString::fromStdString(mapAvMediaTypeToString(type)));
+    mosaicMode = enabled;
+    // otherwise it's applied when the source is prepared
+    if (!ready)
+        return;
 
-        loggable.logMessage(objectName(), QtDebugMsg, msg);
+    bool needResume = false;
+    if (currentState.load() == QMediaPlayer::PlayingState)
+    {
+        needResume = true;
+        pause();
     }
-}
+
+    if (mosaicMode)
+    {
+        resetVideoDecoder();
+        prepareMosaic();
+    }
+    else
+    {
+        resetMosaic();
+        if (selectedVideoStreamIndex != -1)
+            prepareVideoDecoder(selectedVideoStreamIndex);
+    }
+
+    if (needResume)
+    {
+        desiredState.store(QMediaPlayer::PlayingState);
+        desiredStateChanged.notify_all();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The picture with the presentation delay (the second field) is shown by the timer
+// that long after the previous one; the next received picture doesn't wait for it.
+void Demuxer::writeVideoFrameToSink(const std::shared_ptr<VideoFrame> videoFrame)
+{
+    if (pendingVideoFrame)
+        presentPendingVideoFrame();
+
+    int64_t delayUs = 0;
+    if (videoFrame->getPresentationDelay() > 0 && videoFramePresentationTimer.isValid())
+        delayUs = videoFrame->getPresentationDelay() - videoFramePresentationTimer.nsecsElapsed() / 1000;
+
+    if (delayUs <= 0)
+    {
+        presentVideoFrame(videoFrame);
+        return;
+    }
+
+    pendingVideoFrame = videoFrame;
+    int generation = ++pendingVideoFrameGeneration;
+    QTimer::singleShot(int((delayUs + 999) / 1000), Qt::PreciseTimer, this, [this, generation](){
+        if (generation == pendingVideoFrameGeneration && pendingVideoFrame)
+            presentPendingVideoFrame();
+    });
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::presentVideoFrame(const std::shared_ptr<VideoFrame> &videoFrame)
+{
+    markStartupStage(FirstVideoFrameStage);
+    videoSink->setVideoFrame(*videoFrame->getVideoFrame());
+    videoFramePresentationTimer.start();
+
+    if (sourceType == SourceType::Stream && videoFrame->getPresentationTimestamp() != AV_NOPTS_VALUE)
+        latencyMeter.addPresentation(LatencyMeter::Video, videoFrame->getPresentationTimestamp(), av_gettime_relative());
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::presentPendingVideoFrame()
+{
+    std::shared_ptr<VideoFrame> videoFrame = std::move(pendingVideoFrame);
+    pendingVideoFrame.reset();
+    presentVideoFrame(videoFrame);
+}
+
+//---------------------------------------------------------------------------------------
+//   The frame composed before the mosaic was closed is dropped.
+void Demuxer::writeMosaicFrameToSink(const QVideoFrame &frame)
+{
+    if (!mosaicActive.load() || !videoSink)
+        return;
+
+    markStartupStage(FirstVideoFrameStage);
+    videoSink->setVideoFrame(frame);
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::writeAudioSampleToSink(const std::shared_ptr<AudioFrame> audioFrame)
+{
+    markStartupStage(FirstAudioFrameStage);
+    if (!audioOutput || !audioSink)
+        return;
+
+    // the frame is heard after the samples already queued by the sink and the pending
+    // ones (the latency of the device itself isn't known)
+    QAudioFormat format = audioSink->format();
+    int64_t queuedUs = format.durationForBytes(int(audioSink->bufferSize() - audioSink->bytesFree() + pendingAudio.size()));
+
+    // the bursts (e.g. the backlog after the probing in the low latency profile) may
+    // be bigger than the free space of the sink
+    pendingAudio.append(audioFrame->getData(), audioFrame->getSize());
+    int maxPendingBytes = format.bytesForDuration(MaxPendingAudioUs);
+    if (pendingAudio.size() > maxPendingBytes)
+    {
+        int bytesPerFrame = std::max(1, format.bytesPerFrame());
+        int excess = (pendingAudio.size() - maxPendingBytes + bytesPerFrame - 1) / bytesPerFrame * bytesPerFrame;
+        excess = std::min<int>(excess, pendingAudio.size());
+        pendingAudio.remove(0, excess);
+        droppedAudioBytes += excess;
+        queuedUs -= format.durationForBytes(excess);
+    }
+    writePendingAudio();
+
+    if (sourceType == SourceType::Stream && audioFrame->getPresentationTimestamp() != AV_NOPTS_VALUE)
+        latencyMeter.addPresentation(LatencyMeter::Audio, audioFrame->getPresentationTimestamp(),
+                                     av_gettime_relative() + queuedUs);
+}
+
+//---------------------------------------------------------------------------------------
+//   The rest which doesn't fit in the sink is written later.
+void Demuxer::writePendingAudio()
+{
+    if (!audioOutput || pendingAudio.isEmpty())
+        return;
+
+    qint64 written = audioOutput->write(pendingAudio);
+    if (written > 0)
+        pendingAudio.remove(0, int(written));
+
+    if (!pendingAudio.isEmpty() && !pendingAudioScheduled)
+    {
+        pendingAudioScheduled = true;
+        QTimer::singleShot(PendingAudioRetryMs, this, [this](){
+            pendingAudioScheduled = false;
+            writePendingAudio();
+        });
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::initPlaybackThread()
+{
+    loggable.logMessage(objectName(), QtDebugMsg, "Init playback thread.");
+
+    std::unique_lock<std::mutex> locker(stateMutex);
+    while (currentState.load() != QMediaPlayer::StoppedState)
+    {
+        currentStateChanged.wait(locker, [this](){return currentState.load() == QMediaPlayer::StoppedState;});
+    }
+
+    if (ready)
+    {
+        startPlaybackThread();
+        return;
+    }
+
+    if (prepareThread.joinable())
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "Source is being opened already.");
+        return;
+    }
+
+    // the source is opened in the own thread, the control stays responsive (and can
+    // cancel the opening) meanwhile
+    desiredState.store(QMediaPlayer::PlayingState);
+    preparing.store(true);
+    prepareTimer.start();
+    for (auto &time : startupTimesMs)
+        time.store(-1);
+    emit startLockRequired(true);
+
+    int generation = ++prepareGeneration;
+    prepareThread = std::thread{[this, generation](){
+        prepared = prepare();
+        QMetaObject::invokeMethod(this, [this, generation](){finishPreparing(generation);}, Qt::QueuedConnection);
+    }};
+}
+
+//---------------------------------------------------------------------------------------
+//   Called in the control thread when the preparing thread is finished (or cancelled by
+// the stop); the completion of the outdated opening is ignored.
+void Demuxer::finishPreparing(int generation)
+{
+    if (generation != prepareGeneration || !prepareThread.joinable())
+        return;
+
+    prepareThread.join();
+    {
+        std::lock_guard<std::mutex> guard(stateMutex);
+        preparing.store(false);
+    }
+    currentStateChanged.notify_all();
+    emit startLockRequired(false);
+
+    bool cancelled = desiredState.load() == QMediaPlayer::StoppedState;
+    if (!prepared || cancelled)
+    {
+        loggable.logMessage(objectName(), cancelled ? QtDebugMsg : QtCriticalMsg,
+                            cancelled ? "Opening of the source was cancelled."
+                                      : "Preparing of the demuxer and decoders was failed!");
+        emit preparingProgress(false, QString());
+        reset();
+        return;
+    }
+
+    ready = true;
+    emit streamsFound(streams);
+    emit programsFound(programs);
+
+    if (mosaicMode && !prepareMosaic())
+        loggable.logMessage(objectName(), QtWarningMsg, "Multiviewer can't be shown for this source.");
+    adoptEarlyDecoders();
+
+    emit preparingProgress(false, QString());
+    startPlaybackThread();
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::startPlaybackThread()
+{
+    loggable.logMessage(objectName(), QtDebugMsg, "Start playback thread...");
+    desiredState.store(QMediaPlayer::PlayingState, std::memory_order_seq_cst);
+    playbackThread = std::thread{&Demuxer::playing, this};
+    playbackThread.detach();
+}
+
+//---------------------------------------------------------------------------------------
+bool Demuxer::prepare()
+{
+    [[maybe_unused]] bool ok{true};
+
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Load media source: %1").arg(sourcePath));
+    emit preparingProgress(true, "Opening the source");
+
+    try
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "Allocate packet for receiving...");
+        receivedPacket = av_packet_alloc();
+        if (!receivedPacket)
+        {
+            loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate packet.");
+            throw false;
+        }
+
+        loggable.logMessage(objectName(), QtDebugMsg, "Allocate input context...");
+        inputFormatContext = avformat_alloc_context();
+        if (!inputFormatContext)
+        {
+            loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate AVFormatContext.");
+            throw false;
+        }
+
+        AVDictionary *options = nullptr;
+        // also cancels the opening of any source
+        inputFormatContext->interrupt_callback.callback = interruptCallback;
+        inputFormatContext->interrupt_callback.opaque = this;
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Set interrupt callback, blocking RW operations timeout: %1 milliseconds.")
+                            .arg(rwTimeoutInMilliseconds));
+
+        // the packets are passed on as soon as they're parsed (without the buffering of
+        // the probing), the flushing applies to the custom outputs
+        if (sourceType == SourceType::Stream && lowLatency.load())
+            inputFormatContext->flags |= AVFMT_FLAG_NOBUFFER | AVFMT_FLAG_FLUSH_PACKETS;
+
+        // FFmpeg's own file protocol is used only if the file can't be mapped
+        if (sourceType == SourceType::File && mappedFileInput.open(sourcePath))
+        {
+            inputFormatContext->pb = mappedFileInput.getIoContext();
+            inputFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+
+        auto interruptInput = [this](){
+            bool stopping = currentState.load() != QMediaPlayer::StoppedState
+                    && desiredState.load() == QMediaPlayer::StoppedState;
+            return stopping || interruptCallback(this);
+        };
+
+        // the RTP input gives the clean transport stream (reordered and recovered by the
+        // FEC) to the other inputs; the format is forced, as the rtp:// URL would select
+        // FFmpeg's own RTP demuxer
+        const AVInputFormat *inputFormat = nullptr;
+        if (sourceType == SourceType::Stream && RtpInput::isSupported(sourcePath))
+        {
+            if (!rtpInput.open(sourcePath, interruptInput))
+            {
+                loggable.logMessage(objectName(), QtCriticalMsg, QString("Could not open RTP source: %1").arg(sourcePath));
+                throw false;
+            }
+            inputFormatContext->pb = rtpInput.getIoContext();
+            inputFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+            inputFormat = av_find_input_format("mpegts");
+        }
+
+        // the UDP options of the low latency profile go to the input which opens the socket
+        // (the ring, the analyser or the demuxer itself); the option which is left in the
+        // dictionary after the opening wasn't taken by any of them. The udp protocol
+        // applies the URL query after the options, so the same ones are removed from it.
+        QString inputUrl = sourcePath;
+        bool udpFifoRequested = sourceType == SourceType::Stream && lowLatency.load()
+                && !rtpInput.isOpen() && sourcePath.startsWith("udp://", Qt::CaseInsensitive);
+        udpFifoStatus.clear();
+        if (udpFifoRequested)
+        {
+            av_dict_set_int(&options, "fifo_size", LowLatencyUdpFifoPackets, 0);
+            av_dict_set_int(&options, "overrun_nonfatal", 1, 0);
+
+            int queryStart = sourcePath.indexOf('?');
+            if (queryStart >= 0)
+            {
+                QUrlQuery query(sourcePath.mid(queryStart + 1));
+                query.removeAllQueryItems("fifo_size");
+                query.removeAllQueryItems("overrun_nonfatal");
+                inputUrl = sourcePath.left(queryStart);
+                if (!query.isEmpty())
+                    inputUrl += "?" + query.toString();
+            }
+        }
+
+        // the timeshift buffer receives the stream by itself, the demuxer reads the buffer;
+        // the clock recovery needs the arrival time, so its source is received by the small
+        // ring even without the timeshift
+        bool receivedByRing = timeshiftSettings.enabled || clockRecoveryEnabled;
+        bool ringSupported = rtpInput.isOpen() || TimeshiftBuffer::isSupported(sourcePath);
+        if (sourceType == SourceType::Stream && receivedByRing && ringSupported)
+        {
+            TimeshiftSettings ringSettings = timeshiftSettings;
+            if (!timeshiftSettings.enabled)
+            {
+                ringSettings = lowLatency.load()
+                        ? TimeshiftSettings{true, LowLatencyReceiveFifoSeconds, LowLatencyReceiveFifoMegabytes, false}
+                        : TimeshiftSettings{true, ReceiveFifoSeconds, ReceiveFifoMegabytes, false};
+            }
+            clockRecovery.reset();
+            timeshiftBuffer.setClockRecovery(clockRecoveryEnabled ? &clockRecovery : nullptr);
+
+            bool opened = rtpInput.isOpen()
+                    ? timeshiftBuffer.open(rtpInput.getIoContext(), ringSettings, interruptInput)
+                    : timeshiftBuffer.open(inputUrl, ringSettings, interruptInput, &options);
+            if (opened)
+            {
+                inputFormatContext->pb = timeshiftBuffer.getIoContext();
+                inputFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+                receiveFifoOnly = !timeshiftSettings.enabled;
+                clockRecoveryActive = clockRecoveryEnabled;
+                arrivalFromReceiver = true;
+            }
+            else
+            {
+                loggable.logMessage(objectName(), QtWarningMsg, "Timeshift isn't available, the source is read directly.");
+            }
+        }
+
+        // the raw packets are checked before the demuxer gets them
+        if (tsAnalysisEnabled)
+        {
+            bool tapped = inputFormatContext->pb
+                    ? tsAnalyzer.open(inputFormatContext->pb)
+                    : sourceType == SourceType::Stream && TsAnalyzer::isSupported(inputUrl)
+                      && tsAnalyzer.open(inputUrl, &inputFormatContext->interrupt_callback, &options);
+            if (tapped)
+            {
+                inputFormatContext->pb = tsAnalyzer.getIoContext();
+                inputFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+            }
+        }
+
+        // the probing stops as soon as the parameters of all the streams are known
+        // (the frame rate isn't waited for), the limits also bound the search of PAT/PMT
+        bool fastStart = sourceType == SourceType::Stream && fastStartSettings.enabled;
+        if (fastStart)
+        {
+            av_dict_set_int(&options, "probesize", int64_t(fastStartSettings.probeSizeKilobytes) * 1024, 0);
+            av_dict_set_int(&options, "analyzeduration", int64_t(fastStartSettings.analyzeDurationMs) * 1000, 0);
+            av_dict_set_int(&options, "fpsprobesize", 0, 0);
+        }
+        fastStartResult.clear();
+
+        latencyMeter.reset();
+
+        timer.restart();
+        loggable.logMessage(objectName(), QtDebugMsg, "Open input context...");
+        int result = avformat_open_input(&inputFormatContext, inputUrl.toUtf8().data(), inputFormat, &options);
+        if (udpFifoRequested)
+        {
+            udpFifoStatus = av_dict_get(options, "fifo_size", nullptr, 0)
+                    ? QString("not applied")
+                    : QString("%1 packets (%2 KB)").arg(LowLatencyUdpFifoPackets).arg(LowLatencyUdpFifoPackets * 188 / 1024);
+            loggable.logMessage(objectName(), QtDebugMsg, QString("UDP FIFO: %1.").arg(udpFifoStatus));
+        }
+        av_dict_free(&options);
+        if (result < 0)
+        {
+            loggable.logMessage(objectName(), QtCriticalMsg, QString("Could not open source: %1").arg(sourcePath));
+            throw false;
+        }
+        markStartupStage(OpenInputStage);
+
+        if (tsAnalyzer.isOpen() && strcmp(inputFormatContext->iformat->name, "mpegts") != 0)
+            tsAnalyzer.stopAnalysis();
+
+        openDecodersEarly();
+
+        // the streams are already created from PAT/PMT, the cache fills the rest
+        bool mpegts = fastStart && strcmp(inputFormatContext->iformat->name, "mpegts") == 0;
+        bool probed = false;
+        psiCacheValidationPending = false;
+        if (mpegts && psiCache.load(sourcePath))
+        {
+            probed = psiCache.apply(inputFormatContext);
+            fastStartResult = probed ? "PSI cache" : "stale PSI cache, probed";
+            if (probed)
+            {
+                psiCacheValidationPending = true;
+                psiCacheValidationTimer.start();
+            }
+            else
+            {
+                loggable.logMessage(objectName(), QtDebugMsg, "Cached stream parameters are stale, probe the streams.");
+            }
+        }
+
+        if (!probed)
+        {
+            emit preparingProgress(true, "Probing the streams");
+            loggable.logMessage(objectName(), QtDebugMsg, "Find stream info...");
+            if (avformat_find_stream_info(inputFormatContext, NULL) < 0)
+            {
+                loggable.logMessage(objectName(), QtCriticalMsg, "Could not find stream information.");
+                throw false;
+            }
+            if (mpegts)
+            {
+                psiCache.save(sourcePath, inputFormatContext);
+                if (fastStartResult.isEmpty())
+                    fastStartResult = "probed";
+            }
+        }
+        markStartupStage(StreamInfoStage);
+
+        if (!findStreams())
+        {
+            loggable.logMessage(objectName(), QtWarningMsg, "Valid streams does not found.");
+            throw false;
+        }
+
+        findPrograms();
+
+        if (sourceType == SourceType::File)
+            prepareSeekIndex();
+
+        emit preparingProgress(true, "Opening the decoders");
+
+        // it's left for debugging
+        //    int videoIndex = getFirstStreamByType(AVMEDIA_TYPE_VIDEO);
+        //    if (videoIndex != -1)
+        //    {
+        //        ok = prepareVideoDecoder(videoIndex);
+        //        if (!ok)
+        //            throw false;
+        //    }
+
+        //    int audioIndex = getFirstStreamByType(AVMEDIA_TYPE_AUDIO);
+        //    if (audioIndex != -1)
+        //    {
+        //        ok = prepareAudioDecoder(audioIndex);
+        //        if (!ok)
+        //            throw false;
+        //    }
+    }
+    catch (const bool &e)
+    {
+        ok = e;
+    }
+
+    // on the failure the partly opened source is released by the reset
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------
+//   The formats with the header (Matroska, MP4, ...) describe the streams before
+// the probing. The decoders of the streams which will be selected first are opened
+// by the worker pool meanwhile (with the copy of the parameters, the probing updates
+// the stream's ones), and they are taken when the source is ready.
+void Demuxer::openDecodersEarly()
+{
+    if (inputFormatContext->ctx_flags & AVFMTCTX_NOHEADER || inputFormatContext->nb_programs > 0)
+        return;
+
+    // the same stream as the first one in the stream list (sorted by the id)
+    auto findFirstStream = [this](AVMediaType type){
+        int found = -1;
+        int foundKey = 0;
+        for (unsigned int i = 0; i < inputFormatContext->nb_streams; ++i)
+        {
+            const AVStream *stream = inputFormatContext->streams[i];
+            int key = stream->id ? stream->id : stream->index;
+            if (stream->codecpar->codec_type == type && (found == -1 || key < foundKey))
+            {
+                found = int(i);
+                foundKey = key;
+            }
+        }
+        return found;
+    };
+
+    WorkerPool *pool = WorkerPool::getInstance();
+
+    int videoIndex = mosaicMode ? -1 : findFirstStream(AVMEDIA_TYPE_VIDEO);
+    if (videoIndex != -1)
+    {
+        AVStream *stream = inputFormatContext->streams[videoIndex];
+        const AVCodecParameters *parameters = stream->codecpar;
+        if (parameters->codec_id != AV_CODEC_ID_NONE && parameters->width > 0 && parameters->height > 0)
+        {
+            earlyVideoDecoder = createVideoDecoder();
+            earlyVideoDecoder->setCodecParameters(parameters);
+            earlyVideoStreamIndex = videoIndex;
+            pool->post(videoStrand, [this, decoder = earlyVideoDecoder, stream](){
+                if (decoder->open(stream))
+                    markStartupStage(VideoDecoderStage);
+            });
+        }
+    }
+
+    int audioIndex = findFirstStream(AVMEDIA_TYPE_AUDIO);
+    if (audioIndex != -1)
+    {
+        AVStream *stream = inputFormatContext->streams[audioIndex];
+        const AVCodecParameters *parameters = stream->codecpar;
+        if (parameters->codec_id != AV_CODEC_ID_NONE && parameters->sample_rate > 0 && parameters->ch_layout.nb_channels > 0)
+        {
+            earlyAudioDecoder = createAudioDecoder();
+            earlyAudioDecoder->setCodecParameters(parameters);
+            earlyAudioStreamIndex = audioIndex;
+            pool->post(audioStrand, [this, decoder = earlyAudioDecoder, stream](){
+                if (decoder->open(stream))
+                    markStartupStage(AudioDecoderStage);
+            });
+        }
+    }
+
+    if (earlyVideoDecoder || earlyAudioDecoder)
+    {
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Decoders are opened early: video stream %1, audio stream %2.")
+                            .arg(earlyVideoStreamIndex).arg(earlyAudioStreamIndex));
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The early decoders become the active ones without waiting for the selection in
+// the stream lists (the same selection is ignored then).
+void Demuxer::adoptEarlyDecoders()
+{
+    if (earlyVideoDecoder && !mosaicActive.load())
+        prepareVideoDecoder(earlyVideoStreamIndex);
+    if (earlyAudioDecoder)
+        prepareAudioDecoder(earlyAudioStreamIndex);
+
+    releaseEarlyDecoders();
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::releaseEarlyDecoders()
+{
+    if (earlyVideoDecoder)
+    {
+        videoStrand->waitForIdle();
+        earlyVideoDecoder->deleteLater();
+        earlyVideoDecoder = nullptr;
+    }
+    if (earlyAudioDecoder)
+    {
+        audioStrand->waitForIdle();
+        earlyAudioDecoder->deleteLater();
+        earlyAudioDecoder = nullptr;
+    }
+    earlyVideoStreamIndex = -1;
+    earlyAudioStreamIndex = -1;
+}
+
+//---------------------------------------------------------------------------------------
+//   Time from the start of the opening, only the first mark of the stage is kept.
+void Demuxer::markStartupStage(int stage)
+{
+    int64_t notMarked = -1;
+    if (startupTimesMs[stage].load() == notMarked)
+        startupTimesMs[stage].compare_exchange_strong(notMarked, prepareTimer.elapsed());
+}
+
+//---------------------------------------------------------------------------------------
+bool Demuxer::findStreams()
+{
+    loggable.logMessage(objectName(), QtDebugMsg, "Find streams...");
+
+    streams.clear();
+
+    if (!inputFormatContext)
+        return false;
+
+    streams.resize(inputFormatContext->nb_streams);
+
+    std::unordered_map<AVMediaType, int> streamsCounts;
+
+    for (unsigned int i = 0; i < inputFormatContext->nb_streams; ++i)
+    {
+        std::shared_ptr<StreamInfo> streamInfo = createStreamInfo(inputFormatContext->streams[i]);
+        streamsCounts[streamInfo->type]++;
+        streams[streamInfo->index] = streamInfo;
+    }
+
+    QString msg = QString("Found %1 video and %2 audio streams")
+            .arg(streamsCounts[AVMEDIA_TYPE_VIDEO])
+            .arg(streamsCounts[AVMEDIA_TYPE_AUDIO]);
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
+    return streamsCounts[AVMEDIA_TYPE_VIDEO] + streamsCounts[AVMEDIA_TYPE_AUDIO];
+}
+
+//---------------------------------------------------------------------------------------
+std::shared_ptr<StreamInfo> Demuxer::createStreamInfo(AVStream *stream)
+{
+    AVMediaType type = stream->codecpar->codec_type;
+    int idx = stream->index;
+
+    auto streamInfo = std::make_shared<StreamInfo>();
+    streamInfo->index = idx;
+    streamInfo->stream = stream;
+    streamInfo->type = type;
+    streamInfo->id = stream->id;
+
+    QString msg = QString("Stream: index - %1, id - %2, type - %3.")
+            .arg(idx).arg(stream->id).arg(mapAvMediaTypeToString(type));
+
+    AVDictionary *meta = stream->metadata;
+    AVDictionaryEntry *entry = av_dict_get(meta, "", nullptr, AV_DICT_IGNORE_SUFFIX);
+    if (entry)
+    {
+        msg.append("\nMetadata:");
+        while (entry)
+        {
+            streamInfo->properties[entry->key] = entry->value;
+            QString str = QString("\n%1 = %2");
+            msg.append(str.arg(entry->key, entry->value));
+            entry = av_dict_get(meta, "", entry, AV_DICT_IGNORE_SUFFIX);
+        }
+    }
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
+    return streamInfo;
+}
+
+//---------------------------------------------------------------------------------------
+bool Demuxer::findPrograms()
+{
+    loggable.logMessage(objectName(), QtDebugMsg, "Find programs...");
+
+    programs.clear();
+
+    if (!inputFormatContext)
+        return false;
+
+    for (unsigned int i = 0; i < inputFormatContext->nb_programs; ++i)
+    {
+        AVProgram *avProgram = inputFormatContext->programs[i];
+
+        auto programInfo = std::make_shared<ProgramInfo>();
+        programInfo->avProgram = avProgram;
+        updateProgramInfo(programInfo);
+        programs[avProgram->id] = programInfo;
+    }
+
+    QString msg = QString("Found %1 programs").arg(programs.size());
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
+    return !programs.empty();
+}
+
+//---------------------------------------------------------------------------------------
+//   Takes the current PMT version, the metadata and the streams of the program.
+void Demuxer::updateProgramInfo(std::shared_ptr<ProgramInfo> program)
+{
+    AVProgram *avProgram = program->avProgram;
+    program->lastPmtVersion = avProgram->pmt_version;
+    program->lastStreamCount = avProgram->nb_stream_indexes;
+    program->removed = avProgram->nb_stream_indexes == 0;
+
+    QString msg = QString("Program: id - %1, program number - %2, PMT PID - %3, PCR PID - %4, PMT version - %5.")
+            .arg(avProgram->id)
+            .arg(avProgram->program_num)
+            .arg(avProgram->pmt_pid)
+            .arg(avProgram->pcr_pid)
+            .arg(avProgram->pmt_version);
+
+    program->properties.clear();
+    AVDictionary *meta = avProgram->metadata;
+    AVDictionaryEntry *entry = av_dict_get(meta, "", nullptr, AV_DICT_IGNORE_SUFFIX);
+    if (entry)
+    {
+        msg.append("\nMetadata:");
+        while (entry)
+        {
+            program->properties[entry->key] = entry->value;
+            QString str = QString("\n%1 = %2");
+            msg.append(str.arg(entry->key, entry->value));
+            entry = av_dict_get(meta, "", entry, AV_DICT_IGNORE_SUFFIX);
+        }
+    }
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
+    program->streams.clear();
+    fillProgramStreamsData(program);
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::fillProgramStreamsData(std::shared_ptr<ProgramInfo> program)
+{
+    QString msg = QString("Fill the stream data for the program %1").arg(program->avProgram->id);
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
+    AVProgram *avProgram = program->avProgram;
+    QString msgPattern = QString("Program %1: stream #%2 - PID %3, type '%4'");
+    for (unsigned int i = 0; i < avProgram->nb_stream_indexes; ++i)
+    {
+        int idx = avProgram->stream_index[i];
+        if (idx >= int(streams.size()))
+            continue;
+
+        AVStream *stream = inputFormatContext->streams[idx];
+        AVMediaType type = stream->codecpar->codec_type;
+
+        program->streams[idx] = streams[idx];
+
+        msg = msgPattern
+                .arg(avProgram->id)
+                .arg(i+1)
+                .arg(stream->id)
+                .arg(QString::fromStdString(mapAvMediaTypeToString(type)));
+
+        loggable.logMessage(objectName(), QtDebugMsg, msg);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   Called by the playing thread between the packets: the MPEG-TS demuxer adds
+// the streams of the new PIDs and rebuilds the program when its PMT is changed.
+bool Demuxer::isStreamsRefreshNeeded() const
+{
+    if (inputFormatContext->nb_streams != streams.size() || inputFormatContext->nb_programs != programs.size())
+        return true;
+
+    for (unsigned int i = 0; i < inputFormatContext->nb_programs; ++i)
+    {
+        const AVProgram *avProgram = inputFormatContext->programs[i];
+        auto it = programs.find(avProgram->id);
+        if (it == programs.end() || it->second->lastPmtVersion != avProgram->pmt_version
+                || it->second->lastStreamCount != avProgram->nb_stream_indexes)
+            return true;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::requestStreamsRefresh()
+{
+    if (!streamsRefreshPending.exchange(true))
+        QMetaObject::invokeMethod(this, [this](){refreshStreams();}, Qt::QueuedConnection);
+}
+
+//---------------------------------------------------------------------------------------
+//   Updates the streams and the programs in place (the playing thread is held
+// meanwhile) and reports only the difference. The stream of a PID which is no longer
+// listed by any PMT is kept (the stream indexes don't move), but it's marked removed;
+// its decoder is closed. The other decoders aren't touched.
+void Demuxer::refreshStreams()
+{
+    streamsRefreshPending.store(false);
+    if (!ready || !inputFormatContext)
+        return;
+
+    holdPlaying();
+
+    std::vector<std::shared_ptr<StreamInfo>> addedStreams;
+    std::vector<int> removedStreams;
+    std::map<int, std::shared_ptr<ProgramInfo>> changedPrograms;
+
+    // the type of the PID may be changed by PMT too, such stream is replaced
+    for (unsigned int i = 0; i < inputFormatContext->nb_streams; ++i)
+    {
+        AVStream *stream = inputFormatContext->streams[i];
+        if (i < streams.size() && streams[i]->type == stream->codecpar->codec_type)
+            continue;
+
+        if (i < streams.size())
+            removedStreams.push_back(int(i));
+        else
+            streams.resize(i + 1);
+
+        streams[i] = createStreamInfo(stream);
+        addedStreams.push_back(streams[i]);
+    }
+
+    for (unsigned int i = 0; i < inputFormatContext->nb_programs; ++i)
+    {
+        AVProgram *avProgram = inputFormatContext->programs[i];
+        std::shared_ptr<ProgramInfo> &programInfo = programs[avProgram->id];
+        if (!programInfo)
+        {
+            programInfo = std::make_shared<ProgramInfo>();
+            programInfo->avProgram = avProgram;
+        }
+        else if (programInfo->lastPmtVersion == avProgram->pmt_version
+                 && programInfo->lastStreamCount == avProgram->nb_stream_indexes
+                 && std::none_of(addedStreams.begin(), addedStreams.end(), [&programInfo](const auto &item){
+                        return programInfo->streams.count(item->index) != 0;
+                    }))
+        {
+            continue;
+        }
+
+        updateProgramInfo(programInfo);
+        changedPrograms[avProgram->id] = programInfo;
+        if (programInfo->removed)
+            loggable.logMessage(objectName(), QtDebugMsg, QString("Program %1 is removed.").arg(avProgram->id));
+    }
+
+    if (inputFormatContext->nb_programs > 0 && !changedPrograms.empty())
+    {
+        std::vector<bool> listed(streams.size(), false);
+        for (const auto &[id, programInfo] : programs)
+        {
+            for (const auto &[idx, streamInfo] : programInfo->streams)
+                listed[idx] = true;
+        }
+
+        // the PID may come back later (its stream is reused by FFmpeg)
+        for (const auto &streamInfo : streams)
+        {
+            if (listed[streamInfo->index] == !streamInfo->removed)
+                continue;
+
+            streamInfo->removed = !listed[streamInfo->index];
+            if (streamInfo->removed)
+                removedStreams.push_back(streamInfo->index);
+            else
+                addedStreams.push_back(streamInfo);
+        }
+    }
+
+    for (int idx : removedStreams)
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, QString("Stream %1 (PID %2) is removed.").arg(idx).arg(streams[idx]->id));
+        if (idx == activeVideoStreamIndex.load())
+            resetVideoDecoder();
+        else if (idx == activeAudioStreamIndex.load())
+            resetAudioDecoder();
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Streams are refreshed: %1 added, %2 removed, %3 program(s) changed.")
+                        .arg(addedStreams.size())
+                        .arg(removedStreams.size())
+                        .arg(changedPrograms.size()));
+
+    if (!addedStreams.empty() || !removedStreams.empty())
+        emit streamsChanged(addedStreams, removedStreams);
+    if (!changedPrograms.empty())
+        emit programsChanged(changedPrograms);
+
+    releasePlaying();
+}
+
+//---------------------------------------------------------------------------------------
+//   Waits until the playing thread is held between the packets (or isn't reading: it's
+// paused or stopped). Unlike pause() the UI isn't notified.
+void Demuxer::holdPlaying()
+{
+    std::unique_lock<std::mutex> locker(stateMutex);
+    holdRequested.store(true);
+    currentStateChanged.wait(locker, [this](){
+        return playingHeld || currentState.load() != QMediaPlayer::PlayingState;
+    });
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::releasePlaying()
+{
+    {
+        std::lock_guard<std::mutex> guard(stateMutex);
+        holdRequested.store(false);
+    }
+    desiredStateChanged.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::playing()
+{
+    loggable.logMessage(objectName(), QtDebugMsg, "Run decoding.");
+
+    if (!ready || !receivedPacket)
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg, "Player does not ready for decoding.");
+        return;
+    }
+
+    currentState.store(QMediaPlayer::PlayingState);
+
+    notifyPlaybackState();
+
+    if (sourceType == SourceType::Stream)
+        av_read_play(inputFormatContext);
+
+    statisticsTimer.start();
+    const std::function<bool()> stopRequested = [this](){
+        return desiredState.load() == QMediaPlayer::StoppedState;
+    };
+    loggable.logMessage(objectName(), QtDebugMsg, "Enter to decoding loop...");
+    while (desiredState.load() != QMediaPlayer::StoppedState)
+    {
+
+        if (desiredState.load() == QMediaPlayer::PausedState)
+        {
+            if (currentState.load() != QMediaPlayer::PausedState)
+            {
+                currentState.store(QMediaPlayer::PausedState);
+                // the timeshift buffer keeps receiving while the playback is paused
+                if (sourceType == SourceType::Stream && !timeshiftBuffer.isOpen())
+                    av_read_pause(inputFormatContext);
+
+                currentStateChanged.notify_all();
+                notifyPlaybackState();
+            }
+
+            std::unique_lock<std::mutex> locker(stateMutex);
+            while (desiredState.load() == QMediaPlayer::PausedState)
+            {
+                desiredStateChanged.wait(locker, [this](){return desiredState.load() != QMediaPlayer::PausedState;});
+            }
+            currentState.store(QMediaPlayer::PlayingState);
+            currentStateChanged.notify_all();
+            notifyPlaybackState();
+            startDTS = -1;
+        }
+
+        if (holdRequested.load())
+        {
+            std::unique_lock<std::mutex> locker(stateMutex);
+            playingHeld = true;
+            currentStateChanged.notify_all();
+            desiredStateChanged.wait(locker, [this](){
+                return !holdRequested.load() || desiredState.load() == QMediaPlayer::StoppedState;
+            });
+            playingHeld = false;
+        }
+
+        timer.restart();
+        if (av_read_frame(inputFormatContext, receivedPacket) < 0)
+            break;
+        int64_t readTimeUs = av_gettime_relative();
+
+        markStartupStage(FirstPacketStage);
+        if (receivedPacket->stream_index >= int(streams.size()))
+            requestStreamsRefresh();
+        recorder.writePacket(receivedPacket);
+
+        // the pacing goes on, only the decoding is skipped
+        bool scrambled = checkScrambling(receivedPacket);
+
+        if (mosaicActive.load())
+        {
+            if (receivedPacket->stream_index == mosaicPacingStreamIndex)
+                waitForReachPtsTime(receivedPacket);
+
+            if (!scrambled)
+                routeMosaicPacket(receivedPacket);
+
+            if (!mosaicComposeTimer.isValid() || mosaicComposeTimer.elapsed() >= MosaicFrameIntervalMs)
+            {
+                mosaicComposeTimer.start();
+                composeMosaic();
+            }
+        }
+
+        int maxQueuedPackets = lowLatency.load() ? LowLatencyMaxQueuedPackets : MaxQueuedPackets;
+        if (receivedPacket->stream_index == activeVideoStreamIndex.load())
+        {
+            if (!isBeforeSeekTarget(receivedPacket))
+                waitForReachPtsTime(receivedPacket);
+
+            // the reading is blocked while the decoder can't keep up (until the stop)
+            if (videoDecoder && videoDecoder->isOpen() && !scrambled
+                    && videoStrand->waitForQueuedBelow(maxQueuedPackets, stopRequested))
+            {
+                addPacketArrival(LatencyMeter::Video, receivedPacket, readTimeUs);
+                decodePacketInPool(videoStrand, videoDecoder, receivedPacket);
+            }
+        }
+        else if (receivedPacket->stream_index == activeAudioStreamIndex.load())
+        {
+            bool beforeSeekTarget = isBeforeSeekTarget(receivedPacket);
+            if (activeVideoStreamIndex.load() == -1 && !mosaicActive.load() && !beforeSeekTarget)
+                waitForReachPtsTime(receivedPacket);
+
+            // the audio can't be played faster, it's skipped while the live is caught up
+            if (audioDecoder && audioDecoder->isOpen() && playbackSpeed.load() == 1.0 && !beforeSeekTarget && !scrambled
+                    && audioStrand->waitForQueuedBelow(maxQueuedPackets, stopRequested))
+            {
+                addPacketArrival(LatencyMeter::Audio, receivedPacket, readTimeUs);
+                decodePacketInPool(audioStrand, audioDecoder, receivedPacket);
+            }
+        }
+        av_packet_unref(receivedPacket);
+
+        if (statisticsTimer.elapsed() >= StatisticsUpdateIntervalMs)
+        {
+            statisticsTimer.restart();
+            updateLoadGovernor();
+            updateTimeshift();
+            updateClockRecovery();
+            validatePsiCache();
+            if (isStreamsRefreshNeeded())
+                requestStreamsRefresh();
+            if (sourceType == SourceType::File)
+                emit positionChanged(currentPositionUs.load() / 1000);
+            publishStatistics();
+        }
+    }
+    loggable.logMessage(objectName(), QtDebugMsg, "Exit from the playing loop.");
+    currentState.store(QMediaPlayer::StoppedState);
+    if (sourceType == SourceType::Stream)
+        av_read_pause(inputFormatContext);
+    notifyPlaybackState();
+    reset();
+    currentStateChanged.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::waitForReachPtsTime(AVPacket *packet)
+{
+    if (packet->dts == AV_NOPTS_VALUE)
+    {
+        QString msg = QString("ERROR wait for reach DTS time - AV_NOPTS_VALUE, stream (index/id, type): %1/%2, %3.")
+                .arg(receivedPacket->stream_index)
+                .arg(streams[receivedPacket->stream_index]->id)
+                .arg(mapAvMediaTypeToString(streams[receivedPacket->stream_index]->type));
+        loggable.logAvError(objectName(), QtWarningMsg, msg, -1);
+        return;
+    }
+
+    AVRational time_base = streams[packet->stream_index]->stream->time_base;
+    AVRational time_base_q = {1,AV_TIME_BASE};
+    int64_t dts_time = av_rescale_q(packet->dts, time_base, time_base_q);
+    currentPositionUs.store(std::max<int64_t>(0, dts_time - getInputStartTime()));
+
+    // the pacing starts over from the packet which follows the bypass
+    if (isPacingBypassed())
+    {
+        startDTS = -1;
+        pacingLatenessUs = 0;
+        return;
+    }
+
+    double speed = playbackSpeed.load();
+    if (startDTS < 0 || speed != pacingSpeed)
+    {
+        startDTS = dts_time;
+        startTime = av_gettime();
+        pacingLatenessUs = 0;
+        pacingSpeed = speed;
+        pacingRatio = clockRatio;
+        latencyTargetUs = -1;
+    }
+    else
+    {
+        // the reference is moved to this packet, so the new ratio applies only to the
+        // following stream time
+        if (clockRatio != pacingRatio)
+        {
+            startTime += int64_t((dts_time - startDTS) / pacingSpeed * pacingRatio);
+            startDTS = dts_time;
+            pacingRatio = clockRatio;
+        }
+
+        int64_t nowTime = av_gettime() - startTime;
+        int64_t streamTime = int64_t((dts_time - startDTS) / pacingSpeed * pacingRatio);
+        pacingLatenessUs = std::max<int64_t>(0, nowTime - streamTime);
+        if (streamTime > nowTime)
+            av_usleep(streamTime - nowTime);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The live stream of the low latency profile is decoded as it's received (the
+// network is its clock). The timeshift is paced, its buffer is behind the live.
+bool Demuxer::isPacingBypassed() const
+{
+    return lowLatency.load()
+            && sourceType == SourceType::Stream
+            && (!timeshiftBuffer.isOpen() || receiveFifoOnly);
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::addPacketArrival(int output, const AVPacket *packet, int64_t readTimeUs)
+{
+    if (sourceType != SourceType::Stream)
+        return;
+
+    int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if (pts == AV_NOPTS_VALUE)
+        return;
+
+    int64_t arrivalUs = arrivalFromReceiver && packet->pos >= 0 ? timeshiftBuffer.getArrivalTime(packet->pos) : -1;
+    latencyMeter.addArrival(output, pts, arrivalUs >= 0 ? arrivalUs : readTimeUs);
+}
+
+//---------------------------------------------------------------------------------------
+//   The scrambling is found by the analyser of the raw input (the bits are lost by
+// the demuxing), it's ahead of the demuxer by its buffers. The change is logged once.
+bool Demuxer::checkScrambling(const AVPacket *packet)
+{
+    if (packet->stream_index < 0 || packet->stream_index >= int(streams.size()))
+        return false;
+
+    StreamInfo &streamInfo = *streams[packet->stream_index];
+    bool scrambled = tsAnalyzer.isOpen() && tsAnalyzer.isScrambled(streamInfo.id);
+    if (scrambled != streamInfo.scrambled.load())
+    {
+        streamInfo.scrambled.store(scrambled);
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Stream %1 (PID %2) is %3.")
+                            .arg(streamInfo.index)
+                            .arg(streamInfo.id)
+                            .arg(scrambled ? "scrambled, it isn't decoded" : "not scrambled any more"));
+        emit streamScramblingChanged(streamInfo.index, scrambled);
+    }
+    return scrambled;
+}
+
+//---------------------------------------------------------------------------------------
+//   The packet is referenced (not copied) by the task. The strand must be cleared and
+// drained before the decoder is deleted.
+void Demuxer::decodePacketInPool(const std::shared_ptr<WorkerPool::Strand> &strand,
+                                 Decoder *decoder, const AVPacket *packet)
+{
+    std::shared_ptr<AVPacket> pooledPacket(av_packet_clone(packet), [](AVPacket *pkt){
+        av_packet_free(&pkt);
+    });
+    if (!pooledPacket)
+        return;
+
+    // the stream list may grow while the task waits in the strand
+    std::shared_ptr<StreamInfo> streamInfo = streams[packet->stream_index];
+    WorkerPool::getInstance()->post(strand, [this, decoder, pooledPacket, streamInfo](){
+        int result = decoder->decodePacket(pooledPacket.get());
+        if (result < 0)
+        {
+            // ignore decoding errors (the scrambled packets aren't sent), only logging
+            QString msg = QString("ERROR of packet decoding (stream (index/id, type): %1/%2, %3.")
+                    .arg(streamInfo->index)
+                    .arg(streamInfo->id)
+                    .arg(mapAvMediaTypeToString(streamInfo->type));
+            loggable.logAvError(objectName(), QtWarningMsg, msg, result);
+        }
+    });
+}
+
+//---------------------------------------------------------------------------------------
+//   The reading is moved inside of the timeshift buffer: the demuxer and the decoders
+// drop the buffered data and continue from the key frame found by the index.
+void Demuxer::moveTimeshiftPosition(int64_t lagUs)
+{
+    bool needResume = false;
+    if (currentState.load() == QMediaPlayer::PlayingState)
+    {
+        needResume = true;
+        pause();
+    }
+
+    int64_t position = timeshiftBuffer.findPosition(lagUs);
+    avformat_flush(inputFormatContext);
+    int64_t result = avio_seek(inputFormatContext->pb, position, SEEK_SET);
+    if (result < 0)
+        loggable.logAvError(objectName(), QtWarningMsg, "Could not move in the timeshift buffer.", int(result));
+
+    flushDecoders();
+    playbackSpeed.store(1.0);
+    startDTS = -1;
+    startTime = -1;
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Timeshift position: %1 s behind the live (offset %2).")
+                        .arg(lagUs / 1000000.0, 0, 'f', 1)
+                        .arg(position));
+
+    if (needResume)
+    {
+        desiredState.store(QMediaPlayer::PlayingState);
+        desiredStateChanged.notify_all();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::updateTimeshift()
+{
+    if (!timeshiftBuffer.isOpen() || receiveFifoOnly)
+        return;
+
+    TimeshiftStatus status = timeshiftBuffer.getStatus();
+    if (playbackSpeed.load() != 1.0 && status.lagUs <= CatchUpFinishLagUs)
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "Live is caught up.");
+        playbackSpeed.store(1.0);
+    }
+
+    emit timeshiftUpdated(true, status.bufferedUs / 1000, status.lagUs / 1000);
+}
+
+//---------------------------------------------------------------------------------------
+//   The parameters taken from the PSI cache are compared with the first frames of the
+// active decoders; the entry is corrected if they differ, and written again either way
+// (the decoder which gets no frame isn't waited for longer than the timeout).
+void Demuxer::validatePsiCache()
+{
+    if (!psiCacheValidationPending)
+        return;
+
+    bool decoded = true;
+    bool matches = true;
+    auto validate = [&](Decoder *decoder, int streamIndex){
+        if (!decoder || streamIndex < 0 || streamIndex >= int(streams.size()))
+            return;
+        DecodedFormat format = decoder->getFirstFrameFormat();
+        if (!format.valid)
+            decoded = false;
+        else if (!psiCache.validate(streams[streamIndex]->id, format))
+            matches = false;
+    };
+    validate(videoDecoder, activeVideoStreamIndex.load());
+    validate(audioDecoder, activeAudioStreamIndex.load());
+
+    if (!decoded && !psiCacheValidationTimer.hasExpired(PsiCacheValidationTimeoutMs))
+        return;
+    psiCacheValidationPending = false;
+
+    if (!matches)
+    {
+        loggable.logMessage(objectName(), QtWarningMsg,
+                            "Cached stream parameters differ from the decoded ones, the cache entry is corrected.");
+        fastStartResult = "stale PSI cache, corrected";
+        // the file is written only when the entry was corrected (it's the playing thread)
+        psiCache.refresh();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The pacing follows the recovered sender clock, so the receive FIFO neither drains
+// nor grows; the trim holds its lag (taken when the pacing starts over) against the
+// residual error of the recovery. The video frames are presented as they're decoded,
+// so they follow the pacing (a frame is shown a little sooner or later, the display
+// drops or repeats it at its refresh rate); the audio is resampled by the same ratio,
+// the sound card plays it at the local clock.
+void Demuxer::updateClockRecovery()
+{
+    if (!clockRecoveryActive)
+        return;
+
+    ClockRecoveryStatus status = clockRecovery.getStatus();
+    int64_t lagUs = timeshiftBuffer.getStatus().lagUs;
+    if (!status.locked || playbackSpeed.load() != 1.0)
+    {
+        latencyTargetUs = -1;
+        latencyTrimPpm = 0.0;
+    }
+    else if (latencyTargetUs < 0)
+    {
+        latencyTargetUs = lagUs;
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Receive FIFO lag is held at %1 ms.").arg(latencyTargetUs / 1000));
+    }
+    else
+    {
+        // the larger lag is caught up by the faster pacing (the smaller ratio)
+        latencyTrimPpm = std::clamp(-(lagUs - latencyTargetUs) / LatencyTimeConstantUs * 1000000.0,
+                                    -MaxLatencyTrimPpm, MaxLatencyTrimPpm);
+    }
+
+    clockRatio = clockRecovery.getRatio() * (1.0 + latencyTrimPpm / 1000000.0);
+    if (audioDecoder)
+        audioDecoder->setClockRatio(clockRatio);
+}
+
+//---------------------------------------------------------------------------------------
+//   The queued packets are dropped and the decoders are flushed by the tasks of their
+// strands (after the running task is finished).
+void Demuxer::flushDecoders()
+{
+    WorkerPool *pool = WorkerPool::getInstance();
+    auto flush = [pool](const std::shared_ptr<WorkerPool::Strand> &strand, Decoder *decoder){
+        strand->clear();
+        if (decoder)
+            pool->post(strand, [decoder](){decoder->flush();});
+    };
+
+    flush(videoStrand, videoDecoder);
+    flush(audioStrand, audioDecoder);
+    for (const auto &tile : mosaicTiles)
+    {
+        flush(tile->strand, tile->videoDecoder);
+        if (tile->audioDecoder)
+            pool->post(tile->strand, [decoder = tile->audioDecoder](){decoder->flush();});
+        tile->waitForKeyframe = true;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::prepareSeekIndex()
+{
+    bool seekable = seekIndex.open(sourcePath, inputFormatContext, getFirstStreamByType(AVMEDIA_TYPE_VIDEO));
+    int64_t duration = inputFormatContext->duration != AV_NOPTS_VALUE ? inputFormatContext->duration : 0;
+
+    seekTargetUs.store(AV_NOPTS_VALUE);
+    currentPositionUs.store(0);
+    emit seekRangeChanged(seekable && duration > 0, duration / 1000);
+}
+
+//---------------------------------------------------------------------------------------
+//   The target is reached by the first packet of the pacing stream (the video, or
+// the audio if there is no video) which isn't before it.
+bool Demuxer::isBeforeSeekTarget(const AVPacket *packet)
+{
+    int64_t targetUs = seekTargetUs.load();
+    if (targetUs == AV_NOPTS_VALUE || packet->dts == AV_NOPTS_VALUE)
+        return false;
+
+    int64_t dtsUs = av_rescale_q(packet->dts, streams[packet->stream_index]->stream->time_base,
+                                 AVRational{1, AV_TIME_BASE});
+    if (dtsUs < targetUs)
+        return true;
+
+    int pacingIndex = activeVideoStreamIndex.load() != -1 ? activeVideoStreamIndex.load() : activeAudioStreamIndex.load();
+    if (packet->stream_index == pacingIndex)
+        seekTargetUs.store(AV_NOPTS_VALUE);
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+int64_t Demuxer::getInputStartTime() const
+{
+    if (!inputFormatContext || inputFormatContext->start_time == AV_NOPTS_VALUE)
+        return 0;
+    return inputFormatContext->start_time;
+}
 
 //---------------------------------------------------------------------------------------
-void Demuxer::playing()
+void Demuxer::notifyPlaybackState()
 {
-    loggable.logMessage(objectName(), QtDebugMsg, "Run decoding.");
+    QString msg = QString("Playback state changed: %1").arg(mapPlaybackStateToString(currentState));
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
 
-    if (!ready || !receivedPacket)
+    emit playbackStateChanged(currentState);
+}
+
+//---------------------------------------------------------------------------------------
+//   The utilization is the part of the wall time spent in the video strand (decoding,
+// filtering and conversion), the lateness is the larger of the reading delay and
+// the backlog of the video strand (one frame interval per queued packet).
+void Demuxer::updateLoadGovernor()
+{
+    if (!videoDecoder || !videoDecoder->isOpen())
+        return;
+
+    // only the decoding and the filtering are the load, the strand time would include
+    // everything else the tasks do (the counters restart with the reopened decoder)
+    int64_t busyTimeUs = videoDecoder->getStatistics().decodingTimeUs
+            + videoDecoder->getFilterStatistics().filteringTimeUs;
+    int64_t elapsedUs = loadGovernorTimer.isValid() ? loadGovernorTimer.nsecsElapsed() / 1000 : 0;
+    loadGovernorTimer.start();
+
+    if (elapsedUs <= 0 || busyTimeUs < lastVideoBusyTimeUs)
     {
-        loggable.logMessage(objectName(), QtCriticalMsg, "Player does not ready for decoding.");
+        lastVideoBusyTimeUs = busyTimeUs;
         return;
     }
 
-    currentState.store(QMediaPlayer::PlayingState);
-
-    notifyPlaybackState();
+    videoUtilization = double(busyTimeUs - lastVideoBusyTimeUs) / elapsedUs;
+    lastVideoBusyTimeUs = busyTimeUs;
 
-    if (sourceType == SourceType::Stream)
-        av_read_play(inputFormatContext);
+    int64_t backlogUs = int64_t(videoStrand->getQueuedCount()) * videoFrameIntervalUs;
+    videoLatenessUs = std::max(pacingLatenessUs, backlogUs);
 
-    int result = 0;
-    loggable.logMessage(objectName(), QtDebugMsg, "Enter to decoding loop...");
-    while (desiredState.load() != QMediaPlayer::StoppedState)
+    bool changed = false;
+    if (loadGovernorEnabled.load())
+    {
+        changed = loadGovernor.update(videoUtilization, videoLatenessUs);
+    }
+    else if (loadGovernor.getLevel() != LoadGovernor::Full)
     {
+        loadGovernor.reset();
+        changed = true;
+    }
 
-        if (desiredState.load() == QMediaPlayer::PausedState)
-        {
-            if (currentState.load() != QMediaPlayer::PausedState)
-            {
-                currentState.store(QMediaPlayer::PausedState);
-                if (sourceType == SourceType::Stream)
-                    av_read_pause(inputFormatContext);
+    if (!changed)
+        return;
 
-                currentStateChanged.notify_all();
-                notifyPlaybackState();
-            }
+    int level = loadGovernor.getLevel();
+    QString msg = QString("Video decoding level changed: %1 (utilization %2 %, lateness %3 ms).")
+            .arg(LoadGovernor::levelToString(level))
+            .arg(100.0 * videoUtilization, 0, 'f', 1)
+            .arg(videoLatenessUs / 1000);
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
 
-            std::unique_lock<std::mutex> locker(stateMutex);
-            while (desiredState.load() == QMediaPlayer::PausedState)
-            {
-                desiredStateChanged.wait(locker, [this](){return desiredState.load() != QMediaPlayer::PausedState;});
-            }
-            currentState.store(QMediaPlayer::PlayingState);
-            currentStateChanged.notify_all();
-            notifyPlaybackState();
-            startDTS = -1;
-        }
+    videoDecoder->setDegradationLevel(level);
+    emit decodingLevelChanged(level, LoadGovernor::levelToString(level));
+}
 
-        timer.restart();
-        if (av_read_frame(inputFormatContext, receivedPacket) < 0)
-            break;
+//---------------------------------------------------------------------------------------
+void Demuxer::publishStatistics()
+{
+    std::map<QString, QString> values;
+    values["Core budget"] = QString::number(DecoderThreadingPolicy::getInstance()->getCoreBudget());
+    values["Sessions"] = QString::number(SessionManager::getInstance()->getSessionCount());
+
+    WorkerPoolStatistics poolStat = WorkerPool::getInstance()->getStatistics();
+    double capacity = double(poolStat.elapsedTimeUs) * poolStat.threadCount;
+    values["Worker pool"] = QString("%1 thread(s), %2 strand(s), %3 stolen, load %4 %")
+            .arg(poolStat.threadCount)
+            .arg(poolStat.strandCount)
+            .arg(poolStat.stolenStrands)
+            .arg(capacity > 0 ? 100.0 * poolStat.busyTimeUs / capacity : 0.0, 0, 'f', 1);
+
+    auto describe = [](const DecoderStatistics &stat) {
+        double load = stat.elapsedTimeUs ? 100.0 * stat.decodingTimeUs / stat.elapsedTimeUs : 0.0;
+        double perFrame = stat.decodedFrames ? stat.decodingTimeUs / 1000.0 / stat.decodedFrames : 0.0;
+        return QString("%1, %2 thread(s) (%3), %4 ms/frame, load %5 %")
+                .arg(stat.codecName)
+                .arg(stat.threading.threadCount)
+                .arg(DecoderThreadingPolicy::threadTypeToString(stat.threading.threadType))
+                .arg(perFrame, 0, 'f', 2)
+                .arg(load, 0, 'f', 1);
+    };
+
+    if (videoDecoder && videoDecoder->isOpen())
+    {
+        values["Video decoder"] = describe(videoDecoder->getStatistics());
 
-        if (receivedPacket->stream_index == activeVideoStreamIndex.load())
+        FilterStatistics filterStat = videoDecoder->getFilterStatistics();
+        if (!filterStat.description.isEmpty())
         {
-            waitForReachPtsTime(receivedPacket);
+            double load = filterStat.elapsedTimeUs ? 100.0 * filterStat.filteringTimeUs / filterStat.elapsedTimeUs : 0.0;
+            double perFrame = filterStat.filteredFrames ? filterStat.filteringTimeUs / 1000.0 / filterStat.filteredFrames : 0.0;
+            values["Video filter"] = QString("%1, %2 thread(s), %3 ms/frame, load %4 %")
+                    .arg(filterStat.description)
+                    .arg(filterStat.threadCount)
+                    .arg(perFrame, 0, 'f', 2)
+                    .arg(load, 0, 'f', 1);
+        }
 
-            if (videoDecoder && videoDecoder->isOpen())
-                result = videoDecoder->decodePacket(receivedPacket);
+        values["Load governor"] = QString("%1, %2 (level %3/%4), utilization %5 %, lateness %6 ms")
+                .arg(loadGovernorEnabled.load() ? "enabled" : "disabled")
+                .arg(LoadGovernor::levelToString(loadGovernor.getLevel()))
+                .arg(loadGovernor.getLevel())
+                .arg(int(LoadGovernor::KeyFramesOnly))
+                .arg(100.0 * videoUtilization, 0, 'f', 1)
+                .arg(videoLatenessUs / 1000);
+
+        VideoOutputStatistics outputStat = videoDecoder->getOutputStatistics();
+        values["Video output"] = QString("%1, %2x%3, %4 frame(s) presented, %5 skipped")
+                .arg(outputStat.visible ? "visible" : "hidden")
+                .arg(outputStat.outputSize.width())
+                .arg(outputStat.outputSize.height())
+                .arg(outputStat.presentedFrames)
+                .arg(outputStat.skippedFrames);
+    }
+    if (audioDecoder && audioDecoder->isOpen())
+    {
+        values["Audio decoder"] = describe(audioDecoder->getStatistics());
+        values["Audio output"] = QString("%1 byte(s) dropped").arg(droppedAudioBytes.load());
+    }
 
-        }
-        else if (receivedPacket->stream_index == activeAudioStreamIndex.load())
+    if (mosaicActive.load())
+    {
+        QSize size = mosaicCompositor.getOutputSize();
+        values["Multiviewer"] = QString("%1 tile(s), %2x%3, %4 frame(s) composed")
+                .arg(mosaicTiles.size())
+                .arg(size.width())
+                .arg(size.height())
+                .arg(mosaicCompositor.getComposedFrames());
+
+        for (const auto &tile : mosaicTiles)
         {
-            if (activeVideoStreamIndex.load() == -1)
-                waitForReachPtsTime(receivedPacket);
-
-            if (audioDecoder && audioDecoder->isOpen())
-                result = audioDecoder->decodePacket(receivedPacket);
+            if (!tile->videoDecoder || !tile->videoDecoder->isOpen())
+                continue;
+
+            QString reduction = tile->videoDecoder->isSkippingNonReferenceFrames()
+                    ? QString("non-reference frames skipped")
+                    : QString("lowres 1/%1").arg(1 << tile->videoDecoder->getLowres());
+            values[QString("Tile %1").arg(tile->programId)] = QString("%1, %2, %3 packet(s) dropped")
+                    .arg(describe(tile->videoDecoder->getStatistics()), reduction)
+                    .arg(tile->droppedPackets);
         }
-        av_packet_unref(receivedPacket);
-        if (result < 0)
+    }
+
+    TimeshiftStatus timeshiftStatus = timeshiftBuffer.getStatus();
+    if (timeshiftStatus.active && receiveFifoOnly)
+    {
+        values["Receive FIFO"] = QString("%1 MB received, lag %2 ms, %3 overrun(s)")
+                .arg(timeshiftStatus.receivedBytes / 1048576)
+                .arg(timeshiftStatus.lagUs / 1000)
+                .arg(timeshiftStatus.overruns);
+    }
+    else if (timeshiftStatus.active)
+    {
+        values["Timeshift"] = QString("%1, %2 MB received (ring %3 MB), buffered %4 s, lag %5 s, "
+                                      "%6 index entries (%7 key frames), %8 overrun(s)")
+                .arg(timeshiftStatus.fileStorage ? "file" : "RAM")
+                .arg(timeshiftStatus.receivedBytes / 1048576)
+                .arg(timeshiftStatus.capacityBytes / 1048576)
+                .arg(timeshiftStatus.bufferedUs / 1000000.0, 0, 'f', 1)
+                .arg(timeshiftStatus.lagUs / 1000000.0, 0, 'f', 1)
+                .arg(timeshiftStatus.indexEntries)
+                .arg(timeshiftStatus.randomAccessEntries)
+                .arg(timeshiftStatus.overruns);
+        if (playbackSpeed.load() != 1.0)
+            values["Timeshift"].append(QString(", catching up at %1x").arg(playbackSpeed.load()));
+    }
+
+    if (clockRecoveryActive)
+    {
+        ClockRecoveryStatus clockStatus = clockRecovery.getStatus();
+        values["Clock recovery"] = QString("%1, drift %2 ppm, trim %3 ppm, phase error %4 us, "
+                                           "%5 reference(s), %6 relock(s)")
+                .arg(clockStatus.locked ? "locked" : "acquiring")
+                .arg(clockStatus.driftPpm, 0, 'f', 2)
+                .arg(latencyTrimPpm, 0, 'f', 2)
+                .arg(clockStatus.phaseErrorUs)
+                .arg(clockStatus.references)
+                .arg(clockStatus.relocks);
+    }
+
+    if (sourceType == SourceType::Stream)
+    {
+        values["Latency profile"] = lowLatency.load() ? "low latency" : "normal";
+        if (!udpFifoStatus.isEmpty())
+            values["UDP FIFO"] = udpFifoStatus;
+
+        auto describeDelay = [this](const LatencyStatistics &stat){
+            return QString("last %1 ms, min %2 ms, avg %3 ms, max %4 ms (%5 frame(s), from the %6)")
+                    .arg(stat.lastUs / 1000.0, 0, 'f', 1)
+                    .arg(stat.minUs / 1000.0, 0, 'f', 1)
+                    .arg(stat.averageUs / 1000.0, 0, 'f', 1)
+                    .arg(stat.maxUs / 1000.0, 0, 'f', 1)
+                    .arg(stat.samples)
+                    .arg(arrivalFromReceiver ? "arrival" : "read");
+        };
+        LatencyStatistics videoDelay = latencyMeter.takeStatistics(LatencyMeter::Video);
+        if (videoDelay.samples)
+            values["Delay (video)"] = describeDelay(videoDelay);
+        LatencyStatistics audioDelay = latencyMeter.takeStatistics(LatencyMeter::Audio);
+        if (audioDelay.samples)
+            values["Delay (audio)"] = describeDelay(audioDelay);
+    }
+
+    auto describeStage = [this](int stage){
+        int64_t timeMs = startupTimesMs[stage].load();
+        return timeMs >= 0 ? QString("%1 ms").arg(timeMs) : QString("-");
+    };
+    values["Startup"] = QString("open %1, probe %2, video decoder %3, audio decoder %4, "
+                                "first packet %5, first video frame %6, first audio frame %7")
+            .arg(describeStage(OpenInputStage))
+            .arg(describeStage(StreamInfoStage))
+            .arg(describeStage(VideoDecoderStage))
+            .arg(describeStage(AudioDecoderStage))
+            .arg(describeStage(FirstPacketStage))
+            .arg(describeStage(FirstVideoFrameStage))
+            .arg(describeStage(FirstAudioFrameStage));
+
+    RtpInputStatistics rtpStat = rtpInput.getStatistics();
+    if (rtpStat.active)
+    {
+        values["RTP input"] = QString("%1 packet(s), %2 reordered, %3 duplicate, %4 late, %5 lost, "
+                                      "held %6 (max %7, window %8)")
+                .arg(rtpStat.packets)
+                .arg(rtpStat.reorderedPackets)
+                .arg(rtpStat.duplicatePackets)
+                .arg(rtpStat.latePackets)
+                .arg(rtpStat.lostPackets)
+                .arg(rtpStat.heldPackets)
+                .arg(rtpStat.maxHeldPackets)
+                .arg(rtpStat.holdWindow);
+        if (rtpStat.rawDatagrams)
+            values["RTP input"].append(QString(", %1 raw datagram(s)").arg(rtpStat.rawDatagrams));
+        if (rtpStat.discontinuities || rtpStat.overruns)
+            values["RTP input"].append(QString(", %1 discontinuity(ies), %2 overrun(s)")
+                                       .arg(rtpStat.discontinuities)
+                                       .arg(rtpStat.overruns));
+        if (rtpStat.fec)
         {
-            // ignore decoding errors due to possible scrambling, only logging
-            QString msg = QString("ERROR of packet decoding (stream (index/id, type): %1/%2, %3.")
-                    .arg(receivedPacket->stream_index)
-                    .arg(streams[receivedPacket->stream_index]->id)
-                    .arg(mapAvMediaTypeToString(streams[receivedPacket->stream_index]->type));
-            loggable.logAvError(objectName(), QtWarningMsg, msg, result);
+            values["RTP FEC"] = QString("%1 recovered, matrix %2x%3, %4 column / %5 row FEC packet(s)")
+                    .arg(rtpStat.recoveredPackets)
+                    .arg(rtpStat.columns)
+                    .arg(rtpStat.rows)
+                    .arg(rtpStat.columnFecPackets)
+                    .arg(rtpStat.rowFecPackets);
         }
     }
-    loggable.logMessage(objectName(), QtDebugMsg, "Exit from the playing loop.");
-    currentState.store(QMediaPlayer::StoppedState);
-    if (sourceType == SourceType::Stream)
-        av_read_pause(inputFormatContext);
-    notifyPlaybackState();
-    reset();
-    currentStateChanged.notify_all();
-}
 
-//---------------------------------------------------------------------------------------
-void Demuxer::waitForReachPtsTime(AVPacket *packet)
-{
-    if (packet->dts == AV_NOPTS_VALUE)
+    MappedFileInputStatistics inputStat = mappedFileInput.getStatistics();
+    if (inputStat.open)
     {
-        QString msg = QString("ERROR wait for reach DTS time - AV_NOPTS_VALUE, stream (index/id, type): %1/%2, %3.")
-                .arg(receivedPacket->stream_index)
-                .arg(streams[receivedPacket->stream_index]->id)
-                .arg(mapAvMediaTypeToString(streams[receivedPacket->stream_index]->type));
-        loggable.logAvError(objectName(), QtWarningMsg, msg, -1);
-        return;
+        values["File input"] = QString("memory mapped, %1 MB, %2 MB read, %3 seek(s), %4 readahead hint(s), %5 remap(s)")
+                .arg(inputStat.fileSize / 1048576)
+                .arg(inputStat.readBytes / 1048576)
+                .arg(inputStat.seeks)
+                .arg(inputStat.readaheadHints)
+                .arg(inputStat.remaps);
     }
 
-    AVRational time_base = streams[packet->stream_index]->stream->time_base;
-    AVRational time_base_q = {1,AV_TIME_BASE};
-    int64_t dts_time = av_rescale_q(packet->dts, time_base, time_base_q);
-    if (startDTS < 0)
+    if (!fastStartResult.isEmpty())
     {
-        startDTS = dts_time;
-        startTime = av_gettime();
+        values["Fast start"] = QString("%1, probe size %2 KB, analyze duration %3 ms")
+                .arg(fastStartResult)
+                .arg(fastStartSettings.probeSizeKilobytes)
+                .arg(fastStartSettings.analyzeDurationMs);
     }
-    else
+
+    SeekIndexStatistics seekStat = seekIndex.getStatistics();
+    if (seekStat.method == "scanned")
     {
-        int64_t nowTime = av_gettime() - startTime;
-        if ((dts_time - startDTS) > nowTime)
-            av_usleep(dts_time - startDTS - nowTime);
+        values["Seek index"] = QString("%1, %2 key frame(s), %3 %4")
+                .arg(seekStat.method)
+                .arg(seekStat.keyFrames)
+                .arg(seekStat.complete ? "complete" : "scanning")
+                .arg(seekStat.fromSidecar
+                     ? QString("(sidecar)")
+                     : QString("%1 % in %2 s")
+                       .arg(seekStat.fileSize ? 100.0 * seekStat.scannedBytes / seekStat.fileSize : 0.0, 0, 'f', 1)
+                       .arg(seekStat.scanTimeUs / 1000000.0, 0, 'f', 1));
+    }
+    else if (seekStat.method == "native")
+    {
+        values["Seek index"] = QString("%1, %2 key frame(s)").arg(seekStat.method).arg(seekStat.keyFrames);
+    }
+
+    RecorderStatistics recorderStat = recorder.getStatistics();
+    if (recorderStat.recording)
+    {
+        values["Recorder"] = QString("%1, %2 stream(s), %3 MB written, %4 packet(s) dropped, "
+                                     "queue %5 (max %6) packet(s) / %7 KB, %8 error(s)")
+                .arg(recorderStat.path)
+                .arg(recorderStat.streamCount)
+                .arg(recorderStat.writtenBytes / 1048576.0, 0, 'f', 1)
+                .arg(recorderStat.droppedPackets)
+                .arg(recorderStat.queuedPackets)
+                .arg(recorderStat.maxQueuedPackets)
+                .arg(recorderStat.queuedBytes / 1024)
+                .arg(recorderStat.writeErrors);
     }
+
+    emit detailsUpdated("Decoders", values);
+    publishTransportStatistics();
 }
 
 //---------------------------------------------------------------------------------------
-void Demuxer::notifyPlaybackState()
+//   The counters of the transport stream analysis, named by ETSI TR 101 290.
+void Demuxer::publishTransportStatistics()
 {
-    QString msg = QString("Playback state changed: %1").arg(mapPlaybackStateToString(currentState));
-    loggable.logMessage(objectName(), QtDebugMsg, msg);
+    TsAnalyzerStatistics stat = tsAnalyzer.getStatistics();
+    if (!stat.active)
+        return;
 
-    emit playbackStateChanged(currentState);
+    std::map<QString, QString> values;
+    values["Multiplex"] = QString("%1 packet(s), %2 Mbit/s")
+            .arg(stat.packets)
+            .arg(stat.bitrate / 1000000.0, 0, 'f', 2);
+    values["1.1 TS sync loss"] = QString::number(stat.syncLosses);
+    values["1.2 Sync byte error"] = QString::number(stat.syncByteErrors);
+    values["1.3 PAT error"] = QString("%1 (max interval %2 ms)").arg(stat.patErrors).arg(stat.maxPatIntervalMs);
+    values["1.4 Continuity count error"] = QString::number(stat.continuityErrors);
+    values["1.5 PMT error"] = QString("%1 (max interval %2 ms)").arg(stat.pmtErrors).arg(stat.maxPmtIntervalMs);
+    values["1.6 PID error"] = QString::number(stat.pidErrors);
+    values["2.1 Transport error"] = QString::number(stat.transportErrors);
+    values["2.2 CRC error"] = QString::number(stat.crcErrors);
+    values["2.3 PCR error"] = QString("%1 repetition, %2 discontinuity (max interval %3 ms)")
+            .arg(stat.pcrRepetitionErrors)
+            .arg(stat.pcrDiscontinuityErrors)
+            .arg(stat.maxPcrIntervalMs);
+    values["2.4 PCR accuracy error"] = QString("%1 (max %2 ns)").arg(stat.pcrAccuracyErrors).arg(stat.maxPcrJitterNs);
+
+    for (const TsPidStatistics &pidStat : stat.pids)
+    {
+        values[QString("PID %1").arg(pidStat.pid, 4, 10, QChar('0'))] = QString("%1 kbit/s, %2 CC error(s)%3%4")
+                .arg(pidStat.bitrate / 1000.0, 0, 'f', 1)
+                .arg(pidStat.continuityErrors)
+                .arg(pidStat.pcr ? ", PCR" : "")
+                .arg(pidStat.scrambled ? ", scrambled" : "");
+    }
+
+    emit detailsUpdated("Transport stream", values);
 }
 
 //---------------------------------------------------------------------------------------
@@ -639,28 +2307,73 @@ bool Demuxer::prepareVideoDecoder(int streamIndex)
     loggable.logMessage(objectName(), QtDebugMsg,
                     QString("Video stream selected. Stream index: %1.").arg(streamIndex));
 
-    videoDecoder = new VideoDecoder("Video Decoder");
-    connect(videoDecoder, &VideoDecoder::videoFrameReady, this, &Demuxer::writeVideoFrameToSink);
-
+    bool early = earlyVideoDecoder && earlyVideoStreamIndex == streamIndex;
+    if (early)
+    {
+        // opened by the worker pool while the source was probed
+        videoStrand->waitForIdle();
+        videoDecoder = earlyVideoDecoder;
+        earlyVideoDecoder = nullptr;
+        videoDecoder->releaseCodecParameters();
+    }
+    else
+    {
+        videoDecoder = createVideoDecoder();
+    }
+    videoDecoder->setUserFilters(videoFilters);
+    videoDecoder->setDeinterlacer(deinterlacer, deinterlaceToFieldRate);
+    videoDecoder->setActivePictureDetection(activePictureDetection);
+    videoDecoder->setOutputSize(videoOutputSize);
+    videoDecoder->setOutputVisible(videoOutputVisible);
 
-    bool ok = videoDecoder->open(streams[streamIndex]->stream);
+    bool ok = early ? videoDecoder->isOpen() : videoDecoder->open(streams[streamIndex]->stream);
     if (!ok)
         return false;
+    markStartupStage(VideoDecoderStage);
 
     QSize pictureSize = videoDecoder->getPictureSize();
     msg = QString("Video image size: %1x%2.").arg(pictureSize.width()).arg(pictureSize.height());
     loggable.logMessage(objectName(), QtDebugMsg, msg);
 
+    AVStream *stream = streams[streamIndex]->stream;
+    AVRational frameRate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+    videoFrameIntervalUs = frameRate.num && frameRate.den
+            ? av_rescale(AV_TIME_BASE, frameRate.den, frameRate.num)
+            : 40000;
+
+    loadGovernor.reset();
+    loadGovernor.setLowresSupported(videoDecoder->isLowresSupported());
+    loadGovernorTimer.invalidate();
+    videoUtilization = 0.0;
+    videoLatenessUs = 0;
+    emit decodingLevelChanged(loadGovernor.getLevel(), LoadGovernor::levelToString(loadGovernor.getLevel()));
+
     activeVideoStreamIndex.store(streamIndex);
     return true;
 }
 
+//---------------------------------------------------------------------------------------
+//   The decoder may be created in the preparing thread, it's moved to the thread of
+// the demuxer (where it's deleted later). The output settings are applied when it
+// becomes active.
+VideoDecoder *Demuxer::createVideoDecoder()
+{
+    VideoDecoder *decoder = new VideoDecoder("Video Decoder");
+    decoder->setLowDelay(lowLatency.load());
+    decoder->moveToThread(thread());
+    connect(decoder, &VideoDecoder::videoFrameReady, this, &Demuxer::writeVideoFrameToSink);
+    return decoder;
+}
+
 //---------------------------------------------------------------------------------------
 void Demuxer::resetVideoDecoder()
 {
     loggable.logMessage(objectName(), QtDebugMsg, "Reset video decoder.");
     activeVideoStreamIndex.store(-1);
 
+    videoStrand->clear();
+    videoStrand->waitForIdle();
+
     if (videoDecoder)
         videoDecoder->deleteLater();
     videoDecoder = nullptr;
@@ -692,33 +2405,28 @@ bool Demuxer::prepareAudioDecoder(int streamIndex)
     loggable.logMessage(objectName(), QtDebugMsg,
                     QString("Audio stream selected. Stream index: %1.").arg(streamIndex));
 
-    audioDecoder = new AudioDecoder("Audio Decoder");
-    connect(audioDecoder, &AudioDecoder::audioSampleReady, this, &Demuxer::writeAudioSampleToSink);
-
-    bool ok = audioDecoder->open(streams[streamIndex]->stream);
+    bool ok = false;
+    if (earlyAudioDecoder && earlyAudioStreamIndex == streamIndex)
+    {
+        audioStrand->waitForIdle();
+        audioDecoder = earlyAudioDecoder;
+        earlyAudioDecoder = nullptr;
+        audioDecoder->releaseCodecParameters();
+        ok = audioDecoder->isOpen();
+    }
+    else
+    {
+        audioDecoder = createAudioDecoder();
+        ok = audioDecoder->open(streams[streamIndex]->stream);
+    }
     if (ok)
     {
+        markStartupStage(AudioDecoderStage);
         audioDecoder->setAudioLevelMeter(audioLevelMeter);
         QAudioFormat format = audioDecoder->audioFormat();
-        QAudioDevice defaultAudioOutput(QMediaDevices::defaultAudioOutput());
         int inChannelsCount = audioDecoder->inputChannelCount();
 
-        if (defaultAudioOutput.mode() == QAudioDevice::Output)
-        {
-            audioSink = new QAudioSink(defaultAudioOutput, format);
-            QAudioFormat audioOutputFormat = audioSink->format();
-
-            msg = QString("Check output audio device format (Qt):\n"
-                          "- number of channels - %1\n"
-                          "- sample rate - %2\n"
-                          "- sample format - %3")
-                    .arg(audioOutputFormat.channelCount())
-                    .arg(audioOutputFormat.sampleRate())
-                    .arg(mapQSampleFormatToString(format.sampleFormat()));
-            loggable.logMessage(objectName(), QtDebugMsg, msg);
-
-            audioOutput = audioSink->start();
-        }
+        openAudioSink(format);
         audioLevelMeter->setChannelCount(inChannelsCount);
         audioLevelMeter->setSampleRate(format.sampleRate());
         emit currentAudioChannelsCountUpdated(inChannelsCount);
@@ -728,6 +2436,16 @@ bool Demuxer::prepareAudioDecoder(int streamIndex)
     return ok;
 }
 
+//---------------------------------------------------------------------------------------
+AudioDecoder *Demuxer::createAudioDecoder()
+{
+    AudioDecoder *decoder = new AudioDecoder("Audio Decoder");
+    decoder->setLowDelay(lowLatency.load());
+    decoder->moveToThread(thread());
+    connect(decoder, &AudioDecoder::audioSampleReady, this, &Demuxer::writeAudioSampleToSink);
+    return decoder;
+}
+
 //---------------------------------------------------------------------------------------
 void Demuxer::resetAudioDecoder()
 {
@@ -735,6 +2453,9 @@ void Demuxer::resetAudioDecoder()
 
     activeAudioStreamIndex.store(-1);
 
+    audioStrand->clear();
+    audioStrand->waitForIdle();
+
     if (audioDecoder)
         audioDecoder->deleteLater();
     audioDecoder = nullptr;
@@ -742,6 +2463,44 @@ void Demuxer::resetAudioDecoder()
     startDTS = -1;
     startTime = -1;
 
+    closeAudioSink();
+}
+
+//---------------------------------------------------------------------------------------
+//   The buffer of the sink is the main part of the audio delay: the default one (of
+// the device) is kept unless the low latency is required.
+void Demuxer::openAudioSink(const QAudioFormat &format)
+{
+    QAudioDevice defaultAudioOutput(QMediaDevices::defaultAudioOutput());
+    if (defaultAudioOutput.mode() != QAudioDevice::Output)
+        return;
+
+    audioSink = new QAudioSink(defaultAudioOutput, format);
+    QAudioFormat audioOutputFormat = audioSink->format();
+
+    QString msg = QString("Check output audio device format (Qt):\n"
+                          "- number of channels - %1\n"
+                          "- sample rate - %2\n"
+                          "- sample format - %3")
+            .arg(audioOutputFormat.channelCount())
+            .arg(audioOutputFormat.sampleRate())
+            .arg(mapQSampleFormatToString(format.sampleFormat()));
+    loggable.logMessage(objectName(), QtDebugMsg, msg);
+
+    if (lowLatency.load())
+        audioSink->setBufferSize(format.bytesForDuration(LowLatencyAudioBufferUs));
+
+    pendingAudio.clear();
+    droppedAudioBytes.store(0);
+    audioOutput = audioSink->start();
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Audio output buffer: %1 ms.")
+                        .arg(format.durationForBytes(int(audioSink->bufferSize())) / 1000));
+}
+
+//---------------------------------------------------------------------------------------
+void Demuxer::closeAudioSink()
+{
     if (audioSink)
         audioSink->deleteLater();
     audioSink = nullptr;
@@ -749,6 +2508,202 @@ void Demuxer::resetAudioDecoder()
     if (audioOutput)
         audioOutput->deleteLater();
     audioOutput = nullptr;
+    pendingAudio.clear();
+}
+
+//---------------------------------------------------------------------------------------
+//   Creates the tiles for all programs with the video. The tile decoders are served by
+// the shared worker pool (one strand per tile), so the number of the threads doesn't
+// grow with the number of the programs.
+bool Demuxer::prepareMosaic()
+{
+    loggable.logMessage(objectName(), QtDebugMsg, "Prepare multiviewer...");
+
+    resetMosaic();
+
+    std::vector<MosaicTileInfo> tileInfos;
+    for (auto& [id, programInfo] : programs)
+    {
+        int videoIndex = programInfo->findFirstStreamByType(AVMEDIA_TYPE_VIDEO);
+        if (videoIndex == -1)
+            continue;
+
+        MosaicTileInfo info;
+        info.programId = id;
+        auto it = programInfo->properties.find(AVStrings::ServiceName);
+        if (it != programInfo->properties.end())
+            info.serviceName = QString::fromStdString(it->second);
+        tileInfos.push_back(info);
+
+        auto tile = std::make_shared<MosaicTile>();
+        tile->programId = id;
+        tile->index = int(mosaicTiles.size());
+        tile->videoStreamIndex = videoIndex;
+        tile->audioStreamIndex = programInfo->findFirstStreamByType(AVMEDIA_TYPE_AUDIO);
+        mosaicTiles.push_back(tile);
+    }
+
+    if (mosaicTiles.empty())
+    {
+        loggable.logMessage(objectName(), QtWarningMsg, "Programs with video are not found.");
+        return false;
+    }
+
+    mosaicCompositor.setTiles(tileInfos);
+    mosaicCompositor.setOutputSize(videoOutputSize);
+    mosaicCompositor.setVisible(videoOutputVisible);
+
+    WorkerPool *pool = WorkerPool::getInstance();
+    for (const auto &tile : mosaicTiles)
+    {
+        tile->strand = pool->createStrand(QString("Mosaic Tile %1").arg(tile->programId));
+
+        tile->videoDecoder = new MosaicTileDecoder(QString("Mosaic Video Decoder %1").arg(tile->programId),
+                                                   tile->index, &mosaicCompositor);
+        if (tile->videoDecoder->open(streams[tile->videoStreamIndex]->stream))
+        {
+            mosaicStreams[tile->videoStreamIndex] = tile;
+        }
+        else
+        {
+            loggable.logMessage(objectName(), QtWarningMsg,
+                                QString("Video decoder of the program %1 is not opened.").arg(tile->programId));
+            tile->videoDecoder->deleteLater();
+            tile->videoDecoder = nullptr;
+        }
+
+        if (tile->audioStreamIndex == -1)
+            continue;
+
+        tile->audioDecoder = new AudioDecoder(QString("Mosaic Audio Decoder %1").arg(tile->programId));
+        if (tile->audioDecoder->open(streams[tile->audioStreamIndex]->stream))
+        {
+            int tileIndex = tile->index;
+            tile->audioLevelMeter = std::make_shared<AudioLevelMeter>();
+            tile->audioLevelMeter->setChannelCount(tile->audioDecoder->inputChannelCount());
+            tile->audioLevelMeter->setSampleRate(tile->audioDecoder->audioFormat().sampleRate());
+            connect(tile->audioLevelMeter.get(), &AudioLevelMeter::audioLevelsCalculated, this,
+                    [this, tileIndex](const std::vector<double> &levels){
+                mosaicCompositor.setTileAudioLevels(tileIndex, levels);
+            }, Qt::DirectConnection);
+            tile->audioDecoder->setAudioLevelMeter(tile->audioLevelMeter);
+            mosaicStreams[tile->audioStreamIndex] = tile;
+        }
+        else
+        {
+            tile->audioDecoder->deleteLater();
+            tile->audioDecoder = nullptr;
+        }
+    }
+
+    // all programs of the multiplex share the clock, the first tile paces the reading
+    mosaicPacingStreamIndex = mosaicTiles.front()->videoStreamIndex;
+    mosaicComposeStrand = pool->createStrand("Mosaic Compositor");
+    mosaicComposeTimer.invalidate();
+    startDTS = -1;
+    startTime = -1;
+    mosaicActive.store(true);
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Multiviewer prepared: %1 tile(s), %2 worker thread(s).")
+                        .arg(mosaicTiles.size()).arg(pool->getThreadCount()));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   The tasks in the strands use the decoders, so they are finished before the decoders
+// are deleted.
+void Demuxer::resetMosaic()
+{
+    if (mosaicTiles.empty() && !mosaicActive.load())
+        return;
+
+    loggable.logMessage(objectName(), QtDebugMsg, "Reset multiviewer.");
+
+    mosaicActive.store(false);
+    mosaicStreams.clear();
+    mosaicPacingStreamIndex = -1;
+
+    if (mosaicComposeStrand)
+    {
+        mosaicComposeStrand->clear();
+        mosaicComposeStrand->waitForIdle();
+        mosaicComposeStrand.reset();
+    }
+
+    for (const auto &tile : mosaicTiles)
+    {
+        if (tile->strand)
+        {
+            tile->strand->clear();
+            tile->strand->waitForIdle();
+        }
+        if (tile->videoDecoder)
+            tile->videoDecoder->deleteLater();
+        if (tile->audioDecoder)
+            tile->audioDecoder->deleteLater();
+    }
+    mosaicTiles.clear();
+    mosaicCompositor.setTiles({});
+
+    startDTS = -1;
+    startTime = -1;
+}
+
+//---------------------------------------------------------------------------------------
+//   Posts the packet to the strand of its tile. If the workers can't keep up with the
+// tile, its video packets are dropped until the next key frame (the decoding can
+// continue only from there); the audio packets are dropped one by one.
+void Demuxer::routeMosaicPacket(const AVPacket *packet)
+{
+    auto it = mosaicStreams.find(packet->stream_index);
+    if (it == mosaicStreams.end())
+        return;
+
+    MosaicTile *tile = it->second.get();
+    bool isVideo = packet->stream_index == tile->videoStreamIndex;
+    Decoder *decoder = isVideo ? static_cast<Decoder*>(tile->videoDecoder) : tile->audioDecoder;
+    if (!decoder)
+        return;
+
+    size_t queued = tile->strand->getQueuedCount();
+    if (isVideo)
+    {
+        if (queued >= MaxQueuedTilePackets)
+            tile->waitForKeyframe = true;
+
+        if (tile->waitForKeyframe)
+        {
+            if (!(packet->flags & AV_PKT_FLAG_KEY) || queued >= MaxQueuedTilePackets / 2)
+            {
+                tile->droppedPackets++;
+                return;
+            }
+            tile->waitForKeyframe = false;
+        }
+    }
+    else if (queued >= MaxQueuedTilePackets)
+    {
+        tile->droppedPackets++;
+        return;
+    }
+
+    decodePacketInPool(tile->strand, decoder, packet);
+}
+
+//---------------------------------------------------------------------------------------
+//   The mosaic is composed in the worker pool too; if the previous frame isn't composed
+// yet, this one is skipped.
+void Demuxer::composeMosaic()
+{
+    if (!mosaicCompositor.isVisible() || !mosaicComposeStrand || !mosaicComposeStrand->isIdle())
+        return;
+
+    WorkerPool::getInstance()->post(mosaicComposeStrand, [this](){
+        QVideoFrame frame = mosaicCompositor.compose();
+        if (frame.isValid())
+            emit mosaicFrameComposed(frame);
+    });
 }
 
 //---------------------------------------------------------------------------------------
@@ -758,12 +2713,48 @@ void Demuxer::reset()
     ready = false;
     startDTS = -1;
 
+    stopRecording();
+    resetMosaic();
     resetVideoDecoder();
     resetAudioDecoder();
+    releaseEarlyDecoders();
+
+    if (seekIndex.getMethod() != SeekIndex::None)
+    {
+        seekIndex.close();
+        emit seekRangeChanged(false, 0);
+    }
+    seekTargetUs.store(AV_NOPTS_VALUE);
 
     if (inputFormatContext)
         avformat_close_input(&inputFormatContext);
 
+    // after the demuxer, which reads them
+    if (tsAnalyzer.isOpen())
+    {
+        tsAnalyzer.close();
+        bitrateHistory->clear();
+        emit detailsUpdated("Transport stream", {});
+    }
+    mappedFileInput.close();
+    // the ring may be receiving from the RTP input, which ends its reading first
+    rtpInput.stop();
+    if (timeshiftBuffer.isOpen())
+    {
+        timeshiftBuffer.close();
+        emit timeshiftUpdated(false, 0, 0);
+    }
+    rtpInput.close();
+    receiveFifoOnly = false;
+    clockRecoveryActive = false;
+    arrivalFromReceiver = false;
+    latencyMeter.reset();
+    clockRatio = 1.0;
+    pacingRatio = 1.0;
+    latencyTargetUs = -1;
+    latencyTrimPpm = 0.0;
+    playbackSpeed.store(1.0);
+
     if (receivedPacket)
         av_packet_free(&receivedPacket);
 
@@ -772,6 +2763,7 @@ void Demuxer::reset()
 
     emit programsFound(programs);
     emit streamsFound(streams);
+    emit detailsUpdated("Decoders", {});
 }
 
 //---------------------------------------------------------------------------------------
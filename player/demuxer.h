@@ -3,6 +3,7 @@
 
 #include <QObject>
 
+#include <array>
 #include <condition_variable>
 #include <thread>
 
@@ -31,8 +32,21 @@ extern "C" {
 #include "audiodecoder.h"
 #include "audioframe.h"
 #include "audiolevelmeter.h"
+#include "clockrecovery.h"
+#include "latencymeter.h"
+#include "loadgovernor.h"
+#include "mappedfileinput.h"
+#include "mosaiccompositor.h"
+#include "mosaictiledecoder.h"
+#include "psicache.h"
+#include "recorder.h"
+#include "rtpinput.h"
+#include "seekindex.h"
+#include "timeshiftbuffer.h"
+#include "tsanalyzer.h"
 #include "videodecoder.h"
 #include "videoframe.h"
+#include "workerpool.h"
 #include "utils.h"
 
 
@@ -43,6 +57,10 @@ struct StreamInfo
     AVMediaType type;
     AVStream *stream;
     std::unordered_map<std::string, std::string> properties;
+    // its PID isn't listed by PMT any more (the index stays valid)
+    bool removed{false};
+    // found by the transport stream analyser, the packets aren't decoded
+    std::atomic_bool scrambled{false};
 };
 
 struct ProgramInfo {
@@ -50,8 +68,30 @@ struct ProgramInfo {
 
     AVProgram *avProgram{nullptr};
     int lastPmtVersion{-1};
+    unsigned int lastStreamCount{0};
     std::unordered_map<int, std::weak_ptr<StreamInfo>> streams;
     std::unordered_map<std::string, std::string> properties;
+    // it isn't listed by PAT any more (FFmpeg keeps the program without the streams)
+    bool removed{false};
+};
+
+//   Decoders of one program shown in the multiviewer. Both decoders are fed by the tasks
+// of the tile's strand in the worker pool; the audio is decoded only for the level bars.
+struct MosaicTile
+{
+    int programId{-1};
+    int index{-1};
+    int videoStreamIndex{-1};
+    int audioStreamIndex{-1};
+
+    MosaicTileDecoder *videoDecoder{nullptr};
+    AudioDecoder *audioDecoder{nullptr};
+    std::shared_ptr<AudioLevelMeter> audioLevelMeter;
+    std::shared_ptr<WorkerPool::Strand> strand;
+
+    // the strand is overloaded: the video packets are dropped until the next key frame
+    bool waitForKeyframe{false};
+    int64_t droppedPackets{0};
 };
 
 static int interruptCallback(void *ctx);
@@ -70,6 +110,8 @@ public:
     void setRwTimeout(int seconds);
 
     QMediaPlayer::PlaybackState getCurrentState() const;
+    // the same object for all the sources, cleared when the source is closed
+    std::shared_ptr<const BitrateHistory> getBitrateHistory() const;
 
     void setVideoSink(QVideoSink *sink);
 
@@ -86,13 +128,45 @@ public slots:
     void stop();
 
     void changeSelectedStream(AVMediaType type, int streamIndex);
+    void setVideoFilters(const QString &filters);
+    void setDeinterlacer(const QString &algorithm, bool fieldRate);
+    void setActivePictureDetection(bool enabled);
+    void setVideoOutputSize(const QSize &size);
+    void setVideoOutputVisible(bool visible);
+    void setMosaicMode(bool enabled);
+    void setLoadGovernorEnabled(bool enabled);
+    // programId = -1 - the whole multiplex
+    void startRecording(const QString &path, int programId);
+    void stopRecording();
+    // applied to the next opened source
+    void setTimeshift(bool enabled, int durationSeconds, int capacityMegabytes, bool fileStorage);
+    // applied to the next opened MPEG-TS stream
+    void setFastStart(bool enabled, int probeSizeKilobytes, int analyzeDurationMs);
+    // applied to the next opened source
+    void setTsAnalysisEnabled(bool enabled);
+    void setClockRecovery(bool enabled);
+    // the decoders and the audio output are switched at once, the input options are
+    // applied to the next opened stream
+    void setLowLatency(bool enabled);
+    // relative to the current position: negative - back, positive - towards the live
+    void seekTimeshift(int seconds);
+    void returnToLive(bool catchUp);
+    // absolute position in the file source (from its start)
+    void seek(qint64 positionMs);
 
     void writeVideoFrameToSink(const std::shared_ptr<VideoFrame> videoFrame);
     void writeAudioSampleToSink(const std::shared_ptr<AudioFrame> audioFrame);
+    void writeMosaicFrameToSink(const QVideoFrame &frame);
 
 signals:
     void streamsFound(const std::vector<std::shared_ptr<StreamInfo>> &streams);
     void programsFound(const std::map<int, std::shared_ptr<ProgramInfo>> &programs);
+    // the difference after the change of PMT (removed - stream indexes)
+    void streamsChanged(const std::vector<std::shared_ptr<StreamInfo>> &added, const std::vector<int> &removed);
+    void programsChanged(const std::map<int, std::shared_ptr<ProgramInfo>> &changed);
+    void streamScramblingChanged(int streamIndex, bool scrambled);
+    // composed in the pool, written to the sink in the thread of the demuxer
+    void mosaicFrameComposed(const QVideoFrame &frame);
 
     void playbackStateChanged(QMediaPlayer::PlaybackState state);
 
@@ -101,25 +175,77 @@ signals:
     void currentAudioChannelsCountUpdated(int numberOfChannels);
     void audioLevelsCalculated(const std::vector<double> &levels);
 
+    void detailsUpdated(const QString &section, const std::map<QString, QString> &values);
+    void decodingLevelChanged(int level, const QString &description);
+    void recordingStateChanged(bool recording, const QString &path);
+    void timeshiftUpdated(bool active, qint64 bufferedMs, qint64 lagMs);
+    // the stage of the opening of the source (empty when it's finished)
+    void preparingProgress(bool preparing, const QString &stage);
+    void seekRangeChanged(bool seekable, qint64 durationMs);
+    void positionChanged(qint64 positionMs);
+
 private:
     void initPlaybackThread();
+    void finishPreparing(int generation);
+    void startPlaybackThread();
     bool prepare();
+    void openDecodersEarly();
+    void adoptEarlyDecoders();
+    void releaseEarlyDecoders();
+    void markStartupStage(int stage);
+    void presentVideoFrame(const std::shared_ptr<VideoFrame> &videoFrame);
+    void presentPendingVideoFrame();
 
     bool findStreams();
+    std::shared_ptr<StreamInfo> createStreamInfo(AVStream *stream);
     bool findPrograms();
+    void updateProgramInfo(std::shared_ptr<ProgramInfo> program);
 
     void fillProgramStreamsData(std::shared_ptr<ProgramInfo> program);
+    bool isStreamsRefreshNeeded() const;
+    void requestStreamsRefresh();
+    void refreshStreams();
+    void holdPlaying();
+    void releasePlaying();
 
     void playing();
     void waitForReachPtsTime(AVPacket *packet);
+    bool isPacingBypassed() const;
+    void addPacketArrival(int output, const AVPacket *packet, int64_t readTimeUs);
+    bool checkScrambling(const AVPacket *packet);
+    void decodePacketInPool(const std::shared_ptr<WorkerPool::Strand> &strand,
+                            Decoder *decoder, const AVPacket *packet);
 
     void notifyPlaybackState();
+    void publishStatistics();
+    void publishTransportStatistics();
+    void updateLoadGovernor();
 
     bool prepareVideoDecoder(int streamIndex);
+    VideoDecoder *createVideoDecoder();
     void resetVideoDecoder();
 
     bool prepareAudioDecoder(int streamIndex);
+    AudioDecoder *createAudioDecoder();
     void resetAudioDecoder();
+    void openAudioSink(const QAudioFormat &format);
+    void closeAudioSink();
+    void writePendingAudio();
+
+    bool prepareMosaic();
+    void resetMosaic();
+    void routeMosaicPacket(const AVPacket *packet);
+    void composeMosaic();
+
+    void moveTimeshiftPosition(int64_t lagUs);
+    void updateTimeshift();
+    void updateClockRecovery();
+    void validatePsiCache();
+    void flushDecoders();
+
+    void prepareSeekIndex();
+    bool isBeforeSeekTarget(const AVPacket *packet);
+    int64_t getInputStartTime() const;
 
     void reset();
 
@@ -131,9 +257,17 @@ private:
     std::map<int, std::shared_ptr<ProgramInfo>> programs;
     // index in the vector = index of the stream in the AVFormatContext
     std::vector<std::shared_ptr<StreamInfo>> streams;
+    // the change of PMT is found by the playing thread and applied in the control thread
+    std::atomic_bool streamsRefreshPending{false};
+    // the playing thread waits between the packets while the streams are refreshed (the
+    // state isn't changed, the network input isn't paused)
+    std::atomic_bool holdRequested{false};
+    bool playingHeld{false};
 
     std::atomic<int> activeVideoStreamIndex{-1};
     std::atomic<int> activeAudioStreamIndex{-1};
+    // the video stream chosen by the user (kept while the multiviewer is shown)
+    int selectedVideoStreamIndex{-1};
 
     bool ready{false};
     std::atomic<QMediaPlayer::PlaybackState> desiredState{QMediaPlayer::StoppedState};
@@ -141,9 +275,30 @@ private:
     std::condition_variable currentStateChanged;
     std::condition_variable desiredStateChanged;
     QElapsedTimer timer;
+    QElapsedTimer statisticsTimer;
     std::mutex stateMutex;
     std::thread playbackThread;
 
+    // the source is opened in this thread
+    std::thread prepareThread;
+    std::atomic_bool preparing{false};
+    bool prepared{false};
+    int prepareGeneration{0};
+    QElapsedTimer prepareTimer;
+
+    // the time to the first frame by the stages (from the start of the opening)
+    enum StartupStage {
+        OpenInputStage,
+        StreamInfoStage,
+        VideoDecoderStage,
+        AudioDecoderStage,
+        FirstPacketStage,
+        FirstVideoFrameStage,
+        FirstAudioFrameStage,
+        StartupStageCount
+    };
+    std::array<std::atomic<int64_t>, StartupStageCount> startupTimesMs;
+
     int64_t startDTS{-1};
     int64_t startTime{-1};
 
@@ -152,6 +307,108 @@ private:
 
     VideoDecoder *videoDecoder{nullptr};
     AudioDecoder *audioDecoder{nullptr};
+    // the decoders are fed in the shared worker pool
+    std::shared_ptr<WorkerPool::Strand> videoStrand;
+    std::shared_ptr<WorkerPool::Strand> audioStrand;
+    // opened by the worker pool while the source is probed
+    VideoDecoder *earlyVideoDecoder{nullptr};
+    AudioDecoder *earlyAudioDecoder{nullptr};
+    int earlyVideoStreamIndex{-1};
+    int earlyAudioStreamIndex{-1};
+
+    // the governor is updated in the playing thread (and reset while it's paused)
+    LoadGovernor loadGovernor;
+    std::atomic_bool loadGovernorEnabled{true};
+    QElapsedTimer loadGovernorTimer;
+    int64_t lastVideoBusyTimeUs{0};
+    int64_t videoFrameIntervalUs{40000};
+    double videoUtilization{0.0};
+    int64_t videoLatenessUs{0};
+    // how much the reading is behind the stream clock
+    int64_t pacingLatenessUs{0};
+
+    QString videoFilters;
+    QString deinterlacer{"yadif"};
+    bool deinterlaceToFieldRate{false};
+    bool activePictureDetection{true};
+    QSize videoOutputSize;
+    bool videoOutputVisible{true};
+    // the picture waiting for its presentation delay (used in the control thread)
+    std::shared_ptr<VideoFrame> pendingVideoFrame;
+    int pendingVideoFrameGeneration{0};
+    QElapsedTimer videoFramePresentationTimer;
+    // the samples the sink had no room for (used in the control thread)
+    QByteArray pendingAudio;
+    bool pendingAudioScheduled{false};
+    std::atomic<int64_t> droppedAudioBytes{0};
+
+    bool mosaicMode{false};
+    std::atomic_bool mosaicActive{false};
+    MosaicCompositor mosaicCompositor;
+    std::vector<std::shared_ptr<MosaicTile>> mosaicTiles;
+    // key - stream index
+    std::unordered_map<int, std::shared_ptr<MosaicTile>> mosaicStreams;
+    int mosaicPacingStreamIndex{-1};
+    std::shared_ptr<WorkerPool::Strand> mosaicComposeStrand;
+    QElapsedTimer mosaicComposeTimer;
+
+    // fed by the playing thread, writes in its own thread
+    Recorder recorder;
+
+    TimeshiftSettings timeshiftSettings;
+    TimeshiftBuffer timeshiftBuffer;
+    // faster than 1.0 while the live is caught up (the audio isn't played meanwhile)
+    std::atomic<double> playbackSpeed{1.0};
+    // the speed of the current pacing reference (used by the playing thread)
+    double pacingSpeed{1.0};
+    // the ring is opened only as the receive FIFO of the clock recovery (no timeshift)
+    bool receiveFifoOnly{false};
+
+    // the pacing and the audio follow the sender clock of the live UDP stream
+    bool clockRecoveryEnabled{false};
+    bool clockRecoveryActive{false};
+    ClockRecovery clockRecovery;
+    // the local time per the stream time: the recovered ratio with the latency trim,
+    // and the one of the current pacing reference (used by the playing thread)
+    double clockRatio{1.0};
+    double pacingRatio{1.0};
+    // the receive FIFO lag held by the trim (taken when the pacing starts over)
+    int64_t latencyTargetUs{-1};
+    double latencyTrimPpm{0.0};
+
+    // the decoders without the frame delay, no pacing of the live stream, the short
+    // queues and the small audio buffer
+    std::atomic_bool lowLatency{false};
+    // the delay from the packet arrival to the presentation of its frame (the arrival
+    // is taken from the receiving ring if it's used, otherwise it's the read time)
+    LatencyMeter latencyMeter;
+    bool arrivalFromReceiver{false};
+    // whether the receive FIFO of the UDP protocol was applied to the socket (empty -
+    // it wasn't requested; written while preparing)
+    QString udpFifoStatus;
+
+    FastStartSettings fastStartSettings;
+    PsiCache psiCache;
+    // the parameters were taken from the cache, the first frames check them (in the
+    // playing thread)
+    bool psiCacheValidationPending{false};
+    QElapsedTimer psiCacheValidationTimer;
+    // how the streams of the current source were found (written while preparing)
+    QString fastStartResult;
+
+    // TR 101 290 checks of the raw input (in front of the other inputs)
+    bool tsAnalysisEnabled{true};
+    TsAnalyzer tsAnalyzer;
+    std::shared_ptr<BitrateHistory> bitrateHistory;
+
+    MappedFileInput mappedFileInput;
+    // in front of the other inputs of the rtp:// source
+    RtpInput rtpInput;
+    SeekIndex seekIndex;
+    // the packets before the target (in AV_TIME_BASE) are read without the pacing
+    std::atomic<int64_t> seekTargetUs{AV_NOPTS_VALUE};
+    // from the start of the source, updated by the pacing
+    std::atomic<int64_t> currentPositionUs{0};
 
     QVideoSink *videoSink{nullptr};
     QAudioSink *audioSink{nullptr};
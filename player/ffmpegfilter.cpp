@@ -1,5 +1,22 @@
 #include "ffmpegfilter.h"
 
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------
+bool FFmpegFilter::InputFormat::operator==(const InputFormat &other) const
+{
+    return width == other.width
+            && height == other.height
+            && format == other.format
+            && av_cmp_q(sampleAspectRatio, other.sampleAspectRatio) == 0;
+}
+
+//---------------------------------------------------------------------------------------
+bool FFmpegFilter::InputFormat::operator!=(const InputFormat &other) const
+{
+    return !(*this == other);
+}
+
 //---------------------------------------------------------------------------------------
 FFmpegFilter::FFmpegFilter(const QString &name, QObject *parent)
     : QObject{parent}
@@ -10,44 +27,153 @@ FFmpegFilter::FFmpegFilter(const QString &name, QObject *parent)
 //---------------------------------------------------------------------------------------
 FFmpegFilter::~FFmpegFilter()
 {
-    loggable.logMessage(objectName(), QtDebugMsg, QString("Destroy filter %1...").arg(filterName));
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Destroy filter graph %1...").arg(description));
 
-    if (graph)
-        avfilter_graph_free(&graph);
+    reset();
 
     if (outFrame)
         av_frame_free(&outFrame);
 }
 
 //---------------------------------------------------------------------------------------
-bool FFmpegFilter::init(const QString &filter, const QString &params, const QString &format)
+void FFmpegFilter::setDescription(const QString &filterDescription)
+{
+    if (filterDescription == description)
+        return;
+
+    description = filterDescription;
+    reset();
+}
+
+//---------------------------------------------------------------------------------------
+QString FFmpegFilter::getDescription() const
+{
+    return description;
+}
+
+//---------------------------------------------------------------------------------------
+void FFmpegFilter::setTimeBase(AVRational filterTimeBase)
+{
+    if (av_cmp_q(filterTimeBase, timeBase) == 0)
+        return;
+
+    timeBase = filterTimeBase;
+    reset();
+}
+
+//---------------------------------------------------------------------------------------
+//   Time base of the output frames. It may differ from the input time base, e.g. the
+// deinterlacers in the field rate mode halve it.
+AVRational FFmpegFilter::getOutputTimeBase() const
 {
-    filterName = filter;
-    filterParams = params;
-    inputBufferParams = format;
-    return init();
+    if (!ready)
+        return timeBase;
+
+    return av_buffersink_get_time_base(bufferSinkContext);
 }
 
 //---------------------------------------------------------------------------------------
-bool FFmpegFilter::init()
+void FFmpegFilter::setThreadCount(int threads)
 {
-    if (ready)
-        return true;
+    threads = std::max(1, threads);
+    if (threads == threadCount)
+        return;
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Change filter graph threads: %1 -> %2.").arg(threadCount).arg(threads));
+    threadCount = threads;
+    reset();
+}
 
-    if (filterName.isEmpty() || filterParams.isEmpty() || inputBufferParams.isEmpty())
+//---------------------------------------------------------------------------------------
+int FFmpegFilter::getThreadCount() const
+{
+    return threadCount;
+}
+
+//---------------------------------------------------------------------------------------
+bool FFmpegFilter::isReady() const
+{
+    return ready;
+}
+
+//---------------------------------------------------------------------------------------
+//   Frames buffered inside the old graph (e.g. by the deinterlacer) are dropped when
+// the graph is rebuilt.
+int FFmpegFilter::feedGraph(AVFrame *frame)
+{
+    InputFormat frameFormat;
+    frameFormat.width = frame->width;
+    frameFormat.height = frame->height;
+    frameFormat.format = frame->format;
+    frameFormat.sampleAspectRatio = frame->sample_aspect_ratio;
+
+    if ((ready || failed) && frameFormat != inputFormat)
     {
-        QString emptyParam;
-        if (filterName.isEmpty())
-            emptyParam = "Filter name";
-        else if (filterParams.isEmpty())
-            emptyParam = "Filter params";
-        else
-            emptyParam = "Input buffer params";
-        loggable.logMessage(objectName(), QtCriticalMsg, QString("%1 must not be empty").arg(emptyParam));
+        loggable.logMessage(objectName(), QtDebugMsg, "Input format changed, rebuild filter graph.");
+        reset();
+    }
+
+    // don't retry the failed configuration on every frame
+    if (failed)
+        return AVERROR(EINVAL);
+
+    if (!ready && !init(frameFormat))
+        return AVERROR(EINVAL);
+
+    return av_buffersrc_add_frame_flags(bufferSourceContext, frame, AV_BUFFERSRC_FLAG_KEEP_REF);
+}
+
+//---------------------------------------------------------------------------------------
+int FFmpegFilter::getOutputFrame(AVFrame **frame)
+{
+    if (!ready)
+        return AVERROR(EAGAIN);
+
+    int result = av_buffersink_get_frame(bufferSinkContext, outFrame);
+    *frame = outFrame;
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+void FFmpegFilter::reset()
+{
+    if (graph)
+        avfilter_graph_free(&graph);
+
+    bufferSourceContext = nullptr;
+    bufferSinkContext = nullptr;
+    inputFormat = InputFormat();
+    ready = false;
+    failed = false;
+}
+
+//---------------------------------------------------------------------------------------
+QString FFmpegFilter::getInputBufferParams(const InputFormat &format) const
+{
+    // zero aspect ratio means "unknown" and isn't accepted by the buffer source
+    AVRational sar = format.sampleAspectRatio.num ? format.sampleAspectRatio : AVRational{1, 1};
+
+    return QString("video_size=%1x%2:pix_fmt=%3:time_base=%4/%5:pixel_aspect=%6/%7")
+            .arg(format.width)
+            .arg(format.height)
+            .arg(format.format)
+            .arg(timeBase.num)
+            .arg(timeBase.den)
+            .arg(sar.num)
+            .arg(sar.den);
+}
+
+//---------------------------------------------------------------------------------------
+bool FFmpegFilter::init(const InputFormat &format)
+{
+    if (description.isEmpty())
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg, "Filter description must not be empty");
         return false;
     }
 
-    loggable.logMessage(objectName(), QtDebugMsg, QString("Init filter graph for %1...").arg(filterName));
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Init filter graph for %1...").arg(description));
 
     AVFilterInOut *inputs = nullptr;
     AVFilterInOut *outputs = nullptr;
@@ -56,32 +182,38 @@ bool FFmpegFilter::init()
     {
         int result;
 
-        const AVFilter *bufferSource   = avfilter_get_by_name("buffer");
-        const AVFilter *bufferSink  = avfilter_get_by_name("buffersink");
+        const AVFilter *bufferSource = avfilter_get_by_name("buffer");
+        const AVFilter *bufferSink = avfilter_get_by_name("buffersink");
         inputs  = avfilter_inout_alloc();
         outputs = avfilter_inout_alloc();
 
         graph = avfilter_graph_alloc();
 
-        if (!inputs || !outputs || !graph)
+        if (!outFrame)
+            outFrame = av_frame_alloc();
+
+        if (!inputs || !outputs || !graph || !outFrame)
         {
-            result = ENOMEM;
-            loggable.logAvError(objectName(), QtCriticalMsg, "Cannot allocate inputs, outputs or graph", result);
+            result = AVERROR(ENOMEM);
+            loggable.logAvError(objectName(), QtCriticalMsg, "Cannot allocate inputs, outputs, graph or frame", result);
             throw result;
         }
 
-        QByteArray argsArray = inputBufferParams.toLocal8Bit();
-        char *args = argsArray.data();
+        // must be set before the filters are added to the graph
+        graph->nb_threads = threadCount;
 
-        QByteArray descrArray = QString("%1=%2").arg(filterName, filterParams).toLocal8Bit();
-        const char *description = descrArray.data();
+        QByteArray argsArray = getInputBufferParams(format).toLocal8Bit();
+        const char *args = argsArray.data();
+
+        QByteArray descrArray = description.toLocal8Bit();
+        const char *filters = descrArray.data();
 
         loggable.logMessage(objectName(), QtDebugMsg,
                         QString("Config:\n"
-                                "Filter  : %1\n"
-                                "Settings: %2").arg(description, args));
+                                "Filters : %1\n"
+                                "Settings: %2\n"
+                                "Threads : %3").arg(filters, args).arg(threadCount));
 
-        graph = avfilter_graph_alloc();
         result = avfilter_graph_create_filter(&bufferSourceContext, bufferSource, "in",
                                               args, NULL, graph);
         if (result < 0)
@@ -108,7 +240,7 @@ bool FFmpegFilter::init()
         outputs->pad_idx    = 0;
         outputs->next       = NULL;
 
-        result = avfilter_graph_parse_ptr(graph, description, &inputs, &outputs, NULL);
+        result = avfilter_graph_parse_ptr(graph, filters, &inputs, &outputs, NULL);
         if (result < 0)
         {
             loggable.logAvError(objectName(), QtCriticalMsg, "ERROR of the avfilter_graph_parse_ptr.", result);
@@ -122,26 +254,24 @@ bool FFmpegFilter::init()
             throw result;
         }
 
-        outFrame = av_frame_alloc();
-        if (!outFrame)
-        {
-            result = ENOMEM;
-            loggable.logAvError(objectName(), QtCriticalMsg, "Could not allocate frame for filtering.", result);
-            throw result;
-        }
+        avfilter_inout_free(&inputs);
+        avfilter_inout_free(&outputs);
 
+        inputFormat = format;
         ready = true;
 
-        loggable.logMessage(objectName(), QtDebugMsg, QString("Filter graph %1 initialized.").arg(filterName));
+        loggable.logMessage(objectName(), QtDebugMsg, QString("Filter graph %1 initialized.").arg(description));
     }
     catch(int res)
     {
         avfilter_inout_free(&inputs);
         avfilter_inout_free(&outputs);
-        ready = false;
+        reset();
+        inputFormat = format;
+        failed = true;
 
         loggable.logAvError(objectName(), QtCriticalMsg,
-                        QString("ERROR of the initialization of the filter graph %1.").arg(filterName),
+                        QString("ERROR of the initialization of the filter graph %1.").arg(description),
                         res);
     }
 
@@ -149,35 +279,3 @@ bool FFmpegFilter::init()
 }
 
 //---------------------------------------------------------------------------------------
-bool FFmpegFilter::isReady() const
-{
-    return ready;
-}
-
-//---------------------------------------------------------------------------------------
-int FFmpegFilter::feedGraph(AVFrame *frame)
-{
-    return av_buffersrc_add_frame_flags(bufferSourceContext, frame, AV_BUFFERSRC_FLAG_KEEP_REF);
-}
-
-//---------------------------------------------------------------------------------------
-int FFmpegFilter::getOutputFrame(AVFrame **frame)
-{
-    int result = av_buffersink_get_frame(bufferSinkContext, outFrame);
-    *frame = outFrame;
-    return result;
-}
-
-//---------------------------------------------------------------------------------------
-void FFmpegFilter::setNextFilter(FFmpegFilter *filter)
-{
-    nextFilter = filter;
-}
-
-//---------------------------------------------------------------------------------------
-FFmpegFilter* FFmpegFilter::getNextFilter() const
-{
-    return nextFilter;
-}
-
-//---------------------------------------------------------------------------------------
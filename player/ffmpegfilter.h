@@ -11,6 +11,13 @@ extern "C" {
 #include <libavfilter/buffersrc.h>
 }
 
+//---------------------------------------------------------------------------------------
+//   Video filter graph: buffer source -> filter chain -> buffer sink.
+//   The chain is described in the libavfilter syntax (e.g. "crop=704:576:0:0,yadif").
+// The graph is built on the first frame and rebuilt automatically when the description
+// or the format of the input frames (size, pixel format, aspect ratio) changes.
+//   The slice threading of the filters (yadif, bwdif, scale etc.) uses up to
+// threadCount threads of the graph.
 class FFmpegFilter : public QObject
 {
     Q_OBJECT
@@ -18,23 +25,44 @@ public:
     explicit FFmpegFilter(const QString &name = "", QObject *parent = nullptr);
     virtual ~FFmpegFilter();
 
-    bool init(const QString &filter, const QString& params, const QString &format);
-    bool init();
+    void setDescription(const QString &description);
+    QString getDescription() const;
+
+    void setTimeBase(AVRational timeBase);
+    AVRational getOutputTimeBase() const;
+
+    void setThreadCount(int threads);
+    int getThreadCount() const;
 
     bool isReady() const;
 
     int feedGraph(AVFrame *frame);
     int getOutputFrame(AVFrame **frame);
 
-    void setNextFilter(FFmpegFilter *filter);
-    FFmpegFilter* getNextFilter() const;
+    void reset();
 
 private:
-    QString filterName;
-    QString filterParams;
-    QString inputBufferParams;
+    struct InputFormat
+    {
+        bool operator==(const InputFormat &other) const;
+        bool operator!=(const InputFormat &other) const;
+
+        int width{0};
+        int height{0};
+        int format{-1};
+        AVRational sampleAspectRatio{0, 1};
+    };
+
+    bool init(const InputFormat &format);
+    QString getInputBufferParams(const InputFormat &format) const;
+
+    QString description;
+    AVRational timeBase{1, AV_TIME_BASE};
+    int threadCount{1};
+    InputFormat inputFormat;
 
     bool ready{false};
+    bool failed{false};
 
     AVFilterGraph *graph{nullptr};
 
@@ -43,8 +71,6 @@ private:
 
     AVFrame *outFrame{nullptr};
 
-    FFmpegFilter *nextFilter{nullptr};
-
     Loggable loggable;
 };
 
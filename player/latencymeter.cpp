@@ -0,0 +1,74 @@
+#include "latencymeter.h"
+
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------
+void LatencyMeter::reset()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    for (auto &ring : arrivals)
+        ring.fill(Arrival{});
+    heads.fill(0);
+    windows.fill(Window{});
+}
+
+//---------------------------------------------------------------------------------------
+void LatencyMeter::addArrival(int output, int64_t pts, int64_t arrivalUs)
+{
+    if (output < 0 || output >= OutputCount || arrivalUs < 0)
+        return;
+
+    std::lock_guard<std::mutex> guard(mutex);
+
+    arrivals[output][heads[output]] = Arrival{pts, arrivalUs};
+    heads[output] = (heads[output] + 1) % RingSize;
+}
+
+//---------------------------------------------------------------------------------------
+void LatencyMeter::addPresentation(int output, int64_t pts, int64_t presentationUs)
+{
+    if (output < 0 || output >= OutputCount)
+        return;
+
+    std::lock_guard<std::mutex> guard(mutex);
+
+    const Arrival *found = nullptr;
+    for (const Arrival &arrival : arrivals[output])
+    {
+        if (arrival.timeUs >= 0 && arrival.pts <= pts && (!found || arrival.pts > found->pts))
+            found = &arrival;
+    }
+    if (!found)
+        return;
+
+    int64_t delayUs = std::max<int64_t>(0, presentationUs - found->timeUs);
+    Window &window = windows[output];
+    window.minUs = window.samples ? std::min(window.minUs, delayUs) : delayUs;
+    window.maxUs = window.samples ? std::max(window.maxUs, delayUs) : delayUs;
+    window.lastUs = delayUs;
+    window.sumUs += delayUs;
+    window.samples++;
+}
+
+//---------------------------------------------------------------------------------------
+LatencyStatistics LatencyMeter::takeStatistics(int output)
+{
+    if (output < 0 || output >= OutputCount)
+        return LatencyStatistics{};
+
+    std::lock_guard<std::mutex> guard(mutex);
+
+    const Window &window = windows[output];
+    LatencyStatistics stat;
+    stat.samples = window.samples;
+    stat.lastUs = window.lastUs;
+    stat.minUs = window.minUs;
+    stat.maxUs = window.maxUs;
+    stat.averageUs = window.samples ? window.sumUs / window.samples : 0;
+
+    windows[output] = Window{};
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
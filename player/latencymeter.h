@@ -0,0 +1,68 @@
+#ifndef LATENCYMETER_H
+#define LATENCYMETER_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+struct LatencyStatistics
+{
+    int64_t samples{0};
+    int64_t lastUs{0};
+    int64_t minUs{0};
+    int64_t averageUs{0};
+    int64_t maxUs{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Delay of the live stream from the arrival of the packet to the presentation of its
+// frame (video and audio separately). The arrival time is recorded when the packet
+// is sent to the decoder (keyed by its PTS), the presentation time is given by the
+// sink; the statistics are collected between the takes.
+//   The times are of av_gettime_relative. The records are kept in the fixed rings, so
+// the frames which are never presented (dropped, or not decoded) don't accumulate.
+class LatencyMeter
+{
+public:
+    enum Output {
+        Video,
+        Audio,
+        OutputCount
+    };
+
+    void reset();
+    void addArrival(int output, int64_t pts, int64_t arrivalUs);
+    // the arrival of the frame is of its packet, or of the preceding one (the packet
+    // may contain several audio frames)
+    void addPresentation(int output, int64_t pts, int64_t presentationUs);
+
+    // the statistics since the previous take
+    LatencyStatistics takeStatistics(int output);
+
+private:
+    struct Arrival
+    {
+        int64_t pts{0};
+        int64_t timeUs{-1};
+    };
+
+    struct Window
+    {
+        int64_t samples{0};
+        int64_t lastUs{0};
+        int64_t minUs{0};
+        int64_t maxUs{0};
+        int64_t sumUs{0};
+    };
+
+    enum {
+        RingSize = 128
+    };
+
+    std::mutex mutex;
+    std::array<std::array<Arrival, RingSize>, OutputCount> arrivals;
+    std::array<int, OutputCount> heads{};
+    std::array<Window, OutputCount> windows;
+};
+
+#endif // LATENCYMETER_H
@@ -0,0 +1,95 @@
+#include "loadgovernor.h"
+
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------
+LoadGovernor::LoadGovernor()
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void LoadGovernor::setLowresSupported(bool supported)
+{
+    lowresSupported = supported;
+    if (!lowresSupported && level == Lowres)
+        level = KeyFramesOnly;
+}
+
+//---------------------------------------------------------------------------------------
+bool LoadGovernor::update(double utilization, int64_t latenessUs)
+{
+    if (evaluationsSinceStepBack >= 0)
+        evaluationsSinceStepBack++;
+
+    bool overloaded = utilization > MaxUtilization || latenessUs > MaxLatenessUs;
+    if (overloaded)
+    {
+        calmEvaluations = 0;
+        if (evaluationsSinceStepBack >= 0 && evaluationsSinceStepBack <= OscillationWindow)
+            requiredCalmEvaluations = std::min<int>(requiredCalmEvaluations * 2, MaxCalmEvaluations);
+        evaluationsSinceStepBack = -1;
+
+        int newLevel = nextLevel(1);
+        if (newLevel == level)
+            return false;
+        level = newLevel;
+        return true;
+    }
+
+    bool calm = utilization < CalmUtilization && latenessUs < CalmLatenessUs;
+    if (!calm || level == Full)
+    {
+        calmEvaluations = 0;
+        return false;
+    }
+
+    if (++calmEvaluations < requiredCalmEvaluations)
+        return false;
+
+    calmEvaluations = 0;
+    evaluationsSinceStepBack = 0;
+    level = nextLevel(-1);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void LoadGovernor::reset()
+{
+    level = Full;
+    calmEvaluations = 0;
+    requiredCalmEvaluations = MinCalmEvaluations;
+    evaluationsSinceStepBack = -1;
+}
+
+//---------------------------------------------------------------------------------------
+int LoadGovernor::getLevel() const
+{
+    return level;
+}
+
+//---------------------------------------------------------------------------------------
+QString LoadGovernor::levelToString(int level)
+{
+    switch (level)
+    {
+    case Full:             return "full decoding";
+    case SkipLoopFilter:   return "loop filter skipped";
+    case SkipNonReference: return "non-reference frames skipped";
+    case Lowres:           return "reduced resolution";
+    case KeyFramesOnly:    return "key frames only";
+    default:
+        return "unknown";
+    }
+}
+
+//---------------------------------------------------------------------------------------
+int LoadGovernor::nextLevel(int step) const
+{
+    int newLevel = std::clamp(level + step, int(Full), int(KeyFramesOnly));
+    if (newLevel == Lowres && !lowresSupported)
+        newLevel = std::clamp(newLevel + step, int(Full), int(KeyFramesOnly));
+    return newLevel;
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,63 @@
+#ifndef LOADGOVERNOR_H
+#define LOADGOVERNOR_H
+
+#include <QString>
+
+#include <stdint.h>
+
+//---------------------------------------------------------------------------------------
+//   Chooses the degradation level of the video decoding from the measured load.
+//   The load is evaluated periodically (by the caller): the utilization is the part of
+// the wall time spent by the video pipeline (1.0 means it barely keeps up), the lateness
+// is how much the pictures are behind the stream clock. If either is over the limit,
+// the decoding becomes cheaper by one level; if both are low for several evaluations,
+// it goes back one level. When the step back leads to the overload again shortly, the
+// required calm period is doubled, so the governor doesn't oscillate.
+//   The levels are cumulative: each one includes the reductions of the previous ones.
+class LoadGovernor
+{
+public:
+    enum Level {
+        Full,
+        SkipLoopFilter,
+        SkipNonReference,
+        Lowres,
+        KeyFramesOnly,
+        LevelCount
+    };
+
+    LoadGovernor();
+
+    // the lowres level is skipped for the codecs without it
+    void setLowresSupported(bool supported);
+
+    // returns true if the level was changed
+    bool update(double utilization, int64_t latenessUs);
+    void reset();
+
+    int getLevel() const;
+    static QString levelToString(int level);
+
+private:
+    int nextLevel(int step) const;
+
+    static constexpr double MaxUtilization = 0.95;
+    static constexpr double CalmUtilization = 0.6;
+
+    enum {
+        MaxLatenessUs = 200000,
+        CalmLatenessUs = 40000,
+        MinCalmEvaluations = 3,
+        MaxCalmEvaluations = 60,
+        // the overload within this number of evaluations after the step back is oscillation
+        OscillationWindow = 10
+    };
+
+    int level{Full};
+    bool lowresSupported{true};
+    int calmEvaluations{0};
+    int requiredCalmEvaluations{MinCalmEvaluations};
+    int evaluationsSinceStepBack{-1};
+};
+
+#endif // LOADGOVERNOR_H
@@ -0,0 +1,316 @@
+#include "mappedfileinput.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+//---------------------------------------------------------------------------------------
+static int64_t getPageSize()
+{
+#if defined(Q_OS_UNIX)
+    return int64_t(sysconf(_SC_PAGESIZE));
+#else
+    return 4096;
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+//   The hints for the whole mapping: the sequential access (the larger readahead of
+// the kernel), and the huge pages where the file mappings support them.
+static void adviseSequentialAccess(uchar *address, int64_t length)
+{
+#if defined(Q_OS_UNIX)
+    madvise(address, size_t(length), MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+    madvise(address, size_t(length), MADV_HUGEPAGE);
+#endif
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(length);
+#endif
+}
+
+#if defined(Q_OS_WIN)
+//---------------------------------------------------------------------------------------
+//   PrefetchVirtualMemory is available since Windows 8, the build may target the older
+// versions (_WIN32_WINNT < 0x0602), so it's looked up at run time with its own copy of
+// the range structure. Without it the readahead is left to the system.
+struct MemoryRangeEntry
+{
+    PVOID virtualAddress;
+    SIZE_T numberOfBytes;
+};
+
+using PrefetchVirtualMemoryFunction = BOOL (WINAPI *)(HANDLE, ULONG_PTR, MemoryRangeEntry*, ULONG);
+
+static PrefetchVirtualMemoryFunction findPrefetchVirtualMemory()
+{
+    HMODULE kernel = GetModuleHandleW(L"kernel32.dll");
+    return kernel ? reinterpret_cast<PrefetchVirtualMemoryFunction>(
+                        reinterpret_cast<void*>(GetProcAddress(kernel, "PrefetchVirtualMemory")))
+                  : nullptr;
+}
+#endif
+
+//---------------------------------------------------------------------------------------
+//   The pages are read in the background, the call doesn't wait for them.
+static bool adviseWillNeed(uchar *address, int64_t length)
+{
+#if defined(Q_OS_UNIX)
+    return madvise(address, size_t(length), MADV_WILLNEED) == 0;
+#elif defined(Q_OS_WIN)
+    static const PrefetchVirtualMemoryFunction prefetchVirtualMemory = findPrefetchVirtualMemory();
+    if (!prefetchVirtualMemory)
+        return false;
+
+    MemoryRangeEntry range;
+    range.virtualAddress = address;
+    range.numberOfBytes = SIZE_T(length);
+    return prefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != FALSE;
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(length);
+    return false;
+#endif
+}
+
+static const int64_t PageSize = getPageSize();
+
+//---------------------------------------------------------------------------------------
+MappedFileInput::MappedFileInput(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("MappedFileInput");
+}
+
+//---------------------------------------------------------------------------------------
+MappedFileInput::~MappedFileInput()
+{
+    close();
+}
+
+//---------------------------------------------------------------------------------------
+bool MappedFileInput::open(const QString &path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        loggable.logMessage(objectName(), QtWarningMsg,
+                            QString("Could not open '%1': %2").arg(path, file.errorString()));
+        return false;
+    }
+
+    position = 0;
+    if (!mapFile())
+    {
+        close();
+        return false;
+    }
+
+    unsigned char *buffer = static_cast<unsigned char*>(av_malloc(ReadBufferSize));
+    ioContext = buffer ? avio_alloc_context(buffer, ReadBufferSize, 0, this,
+                                            &MappedFileInput::readCallback, nullptr,
+                                            &MappedFileInput::seekCallback)
+                       : nullptr;
+    if (!ioContext)
+    {
+        av_free(buffer);
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate input IO context.");
+        close();
+        return false;
+    }
+    ioContext->seekable = AVIO_SEEKABLE_NORMAL;
+
+    readBytes.store(0);
+    seeks.store(0);
+    readaheadHints.store(0);
+    remaps.store(0);
+
+    loggable.logMessage(objectName(), QtDebugMsg, QString("File '%1' mapped: %2 byte(s).").arg(path).arg(size));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called after the demuxer which reads the IO context is closed.
+void MappedFileInput::close()
+{
+    if (ioContext)
+    {
+        av_freep(&ioContext->buffer);
+        avio_context_free(&ioContext);
+    }
+
+    if (data)
+    {
+        file.unmap(data);
+        data = nullptr;
+    }
+    if (file.isOpen())
+        file.close();
+
+    size = 0;
+    position = 0;
+    readaheadEnd = 0;
+}
+
+//---------------------------------------------------------------------------------------
+bool MappedFileInput::isOpen() const
+{
+    return ioContext != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+AVIOContext *MappedFileInput::getIoContext() const
+{
+    return ioContext;
+}
+
+//---------------------------------------------------------------------------------------
+MappedFileInputStatistics MappedFileInput::getStatistics() const
+{
+    MappedFileInputStatistics stat;
+    stat.open = isOpen();
+    if (!stat.open)
+        return stat;
+
+    stat.fileSize = size;
+    stat.readBytes = readBytes.load();
+    stat.seeks = seeks.load();
+    stat.readaheadHints = readaheadHints.load();
+    stat.remaps = remaps.load();
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
+//   The whole file is mapped at once (the previous mapping is released).
+bool MappedFileInput::mapFile()
+{
+    if (data)
+    {
+        file.unmap(data);
+        data = nullptr;
+        size = 0;
+    }
+
+    int64_t fileSize = file.size();
+    if (fileSize <= 0)
+        return false;
+
+    data = file.map(0, fileSize);
+    if (!data)
+    {
+        loggable.logMessage(objectName(), QtWarningMsg,
+                            QString("Could not map %1 byte(s): %2").arg(fileSize).arg(file.errorString()));
+        return false;
+    }
+    size = fileSize;
+
+    adviseSequentialAccess(data, size);
+    readaheadEnd = position;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   The next window is requested when the half of the current one is read.
+void MappedFileInput::adviseReadahead(int64_t readPosition)
+{
+    if (readPosition + ReadaheadSize / 2 < readaheadEnd)
+        return;
+
+    int64_t start = std::max(readPosition, readaheadEnd) / PageSize * PageSize;
+    int64_t end = std::min(size, readPosition + ReadaheadSize);
+    if (end <= start)
+        return;
+
+    if (adviseWillNeed(data + start, end - start))
+        readaheadHints++;
+    readaheadEnd = end;
+}
+
+//---------------------------------------------------------------------------------------
+int MappedFileInput::readCallback(void *opaque, uint8_t *buf, int bufSize)
+{
+    MappedFileInput *input = static_cast<MappedFileInput*>(opaque);
+
+    // the mapped pages beyond the end of the truncated file can't be read (SIGBUS), so
+    // the size is checked from time to time (and at the end of the mapping, where the
+    // file may be still written) and the shorter file is mapped again
+    bool atEnd = input->position >= input->size;
+    if (atEnd || !input->sizeCheckTimer.isValid() || input->sizeCheckTimer.elapsed() >= SizeCheckIntervalMs)
+    {
+        input->sizeCheckTimer.start();
+        int64_t fileSize = input->file.size();
+        if (fileSize < input->size)
+        {
+            input->loggable.logMessage(input->objectName(), QtWarningMsg,
+                                       QString("File truncated: %1 -> %2 byte(s).").arg(input->size).arg(fileSize));
+            if (!input->mapFile())
+                return AVERROR_EOF;
+            input->remaps++;
+        }
+        else if (atEnd)
+        {
+            if (fileSize == input->size || !input->mapFile())
+                return AVERROR_EOF;
+            input->remaps++;
+        }
+    }
+    if (input->position >= input->size)
+        return AVERROR_EOF;
+
+    int count = int(std::min<int64_t>(bufSize, input->size - input->position));
+    input->adviseReadahead(input->position + count);
+    memcpy(buf, input->data + input->position, size_t(count));
+
+    input->position += count;
+    input->readBytes += count;
+    return count;
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the position is moved; the window after it is requested by the next read.
+int64_t MappedFileInput::seekCallback(void *opaque, int64_t offset, int whence)
+{
+    MappedFileInput *input = static_cast<MappedFileInput*>(opaque);
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return std::max(input->size, int64_t(input->file.size()));
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += input->position;
+        break;
+    case SEEK_END:
+        offset += input->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (offset < 0)
+        return AVERROR(EINVAL);
+
+    if (offset != input->position)
+    {
+        input->seeks++;
+        input->readaheadEnd = offset;
+    }
+    input->position = offset;
+    return offset;
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,85 @@
+#ifndef MAPPEDFILEINPUT_H
+#define MAPPEDFILEINPUT_H
+
+#include <QObject>
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <atomic>
+
+#include "loggable.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct MappedFileInputStatistics
+{
+    bool open{false};
+    int64_t fileSize{0};
+    int64_t readBytes{0};
+    int64_t seeks{0};
+    int64_t readaheadHints{0};
+    int64_t remaps{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Input of the file source through the memory mapping of the whole file.
+//   The demuxer reads it through the custom AVIOContext: the reading is a copy from
+// the mapped pages into the IO buffer and the seeking is only the move of the position,
+// there are no system calls per read. The kernel is told that the file is read
+// sequentially, and the window ahead of the position is requested in advance (again
+// after every seek), so the pages are ready when the demuxer gets there; they stay
+// in the page cache shared by all instances reading the same file.
+//   The file growing while it's played (e.g. the recording in progress) is mapped again
+// when its end is reached. The size is also checked every SizeCheckIntervalMs, so the
+// truncated file is mapped again (the truncation between the checks isn't caught).
+// If the mapping isn't possible (e.g. 32-bit address space), the source is opened by
+// FFmpeg as usual.
+class MappedFileInput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MappedFileInput(QObject *parent = nullptr);
+    virtual ~MappedFileInput();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    AVIOContext *getIoContext() const;
+    MappedFileInputStatistics getStatistics() const;
+
+private:
+    bool mapFile();
+    void adviseReadahead(int64_t readPosition);
+
+    static int readCallback(void *opaque, uint8_t *buf, int bufSize);
+    static int64_t seekCallback(void *opaque, int64_t offset, int whence);
+
+    enum {
+        ReadBufferSize = 256 * 1024,
+        ReadaheadSize = 8 * 1024 * 1024,
+        SizeCheckIntervalMs = 500
+    };
+
+    QFile file;
+    uchar *data{nullptr};
+    int64_t size{0};
+    int64_t position{0};
+    // the end of the window requested from the kernel
+    int64_t readaheadEnd{0};
+    QElapsedTimer sizeCheckTimer;
+
+    AVIOContext *ioContext{nullptr};
+
+    std::atomic<int64_t> readBytes{0};
+    std::atomic<int64_t> seeks{0};
+    std::atomic<int64_t> readaheadHints{0};
+    std::atomic<int64_t> remaps{0};
+
+    Loggable loggable;
+};
+
+#endif // MAPPEDFILEINPUT_H
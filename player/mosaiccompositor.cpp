@@ -0,0 +1,230 @@
+#include "mosaiccompositor.h"
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QImage>
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+//---------------------------------------------------------------------------------------
+MosaicCompositor::MosaicCompositor()
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+void MosaicCompositor::setTiles(const std::vector<MosaicTileInfo> &tileInfos)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    tiles.clear();
+    for (const MosaicTileInfo &info : tileInfos)
+    {
+        Tile tile;
+        tile.info = info;
+        tiles.push_back(tile);
+    }
+    updateLayout();
+}
+
+//---------------------------------------------------------------------------------------
+int MosaicCompositor::getTileCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return int(tiles.size());
+}
+
+//---------------------------------------------------------------------------------------
+//   Usually the size of the video widget (in the device pixels). The mosaic is composed
+// on the CPU, so its size is limited by MaxWidth x MaxHeight; the sink scales it up.
+void MosaicCompositor::setOutputSize(const QSize &size)
+{
+    QSize newSize = size.isEmpty() ? QSize(DefaultWidth, DefaultHeight)
+                                   : size.boundedTo(QSize(MaxWidth, MaxHeight));
+    newSize = QSize(newSize.width() & ~1, newSize.height() & ~1);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    outputSize = newSize;
+}
+
+//---------------------------------------------------------------------------------------
+QSize MosaicCompositor::getOutputSize() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return outputSize;
+}
+
+//---------------------------------------------------------------------------------------
+QSize MosaicCompositor::getTileSize() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    QRect rect = getTileRect(0);
+    return QSize(rect.width() & ~1, std::max(2, rect.height() - CaptionHeight) & ~1);
+}
+
+//---------------------------------------------------------------------------------------
+void MosaicCompositor::setVisible(bool visibleOutput)
+{
+    visible.store(visibleOutput);
+}
+
+//---------------------------------------------------------------------------------------
+bool MosaicCompositor::isVisible() const
+{
+    return visible.load();
+}
+
+//---------------------------------------------------------------------------------------
+//   Called by the tile decoders from the worker threads.
+void MosaicCompositor::setTilePicture(int tile, const QVideoFrame &picture)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (tile < 0 || tile >= int(tiles.size()))
+        return;
+
+    tiles[tile].picture = picture;
+    tiles[tile].pictureTime = av_gettime_relative();
+}
+
+//---------------------------------------------------------------------------------------
+void MosaicCompositor::setTileAudioLevels(int tile, const std::vector<double> &levels)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (tile < 0 || tile >= int(tiles.size()))
+        return;
+
+    tiles[tile].audioLevels = levels;
+}
+
+//---------------------------------------------------------------------------------------
+//   The tiles are copied under the lock (the pictures are shared, not copied), so the
+// decoders aren't blocked while the frame is painted.
+QVideoFrame MosaicCompositor::compose()
+{
+    std::vector<Tile> snapshot;
+    std::vector<QRect> tileRects;
+    QSize size;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        snapshot = tiles;
+        size = outputSize;
+        for (int i = 0; i < int(tiles.size()); ++i)
+            tileRects.push_back(getTileRect(i));
+    }
+
+    QVideoFrame frame(QVideoFrameFormat(size, getPixelFormat()));
+    if (!frame.map(QVideoFrame::WriteOnly))
+        return QVideoFrame();
+
+    QImage canvas(frame.bits(0), size.width(), size.height(), frame.bytesPerLine(0), QImage::Format_RGB32);
+    canvas.fill(Qt::black);
+
+    QPainter painter(&canvas);
+    QFont font = painter.font();
+    font.setPixelSize(CaptionHeight - 6);
+    painter.setFont(font);
+    QFontMetrics metrics(font);
+
+    int64_t now = av_gettime_relative();
+    for (int i = 0; i < int(snapshot.size()); ++i)
+    {
+        Tile &tile = snapshot[i];
+        QRect tileRect = tileRects[i];
+        QRect pictureRect(tileRect.x(), tileRect.y(), tileRect.width(), tileRect.height() - CaptionHeight);
+        QRect captionRect(tileRect.x(), pictureRect.bottom() + 1, tileRect.width(), CaptionHeight);
+
+        painter.fillRect(pictureRect, QColor(16, 16, 16));
+
+        if (tile.picture.isValid() && tile.picture.map(QVideoFrame::ReadOnly))
+        {
+            QImage image(tile.picture.bits(0), tile.picture.width(), tile.picture.height(),
+                         tile.picture.bytesPerLine(0), QImage::Format_RGB32);
+            QRect target(QPoint(0, 0), image.size().boundedTo(pictureRect.size()));
+            target.moveCenter(pictureRect.center());
+            painter.drawImage(target, image);
+            tile.picture.unmap();
+        }
+
+        if (!tile.picture.isValid() || now - tile.pictureTime > StaleTimeoutUs)
+        {
+            painter.setPen(QColor(160, 160, 160));
+            painter.drawText(pictureRect, Qt::AlignCenter, "No signal");
+        }
+
+        // audio level bars along the right edge of the picture
+        int barX = pictureRect.right() + 1;
+        for (auto it = tile.audioLevels.rbegin(); it != tile.audioLevels.rend(); ++it)
+        {
+            barX -= AudioBarWidth + 1;
+            if (barX < pictureRect.left())
+                break;
+
+            double level = std::clamp(*it, MinAudioLevel, 0.0);
+            int barHeight = int(std::lround((level - MinAudioLevel) / -MinAudioLevel * pictureRect.height()));
+            QColor color = level > OverloadLevel ? QColor(220, 40, 40)
+                         : level > AlignmentLevel ? QColor(230, 200, 40)
+                         : QColor(40, 200, 60);
+
+            painter.fillRect(barX, pictureRect.top(), AudioBarWidth, pictureRect.height(), QColor(0, 0, 0));
+            painter.fillRect(barX, pictureRect.bottom() + 1 - barHeight, AudioBarWidth, barHeight, color);
+        }
+
+        painter.fillRect(captionRect, QColor(40, 40, 40));
+        painter.setPen(QColor(230, 230, 230));
+        QString caption = tile.info.serviceName.isEmpty()
+                ? QString::number(tile.info.programId)
+                : QString("%1 - %2").arg(tile.info.programId).arg(tile.info.serviceName);
+        painter.drawText(captionRect.adjusted(4, 0, -4, 0), Qt::AlignVCenter | Qt::AlignLeft,
+                         metrics.elidedText(caption, Qt::ElideRight, captionRect.width() - 8));
+    }
+    painter.end();
+
+    frame.unmap();
+    composedFrames++;
+    return frame;
+}
+
+//---------------------------------------------------------------------------------------
+int64_t MosaicCompositor::getComposedFrames() const
+{
+    return composedFrames.load();
+}
+
+//---------------------------------------------------------------------------------------
+QVideoFrameFormat::PixelFormat MosaicCompositor::getPixelFormat()
+{
+    // the same memory layout as QImage::Format_RGB32
+    return QVideoFrameFormat::Format_XRGB8888;
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+void MosaicCompositor::updateLayout()
+{
+    int count = std::max<int>(1, int(tiles.size()));
+    columns = int(std::ceil(std::sqrt(double(count))));
+    rows = (count + columns - 1) / columns;
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+QRect MosaicCompositor::getTileRect(int tile) const
+{
+    int cellWidth = (outputSize.width() - Spacing * (columns - 1)) / columns;
+    int cellHeight = (outputSize.height() - Spacing * (rows - 1)) / rows;
+
+    int column = tile % columns;
+    int row = tile / columns;
+    return QRect(column * (cellWidth + Spacing), row * (cellHeight + Spacing), cellWidth, cellHeight);
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,90 @@
+#ifndef MOSAICCOMPOSITOR_H
+#define MOSAICCOMPOSITOR_H
+
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVideoFrame>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+struct MosaicTileInfo
+{
+    int programId{-1};
+    QString serviceName;
+};
+
+//---------------------------------------------------------------------------------------
+//   Output surface of the multiviewer: the tiles are arranged in the grid (close to
+// square), each tile shows the picture of one program with the service name and the
+// audio level bars of the program's audio.
+//   The tile decoders convert their pictures to the tile size in the worker threads and
+// only pass them here; compose() draws the latest picture of every tile into one
+// frame for the video sink. Tiles without the pictures for StaleTimeoutUs are marked
+// as "no signal".
+class MosaicCompositor
+{
+public:
+    MosaicCompositor();
+
+    void setTiles(const std::vector<MosaicTileInfo> &tileInfos);
+    int getTileCount() const;
+
+    void setOutputSize(const QSize &size);
+    QSize getOutputSize() const;
+    // size of the picture area of the tile (without the caption)
+    QSize getTileSize() const;
+
+    void setVisible(bool visible);
+    bool isVisible() const;
+
+    void setTilePicture(int tile, const QVideoFrame &picture);
+    void setTileAudioLevels(int tile, const std::vector<double> &levels);
+
+    QVideoFrame compose();
+    int64_t getComposedFrames() const;
+
+    // pixel format of the tile pictures and of the composed frame
+    static QVideoFrameFormat::PixelFormat getPixelFormat();
+
+private:
+    struct Tile
+    {
+        MosaicTileInfo info;
+        QVideoFrame picture;
+        int64_t pictureTime{0};
+        std::vector<double> audioLevels;
+    };
+
+    void updateLayout();
+    QRect getTileRect(int tile) const;
+
+    enum {
+        DefaultWidth = 1280,
+        DefaultHeight = 720,
+        MaxWidth = 1920,
+        MaxHeight = 1080,
+        Spacing = 2,
+        CaptionHeight = 18,
+        AudioBarWidth = 4,
+        StaleTimeoutUs = 2000000
+    };
+
+    // the levels of the audio bars, dB
+    static constexpr double MinAudioLevel = -60.0;
+    static constexpr double AlignmentLevel = -23.0;
+    static constexpr double OverloadLevel = -18.0;
+
+    mutable std::mutex mutex;
+    std::vector<Tile> tiles;
+    QSize outputSize{DefaultWidth, DefaultHeight};
+    int columns{1};
+    int rows{1};
+
+    std::atomic_bool visible{true};
+    std::atomic<int64_t> composedFrames{0};
+};
+
+#endif // MOSAICCOMPOSITOR_H
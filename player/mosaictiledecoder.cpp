@@ -0,0 +1,69 @@
+#include "mosaictiledecoder.h"
+
+//---------------------------------------------------------------------------------------
+MosaicTileDecoder::MosaicTileDecoder(const QString &name, int tileIndex,
+                                     MosaicCompositor *compositor, QObject *parent)
+    : VideoDecoder{name, parent}
+    , tileIndex{tileIndex}
+    , compositor{compositor}
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+int MosaicTileDecoder::outputFrame(AVFrame *avFrame)
+{
+    if (!compositor->isVisible())
+        return 0;
+
+    tileConverter.setMaxOutputSize(compositor->getTileSize());
+
+    AVFrame *source = tileConverter.crop(avFrame);
+    if (!source)
+        return 0;
+
+    QSize size = tileConverter.getOutputSize(source);
+    QVideoFrame picture;
+    bool ok = tileConverter.convert(source, size, MosaicCompositor::getPixelFormat(), picture);
+    av_frame_free(&source);
+
+    if (!ok)
+        return 0;
+
+    compositor->setTilePicture(tileIndex, picture);
+    return size.width() * size.height() * 4;
+}
+
+//---------------------------------------------------------------------------------------
+int MosaicTileDecoder::getLowres() const
+{
+    return lowres.load();
+}
+
+//---------------------------------------------------------------------------------------
+bool MosaicTileDecoder::isSkippingNonReferenceFrames() const
+{
+    return skipNonReference.load();
+}
+
+//---------------------------------------------------------------------------------------
+void MosaicTileDecoder::configureCodecContext()
+{
+    VideoDecoder::configureCodecContext();
+
+    QSize tileSize = compositor->getTileSize();
+    int factor = 0;
+    while (factor < codec->max_lowres
+           && (codecContext->width >> (factor + 1)) >= tileSize.width()
+           && (codecContext->height >> (factor + 1)) >= tileSize.height())
+        factor++;
+
+    codecContext->lowres = factor;
+    lowres.store(factor);
+
+    skipNonReference.store(codec->max_lowres == 0);
+    if (skipNonReference.load())
+        codecContext->skip_frame = AVDISCARD_NONREF;
+}
+
+//---------------------------------------------------------------------------------------
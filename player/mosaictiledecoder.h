@@ -0,0 +1,39 @@
+#ifndef MOSAICTILEDECODER_H
+#define MOSAICTILEDECODER_H
+
+#include "mosaiccompositor.h"
+#include "videoconverter.h"
+#include "videodecoder.h"
+
+//---------------------------------------------------------------------------------------
+//   Video decoder of one multiviewer tile.
+//   The tiles are small, so the decoding is reduced: the codecs with the lowres
+// support (MPEG-2, MJPEG, ...) decode at 1/2, 1/4 or 1/8 of the resolution (but never
+// below the tile size), the others skip the non-reference frames. The pictures aren't
+// filtered; they are scaled and converted directly to the tile size (the scaler
+// blends the fields of the interlaced pictures) and passed to the compositor.
+class MosaicTileDecoder : public VideoDecoder
+{
+    Q_OBJECT
+public:
+    explicit MosaicTileDecoder(const QString& name, int tileIndex,
+                               MosaicCompositor *compositor, QObject *parent = nullptr);
+
+    int outputFrame(AVFrame *avFrame) override;
+
+    int getLowres() const;
+    bool isSkippingNonReferenceFrames() const;
+
+protected:
+    void configureCodecContext() override;
+
+private:
+    int tileIndex{-1};
+    MosaicCompositor *compositor{nullptr};
+
+    VideoConverter tileConverter;
+    std::atomic<int> lowres{0};
+    std::atomic_bool skipNonReference{false};
+};
+
+#endif // MOSAICTILEDECODER_H
@@ -0,0 +1,144 @@
+#include "pixelrepack.h"
+
+#include <algorithm>
+
+#include "simd.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+//---------------------------------------------------------------------------------------
+static void shiftSamples(const uint16_t *src, uint16_t *dst, int count, int shift)
+{
+    int i = 0;
+
+#ifdef PLAYER_SIMD_SSE2
+    __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_sll_epi16(samples, shiftCount));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = static_cast<uint16_t>(src[i] << shift);
+}
+
+//---------------------------------------------------------------------------------------
+static void interleaveChroma(const uint16_t *u, const uint16_t *v, uint16_t *dst, int count, int shift)
+{
+    int i = 0;
+
+#ifdef PLAYER_SIMD_SSE2
+    __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i us = _mm_sll_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i)), shiftCount);
+        __m128i vs = _mm_sll_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)), shiftCount);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi16(us, vs));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 8), _mm_unpackhi_epi16(us, vs));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        dst[2 * i] = static_cast<uint16_t>(u[i] << shift);
+        dst[2 * i + 1] = static_cast<uint16_t>(v[i] << shift);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   Interleaves the average of two chroma lines (4:2:2 -> 4:2:0).
+static void interleaveChromaAverage(const uint16_t *u0, const uint16_t *u1,
+                                    const uint16_t *v0, const uint16_t *v1,
+                                    uint16_t *dst, int count, int shift)
+{
+    int i = 0;
+
+#ifdef PLAYER_SIMD_SSE2
+    __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i us = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u0 + i)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(u1 + i)));
+        __m128i vs = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v0 + i)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(v1 + i)));
+        us = _mm_sll_epi16(us, shiftCount);
+        vs = _mm_sll_epi16(vs, shiftCount);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi16(us, vs));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 8), _mm_unpackhi_epi16(us, vs));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        dst[2 * i] = static_cast<uint16_t>(((u0[i] + u1[i] + 1) >> 1) << shift);
+        dst[2 * i + 1] = static_cast<uint16_t>(((v0[i] + v1[i] + 1) >> 1) << shift);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+AVPixelFormat getSemiPlanar16Format(AVPixelFormat format)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    if (!desc
+            || desc->nb_components != 3
+            || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR)
+            || (desc->flags & (AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL))
+            || desc->comp[0].depth <= 8
+            || desc->comp[0].depth > 16
+            || desc->log2_chroma_w != 1
+            || desc->log2_chroma_h > 1)
+        return AV_PIX_FMT_NONE;
+
+    return desc->comp[0].depth <= 10 ? AV_PIX_FMT_P010LE : AV_PIX_FMT_P016LE;
+}
+
+//---------------------------------------------------------------------------------------
+bool repackToSemiPlanar16(const AVFrame *avFrame, uint8_t *const dstData[2], const int dstLinesize[2])
+{
+    AVPixelFormat format = static_cast<AVPixelFormat>(avFrame->format);
+    if (getSemiPlanar16Format(format) == AV_PIX_FMT_NONE)
+        return false;
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    int shift = 16 - desc->comp[0].depth;
+    int chromaWidth = (avFrame->width + 1) >> 1;
+    int chromaHeight = (avFrame->height + 1) >> 1;
+    int srcChromaHeight = desc->log2_chroma_h ? chromaHeight : avFrame->height;
+
+    for (int y = 0; y < avFrame->height; ++y)
+    {
+        shiftSamples(reinterpret_cast<const uint16_t*>(avFrame->data[0] + int64_t(y) * avFrame->linesize[0]),
+                     reinterpret_cast<uint16_t*>(dstData[0] + int64_t(y) * dstLinesize[0]),
+                     avFrame->width, shift);
+    }
+
+    for (int y = 0; y < chromaHeight; ++y)
+    {
+        uint16_t *dst = reinterpret_cast<uint16_t*>(dstData[1] + int64_t(y) * dstLinesize[1]);
+
+        if (desc->log2_chroma_h)
+        {
+            const uint16_t *u = reinterpret_cast<const uint16_t*>(avFrame->data[1] + int64_t(y) * avFrame->linesize[1]);
+            const uint16_t *v = reinterpret_cast<const uint16_t*>(avFrame->data[2] + int64_t(y) * avFrame->linesize[2]);
+            interleaveChroma(u, v, dst, chromaWidth, shift);
+        }
+        else
+        {
+            int y0 = 2 * y;
+            int y1 = std::min(y0 + 1, srcChromaHeight - 1);
+            const uint16_t *u0 = reinterpret_cast<const uint16_t*>(avFrame->data[1] + int64_t(y0) * avFrame->linesize[1]);
+            const uint16_t *u1 = reinterpret_cast<const uint16_t*>(avFrame->data[1] + int64_t(y1) * avFrame->linesize[1]);
+            const uint16_t *v0 = reinterpret_cast<const uint16_t*>(avFrame->data[2] + int64_t(y0) * avFrame->linesize[2]);
+            const uint16_t *v1 = reinterpret_cast<const uint16_t*>(avFrame->data[2] + int64_t(y1) * avFrame->linesize[2]);
+            interleaveChromaAverage(u0, u1, v0, v1, dst, chromaWidth, shift);
+        }
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,23 @@
+#ifndef PIXELREPACK_H
+#define PIXELREPACK_H
+
+#include <stdint.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+//---------------------------------------------------------------------------------------
+//   Repacking of the planar 4:2:0 and 4:2:2 YUV formats with 9..16 bits per component
+// (little endian) to the semi-planar 16-bit formats P010/P016, which the video sink
+// supports natively. The samples are only shifted to the most significant bits and the
+// chroma planes are interleaved; 4:2:2 chroma is averaged vertically. No scaling.
+
+// AV_PIX_FMT_NONE if the format can't be repacked
+AVPixelFormat getSemiPlanar16Format(AVPixelFormat format);
+
+bool repackToSemiPlanar16(const AVFrame *avFrame,
+                          uint8_t *const dstData[2], const int dstLinesize[2]);
+
+#endif // PIXELREPACK_H
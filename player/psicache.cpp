@@ -0,0 +1,334 @@
+#include "psicache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+#include "decoder.h"
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+//---------------------------------------------------------------------------------------
+PsiCache::PsiCache(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("PsiCache");
+}
+
+//---------------------------------------------------------------------------------------
+bool PsiCache::load(const QString &url)
+{
+    clear();
+
+    QString cachePath = getCachePath(url);
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString cachedUrl;
+    qint32 count = 0;
+    stream >> magic >> version >> cachedUrl >> count;
+    if (stream.status() != QDataStream::Ok || magic != CacheMagic || version != CacheVersion
+            || cachedUrl != url || count <= 0 || count > 8192)
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, QString("Cache entry '%1' is outdated.").arg(cachePath));
+        return false;
+    }
+
+    std::vector<Entry> loaded(size_t(count), Entry{});
+    for (Entry &entry : loaded)
+    {
+        qint32 pid, codecType, codecId, profile, level, format, width, height;
+        qint32 sarNum, sarDen, frameRateNum, frameRateDen, fieldOrder, sampleRate, channels, frameSize;
+        qint64 bitRate;
+        bool complete;
+        stream >> pid >> codecType >> codecId >> complete >> profile >> level >> format >> width >> height
+               >> sarNum >> sarDen >> frameRateNum >> frameRateDen >> fieldOrder
+               >> sampleRate >> channels >> frameSize >> bitRate >> entry.extradata;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        entry.pid = pid;
+        entry.codecType = codecType;
+        entry.codecId = codecId;
+        entry.complete = complete;
+        entry.profile = profile;
+        entry.level = level;
+        entry.format = format;
+        entry.width = width;
+        entry.height = height;
+        entry.sampleAspectRatio = AVRational{sarNum, sarDen};
+        entry.frameRate = AVRational{frameRateNum, frameRateDen};
+        entry.fieldOrder = fieldOrder;
+        entry.sampleRate = sampleRate;
+        entry.channels = channels;
+        entry.frameSize = frameSize;
+        entry.bitRate = bitRate;
+    }
+
+    this->url = url;
+    entries = std::move(loaded);
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Cache entry of '%1' loaded: %2 stream(s).").arg(url).arg(count));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void PsiCache::clear()
+{
+    url.clear();
+    entries.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool PsiCache::isLoaded() const
+{
+    return !entries.empty();
+}
+
+//---------------------------------------------------------------------------------------
+//   The streams are matched by PID: the same set of PIDs with the same codecs as when
+// the entry was saved.
+bool PsiCache::apply(AVFormatContext *input)
+{
+    if (entries.empty() || input->nb_streams != entries.size())
+        return false;
+
+    std::vector<const Entry*> matched(input->nb_streams, nullptr);
+    for (unsigned int i = 0; i < input->nb_streams; ++i)
+    {
+        const AVStream *stream = input->streams[i];
+        for (const Entry &entry : entries)
+        {
+            if (entry.pid == stream->id)
+            {
+                matched[i] = &entry;
+                break;
+            }
+        }
+        if (!matched[i] || matched[i]->codecType != stream->codecpar->codec_type
+                || matched[i]->codecId != stream->codecpar->codec_id)
+        {
+            loggable.logMessage(objectName(), QtDebugMsg,
+                                QString("PID %1 doesn't match the cache entry.").arg(stream->id));
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < input->nb_streams; ++i)
+    {
+        const Entry &entry = *matched[i];
+        if (!entry.complete)
+            continue;
+
+        AVStream *stream = input->streams[i];
+        AVCodecParameters *parameters = stream->codecpar;
+        parameters->profile = entry.profile;
+        parameters->level = entry.level;
+        parameters->format = entry.format;
+        if (entry.bitRate > 0)
+            parameters->bit_rate = entry.bitRate;
+
+        if (parameters->codec_type == AVMEDIA_TYPE_VIDEO)
+        {
+            parameters->width = entry.width;
+            parameters->height = entry.height;
+            parameters->sample_aspect_ratio = entry.sampleAspectRatio;
+            parameters->field_order = AVFieldOrder(entry.fieldOrder);
+            if (entry.frameRate.num > 0 && entry.frameRate.den > 0)
+            {
+                stream->avg_frame_rate = entry.frameRate;
+                stream->r_frame_rate = entry.frameRate;
+            }
+        }
+        else if (parameters->codec_type == AVMEDIA_TYPE_AUDIO)
+        {
+            parameters->sample_rate = entry.sampleRate;
+            parameters->frame_size = entry.frameSize;
+            if (parameters->ch_layout.nb_channels != entry.channels)
+            {
+                av_channel_layout_uninit(&parameters->ch_layout);
+                av_channel_layout_default(&parameters->ch_layout, entry.channels);
+            }
+        }
+
+        if (!parameters->extradata && !entry.extradata.isEmpty())
+        {
+            parameters->extradata = static_cast<uint8_t*>(av_mallocz(size_t(entry.extradata.size())
+                                                                     + AV_INPUT_BUFFER_PADDING_SIZE));
+            if (parameters->extradata)
+            {
+                memcpy(parameters->extradata, entry.extradata.constData(), size_t(entry.extradata.size()));
+                parameters->extradata_size = int(entry.extradata.size());
+            }
+        }
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Stream parameters of '%1' taken from the cache.").arg(url));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool PsiCache::save(const QString &url, const AVFormatContext *input)
+{
+    std::vector<Entry> saved;
+    for (unsigned int i = 0; i < input->nb_streams; ++i)
+    {
+        const AVStream *stream = input->streams[i];
+        const AVCodecParameters *parameters = stream->codecpar;
+
+        Entry entry;
+        entry.pid = stream->id;
+        entry.codecType = parameters->codec_type;
+        entry.codecId = parameters->codec_id;
+        entry.complete = isComplete(parameters);
+        entry.profile = parameters->profile;
+        entry.level = parameters->level;
+        entry.format = parameters->format;
+        entry.width = parameters->width;
+        entry.height = parameters->height;
+        entry.sampleAspectRatio = parameters->sample_aspect_ratio;
+        entry.frameRate = stream->avg_frame_rate;
+        entry.fieldOrder = parameters->field_order;
+        entry.sampleRate = parameters->sample_rate;
+        entry.channels = parameters->ch_layout.nb_channels;
+        entry.frameSize = parameters->frame_size;
+        entry.bitRate = parameters->bit_rate;
+        if (parameters->extradata && parameters->extradata_size > 0)
+            entry.extradata = QByteArray(reinterpret_cast<const char*>(parameters->extradata), parameters->extradata_size);
+        saved.push_back(entry);
+    }
+    if (saved.empty())
+        return false;
+
+    return write(url, std::move(saved));
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the complete entries are checked (the others aren't applied); the codec of the
+// stream may also report the format as unknown, it isn't compared then.
+bool PsiCache::validate(int pid, const DecodedFormat &format)
+{
+    auto it = std::find_if(entries.begin(), entries.end(), [pid](const Entry &entry){
+        return entry.pid == pid;
+    });
+    if (it == entries.end() || !it->complete || !format.valid)
+        return true;
+
+    Entry &entry = *it;
+    bool matches = format.format < 0 || entry.format == format.format;
+    if (entry.codecType == AVMEDIA_TYPE_VIDEO)
+        matches = matches && entry.width == format.width && entry.height == format.height;
+    else if (entry.codecType == AVMEDIA_TYPE_AUDIO)
+        matches = matches && entry.sampleRate == format.sampleRate && entry.channels == format.channels;
+    if (matches)
+        return true;
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("PID %1 decoded as %2x%3, format %4, %5 Hz, %6 channel(s); the cache entry is corrected.")
+                        .arg(pid).arg(format.width).arg(format.height).arg(format.format)
+                        .arg(format.sampleRate).arg(format.channels));
+
+    if (format.format >= 0)
+        entry.format = format.format;
+    if (entry.codecType == AVMEDIA_TYPE_VIDEO)
+    {
+        entry.width = format.width;
+        entry.height = format.height;
+    }
+    else if (entry.codecType == AVMEDIA_TYPE_AUDIO)
+    {
+        entry.sampleRate = format.sampleRate;
+        entry.channels = format.channels;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+bool PsiCache::refresh()
+{
+    if (entries.empty())
+        return false;
+
+    std::vector<Entry> saved = entries;
+    return write(url, std::move(saved));
+}
+
+//---------------------------------------------------------------------------------------
+bool PsiCache::write(const QString &url, std::vector<Entry> &&saved)
+{
+    QString cachePath = getCachePath(url);
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        loggable.logMessage(objectName(), QtWarningMsg, QString("Could not write '%1'.").arg(cachePath));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << quint32(CacheMagic) << quint32(CacheVersion) << url << qint32(saved.size());
+    for (const Entry &entry : saved)
+    {
+        stream << qint32(entry.pid) << qint32(entry.codecType) << qint32(entry.codecId) << entry.complete
+               << qint32(entry.profile) << qint32(entry.level) << qint32(entry.format)
+               << qint32(entry.width) << qint32(entry.height)
+               << qint32(entry.sampleAspectRatio.num) << qint32(entry.sampleAspectRatio.den)
+               << qint32(entry.frameRate.num) << qint32(entry.frameRate.den) << qint32(entry.fieldOrder)
+               << qint32(entry.sampleRate) << qint32(entry.channels) << qint32(entry.frameSize)
+               << qint64(entry.bitRate) << entry.extradata;
+    }
+
+    if (stream.status() != QDataStream::Ok || !file.commit())
+    {
+        loggable.logMessage(objectName(), QtWarningMsg, QString("Could not save the cache entry of '%1'.").arg(url));
+        return false;
+    }
+
+    this->url = url;
+    entries = std::move(saved);
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Cache entry of '%1' saved.").arg(url));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   What the decoders need to be opened before their first frame.
+bool PsiCache::isComplete(const AVCodecParameters *parameters)
+{
+    switch (parameters->codec_type)
+    {
+    case AVMEDIA_TYPE_VIDEO:
+        return parameters->width > 0 && parameters->height > 0 && parameters->format >= 0;
+    case AVMEDIA_TYPE_AUDIO:
+        return parameters->sample_rate > 0 && parameters->ch_layout.nb_channels > 0 && parameters->format >= 0;
+    default:
+        return true;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   Named by the hash of the URI (the group address and port for the multicast).
+QString PsiCache::getCachePath(const QString &url)
+{
+    QByteArray hash = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha1).toHex();
+    QDir cacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    return cacheDirectory.filePath(QString("psicache/%1.yaffpsi").arg(QString::fromLatin1(hash.constData())));
+}
+
+//---------------------------------------------------------------------------------------
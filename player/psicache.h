@@ -0,0 +1,93 @@
+#ifndef PSICACHE_H
+#define PSICACHE_H
+
+#include <QObject>
+
+#include <vector>
+
+#include "loggable.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct DecodedFormat;
+
+struct FastStartSettings
+{
+    bool enabled{false};
+    // limits of the probing when there is no valid cache entry
+    int probeSizeKilobytes{512};
+    int analyzeDurationMs{500};
+};
+
+//---------------------------------------------------------------------------------------
+//   Disk cache of the stream parameters of the MPEG-TS sources, one entry per URI.
+//   The MPEG-TS demuxer creates the streams from PAT/PMT while the input is opened,
+// but the parameters which aren't signalled there (the picture size and format,
+// the sample rate, the channels, ...) are found only by the decoding of the first
+// frames. The cache keeps them from the previous opening of the same source, so
+// the repeated opening doesn't need the probing at all. The entry is stale if the PMT
+// of the source doesn't match it any more (other PIDs or codecs), then the source is
+// probed again and the entry is replaced. The applied entry is also validated by the
+// first decoded frames (the PMT doesn't tell e.g. the new resolution): the mismatching
+// parameters are corrected, and the entry is written again after the start.
+class PsiCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PsiCache(QObject *parent = nullptr);
+
+    bool load(const QString &url);
+    void clear();
+    bool isLoaded() const;
+
+    // fills the parameters of the streams; false - the entry doesn't match the source
+    // (the context isn't changed then)
+    bool apply(AVFormatContext *input);
+    // the streams without the complete parameters are kept only for the matching
+    bool save(const QString &url, const AVFormatContext *input);
+    // compares the entry of the stream with the format of its first decoded frame and
+    // corrects it; false - it didn't match
+    bool validate(int pid, const DecodedFormat &format);
+    // writes the loaded entry again, after the validation has corrected it
+    bool refresh();
+
+private:
+    struct Entry
+    {
+        int pid{0};
+        int codecType{AVMEDIA_TYPE_UNKNOWN};
+        int codecId{AV_CODEC_ID_NONE};
+        bool complete{false};
+        int profile{FF_PROFILE_UNKNOWN};
+        int level{FF_LEVEL_UNKNOWN};
+        int format{-1};
+        int width{0};
+        int height{0};
+        AVRational sampleAspectRatio{0, 1};
+        AVRational frameRate{0, 0};
+        int fieldOrder{AV_FIELD_UNKNOWN};
+        int sampleRate{0};
+        int channels{0};
+        int frameSize{0};
+        int64_t bitRate{0};
+        QByteArray extradata;
+    };
+
+    bool write(const QString &url, std::vector<Entry> &&saved);
+    static bool isComplete(const AVCodecParameters *parameters);
+    static QString getCachePath(const QString &url);
+
+    enum {
+        CacheMagic = 0x59505349, // "YPSI"
+        CacheVersion = 1
+    };
+
+    QString url;
+    std::vector<Entry> entries;
+
+    Loggable loggable;
+};
+
+#endif // PSICACHE_H
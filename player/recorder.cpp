@@ -0,0 +1,389 @@
+#include "recorder.h"
+
+#include <cstring>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+//---------------------------------------------------------------------------------------
+Recorder::Recorder(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("Recorder");
+}
+
+//---------------------------------------------------------------------------------------
+Recorder::~Recorder()
+{
+    stop();
+}
+
+//---------------------------------------------------------------------------------------
+bool Recorder::start(const QString &path, const AVFormatContext *input, const std::vector<int> &streamIndexes)
+{
+    stop();
+
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Start recording to '%1'...").arg(path));
+
+    if (!openOutput(path, input, streamIndexes))
+    {
+        closeOutput();
+        return false;
+    }
+
+    // the key frame of the first video stream starts the recording
+    keyStreamIndex = -1;
+    keyFrameFound = false;
+    for (int index : streamIndexes)
+    {
+        if (input->streams[index]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        {
+            keyStreamIndex = index;
+            break;
+        }
+    }
+    keyFrameFound = keyStreamIndex == -1;
+
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        stopRequested = false;
+        queuedBytes = 0;
+        maxQueuedPackets = 0;
+    }
+    writtenPackets.store(0);
+    writtenBytes.store(0);
+    droppedPackets.store(0);
+    writeErrors.store(0);
+    startTime = av_gettime_relative();
+
+    writerThread = std::thread{&Recorder::writing, this};
+    recording.store(true);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   The queued packets are written before the file is closed.
+void Recorder::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        recording.store(false);
+        stopRequested = true;
+    }
+    queueChanged.notify_all();
+
+    if (!writerThread.joinable())
+        return;
+
+    writerThread.join();
+    closeOutput();
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Recording to '%1' stopped: %2 packet(s), %3 byte(s) written, %4 dropped.")
+                        .arg(outputPath)
+                        .arg(writtenPackets.load())
+                        .arg(writtenBytes.load())
+                        .arg(droppedPackets.load()));
+}
+
+//---------------------------------------------------------------------------------------
+bool Recorder::isRecording() const
+{
+    return recording.load();
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the reference to the packet data is queued.
+void Recorder::writePacket(const AVPacket *packet)
+{
+    if (!recording.load())
+        return;
+
+    std::unique_lock<std::mutex> locker(queueMutex);
+    if (!recording.load())
+        return;
+
+    auto it = streamMapping.find(packet->stream_index);
+    if (it == streamMapping.end())
+        return;
+
+    if (!keyFrameFound)
+    {
+        if (packet->stream_index != keyStreamIndex || !(packet->flags & AV_PKT_FLAG_KEY))
+            return;
+        keyFrameFound = true;
+    }
+
+    if (queue.size() >= MaxQueuedPackets || queuedBytes + packet->size > MaxQueuedBytes)
+    {
+        droppedPackets++;
+        return;
+    }
+
+    AVPacket *queuedPacket = av_packet_alloc();
+    if (!queuedPacket || av_packet_ref(queuedPacket, packet) < 0)
+    {
+        av_packet_free(&queuedPacket);
+        droppedPackets++;
+        return;
+    }
+    queuedPacket->stream_index = it->second;
+
+    queue.push_back(queuedPacket);
+    queuedBytes += queuedPacket->size;
+    maxQueuedPackets = std::max(maxQueuedPackets, queue.size());
+    locker.unlock();
+
+    queueChanged.notify_one();
+}
+
+//---------------------------------------------------------------------------------------
+RecorderStatistics Recorder::getStatistics() const
+{
+    RecorderStatistics stat;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        stat.recording = recording.load();
+        if (!stat.recording)
+            return stat;
+
+        stat.path = outputPath;
+        stat.streamCount = int(streamMapping.size());
+        stat.queuedPackets = queue.size();
+        stat.maxQueuedPackets = maxQueuedPackets;
+        stat.queuedBytes = queuedBytes;
+    }
+    stat.writtenPackets = writtenPackets.load();
+    stat.writtenBytes = writtenBytes.load();
+    stat.droppedPackets = droppedPackets.load();
+    stat.writeErrors = writeErrors.load();
+    stat.elapsedTimeUs = av_gettime_relative() - startTime;
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
+//   The output is written through the own IO context: the muxer fills the large buffer
+// and the file gets only the big blocks.
+//   For the whole multiplex the programs are kept (with their service names), and
+// the stream ids (PIDs for MPEG-TS) are the same as in the source.
+bool Recorder::openOutput(const QString &path, const AVFormatContext *input, const std::vector<int> &streamIndexes)
+{
+    outputPath = path;
+    streamMapping.clear();
+    inputTimeBases.clear();
+
+    QByteArray fileName = path.toUtf8();
+    const AVOutputFormat *format = av_guess_format(nullptr, fileName.data(), nullptr);
+    if (!format || format->flags & AVFMT_NOFILE)
+        format = av_guess_format("mpegts", nullptr, nullptr);
+
+    int result = avformat_alloc_output_context2(&outputFormatContext, format, nullptr, fileName.data());
+    if (result < 0 || !outputFormatContext)
+    {
+        loggable.logAvError(objectName(), QtCriticalMsg, "Could not allocate output context.", result);
+        return false;
+    }
+
+    for (int index : streamIndexes)
+    {
+        const AVStream *inputStream = input->streams[index];
+        if (avformat_query_codec(format, inputStream->codecpar->codec_id, FF_COMPLIANCE_NORMAL) == 0)
+        {
+            loggable.logMessage(objectName(), QtWarningMsg,
+                                QString("Stream %1 can't be stored in the %2 format, skipped.")
+                                .arg(inputStream->id).arg(format->name));
+            continue;
+        }
+
+        AVStream *outputStream = avformat_new_stream(outputFormatContext, nullptr);
+        if (!outputStream || avcodec_parameters_copy(outputStream->codecpar, inputStream->codecpar) < 0)
+        {
+            loggable.logMessage(objectName(), QtCriticalMsg, "Could not create output stream.");
+            return false;
+        }
+        outputStream->codecpar->codec_tag = 0;
+        outputStream->id = inputStream->id;
+        outputStream->time_base = inputStream->time_base;
+        outputStream->disposition = inputStream->disposition;
+        av_dict_copy(&outputStream->metadata, inputStream->metadata, 0);
+
+        streamMapping[index] = outputStream->index;
+        inputTimeBases.push_back(inputStream->time_base);
+    }
+
+    if (streamMapping.empty())
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg, "There are no streams for the recording.");
+        return false;
+    }
+
+    for (unsigned int i = 0; i < input->nb_programs; ++i)
+    {
+        const AVProgram *inputProgram = input->programs[i];
+        AVProgram *outputProgram = nullptr;
+        for (unsigned int j = 0; j < inputProgram->nb_stream_indexes; ++j)
+        {
+            auto it = streamMapping.find(int(inputProgram->stream_index[j]));
+            if (it == streamMapping.end())
+                continue;
+
+            if (!outputProgram)
+            {
+                outputProgram = av_new_program(outputFormatContext, inputProgram->id);
+                if (!outputProgram)
+                    break;
+                av_dict_copy(&outputProgram->metadata, inputProgram->metadata, 0);
+            }
+            av_program_add_stream_index(outputFormatContext, inputProgram->id, it->second);
+        }
+    }
+
+    // the players expect Matroska to start from zero, MPEG-TS keeps the source clock
+    if (strcmp(format->name, "mpegts") != 0)
+        outputFormatContext->avoid_negative_ts = AVFMT_AVOID_NEG_TS_MAKE_ZERO;
+    // the buffer is flushed only when it's full
+    outputFormatContext->flush_packets = 0;
+
+    outputFile.setFileName(path);
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg,
+                            QString("Could not open file '%1': %2").arg(path, outputFile.errorString()));
+        return false;
+    }
+
+    unsigned char *buffer = static_cast<unsigned char*>(av_malloc(WriteBufferSize));
+    outputIoContext = buffer ? avio_alloc_context(buffer, WriteBufferSize, 1, this, nullptr,
+                                                  &Recorder::writeCallback, &Recorder::seekCallback)
+                             : nullptr;
+    if (!outputIoContext)
+    {
+        av_free(buffer);
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate output IO context.");
+        return false;
+    }
+    outputFormatContext->pb = outputIoContext;
+
+    result = avformat_write_header(outputFormatContext, nullptr);
+    if (result < 0)
+    {
+        loggable.logAvError(objectName(), QtCriticalMsg, "Could not write the header of the recording.", result);
+        return false;
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Recording started: format %1, %2 stream(s), %3 program(s).")
+                        .arg(format->name)
+                        .arg(streamMapping.size())
+                        .arg(outputFormatContext->nb_programs));
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void Recorder::closeOutput()
+{
+    if (outputFormatContext)
+    {
+        outputFormatContext->pb = nullptr;
+        avformat_free_context(outputFormatContext);
+        outputFormatContext = nullptr;
+    }
+
+    if (outputIoContext)
+    {
+        av_freep(&outputIoContext->buffer);
+        avio_context_free(&outputIoContext);
+    }
+
+    if (outputFile.isOpen())
+        outputFile.close();
+
+    for (AVPacket *packet : queue)
+        av_packet_free(&packet);
+    queue.clear();
+    queuedBytes = 0;
+    streamMapping.clear();
+    inputTimeBases.clear();
+}
+
+//---------------------------------------------------------------------------------------
+//   Writer thread. The muxer takes the reference of the packet, so the packet is only
+// freed here; the trailer is written after the queue is drained.
+void Recorder::writing()
+{
+    while (true)
+    {
+        AVPacket *packet = nullptr;
+        {
+            std::unique_lock<std::mutex> locker(queueMutex);
+            queueChanged.wait(locker, [this](){return !queue.empty() || stopRequested;});
+            if (queue.empty())
+                break;
+
+            packet = queue.front();
+            queue.pop_front();
+            queuedBytes -= packet->size;
+        }
+
+        int size = packet->size;
+        av_packet_rescale_ts(packet, inputTimeBases[packet->stream_index],
+                             outputFormatContext->streams[packet->stream_index]->time_base);
+        packet->pos = -1;
+
+        int result = av_interleaved_write_frame(outputFormatContext, packet);
+        av_packet_free(&packet);
+
+        if (result < 0)
+        {
+            writeErrors++;
+            loggable.logAvError(objectName(), QtWarningMsg, "ERROR of packet writing.", result);
+            continue;
+        }
+        writtenPackets++;
+        writtenBytes += size;
+    }
+
+    int result = av_write_trailer(outputFormatContext);
+    if (result < 0)
+        loggable.logAvError(objectName(), QtWarningMsg, "Could not write the trailer of the recording.", result);
+    avio_flush(outputIoContext);
+}
+
+//---------------------------------------------------------------------------------------
+int Recorder::writeCallback(void *opaque, uint8_t *buf, int bufSize)
+{
+    Recorder *recorder = static_cast<Recorder*>(opaque);
+
+    qint64 written = recorder->outputFile.write(reinterpret_cast<const char*>(buf), bufSize);
+    return written == bufSize ? bufSize : AVERROR(EIO);
+}
+
+//---------------------------------------------------------------------------------------
+//   Used by the muxers which update the header at the end (e.g. the duration and
+// the cues of Matroska).
+int64_t Recorder::seekCallback(void *opaque, int64_t offset, int whence)
+{
+    Recorder *recorder = static_cast<Recorder*>(opaque);
+    QFile &file = recorder->outputFile;
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return file.size();
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += file.pos();
+        break;
+    case SEEK_END:
+        offset += file.size();
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    return file.seek(offset) ? offset : AVERROR(EIO);
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,109 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <QObject>
+
+#include <QFile>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "loggable.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+struct RecorderStatistics
+{
+    QString path;
+    bool recording{false};
+    int streamCount{0};
+    size_t queuedPackets{0};
+    size_t maxQueuedPackets{0};
+    int64_t queuedBytes{0};
+    int64_t writtenPackets{0};
+    int64_t writtenBytes{0};
+    int64_t droppedPackets{0};
+    int64_t writeErrors{0};
+    int64_t elapsedTimeUs{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Writes the packets read by the demuxer to the file without the transcoding
+// (MPEG-TS or Matroska, chosen by the extension of the file).
+//   The reading thread only references the packets (the data isn't copied) and puts
+// them into the bounded queue; the muxing and the file output are done by the own
+// writer thread through the large output buffer, so the recording never blocks the
+// reading and the decoding. If the writer can't keep up, the new packets are dropped
+// and counted.
+//   The recording starts from the first key frame of the video (if it's recorded), so
+// the file can be decoded from the beginning.
+class Recorder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Recorder(QObject *parent = nullptr);
+    virtual ~Recorder();
+
+    // the streams are given by their indexes in the input context
+    bool start(const QString &path, const AVFormatContext *input, const std::vector<int> &streamIndexes);
+    void stop();
+    bool isRecording() const;
+
+    // called by the reading thread for every read packet
+    void writePacket(const AVPacket *packet);
+
+    RecorderStatistics getStatistics() const;
+
+private:
+    bool openOutput(const QString &path, const AVFormatContext *input, const std::vector<int> &streamIndexes);
+    void closeOutput();
+    void writing();
+
+    static int writeCallback(void *opaque, uint8_t *buf, int bufSize);
+    static int64_t seekCallback(void *opaque, int64_t offset, int whence);
+
+    enum {
+        MaxQueuedPackets = 4000,
+        MaxQueuedBytes = 64 * 1024 * 1024,
+        WriteBufferSize = 1024 * 1024
+    };
+
+    QString outputPath;
+    QFile outputFile;
+    AVFormatContext *outputFormatContext{nullptr};
+    AVIOContext *outputIoContext{nullptr};
+
+    // key - input stream index, value - output stream index
+    std::unordered_map<int, int> streamMapping;
+    // time bases of the input streams, the index in the vector = output stream index
+    std::vector<AVRational> inputTimeBases;
+    int keyStreamIndex{-1};
+    bool keyFrameFound{false};
+
+    std::atomic_bool recording{false};
+    bool stopRequested{false};
+    mutable std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<AVPacket*> queue;
+    int64_t queuedBytes{0};
+    size_t maxQueuedPackets{0};
+    std::thread writerThread;
+
+    std::atomic<int64_t> writtenPackets{0};
+    std::atomic<int64_t> writtenBytes{0};
+    std::atomic<int64_t> droppedPackets{0};
+    std::atomic<int64_t> writeErrors{0};
+    int64_t startTime{0};
+
+    Loggable loggable;
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,689 @@
+#include "rtpinput.h"
+
+#include <QUrlQuery>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+}
+
+static const int TsPacketSize = 188;
+
+//---------------------------------------------------------------------------------------
+static uint16_t readUint16(const uint8_t *data)
+{
+    return uint16_t((data[0] << 8) | data[1]);
+}
+
+//---------------------------------------------------------------------------------------
+static uint32_t readUint32(const uint8_t *data)
+{
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+//---------------------------------------------------------------------------------------
+//   The size of the CSRC list and of the header extension (after the fixed header),
+// -1 if the packet is too short.
+static int getHeaderExtraSize(const uint8_t *packet, int size)
+{
+    int extraSize = (packet[0] & 0x0F) * 4;
+    if (packet[0] & 0x10)
+    {
+        int extensionStart = 12 + extraSize;
+        if (size < extensionStart + 4)
+            return -1;
+        extraSize += 4 + readUint16(packet + extensionStart + 2) * 4;
+    }
+    return 12 + extraSize <= size ? extraSize : -1;
+}
+
+//---------------------------------------------------------------------------------------
+RtpInput::RtpInput(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("RTP Input");
+}
+
+//---------------------------------------------------------------------------------------
+RtpInput::~RtpInput()
+{
+    close();
+}
+
+//---------------------------------------------------------------------------------------
+bool RtpInput::isSupported(const QString &url)
+{
+    return url.startsWith("rtp://", Qt::CaseInsensitive);
+}
+
+//---------------------------------------------------------------------------------------
+bool RtpInput::open(const QString &url, std::function<bool()> interruptFunction)
+{
+    close();
+
+    interrupt = interruptFunction;
+
+    // the host part is kept as it is (the leading '@' binds the socket to any interface)
+    QString location = url.mid(QString("rtp://").size());
+    int queryStart = location.indexOf('?');
+    QString authority = queryStart < 0 ? location : location.left(queryStart);
+    QUrlQuery query(queryStart < 0 ? QString() : location.mid(queryStart + 1));
+
+    reorderWindow = query.hasQueryItem("reorder_window")
+            ? std::clamp(query.queryItemValue("reorder_window").toInt(), 1, int(MaxReorderWindow))
+            : int(DefaultReorderWindow);
+    fecEnabled = query.queryItemValue("fec") == "1";
+    query.removeAllQueryItems("reorder_window");
+    query.removeAllQueryItems("fec");
+
+    // the FEC streams are received on the port + 2 and the port + 4
+    int portSeparator = authority.lastIndexOf(':');
+    bool ok = false;
+    int port = portSeparator < 0 ? 0 : authority.mid(portSeparator + 1).toInt(&ok);
+    if (!ok || port <= 0 || port > 65535 - (fecEnabled ? 4 : 0))
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg, QString("Invalid port of the RTP source: %1").arg(url));
+        return false;
+    }
+    QString host = authority.left(portSeparator);
+
+    auto channelUrl = [&](int channelPort){
+        QString channelUrl = QString("udp://%1:%2").arg(host).arg(channelPort);
+        if (!query.isEmpty())
+            channelUrl += "?" + query.toString();
+        return channelUrl;
+    };
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Open RTP input: reorder window %1 packet(s), FEC %2.")
+                        .arg(reorderWindow)
+                        .arg(fecEnabled ? "enabled" : "disabled"));
+
+    stopRequested.store(false);
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        inputEnded = false;
+        history.assign(HistorySize, Slot{});
+        nextSequence = -1;
+        highestSequence = -1;
+        gapSinceUs = -1;
+        fecPackets.clear();
+        jumpPackets.clear();
+        output.clear();
+        outputOffset = 0;
+        statistics = RtpInputStatistics{};
+        statistics.active = true;
+        statistics.fec = fecEnabled;
+        statistics.reorderWindow = reorderWindow;
+        statistics.holdWindow = reorderWindow;
+    }
+
+    if (!openChannel(MediaChannel, channelUrl(port)))
+    {
+        close();
+        return false;
+    }
+    // the stream is still played without the FEC which can't be received
+    if (fecEnabled)
+    {
+        openChannel(ColumnFecChannel, channelUrl(port + 2));
+        openChannel(RowFecChannel, channelUrl(port + 4));
+    }
+
+    unsigned char *buffer = static_cast<unsigned char*>(av_malloc(ReadBufferSize));
+    ioContext = buffer ? avio_alloc_context(buffer, ReadBufferSize, 0, this, &RtpInput::readCallback, nullptr, nullptr)
+                       : nullptr;
+    if (!ioContext)
+    {
+        av_free(buffer);
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate IO context.");
+        close();
+        return false;
+    }
+
+    for (int channel = 0; channel < ChannelCount; channel++)
+    {
+        if (inputIoContexts[channel])
+            receiverThreads[channel] = std::thread{&RtpInput::receiving, this, channel};
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool RtpInput::openChannel(int channel, const QString &url)
+{
+    AVIOInterruptCB interruptCallback{&RtpInput::receiverInterruptCallback, this};
+    int result = avio_open2(&inputIoContexts[channel], url.toUtf8().data(), AVIO_FLAG_READ, &interruptCallback, nullptr);
+    if (result < 0)
+    {
+        loggable.logAvError(objectName(), channel == MediaChannel ? QtCriticalMsg : QtWarningMsg,
+                            QString("Could not open %1: %2")
+                            .arg(channel == MediaChannel ? "source" : "FEC stream", url), result);
+        inputIoContexts[channel] = nullptr;
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void RtpInput::stop()
+{
+    stopRequested.store(true);
+    dataAvailable.notify_all();
+
+    for (std::thread &thread : receiverThreads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The demuxer (and the other readers) of the IO context must be closed before.
+void RtpInput::close()
+{
+    stop();
+
+    for (AVIOContext *&input : inputIoContexts)
+    {
+        if (input)
+            avio_closep(&input);
+    }
+
+    if (ioContext)
+    {
+        av_freep(&ioContext->buffer);
+        avio_context_free(&ioContext);
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    history.clear();
+    fecPackets.clear();
+    jumpPackets.clear();
+    output.clear();
+    outputOffset = 0;
+    statistics.active = false;
+}
+
+//---------------------------------------------------------------------------------------
+bool RtpInput::isOpen() const
+{
+    return ioContext != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+AVIOContext *RtpInput::getIoContext() const
+{
+    return ioContext;
+}
+
+//---------------------------------------------------------------------------------------
+RtpInputStatistics RtpInput::getStatistics() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return statistics;
+}
+
+//---------------------------------------------------------------------------------------
+//   Receiving thread of one socket (one datagram per read).
+void RtpInput::receiving(int channel)
+{
+    AVIOContext *input = inputIoContexts[channel];
+    std::vector<uint8_t> buffer(ReceiveBufferSize);
+
+    while (!stopRequested.load())
+    {
+        int result = avio_read_partial(input, buffer.data(), ReceiveBufferSize);
+        if (result == AVERROR(EAGAIN) || (result == 0 && !avio_feof(input)))
+            continue;
+        if (result <= 0)
+        {
+            if (!stopRequested.load())
+                loggable.logAvError(objectName(), QtWarningMsg,
+                                    channel == MediaChannel ? "Receiving of the source stopped."
+                                                            : "Receiving of the FEC stream stopped.", result);
+            break;
+        }
+
+        std::unique_lock<std::mutex> locker(mutex);
+        if (channel == MediaChannel)
+            addMediaPacket(buffer.data(), result, av_gettime_relative());
+        else
+            addFecPacket(channel, buffer.data(), result);
+        locker.unlock();
+
+        dataAvailable.notify_all();
+    }
+
+    if (channel == MediaChannel)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        inputEnded = true;
+        dataAvailable.notify_all();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+void RtpInput::addMediaPacket(const uint8_t *packet, int size, int64_t nowUs)
+{
+    if (size >= TsPacketSize && packet[0] == 0x47 && size % TsPacketSize == 0)
+    {
+        statistics.rawDatagrams++;
+        Slot raw;
+        raw.data.assign(packet, packet + size);
+        outputPacket(raw);
+        return;
+    }
+
+    int extraSize = size >= RtpHeaderSize && (packet[0] >> 6) == 2 ? getHeaderExtraSize(packet, size) : -1;
+    if (extraSize < 0)
+        return;
+
+    int paddingSize = (packet[0] & 0x20) ? packet[size - 1] : 0;
+    if (RtpHeaderSize + extraSize + paddingSize > size)
+        return;
+
+    statistics.packets++;
+    int64_t sequence = extendSequence(readUint16(packet + 2));
+    if (nextSequence < 0)
+    {
+        restart(sequence);
+    }
+    else if (sequence - nextSequence > MaxSequenceJump || nextSequence - sequence > MaxSequenceJump)
+    {
+        // a single stray packet (the old one, or from another sender) is only late; the
+        // jump is taken when the following packets continue the new sequence
+        bool continues = !jumpPackets.empty() && sequence > lastJumpSequence
+                         && sequence - lastJumpSequence <= MaxReorderWindow;
+        if (!continues)
+        {
+            jumpPackets.clear();
+            jumpFirstSequence = sequence;
+        }
+        lastJumpSequence = sequence;
+        if (int(jumpPackets.size()) + 1 < JumpConfirmations)
+        {
+            jumpPackets.emplace_back(packet, packet + size);
+            statistics.latePackets++;
+            return;
+        }
+
+        // the sender was restarted (or the packets were lost for too long): the held
+        // packets are given out as they are
+        statistics.discontinuities++;
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Discontinuity of the RTP sequence: %1 -> %2.")
+                            .arg(nextSequence & 0xFFFF)
+                            .arg(jumpFirstSequence & 0xFFFF));
+        for (; nextSequence <= highestSequence; nextSequence++)
+        {
+            if (isPresent(nextSequence))
+                outputPacket(slotOf(nextSequence));
+        }
+        restart(jumpFirstSequence);
+
+        // the packets which confirmed the jump are taken again in the new sequence
+        std::vector<std::vector<uint8_t>> confirmingPackets;
+        confirmingPackets.swap(jumpPackets);
+        statistics.packets -= int64_t(confirmingPackets.size());
+        statistics.latePackets -= int64_t(confirmingPackets.size());
+        for (const std::vector<uint8_t> &confirming : confirmingPackets)
+            addMediaPacket(confirming.data(), int(confirming.size()), nowUs);
+        sequence = extendSequence(readUint16(packet + 2));
+    }
+    else
+    {
+        jumpPackets.clear();
+    }
+
+    if (sequence < nextSequence)
+    {
+        if (isPresent(sequence))
+            statistics.duplicatePackets++;
+        else
+            statistics.latePackets++;
+        return;
+    }
+    if (isPresent(sequence))
+    {
+        statistics.duplicatePackets++;
+        return;
+    }
+    if (sequence < highestSequence)
+        statistics.reorderedPackets++;
+
+    Slot &slot = slotOf(sequence);
+    slot.sequence = sequence;
+    slot.present = true;
+    slot.payloadType = packet[1] & 0x7F;
+    slot.timestamp = readUint32(packet + 4);
+    slot.data.assign(packet + RtpHeaderSize, packet + size);
+    slot.payloadOffset = extraSize;
+    slot.paddingSize = paddingSize;
+    highestSequence = std::max(highestSequence, sequence);
+
+    if (fecEnabled && !isPresent(nextSequence))
+        recoverPackets();
+    releasePackets(nowUs);
+}
+
+//---------------------------------------------------------------------------------------
+//   The FEC header of SMPTE 2022-1 (after the RTP header): SNBase low bits, length
+// recovery, E and PT recovery, mask, TS recovery, N, D, type and index, offset, NA,
+// SNBase extension bits. Must be called with the locked mutex.
+void RtpInput::addFecPacket(int channel, const uint8_t *packet, int size)
+{
+    int extraSize = size >= RtpHeaderSize && (packet[0] >> 6) == 2 ? getHeaderExtraSize(packet, size) : -1;
+    if (extraSize < 0 || RtpHeaderSize + extraSize + FecHeaderSize > size)
+        return;
+
+    const uint8_t *header = packet + RtpHeaderSize + extraSize;
+    FecPacket fec;
+    fec.lengthRecovery = readUint16(header + 2);
+    fec.payloadTypeRecovery = header[4] & 0x7F;
+    fec.timestampRecovery = readUint32(header + 8);
+    fec.offset = header[13];
+    fec.count = header[14];
+    if (fec.offset <= 0 || fec.count <= 0)
+        return;
+
+    // column: offset = L, NA = D; row: offset = 1, NA = L
+    int columns = channel == ColumnFecChannel ? fec.offset : fec.count;
+    int rows = channel == ColumnFecChannel ? fec.count : statistics.rows;
+    if (channel == ColumnFecChannel)
+        statistics.columnFecPackets++;
+    else
+        statistics.rowFecPackets++;
+    if (columns != statistics.columns || rows != statistics.rows)
+    {
+        statistics.columns = columns;
+        statistics.rows = rows;
+        statistics.holdWindow = getHoldWindow();
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("FEC matrix: %1 column(s), %2 row(s), packets are held for %3.")
+                            .arg(columns)
+                            .arg(rows)
+                            .arg(statistics.holdWindow));
+    }
+
+    if (nextSequence < 0)
+        return;
+
+    fec.base = extendSequence(readUint16(header));
+    if (fec.base + int64_t(fec.count - 1) * fec.offset < nextSequence)
+        return;
+    fec.data.assign(header + FecHeaderSize, packet + size);
+    fecPackets.push_back(std::move(fec));
+    if (fecPackets.size() > MaxFecPackets)
+        fecPackets.pop_front();
+
+    if (recoverPackets())
+        releasePackets(av_gettime_relative());
+}
+
+//---------------------------------------------------------------------------------------
+//   The 16 bit sequence number extended by the one expected next (the first one is
+// moved up, so the extended numbers are never negative).
+int64_t RtpInput::extendSequence(uint16_t sequence) const
+{
+    if (nextSequence < 0)
+        return int64_t(sequence) + 0x10000;
+    return nextSequence + int16_t(uint16_t(sequence - uint16_t(nextSequence)));
+}
+
+//---------------------------------------------------------------------------------------
+RtpInput::Slot &RtpInput::slotOf(int64_t sequence)
+{
+    return history[size_t(sequence % HistorySize)];
+}
+
+//---------------------------------------------------------------------------------------
+bool RtpInput::isPresent(int64_t sequence)
+{
+    const Slot &slot = slotOf(sequence);
+    return slot.sequence == sequence && slot.present;
+}
+
+//---------------------------------------------------------------------------------------
+//   Repeated while any packet is recovered, as the recovered packet may complete
+// the other column or row. The FEC packets which can't help any more are dropped.
+bool RtpInput::recoverPackets()
+{
+    bool recovered = false;
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (auto it = fecPackets.begin(); it != fecPackets.end();)
+        {
+            int64_t last = it->base + int64_t(it->count - 1) * it->offset;
+            if (last < nextSequence || it->base <= highestSequence - HistorySize)
+            {
+                it = fecPackets.erase(it);
+                continue;
+            }
+
+            int missingCount = 0;
+            int64_t missing = -1;
+            for (int i = 0; i < it->count && missingCount < 2; i++)
+            {
+                int64_t sequence = it->base + int64_t(i) * it->offset;
+                if (!isPresent(sequence))
+                {
+                    missingCount++;
+                    missing = sequence;
+                }
+            }
+
+            if (missingCount == 0)
+            {
+                it = fecPackets.erase(it);
+                continue;
+            }
+            // the packet which wasn't received yet is waited for
+            if (missingCount == 1 && missing >= nextSequence && missing <= highestSequence && recoverPacket(*it, missing))
+            {
+                recovered = true;
+                progress = true;
+                it = fecPackets.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+    return recovered;
+}
+
+//---------------------------------------------------------------------------------------
+//   The missing packet is the XOR of the FEC packet and of the other protected ones
+// (the shorter packets are padded by zeros). The recovered packet has no CSRCs, header
+// extension or padding, as the 2022-1 streams don't use them.
+bool RtpInput::recoverPacket(const FecPacket &fec, int64_t missing)
+{
+    uint16_t length = fec.lengthRecovery;
+    uint8_t payloadType = fec.payloadTypeRecovery;
+    uint32_t timestamp = fec.timestampRecovery;
+    std::vector<uint8_t> data(fec.data);
+
+    for (int i = 0; i < fec.count; i++)
+    {
+        int64_t sequence = fec.base + int64_t(i) * fec.offset;
+        if (sequence == missing)
+            continue;
+
+        const Slot &slot = slotOf(sequence);
+        length ^= uint16_t(slot.data.size());
+        payloadType ^= slot.payloadType;
+        timestamp ^= slot.timestamp;
+        size_t size = std::min(slot.data.size(), data.size());
+        for (size_t j = 0; j < size; j++)
+            data[j] ^= slot.data[j];
+    }
+
+    if (length == 0 || length > data.size())
+    {
+        loggable.logMessage(objectName(), QtWarningMsg,
+                            QString("FEC doesn't match the packets, sequence %1 isn't recovered.").arg(missing & 0xFFFF));
+        return false;
+    }
+    data.resize(length);
+
+    Slot &slot = slotOf(missing);
+    slot.sequence = missing;
+    slot.present = true;
+    slot.payloadType = payloadType & 0x7F;
+    slot.timestamp = timestamp;
+    slot.data = std::move(data);
+    slot.payloadOffset = 0;
+    slot.paddingSize = 0;
+    statistics.recoveredPackets++;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   The missing packet is given up when the window of the later packets is received,
+// or when the stream is held by it for too long (the later missing packets are given
+// up at once then). Must be called with the locked mutex.
+void RtpInput::releasePackets(int64_t nowUs)
+{
+    while (nextSequence >= 0 && nextSequence <= highestSequence)
+    {
+        if (isPresent(nextSequence))
+        {
+            outputPacket(slotOf(nextSequence));
+            nextSequence++;
+            gapSinceUs = -1;
+            continue;
+        }
+
+        if (gapSinceUs < 0)
+            gapSinceUs = nowUs;
+        bool windowPassed = highestSequence - nextSequence >= getHoldWindow();
+        bool holdExpired = nowUs - gapSinceUs >= int64_t(MaxHoldMs) * 1000;
+        if (!windowPassed && !holdExpired)
+            break;
+
+        if (fecEnabled && recoverPackets())
+            continue;
+
+        statistics.lostPackets++;
+        nextSequence++;
+    }
+
+    statistics.heldPackets = nextSequence >= 0 ? int(highestSequence - nextSequence + 1) : 0;
+    statistics.maxHeldPackets = std::max(statistics.maxHeldPackets, statistics.heldPackets);
+}
+
+//---------------------------------------------------------------------------------------
+//   At the end of the input the remaining gaps are given up at once (after the last
+// try of the FEC); false if nothing more is to be read. Must be called with the
+// locked mutex.
+bool RtpInput::releaseAllPackets()
+{
+    while (nextSequence >= 0 && nextSequence <= highestSequence)
+    {
+        if (isPresent(nextSequence) || (fecEnabled && recoverPackets() && isPresent(nextSequence)))
+            outputPacket(slotOf(nextSequence));
+        else
+            statistics.lostPackets++;
+        nextSequence++;
+    }
+    gapSinceUs = -1;
+    statistics.heldPackets = 0;
+    return outputOffset < output.size();
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+void RtpInput::outputPacket(const Slot &slot)
+{
+    int size = int(slot.data.size()) - slot.payloadOffset - slot.paddingSize;
+    if (size <= 0)
+        return;
+
+    if (output.size() - outputOffset + size > size_t(MaxOutputBytes))
+    {
+        statistics.overruns++;
+        return;
+    }
+    if (outputOffset > 0 && output.size() + size > size_t(MaxOutputBytes))
+    {
+        output.erase(output.begin(), output.begin() + outputOffset);
+        outputOffset = 0;
+    }
+
+    const uint8_t *payload = slot.data.data() + slot.payloadOffset;
+    output.insert(output.end(), payload, payload + size);
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+void RtpInput::restart(int64_t sequence)
+{
+    for (Slot &slot : history)
+    {
+        slot.sequence = -1;
+        slot.present = false;
+    }
+    fecPackets.clear();
+    nextSequence = sequence;
+    highestSequence = sequence - 1;
+    gapSinceUs = -1;
+}
+
+//---------------------------------------------------------------------------------------
+//   The column FEC of the matrix is sent while the next matrix is sent.
+int RtpInput::getHoldWindow() const
+{
+    if (!fecEnabled || statistics.columns <= 0 || statistics.rows <= 0)
+        return reorderWindow;
+    return std::max(reorderWindow, std::min(2 * statistics.columns * statistics.rows, int(MaxSequenceJump)));
+}
+
+//---------------------------------------------------------------------------------------
+//   Waits for the released packets; the missing packets are given up by the time while
+// nothing arrives.
+int RtpInput::readCallback(void *opaque, uint8_t *buf, int bufSize)
+{
+    RtpInput *input = static_cast<RtpInput*>(opaque);
+
+    std::unique_lock<std::mutex> locker(input->mutex);
+    while (input->outputOffset >= input->output.size())
+    {
+        // the packets held behind the gaps are given out before the end
+        if (input->inputEnded && !input->stopRequested.load() && input->releaseAllPackets())
+            continue;
+        if (input->inputEnded || input->stopRequested.load())
+            return AVERROR_EOF;
+
+        input->dataAvailable.wait_for(locker, std::chrono::milliseconds(ReadWaitTimeoutMs));
+        input->releasePackets(av_gettime_relative());
+        if (input->interrupt && input->interrupt())
+            return AVERROR_EXIT;
+    }
+
+    int size = int(std::min<size_t>(bufSize, input->output.size() - input->outputOffset));
+    memcpy(buf, input->output.data() + input->outputOffset, size);
+    input->outputOffset += size;
+    if (input->outputOffset >= input->output.size())
+    {
+        input->output.clear();
+        input->outputOffset = 0;
+    }
+
+    return size;
+}
+
+//---------------------------------------------------------------------------------------
+int RtpInput::receiverInterruptCallback(void *opaque)
+{
+    RtpInput *input = static_cast<RtpInput*>(opaque);
+    return input->stopRequested.load();
+}
+
+//---------------------------------------------------------------------------------------
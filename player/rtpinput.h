@@ -0,0 +1,191 @@
+#ifndef RTPINPUT_H
+#define RTPINPUT_H
+
+#include <QObject>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "loggable.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct RtpInputStatistics
+{
+    bool active{false};
+    bool fec{false};
+    // the FEC matrix (L columns, D rows) of the last FEC packet
+    int columns{0};
+    int rows{0};
+    int reorderWindow{0};
+    // the reorder window extended to the FEC matrix
+    int holdWindow{0};
+
+    int64_t packets{0};
+    // the raw TS datagrams (without the RTP header) are passed through
+    int64_t rawDatagrams{0};
+    int64_t reorderedPackets{0};
+    int64_t duplicatePackets{0};
+    // arrived after the sequence number was given up
+    int64_t latePackets{0};
+    int64_t recoveredPackets{0};
+    // not received and not recovered
+    int64_t lostPackets{0};
+    int64_t columnFecPackets{0};
+    int64_t rowFecPackets{0};
+    int64_t discontinuities{0};
+    int64_t overruns{0};
+    // the packets held by the reordering
+    int heldPackets{0};
+    int maxHeldPackets{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   MPEG-TS over RTP (RFC 2250, SMPTE 2022-2) received by the own threads.
+//   The URL is rtp://[@]address:port?options: the options of FFmpeg's UDP protocol are
+// passed to the sockets, reorder_window (packets) and fec (0/1) are of the input. The
+// media packets are put in the order of their sequence numbers; the missing packet is
+// waited for until the window of the later packets is received (or the hold time is
+// over) and then given up.
+//   With the FEC, the column and the row FEC streams of SMPTE 2022-1 are received on
+// the port + 2 and the port + 4. The packet which is the only missing one of its
+// column or row is recovered from the XOR of the others; the recovery of a row may
+// allow the recovery of the column and vice versa. The window is extended to the FEC
+// matrix, as the column FEC is sent after the whole matrix.
+//   The clean transport stream is read by the demuxer through the custom AVIOContext.
+// The datagrams which aren't RTP (raw TS over UDP) are passed through.
+class RtpInput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RtpInput(QObject *parent = nullptr);
+    virtual ~RtpInput();
+
+    static bool isSupported(const QString &url);
+
+    // the interrupt function is checked while the reading waits for the data
+    bool open(const QString &url, std::function<bool()> interrupt);
+    // the reading of the IO context gets the end of the stream (the context stays
+    // valid until the closing, so its other readers can be stopped before)
+    void stop();
+    void close();
+    bool isOpen() const;
+
+    AVIOContext *getIoContext() const;
+    RtpInputStatistics getStatistics() const;
+
+private:
+    enum Channel {
+        MediaChannel,
+        ColumnFecChannel,
+        RowFecChannel,
+        ChannelCount
+    };
+
+    struct Slot
+    {
+        int64_t sequence{-1};
+        bool present{false};
+        uint8_t payloadType{0};
+        uint32_t timestamp{0};
+        // everything after the fixed RTP header (protected by the FEC): the CSRCs and
+        // the header extension, the payload and the padding
+        std::vector<uint8_t> data;
+        int payloadOffset{0};
+        int paddingSize{0};
+    };
+
+    struct FecPacket
+    {
+        int64_t base{0};
+        int offset{0};
+        int count{0};
+        uint16_t lengthRecovery{0};
+        uint8_t payloadTypeRecovery{0};
+        uint32_t timestampRecovery{0};
+        std::vector<uint8_t> data;
+    };
+
+    enum {
+        // the media packets kept for the FEC (larger than the biggest 2022-1 matrix
+        // with its delay)
+        HistorySize = 1024,
+        MaxReorderWindow = 512,
+        DefaultReorderWindow = 32,
+        // the missing packet isn't waited for longer (the low bitrates)
+        MaxHoldMs = 500,
+        ReceiveBufferSize = 65536,
+        ReadBufferSize = 64 * 1024,
+        ReadWaitTimeoutMs = 100,
+        MaxOutputBytes = 16 * 1024 * 1024,
+        // the bigger jumps of the sequence numbers restart the reordering, when as many
+        // packets continue the new sequence (the stray ones are late)
+        MaxSequenceJump = HistorySize / 2,
+        JumpConfirmations = 4,
+        MaxFecPackets = 256,
+        FecHeaderSize = 16,
+        RtpHeaderSize = 12
+    };
+
+    bool openChannel(int channel, const QString &url);
+    void receiving(int channel);
+
+    void addMediaPacket(const uint8_t *packet, int size, int64_t nowUs);
+    void addFecPacket(int channel, const uint8_t *packet, int size);
+    int64_t extendSequence(uint16_t sequence) const;
+    Slot &slotOf(int64_t sequence);
+    bool isPresent(int64_t sequence);
+    bool recoverPackets();
+    bool recoverPacket(const FecPacket &fec, int64_t missing);
+    void releasePackets(int64_t nowUs);
+    bool releaseAllPackets();
+    void outputPacket(const Slot &slot);
+    void restart(int64_t sequence);
+    int getHoldWindow() const;
+
+    static int readCallback(void *opaque, uint8_t *buf, int bufSize);
+    static int receiverInterruptCallback(void *opaque);
+
+    std::function<bool()> interrupt;
+    int reorderWindow{DefaultReorderWindow};
+    bool fecEnabled{false};
+
+    std::array<AVIOContext*, ChannelCount> inputIoContexts{};
+    std::array<std::thread, ChannelCount> receiverThreads;
+    AVIOContext *ioContext{nullptr};
+    std::atomic_bool stopRequested{false};
+
+    mutable std::mutex mutex;
+    std::condition_variable dataAvailable;
+    bool inputEnded{false};
+
+    // the media packets by the sequence number (modulo the size), the next sequence
+    // number to output (extended to 64 bits) and the highest one received
+    std::vector<Slot> history;
+    int64_t nextSequence{-1};
+    int64_t highestSequence{-1};
+    int64_t gapSinceUs{-1};
+    std::deque<FecPacket> fecPackets;
+    // the packets after the jump of the sequence, until it's confirmed
+    std::vector<std::vector<uint8_t>> jumpPackets;
+    int64_t jumpFirstSequence{-1};
+    int64_t lastJumpSequence{-1};
+
+    // the clean stream read by the demuxer
+    std::vector<uint8_t> output;
+    size_t outputOffset{0};
+
+    RtpInputStatistics statistics;
+
+    Loggable loggable;
+};
+
+#endif // RTPINPUT_H
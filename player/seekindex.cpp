@@ -0,0 +1,453 @@
+#include "seekindex.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+// PTS is 33 bits of the 90 kHz clock
+static const int64_t PtsPeriod = int64_t(1) << 33;
+static const int64_t PtsClockRate = 90000;
+
+//---------------------------------------------------------------------------------------
+SeekIndex::SeekIndex(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("SeekIndex");
+}
+
+//---------------------------------------------------------------------------------------
+SeekIndex::~SeekIndex()
+{
+    close();
+}
+
+//---------------------------------------------------------------------------------------
+bool SeekIndex::open(const QString &path, const AVFormatContext *input, int videoStreamIndex)
+{
+    close();
+
+    this->path = path;
+    this->videoStreamIndex = videoStreamIndex;
+    inputFormatContext = input;
+
+    if (!input->pb || !(input->pb->seekable & AVIO_SEEKABLE_NORMAL))
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "Source isn't seekable.");
+        return false;
+    }
+
+    // the demuxers of the indexed formats seek by the key frames themselves, MPEG-TS
+    // without video is seeked by the timestamps (the audio frames are all key frames)
+    if (strcmp(input->iformat->name, "mpegts") != 0 || videoStreamIndex < 0)
+    {
+        method.store(Native);
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Native seeking of the %1 format.").arg(input->iformat->name));
+        return true;
+    }
+
+    const AVStream *stream = input->streams[videoStreamIndex];
+    pid = stream->id;
+    codecId = stream->codecpar->codec_id;
+
+    QFileInfo info(path);
+    fileSize = info.size();
+    lastModified = info.lastModified().toMSecsSinceEpoch();
+    method.store(Scanned);
+
+    if (loadSidecar())
+    {
+        fromSidecar = true;
+        scannedBytes.store(fileSize);
+        complete.store(true);
+        return true;
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Start scanning of '%1' (%2 bytes, PID %3)...").arg(path).arg(fileSize).arg(pid));
+    stopRequested.store(false);
+    scanThread = std::thread{&SeekIndex::scanning, this};
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void SeekIndex::close()
+{
+    stopRequested.store(true);
+    if (scanThread.joinable())
+        scanThread.join();
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        entries.clear();
+    }
+    method.store(None);
+    inputFormatContext = nullptr;
+    videoStreamIndex = -1;
+    pid = -1;
+    fromSidecar = false;
+    complete.store(false);
+    scannedBytes.store(0);
+    scanTimeUs.store(0);
+}
+
+//---------------------------------------------------------------------------------------
+int SeekIndex::getMethod() const
+{
+    return method.load();
+}
+
+//---------------------------------------------------------------------------------------
+//   Until the scan is complete the time after the last indexed key frame may lie
+// anywhere in the rest of the file, so it isn't resolved by the index.
+int64_t SeekIndex::findPosition(int64_t timeUs) const
+{
+    if (method.load() != Scanned)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if (entries.empty())
+        return -1;
+
+    if (timeUs < entries.front().timeUs)
+        return 0;
+
+    if (timeUs > entries.back().timeUs && !complete.load())
+        return -1;
+
+    auto it = std::upper_bound(entries.begin(), entries.end(), timeUs, [](int64_t time, const Entry &entry){
+        return time < entry.timeUs;
+    });
+    return std::prev(it)->position;
+}
+
+//---------------------------------------------------------------------------------------
+SeekIndexStatistics SeekIndex::getStatistics() const
+{
+    SeekIndexStatistics stat;
+    switch (method.load())
+    {
+    case Native:
+        stat.method = "native";
+        stat.complete = true;
+        if (inputFormatContext && videoStreamIndex >= 0)
+            stat.keyFrames = size_t(avformat_index_get_entries_count(inputFormatContext->streams[videoStreamIndex]));
+        return stat;
+    case Scanned:
+        stat.method = "scanned";
+        break;
+    default:
+        stat.method = "none";
+        return stat;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stat.keyFrames = entries.size();
+    }
+    stat.complete = complete.load();
+    stat.fromSidecar = fromSidecar;
+    stat.scannedBytes = scannedBytes.load();
+    stat.fileSize = fileSize;
+    stat.scanTimeUs = scanTimeUs.load();
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
+//   Scanning thread. The file is read by the large blocks (the scan is limited by
+// the disk, not by the parsing); the lost sync is found again byte by byte.
+void SeekIndex::scanning()
+{
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        loggable.logMessage(objectName(), QtWarningMsg,
+                            QString("Could not open '%1' for scanning: %2").arg(path, file.errorString()));
+        return;
+    }
+
+    packetSize = detectPacketSize(file);
+    if (packetSize == 0)
+    {
+        loggable.logMessage(objectName(), QtWarningMsg, "MPEG-TS packet size isn't detected, the file isn't indexed.");
+        return;
+    }
+    // M2TS packets start with the 4 bytes of the arrival timestamp
+    int prefixSize = packetSize - TsPacketSize == 4 ? 4 : 0;
+    lastPts = -1;
+    ptsWrapOffset = 0;
+
+    std::vector<uint8_t> block(ScanBlockSize);
+    int64_t blockPosition = 0;
+    int pending = 0;
+    int64_t lostSyncBytes = 0;
+    while (!stopRequested.load())
+    {
+        qint64 size = file.read(reinterpret_cast<char*>(block.data()) + pending, qint64(block.size()) - pending);
+        if (size <= 0)
+            break;
+
+        int available = pending + int(size);
+        int offset = 0;
+        while (offset + packetSize <= available)
+        {
+            if (block[offset + prefixSize] != 0x47)
+            {
+                offset++;
+                lostSyncBytes++;
+                continue;
+            }
+            scanTsPacket(block.data() + offset + prefixSize, blockPosition + offset);
+            offset += packetSize;
+        }
+
+        pending = available - offset;
+        memmove(block.data(), block.data() + offset, size_t(pending));
+        blockPosition += offset;
+        scannedBytes.store(blockPosition + pending);
+        scanTimeUs.store(scanTimer.nsecsElapsed() / 1000);
+    }
+
+    scanTimeUs.store(scanTimer.nsecsElapsed() / 1000);
+    if (stopRequested.load())
+        return;
+
+    complete.store(true);
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Scan finished: %1 key frame(s) in %2 ms, %3 byte(s) out of sync.")
+                        .arg(getStatistics().keyFrames)
+                        .arg(scanTimeUs.load() / 1000)
+                        .arg(lostSyncBytes));
+    saveSidecar();
+}
+
+//---------------------------------------------------------------------------------------
+//   188 (TS), 192 (M2TS) or 204 (TS with Reed-Solomon), 0 - not detected.
+int SeekIndex::detectPacketSize(QFile &file)
+{
+    static const int packetSizes[] = {TsPacketSize, TsPacketSize + 4, TsPacketSize + 16};
+    static const int checkedPackets = 4;
+
+    QByteArray probe = file.read((TsPacketSize + 16) * (checkedPackets + 1));
+    file.seek(0);
+
+    for (int size : packetSizes)
+    {
+        int prefixSize = size - TsPacketSize == 4 ? 4 : 0;
+        bool synced = probe.size() >= prefixSize + size * checkedPackets;
+        for (int i = 0; synced && i < checkedPackets; ++i)
+            synced = probe.constData()[prefixSize + i * size] == 0x47;
+        if (synced)
+            return size;
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the packets starting PES of the video are parsed: the key frame is marked by
+// the random access indicator, or found by the start codes in the first payload bytes.
+void SeekIndex::scanTsPacket(const uint8_t *packet, int64_t position)
+{
+    int packetPid = ((packet[1] & 0x1f) << 8) | packet[2];
+    bool payloadUnitStart = packet[1] & 0x40;
+    if (packetPid != pid || !payloadUnitStart)
+        return;
+
+    int offset = 4;
+    bool randomAccess = false;
+    int adaptationFieldControl = (packet[3] >> 4) & 0x03;
+    if (adaptationFieldControl & 0x02)
+    {
+        int length = packet[4];
+        randomAccess = length > 0 && (packet[5] & 0x40);
+        offset += 1 + length;
+    }
+
+    // the PES header up to the PTS
+    if (!(adaptationFieldControl & 0x01) || offset + 14 > TsPacketSize)
+        return;
+
+    const uint8_t *pes = packet + offset;
+    int pesSize = TsPacketSize - offset;
+    bool hasPts = pes[7] & 0x80;
+    if (pes[0] != 0 || pes[1] != 0 || pes[2] != 1 || !hasPts)
+        return;
+
+    int64_t pts = (int64_t(pes[9] & 0x0e) << 29)
+            | (int64_t(pes[10]) << 22)
+            | (int64_t(pes[11] & 0xfe) << 14)
+            | (int64_t(pes[12]) << 7)
+            | (int64_t(pes[13]) >> 1);
+    if (lastPts >= 0 && pts + ptsWrapOffset < lastPts - PtsPeriod / 2)
+        ptsWrapOffset += PtsPeriod;
+    pts += ptsWrapOffset;
+    lastPts = pts;
+
+    int headerSize = 9 + pes[8];
+    bool keyFrame = randomAccess
+            || (headerSize < pesSize && isKeyFramePayload(codecId, pes + headerSize, pesSize - headerSize));
+    if (!keyFrame)
+        return;
+
+    int64_t timeUs = av_rescale(pts, AV_TIME_BASE, PtsClockRate);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    // after the discontinuity the time goes back, such part isn't indexed
+    if (!entries.empty() && timeUs <= entries.back().timeUs)
+        return;
+    entries.push_back({timeUs, position});
+}
+
+//---------------------------------------------------------------------------------------
+//   IDR/SPS of H.264, IRAP/parameter sets of HEVC, sequence/GOP header of MPEG-1/2.
+bool SeekIndex::isKeyFramePayload(AVCodecID codecId, const uint8_t *data, int size)
+{
+    for (int i = 0; i + 3 < size; ++i)
+    {
+        if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+            continue;
+
+        uint8_t code = data[i + 3];
+        switch (codecId)
+        {
+        case AV_CODEC_ID_H264:
+        {
+            int type = code & 0x1f;
+            if (type == 5 || type == 7)
+                return true;
+            break;
+        }
+        case AV_CODEC_ID_HEVC:
+        {
+            int type = (code >> 1) & 0x3f;
+            if ((type >= 16 && type <= 21) || (type >= 32 && type <= 34))
+                return true;
+            break;
+        }
+        case AV_CODEC_ID_MPEG1VIDEO:
+        case AV_CODEC_ID_MPEG2VIDEO:
+            if (code == 0xb3 || code == 0xb8)
+                return true;
+            break;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+//   The sidecar is used only for the same file (size and modification time) and
+// the same video PID.
+bool SeekIndex::loadSidecar()
+{
+    for (const QString &sidecarPath : getSidecarPaths())
+    {
+        QFile file(sidecarPath);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+
+        quint32 magic = 0;
+        quint32 version = 0;
+        qint64 size = 0;
+        qint64 modified = 0;
+        qint32 streamPid = -1;
+        qint32 count = 0;
+        stream >> magic >> version >> size >> modified >> streamPid >> count;
+        if (stream.status() != QDataStream::Ok || magic != SidecarMagic || version != SidecarVersion
+                || size != fileSize || modified != lastModified || streamPid != pid
+                || count < 0 || count > file.size() / 16)
+        {
+            loggable.logMessage(objectName(), QtDebugMsg, QString("Sidecar '%1' is outdated.").arg(sidecarPath));
+            continue;
+        }
+
+        std::vector<Entry> loaded(size_t(count), Entry{});
+        for (Entry &entry : loaded)
+        {
+            qint64 timeUs = 0;
+            qint64 position = 0;
+            stream >> timeUs >> position;
+            entry.timeUs = timeUs;
+            entry.position = position;
+        }
+        if (stream.status() != QDataStream::Ok)
+            continue;
+
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            entries = std::move(loaded);
+        }
+        loggable.logMessage(objectName(), QtDebugMsg,
+                            QString("Seek index loaded from '%1': %2 key frame(s).").arg(sidecarPath).arg(count));
+        return true;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+bool SeekIndex::saveSidecar()
+{
+    std::vector<Entry> saved;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        saved = entries;
+    }
+
+    for (const QString &sidecarPath : getSidecarPaths())
+    {
+        QDir().mkpath(QFileInfo(sidecarPath).absolutePath());
+
+        QSaveFile file(sidecarPath);
+        if (!file.open(QIODevice::WriteOnly))
+            continue;
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << quint32(SidecarMagic) << quint32(SidecarVersion)
+               << qint64(fileSize) << qint64(lastModified) << qint32(pid) << qint32(saved.size());
+        for (const Entry &entry : saved)
+            stream << qint64(entry.timeUs) << qint64(entry.position);
+
+        if (stream.status() == QDataStream::Ok && file.commit())
+        {
+            loggable.logMessage(objectName(), QtDebugMsg, QString("Seek index saved to '%1'.").arg(sidecarPath));
+            return true;
+        }
+    }
+
+    loggable.logMessage(objectName(), QtWarningMsg, "Could not save the seek index.");
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+//   Next to the media file first, then in the cache (named by the hash of the path).
+QStringList SeekIndex::getSidecarPaths() const
+{
+    QByteArray hash = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(),
+                                               QCryptographicHash::Sha1).toHex();
+    QDir cacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+
+    return {path + ".yaffidx",
+            cacheDirectory.filePath(QString("seekindex/%1.yaffidx").arg(QString::fromLatin1(hash.constData())))};
+}
+
+//---------------------------------------------------------------------------------------
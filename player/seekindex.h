@@ -0,0 +1,113 @@
+#ifndef SEEKINDEX_H
+#define SEEKINDEX_H
+
+#include <QObject>
+
+#include <QFile>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "loggable.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct SeekIndexStatistics
+{
+    QString method;
+    bool complete{false};
+    bool fromSidecar{false};
+    size_t keyFrames{0};
+    int64_t scannedBytes{0};
+    int64_t fileSize{0};
+    int64_t scanTimeUs{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Key frame index of the file source, it bounds the seeking by one GOP.
+//   The formats with their own index (Matroska cues, MP4 sample tables, ...) are seeked
+// by FFmpeg directly. MPEG-TS has no index: the own thread scans the file in the large
+// blocks and collects the positions of the key frames of the video stream (the random
+// access indicator or the key frame NAL units/start codes at the start of PES). The
+// seeking works while the scan is running: the part not scanned yet is seeked by
+// the timestamp.
+//   The complete index is stored in the sidecar file (next to the media file, or in
+// the cache directory if it can't be written there), so the scan is done once.
+class SeekIndex : public QObject
+{
+    Q_OBJECT
+public:
+    enum Method {
+        None,
+        Native,
+        Scanned
+    };
+
+    explicit SeekIndex(QObject *parent = nullptr);
+    virtual ~SeekIndex();
+
+    bool open(const QString &path, const AVFormatContext *input, int videoStreamIndex);
+    void close();
+    int getMethod() const;
+
+    // byte position of the last key frame before the time (in AV_TIME_BASE, the same
+    // clock as in the input context), -1 - the time isn't covered by the index
+    int64_t findPosition(int64_t timeUs) const;
+    SeekIndexStatistics getStatistics() const;
+
+private:
+    struct Entry
+    {
+        int64_t timeUs{0};
+        int64_t position{0};
+    };
+
+    void scanning();
+    int detectPacketSize(QFile &file);
+    void scanTsPacket(const uint8_t *packet, int64_t position);
+    static bool isKeyFramePayload(AVCodecID codecId, const uint8_t *data, int size);
+
+    bool loadSidecar();
+    bool saveSidecar();
+    QStringList getSidecarPaths() const;
+
+    enum {
+        TsPacketSize = 188,
+        ScanBlockSize = 4 * 1024 * 1024,
+        SidecarMagic = 0x59494458, // "YIDX"
+        SidecarVersion = 1
+    };
+
+    std::atomic<int> method{None};
+    QString path;
+    int64_t fileSize{0};
+    int64_t lastModified{0};
+    int pid{-1};
+    AVCodecID codecId{AV_CODEC_ID_NONE};
+    int videoStreamIndex{-1};
+    const AVFormatContext *inputFormatContext{nullptr};
+
+    std::thread scanThread;
+    std::atomic_bool stopRequested{false};
+    std::atomic_bool complete{false};
+    std::atomic<int64_t> scannedBytes{0};
+    std::atomic<int64_t> scanTimeUs{0};
+    bool fromSidecar{false};
+
+    mutable std::mutex mutex;
+    // sorted by the time
+    std::vector<Entry> entries;
+
+    // the scanner state (used only by the scanning thread)
+    int packetSize{TsPacketSize};
+    int64_t lastPts{-1};
+    int64_t ptsWrapOffset{0};
+
+    Loggable loggable;
+};
+
+#endif // SEEKINDEX_H
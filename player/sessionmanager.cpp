@@ -0,0 +1,95 @@
+#include "sessionmanager.h"
+
+#include <algorithm>
+
+#include "demuxer.h"
+
+SessionManager *SessionManager::instance = nullptr;
+std::once_flag SessionManager::initInstanceFlag;
+
+//---------------------------------------------------------------------------------------
+SessionManager *SessionManager::getInstance()
+{
+    std::call_once(initInstanceFlag, &SessionManager::initInstance);
+
+    return instance;
+}
+
+//---------------------------------------------------------------------------------------
+SessionManager::SessionManager(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("SessionManager");
+}
+
+//---------------------------------------------------------------------------------------
+void SessionManager::initInstance()
+{
+    instance = new SessionManager();
+}
+
+//---------------------------------------------------------------------------------------
+//   The first session keeps the plain "Demuxer" name in the log.
+Demuxer *SessionManager::createSession()
+{
+    Session session;
+    session.demuxer = new Demuxer();
+    session.thread = new QThread();
+
+    int count;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        int id = nextSessionId++;
+        if (id > 1)
+            session.demuxer->setObjectName(QString("Demuxer %1").arg(id));
+        sessions.push_back(session);
+        count = int(sessions.size());
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Create session '%1' (%2 session(s)).").arg(session.demuxer->objectName()).arg(count));
+
+    session.demuxer->moveToThread(session.thread);
+    connect(session.thread, &QThread::finished, session.demuxer, &QObject::deleteLater);
+    session.thread->start();
+
+    emit sessionCountChanged(count);
+    return session.demuxer;
+}
+
+//---------------------------------------------------------------------------------------
+void SessionManager::closeSession(Demuxer *demuxer)
+{
+    Session session;
+    int count;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto it = std::find_if(sessions.begin(), sessions.end(), [demuxer](const Session &item){
+            return item.demuxer == demuxer;
+        });
+        if (it == sessions.end())
+            return;
+        session = *it;
+        sessions.erase(it);
+        count = int(sessions.size());
+    }
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Close session '%1' (%2 session(s) left).").arg(demuxer->objectName()).arg(count));
+
+    session.demuxer->stop();
+    session.thread->quit();
+    session.thread->wait();
+    delete session.thread;
+
+    emit sessionCountChanged(count);
+}
+
+//---------------------------------------------------------------------------------------
+int SessionManager::getSessionCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return int(sessions.size());
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,59 @@
+#ifndef SESSIONMANAGER_H
+#define SESSIONMANAGER_H
+
+#include <QObject>
+
+#include <QThread>
+
+#include <mutex>
+#include <vector>
+
+#include "loggable.h"
+
+class Demuxer;
+
+//---------------------------------------------------------------------------------------
+//   Owner of all playback sessions of the process (one per window). Each session is
+// a demuxer with its control thread; the decoding of all sessions is done in the shared
+// worker pool and the decoder threads are balanced by the common threading policy,
+// so the number of the busy threads doesn't grow with the number of the sources.
+class SessionManager : public QObject
+{
+    Q_OBJECT
+public:
+    static SessionManager *getInstance();
+
+    // the demuxer is already moved to its control thread
+    Demuxer *createSession();
+    // stops the playback and deletes the demuxer
+    void closeSession(Demuxer *demuxer);
+
+    int getSessionCount() const;
+
+signals:
+    void sessionCountChanged(int count);
+
+private:
+    explicit SessionManager(QObject *parent = nullptr);
+
+    SessionManager(const SessionManager&) = delete;
+    SessionManager& operator=(const SessionManager&) = delete;
+
+    struct Session
+    {
+        Demuxer *demuxer{nullptr};
+        QThread *thread{nullptr};
+    };
+
+    static void initInstance();
+    static SessionManager *instance;
+    static std::once_flag initInstanceFlag;
+
+    mutable std::mutex mutex;
+    std::vector<Session> sessions;
+    int nextSessionId{1};
+
+    Loggable loggable;
+};
+
+#endif // SESSIONMANAGER_H
@@ -0,0 +1,14 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+//---------------------------------------------------------------------------------------
+//   Compile time detection of the SIMD instruction sets used by the pixel and packet
+// kernels. SSE2 is the baseline of x86-64 (and of the MSVC x86 builds with
+// /arch:SSE2), so no runtime dispatch is needed for it. Every kernel has a scalar
+// fallback for the other platforms.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLAYER_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#endif // SIMD_H
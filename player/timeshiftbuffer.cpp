@@ -0,0 +1,520 @@
+#include "timeshiftbuffer.h"
+
+#include <QDir>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+}
+
+// the random access point is searched back from the requested time within this range
+static const int64_t MaxRandomAccessDistanceUs = 5000000;
+// the PCR base is 33 bits of 90 kHz
+static const int64_t PcrMask = (int64_t(1) << 33) - 1;
+
+//---------------------------------------------------------------------------------------
+TimeshiftBuffer::TimeshiftBuffer(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("Timeshift");
+}
+
+//---------------------------------------------------------------------------------------
+TimeshiftBuffer::~TimeshiftBuffer()
+{
+    close();
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the raw MPEG-TS over UDP is received by the buffer (other protocols either
+// can be paused by themselves or carry the additional headers).
+bool TimeshiftBuffer::isSupported(const QString &url)
+{
+    return url.startsWith("udp://", Qt::CaseInsensitive);
+}
+
+//---------------------------------------------------------------------------------------
+bool TimeshiftBuffer::open(const QString &url, const TimeshiftSettings &newSettings, std::function<bool()> interruptFunction,
+                           AVDictionary **options)
+{
+    if (!initialize(newSettings, interruptFunction))
+        return false;
+
+    AVIOInterruptCB interruptCallback{&TimeshiftBuffer::receiverInterruptCallback, this};
+    int result = avio_open2(&inputIoContext, url.toUtf8().data(), AVIO_FLAG_READ, &interruptCallback, options);
+    if (result < 0)
+    {
+        loggable.logAvError(objectName(), QtCriticalMsg, QString("Could not open source: %1").arg(url), result);
+        close();
+        return false;
+    }
+    inputOwned = true;
+
+    return startReceiving();
+}
+
+//---------------------------------------------------------------------------------------
+bool TimeshiftBuffer::open(AVIOContext *input, const TimeshiftSettings &newSettings, std::function<bool()> interruptFunction)
+{
+    if (!initialize(newSettings, interruptFunction))
+        return false;
+
+    inputIoContext = input;
+    inputOwned = false;
+
+    return startReceiving();
+}
+
+//---------------------------------------------------------------------------------------
+bool TimeshiftBuffer::initialize(const TimeshiftSettings &newSettings, std::function<bool()> interruptFunction)
+{
+    close();
+
+    settings = newSettings;
+    interrupt = interruptFunction;
+    capacity = int64_t(settings.capacityMegabytes) * 1024 * 1024;
+
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Open timeshift buffer: %1 s, %2 MB in %3.")
+                        .arg(settings.durationSeconds)
+                        .arg(settings.capacityMegabytes)
+                        .arg(settings.fileStorage ? "file" : "RAM"));
+
+    if (!allocateStorage())
+    {
+        close();
+        return false;
+    }
+
+    stopRequested.store(false);
+    writePosition = 0;
+    readPosition = 0;
+    inputEnded = false;
+    overruns = 0;
+    index.clear();
+    randomAccessEntries = 0;
+    arrivals.clear();
+
+    pendingData.clear();
+    pendingPosition = 0;
+    pcrPid = -1;
+    lastPcr = -1;
+    lastPcrTimeUs = 0;
+    lastPcrArrivalUs = 0;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool TimeshiftBuffer::startReceiving()
+{
+    unsigned char *buffer = static_cast<unsigned char*>(av_malloc(ReadBufferSize));
+    ioContext = buffer ? avio_alloc_context(buffer, ReadBufferSize, 0, this, &TimeshiftBuffer::readCallback,
+                                            nullptr, &TimeshiftBuffer::seekCallback)
+                       : nullptr;
+    if (!ioContext)
+    {
+        av_free(buffer);
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate IO context.");
+        close();
+        return false;
+    }
+    // libavformat may seek in the context, so the demuxer can move within the ring (the
+    // size isn't reported by the seek callback)
+    ioContext->seekable = AVIO_SEEKABLE_NORMAL;
+
+    receiverThread = std::thread{&TimeshiftBuffer::receiving, this};
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   The demuxer which uses the IO context must be closed before.
+void TimeshiftBuffer::close()
+{
+    stopRequested.store(true);
+    dataAvailable.notify_all();
+
+    if (receiverThread.joinable())
+        receiverThread.join();
+
+    if (inputIoContext && inputOwned)
+        avio_closep(&inputIoContext);
+    inputIoContext = nullptr;
+    inputOwned = false;
+
+    if (ioContext)
+    {
+        av_freep(&ioContext->buffer);
+        avio_context_free(&ioContext);
+    }
+
+    releaseStorage();
+
+    std::lock_guard<std::mutex> guard(mutex);
+    index.clear();
+    randomAccessEntries = 0;
+    arrivals.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool TimeshiftBuffer::isOpen() const
+{
+    return ioContext != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+AVIOContext *TimeshiftBuffer::getIoContext() const
+{
+    return ioContext;
+}
+
+//---------------------------------------------------------------------------------------
+void TimeshiftBuffer::setClockRecovery(ClockRecovery *recovery)
+{
+    clockRecovery = recovery;
+}
+
+//---------------------------------------------------------------------------------------
+int64_t TimeshiftBuffer::findPosition(int64_t lagUs) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (index.empty())
+        return writePosition;
+
+    int64_t liveTimeUs = index.back().timeUs;
+    int64_t targetUs = liveTimeUs - std::clamp<int64_t>(lagUs, 0, liveTimeUs - index.front().timeUs);
+
+    auto it = std::upper_bound(index.begin(), index.end(), targetUs, [](int64_t time, const IndexEntry &entry){
+        return time < entry.timeUs;
+    });
+    if (it != index.begin())
+        --it;
+
+    for (auto rap = it; ; --rap)
+    {
+        if (rap->randomAccess)
+        {
+            it = rap;
+            break;
+        }
+        if (rap == index.begin() || it->timeUs - rap->timeUs > MaxRandomAccessDistanceUs)
+            break;
+    }
+
+    return it->position;
+}
+
+//---------------------------------------------------------------------------------------
+TimeshiftStatus TimeshiftBuffer::getStatus() const
+{
+    TimeshiftStatus status;
+    status.active = isOpen();
+    if (!status.active)
+        return status;
+
+    status.fileStorage = settings.fileStorage;
+    status.capacityBytes = capacity;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    status.bufferedUs = index.empty() ? 0 : index.back().timeUs - index.front().timeUs;
+    status.lagUs = getLagUs(readPosition);
+    status.receivedBytes = writePosition;
+    status.overruns = overruns;
+    status.indexEntries = index.size();
+    status.randomAccessEntries = randomAccessEntries;
+    return status;
+}
+
+//---------------------------------------------------------------------------------------
+bool TimeshiftBuffer::allocateStorage()
+{
+    if (settings.fileStorage)
+    {
+        QString path = QDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation))
+                .filePath(QString("yaffplayer-timeshift-%1.bin").arg(quintptr(this), 0, 16));
+        storageFile.setFileName(path);
+        if (storageFile.open(QIODevice::ReadWrite | QIODevice::Truncate) && storageFile.resize(capacity))
+            data = storageFile.map(0, capacity);
+    }
+    else
+    {
+        memory.reset(new (std::nothrow) uint8_t[capacity]);
+        data = memory.get();
+    }
+
+    if (!data)
+    {
+        loggable.logMessage(objectName(), QtCriticalMsg,
+                            QString("Could not allocate %1 MB for the timeshift buffer.").arg(settings.capacityMegabytes));
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void TimeshiftBuffer::releaseStorage()
+{
+    if (storageFile.isOpen())
+    {
+        if (data)
+            storageFile.unmap(data);
+        storageFile.close();
+        storageFile.remove();
+    }
+    memory.reset();
+    data = nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+//   Receiving thread. The new index entries are published together with the data, so
+// the index never points to the data which isn't in the ring yet.
+void TimeshiftBuffer::receiving()
+{
+    std::vector<uint8_t> buffer(ReceiveBufferSize);
+
+    while (!stopRequested.load())
+    {
+        int result = avio_read_partial(inputIoContext, buffer.data(), ReceiveBufferSize);
+        int64_t arrivalUs = av_gettime_relative();
+        if (result == AVERROR(EAGAIN) || (result == 0 && !avio_feof(inputIoContext)))
+            continue;
+        if (result <= 0)
+        {
+            if (!stopRequested.load())
+                loggable.logAvError(objectName(), QtWarningMsg, "Receiving of the source stopped.", result);
+            break;
+        }
+
+        newEntries.clear();
+        indexData(buffer.data(), result);
+
+        std::unique_lock<std::mutex> locker(mutex);
+        int64_t offset = writePosition % capacity;
+        int64_t first = std::min<int64_t>(result, capacity - offset);
+        memcpy(data + offset, buffer.data(), first);
+        memcpy(data, buffer.data() + first, result - first);
+        arrivals.push_back(ArrivalEntry{writePosition, arrivalUs});
+        if (arrivals.size() > MaxArrivalEntries)
+            arrivals.pop_front();
+        writePosition += result;
+        for (const IndexEntry &entry : newEntries)
+        {
+            index.push_back(entry);
+            if (entry.randomAccess)
+                randomAccessEntries++;
+        }
+        trimIndex();
+        locker.unlock();
+
+        dataAvailable.notify_all();
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    inputEnded = true;
+    dataAvailable.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+//   The datagrams usually contain the whole TS packets, but the packets split between
+// the reads and the lost sync are handled too.
+void TimeshiftBuffer::indexData(const uint8_t *newData, int size)
+{
+    pendingData.insert(pendingData.end(), newData, newData + size);
+
+    size_t offset = 0;
+    while (pendingData.size() - offset >= TsPacketSize)
+    {
+        if (pendingData[offset] != 0x47)
+        {
+            offset++;
+            continue;
+        }
+        indexTsPacket(&pendingData[offset], pendingPosition + int64_t(offset));
+        offset += TsPacketSize;
+    }
+
+    pendingData.erase(pendingData.begin(), pendingData.begin() + offset);
+    pendingPosition += int64_t(offset);
+}
+
+//---------------------------------------------------------------------------------------
+//   Only the adaptation field is parsed: the PCR and the random access indicator.
+void TimeshiftBuffer::indexTsPacket(const uint8_t *packet, int64_t position)
+{
+    int pid = ((packet[1] & 0x1f) << 8) | packet[2];
+    bool hasAdaptationField = packet[3] & 0x20;
+    int adaptationFieldLength = packet[4];
+    if (!hasAdaptationField || adaptationFieldLength == 0)
+        return;
+
+    uint8_t flags = packet[5];
+    bool hasPcr = (flags & 0x10) && adaptationFieldLength >= 7;
+    if (hasPcr && pcrPid == -1)
+    {
+        pcrPid = pid;
+        loggable.logMessage(objectName(), QtDebugMsg, QString("Timeshift index by PCR of the PID %1.").arg(pid));
+    }
+    if (pid != pcrPid)
+        return;
+
+    bool randomAccess = flags & 0x40;
+    if (!hasPcr)
+    {
+        if (randomAccess && lastPcr >= 0)
+            newEntries.push_back(IndexEntry{position, lastPcrTimeUs, true});
+        return;
+    }
+
+    int64_t pcr = (int64_t(packet[6]) << 25) | (packet[7] << 17) | (packet[8] << 9) | (packet[9] << 1) | (packet[10] >> 7);
+    int64_t arrivalUs = av_gettime_relative();
+
+    int64_t timeUs = 0;
+    if (lastPcr >= 0)
+    {
+        int64_t deltaUs = av_rescale(int64_t((pcr - lastPcr) & PcrMask), 1000000, 90000);
+        timeUs = lastPcrTimeUs + (deltaUs <= MaxPcrGapUs ? deltaUs : arrivalUs - lastPcrArrivalUs);
+    }
+
+    lastPcr = pcr;
+    lastPcrTimeUs = timeUs;
+    lastPcrArrivalUs = arrivalUs;
+
+    if (clockRecovery)
+        clockRecovery->addReference(pcr, arrivalUs);
+
+    newEntries.push_back(IndexEntry{position, timeUs, randomAccess});
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex. The entries of the overwritten data and the
+// entries older than the configured duration are removed.
+void TimeshiftBuffer::trimIndex()
+{
+    if (index.empty())
+        return;
+
+    int64_t oldestPosition = writePosition - capacity;
+    int64_t oldestTimeUs = index.back().timeUs - int64_t(settings.durationSeconds) * 1000000;
+    while (!index.empty() && (index.front().position < oldestPosition || index.front().timeUs < oldestTimeUs))
+    {
+        if (index.front().randomAccess)
+            randomAccessEntries--;
+        index.pop_front();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+int64_t TimeshiftBuffer::getArrivalTime(int64_t position) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    if (arrivals.empty() || position < arrivals.front().position || position >= writePosition)
+        return -1;
+
+    auto it = std::upper_bound(arrivals.begin(), arrivals.end(), position, [](int64_t value, const ArrivalEntry &entry){
+        return value < entry.position;
+    });
+    return std::prev(it)->timeUs;
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+int64_t TimeshiftBuffer::getLagUs(int64_t position) const
+{
+    if (index.empty())
+        return 0;
+
+    auto it = std::upper_bound(index.begin(), index.end(), position, [](int64_t value, const IndexEntry &entry){
+        return value < entry.position;
+    });
+    if (it != index.begin())
+        --it;
+
+    return index.back().timeUs - it->timeUs;
+}
+
+//---------------------------------------------------------------------------------------
+//   Waits for the data at the live edge. If the data was overwritten while the reading
+// was paused, the reading continues from the oldest indexed point.
+int TimeshiftBuffer::readCallback(void *opaque, uint8_t *buf, int bufSize)
+{
+    TimeshiftBuffer *buffer = static_cast<TimeshiftBuffer*>(opaque);
+
+    std::unique_lock<std::mutex> locker(buffer->mutex);
+    while (buffer->readPosition >= buffer->writePosition)
+    {
+        if (buffer->inputEnded)
+            return AVERROR_EOF;
+        if (buffer->stopRequested.load())
+            return AVERROR_EXIT;
+
+        buffer->dataAvailable.wait_for(locker, std::chrono::milliseconds(ReadWaitTimeoutMs));
+        if (buffer->interrupt && buffer->interrupt())
+            return AVERROR_EXIT;
+    }
+
+    int64_t oldestPosition = buffer->writePosition - buffer->capacity;
+    if (buffer->readPosition < oldestPosition)
+    {
+        buffer->overruns++;
+        buffer->readPosition = buffer->index.empty()
+                ? oldestPosition
+                : std::max(oldestPosition, buffer->index.front().position);
+    }
+
+    int64_t size = std::min<int64_t>(bufSize, buffer->writePosition - buffer->readPosition);
+    int64_t offset = buffer->readPosition % buffer->capacity;
+    int64_t first = std::min(size, buffer->capacity - offset);
+    memcpy(buf, buffer->data + offset, first);
+    memcpy(buf + first, buffer->data, size - first);
+    buffer->readPosition += size;
+
+    return int(size);
+}
+
+//---------------------------------------------------------------------------------------
+//   The positions outside of the ring are clamped to it. The size of the live stream is
+// unknown.
+int64_t TimeshiftBuffer::seekCallback(void *opaque, int64_t offset, int whence)
+{
+    TimeshiftBuffer *buffer = static_cast<TimeshiftBuffer*>(opaque);
+
+    if (whence & AVSEEK_SIZE)
+        return AVERROR(ENOSYS);
+
+    std::lock_guard<std::mutex> guard(buffer->mutex);
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += buffer->readPosition;
+        break;
+    case SEEK_END:
+        offset += buffer->writePosition;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    int64_t oldestPosition = std::max<int64_t>(0, buffer->writePosition - buffer->capacity);
+    buffer->readPosition = std::clamp(offset, oldestPosition, buffer->writePosition);
+    return buffer->readPosition;
+}
+
+//---------------------------------------------------------------------------------------
+int TimeshiftBuffer::receiverInterruptCallback(void *opaque)
+{
+    TimeshiftBuffer *buffer = static_cast<TimeshiftBuffer*>(opaque);
+    return buffer->stopRequested.load();
+}
+
+//---------------------------------------------------------------------------------------
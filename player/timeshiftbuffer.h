@@ -0,0 +1,169 @@
+#ifndef TIMESHIFTBUFFER_H
+#define TIMESHIFTBUFFER_H
+
+#include <QObject>
+
+#include <QFile>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "clockrecovery.h"
+#include "loggable.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct TimeshiftSettings
+{
+    bool enabled{false};
+    int durationSeconds{300};
+    int capacityMegabytes{512};
+    // the ring is kept in the pre-allocated (memory mapped) file instead of the RAM
+    bool fileStorage{false};
+};
+
+struct TimeshiftStatus
+{
+    bool active{false};
+    bool fileStorage{false};
+    // the duration available for the seeking back
+    int64_t bufferedUs{0};
+    // how much the reading is behind the received data
+    int64_t lagUs{0};
+    int64_t receivedBytes{0};
+    int64_t capacityBytes{0};
+    int64_t overruns{0};
+    size_t indexEntries{0};
+    size_t randomAccessEntries{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Timeshift ring of the live MPEG-TS received over UDP (or taken from the RTP input).
+//   The own thread receives the datagrams and stores them in the ring (RAM or the memory
+// mapped file) whether the playback is running or not, so nothing is lost while it's
+// paused. The demuxer reads the ring through the custom AVIOContext; its positions are
+// the absolute byte offsets of the received stream, so the demuxer can be moved to any
+// point still kept in the ring.
+//   The received packets are indexed by the PCR (of the first PID which carries it) and
+// by the random access indicator on that PID (usually the video key frames). The PCR
+// is unwrapped, and its discontinuities are bridged by the arrival time, so the index
+// gives the continuous timeline for the instant seeking inside the ring.
+class TimeshiftBuffer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TimeshiftBuffer(QObject *parent = nullptr);
+    virtual ~TimeshiftBuffer();
+
+    static bool isSupported(const QString &url);
+
+    // the interrupt function is checked while the reading waits for the data; the
+    // protocol options are passed to avio_open2 (the unused ones are left)
+    bool open(const QString &url, const TimeshiftSettings &settings, std::function<bool()> interrupt,
+              AVDictionary **options = nullptr);
+    // receives the stream of the other input (it must stay open until close, and it
+    // must end its reading before, as the receiving can't be interrupted)
+    bool open(AVIOContext *input, const TimeshiftSettings &settings, std::function<bool()> interrupt);
+    void close();
+    bool isOpen() const;
+
+    AVIOContext *getIoContext() const;
+    // gets the PCRs of the indexed PID with their arrival time (set before the opening)
+    void setClockRecovery(ClockRecovery *recovery);
+
+    // position of the random access point (or of the PCR) lagUs behind the live,
+    // clamped to the buffered range
+    int64_t findPosition(int64_t lagUs) const;
+    TimeshiftStatus getStatus() const;
+    // when the byte at the position was received (av_gettime_relative), -1 if it's
+    // older than the kept arrival log
+    int64_t getArrivalTime(int64_t position) const;
+
+private:
+    struct ArrivalEntry
+    {
+        int64_t position{0};
+        int64_t timeUs{0};
+    };
+
+    struct IndexEntry
+    {
+        int64_t position{0};
+        int64_t timeUs{0};
+        bool randomAccess{false};
+    };
+
+    bool initialize(const TimeshiftSettings &newSettings, std::function<bool()> interruptFunction);
+    bool startReceiving();
+    bool allocateStorage();
+    void releaseStorage();
+
+    void receiving();
+    void indexData(const uint8_t *data, int size);
+    void indexTsPacket(const uint8_t *packet, int64_t position);
+    void trimIndex();
+    int64_t getLagUs(int64_t position) const;
+
+    static int readCallback(void *opaque, uint8_t *buf, int bufSize);
+    static int64_t seekCallback(void *opaque, int64_t offset, int whence);
+    static int receiverInterruptCallback(void *opaque);
+
+    enum {
+        TsPacketSize = 188,
+        ReceiveBufferSize = 64 * 1024,
+        ReadBufferSize = 64 * 1024,
+        ReadWaitTimeoutMs = 100,
+        // the longer gaps between the PCRs are the discontinuities
+        MaxPcrGapUs = 1000000,
+        // the reads of the receiver (a few seconds of the high bitrate)
+        MaxArrivalEntries = 16384
+    };
+
+    TimeshiftSettings settings;
+    std::function<bool()> interrupt;
+    ClockRecovery *clockRecovery{nullptr};
+
+    // the ring storage
+    int64_t capacity{0};
+    uint8_t *data{nullptr};
+    std::unique_ptr<uint8_t[]> memory;
+    QFile storageFile;
+
+    AVIOContext *inputIoContext{nullptr};
+    bool inputOwned{false};
+    AVIOContext *ioContext{nullptr};
+    std::thread receiverThread;
+    std::atomic_bool stopRequested{false};
+
+    mutable std::mutex mutex;
+    std::condition_variable dataAvailable;
+    // the absolute positions in the received stream
+    int64_t writePosition{0};
+    int64_t readPosition{0};
+    bool inputEnded{false};
+    int64_t overruns{0};
+    std::deque<IndexEntry> index;
+    size_t randomAccessEntries{0};
+    std::deque<ArrivalEntry> arrivals;
+
+    // the parser state (used only by the receiving thread)
+    std::vector<uint8_t> pendingData;
+    std::vector<IndexEntry> newEntries;
+    int64_t pendingPosition{0};
+    int pcrPid{-1};
+    int64_t lastPcr{-1};
+    int64_t lastPcrTimeUs{0};
+    int64_t lastPcrArrivalUs{0};
+
+    Loggable loggable;
+};
+
+#endif // TIMESHIFTBUFFER_H
@@ -0,0 +1,854 @@
+#include "tsanalyzer.h"
+
+#include <QStringList>
+#include <QUrl>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+extern "C" {
+#include <libavutil/crc.h>
+#include <libavutil/mem.h>
+}
+
+// PCR is 33 bits of the 90 kHz base and 9 bits of the 27 MHz extension
+static const int64_t PcrPeriod = (int64_t(1) << 33) * 300;
+
+//---------------------------------------------------------------------------------------
+static int countTrailingZeros(unsigned int value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+    return int(index);
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+TsAnalyzer::TsAnalyzer(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("TsAnalyzer");
+
+    for (std::atomic_bool &scrambled : scrambledPids)
+        scrambled.store(false);
+}
+
+//---------------------------------------------------------------------------------------
+TsAnalyzer::~TsAnalyzer()
+{
+    close();
+}
+
+//---------------------------------------------------------------------------------------
+//   The protocols which give the raw stream (the others are demuxers by themselves).
+bool TsAnalyzer::isSupported(const QString &url)
+{
+    static const QStringList schemes{"udp", "tcp", "srt", "http", "https"};
+    return schemes.contains(QUrl(url).scheme().toLower());
+}
+
+//---------------------------------------------------------------------------------------
+bool TsAnalyzer::open(AVIOContext *source)
+{
+    close();
+
+    this->source = source;
+    sourceOwned = false;
+    return createIoContext();
+}
+
+//---------------------------------------------------------------------------------------
+bool TsAnalyzer::open(const QString &url, const AVIOInterruptCB *interrupt, AVDictionary **options)
+{
+    close();
+
+    int result = avio_open2(&source, url.toUtf8().constData(), AVIO_FLAG_READ, interrupt, options);
+    if (result < 0)
+    {
+        loggable.logAvError(objectName(), QtWarningMsg, QString("Could not open '%1' for the analysis.").arg(url), result);
+        source = nullptr;
+        return false;
+    }
+    sourceOwned = true;
+    return createIoContext();
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called after the demuxer which reads the IO context is closed.
+void TsAnalyzer::close()
+{
+    if (ioContext)
+    {
+        av_freep(&ioContext->buffer);
+        avio_context_free(&ioContext);
+    }
+    if (source && sourceOwned)
+        avio_closep(&source);
+    source = nullptr;
+    sourceOwned = false;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    analysing = false;
+    carry.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool TsAnalyzer::isOpen() const
+{
+    return ioContext != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+AVIOContext *TsAnalyzer::getIoContext() const
+{
+    return ioContext;
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::stopAnalysis()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (analysing)
+        loggable.logMessage(objectName(), QtDebugMsg, "Input isn't a transport stream, it isn't analysed.");
+
+    analysing = false;
+    carry.clear();
+}
+
+//---------------------------------------------------------------------------------------
+TsAnalyzerStatistics TsAnalyzer::getStatistics() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    TsAnalyzerStatistics stat = counters;
+    stat.active = analysing && detected;
+    if (!stat.active)
+        return stat;
+
+    stat.packets = packetCount;
+    stat.bitrate = bitrate;
+    for (int pid = 0; pid < int(pids.size()); ++pid)
+    {
+        const PidState &state = pids[pid];
+        if (state.packets == 0)
+            continue;
+
+        TsPidStatistics pidStat;
+        pidStat.pid = pid;
+        pidStat.packets = state.packets;
+        pidStat.continuityErrors = state.continuityErrors;
+        pidStat.bitrate = state.bitrate;
+        pidStat.pcr = state.pcr;
+        pidStat.scrambled = state.transportScrambled || state.pesScrambled;
+        stat.pids.push_back(pidStat);
+    }
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::setBitrateHistory(std::shared_ptr<BitrateHistory> history)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    bitrateHistory = std::move(history);
+}
+
+//---------------------------------------------------------------------------------------
+bool TsAnalyzer::isScrambled(int pid) const
+{
+    if (pid < 0 || pid >= PidCount)
+        return false;
+    return scrambledPids[size_t(pid)].load(std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------------------
+bool TsAnalyzer::createIoContext()
+{
+    unsigned char *buffer = static_cast<unsigned char*>(av_malloc(ReadBufferSize));
+    ioContext = buffer ? avio_alloc_context(buffer, ReadBufferSize, 0, this,
+                                            &TsAnalyzer::readCallback, nullptr,
+                                            &TsAnalyzer::seekCallback)
+                       : nullptr;
+    if (!ioContext)
+    {
+        av_free(buffer);
+        loggable.logMessage(objectName(), QtCriticalMsg, "Could not allocate analyser IO context.");
+        close();
+        return false;
+    }
+    ioContext->seekable = source->seekable;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    resetState();
+    analysing = true;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::resetState()
+{
+    detected = false;
+    receivedBytes = 0;
+    synced = false;
+    corruptedSyncBytes = 0;
+    carry.clear();
+
+    pids.assign(PidCount, PidState{});
+    for (std::atomic_bool &scrambled : scrambledPids)
+        scrambled.store(false);
+    pat = TableState{};
+    pmts.clear();
+
+    packetCount = 0;
+    clockPid = -1;
+    clockTicks = -1;
+    clockPacket = 0;
+    clockTicksPerPacket = 0.0;
+    windowStartUs = -1;
+    windowPackets = 0;
+    bitrate = 0;
+    counters = TsAnalyzerStatistics{};
+}
+
+//---------------------------------------------------------------------------------------
+//   After the seeking: the counters are kept, the continuity and the timing start over.
+void TsAnalyzer::resync()
+{
+    synced = false;
+    corruptedSyncBytes = 0;
+    carry.clear();
+
+    for (PidState &state : pids)
+    {
+        state.lastContinuityCounter = -1;
+        state.duplicated = false;
+        state.windowPackets = state.packets;
+        state.lastPcr = -1;
+        state.lastSeenUs = -1;
+        state.missing = false;
+        state.section.clear();
+    }
+
+    pat.lastTimeUs = -1;
+    pat.overdue = false;
+    for (auto &[pid, table] : pmts)
+    {
+        table.lastTimeUs = -1;
+        table.overdue = false;
+    }
+
+    clockPid = -1;
+    clockTicks = -1;
+    windowStartUs = -1;
+    windowPackets = packetCount;
+}
+
+//---------------------------------------------------------------------------------------
+//   The data is split into the packets regardless of the read boundaries. While the sync
+// is lost, the data is collected and searched for the sync.
+void TsAnalyzer::analyze(const uint8_t *data, int size)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!analysing)
+        return;
+
+    receivedBytes += size;
+    while (size > 0)
+    {
+        if (!synced)
+        {
+            carry.insert(carry.end(), data, data + size);
+            size = 0;
+
+            int position = findSync(carry.data(), int(carry.size()));
+            if (position < 0)
+            {
+                // the candidates near the end are checked again with the next data
+                size_t kept = (SyncConfirmations - 1) * TsPacketSize;
+                if (carry.size() > kept)
+                    carry.erase(carry.begin(), carry.end() - kept);
+                break;
+            }
+
+            synced = true;
+            corruptedSyncBytes = 0;
+            if (!detected)
+            {
+                detected = true;
+                loggable.logMessage(objectName(), QtDebugMsg, "Transport stream is detected.");
+            }
+
+            scratch.assign(carry.begin() + position, carry.end());
+            carry.clear();
+            data = scratch.data();
+            size = int(scratch.size());
+            continue;
+        }
+
+        if (!carry.empty())
+        {
+            int count = std::min(TsPacketSize - int(carry.size()), size);
+            carry.insert(carry.end(), data, data + count);
+            data += count;
+            size -= count;
+            if (carry.size() < TsPacketSize)
+                break;
+
+            checkPacket(carry.data());
+            carry.clear();
+            continue;
+        }
+
+        while (synced && size >= TsPacketSize)
+        {
+            checkPacket(data);
+            data += TsPacketSize;
+            size -= TsPacketSize;
+        }
+        if (synced && size > 0)
+        {
+            carry.assign(data, data + size);
+            size = 0;
+        }
+    }
+
+    if (!detected && receivedBytes > DetectionLimit)
+    {
+        loggable.logMessage(objectName(), QtDebugMsg, "No sync is found, the input isn't analysed.");
+        analysing = false;
+        carry.clear();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::checkPacket(const uint8_t *packet)
+{
+    if (packet[0] != SyncByte)
+    {
+        counters.syncByteErrors++;
+        if (++corruptedSyncBytes >= SyncLossThreshold)
+        {
+            counters.syncLosses++;
+            synced = false;
+        }
+        return;
+    }
+
+    corruptedSyncBytes = 0;
+    processPacket(packet);
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::processPacket(const uint8_t *packet)
+{
+    packetCount++;
+
+    int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    PidState &state = pids[pid];
+    state.packets++;
+
+    int64_t nowUs = getStreamTimeUs();
+    state.lastSeenUs = nowUs;
+    state.missing = false;
+    if (nowUs >= 0 && (windowStartUs < 0 || nowUs - windowStartUs >= int64_t(WindowMs) * 1000))
+        updateWindow(nowUs);
+
+    if (packet[1] & 0x80)
+    {
+        counters.transportErrors++;
+        return;
+    }
+
+    bool unitStart = packet[1] & 0x40;
+    int scrambling = packet[3] >> 6;
+    int adaptation = (packet[3] >> 4) & 0x03;
+    int continuityCounter = packet[3] & 0x0F;
+    if (adaptation == 0)
+        return;
+
+    bool discontinuity = false;
+    int payloadOffset = 4;
+    if (adaptation & 0x02)
+    {
+        int length = packet[4];
+        if (length > 0)
+        {
+            discontinuity = packet[5] & 0x80;
+            if ((packet[5] & 0x10) && length >= 7)
+            {
+                int64_t base = (int64_t(packet[6]) << 25) | (int64_t(packet[7]) << 17)
+                        | (int64_t(packet[8]) << 9) | (int64_t(packet[9]) << 1) | (packet[10] >> 7);
+                int extension = ((packet[10] & 0x01) << 8) | packet[11];
+                processPcr(pid, state, base * 300 + extension, discontinuity);
+            }
+        }
+        payloadOffset = 5 + length;
+    }
+
+    // one duplicate packet is allowed, the counter doesn't change without the payload
+    if (pid != NullPid)
+    {
+        bool payload = adaptation & 0x01;
+        if (state.lastContinuityCounter >= 0 && !discontinuity)
+        {
+            bool error = false;
+            if (payload && continuityCounter == state.lastContinuityCounter)
+            {
+                error = state.duplicated;
+                state.duplicated = true;
+            }
+            else
+            {
+                int expected = payload ? (state.lastContinuityCounter + 1) & 0x0F : state.lastContinuityCounter;
+                error = continuityCounter != expected;
+                state.duplicated = false;
+            }
+
+            if (error)
+            {
+                state.continuityErrors++;
+                counters.continuityErrors++;
+                state.duplicated = false;
+            }
+        }
+        state.lastContinuityCounter = continuityCounter;
+    }
+
+    bool psi = pid == 0 || state.pmt;
+    if ((adaptation & 0x01) && payloadOffset < TsPacketSize && pid != NullPid && !psi)
+        processScrambling(pid, state, packet + payloadOffset, TsPacketSize - payloadOffset, scrambling, unitStart);
+
+    if ((adaptation & 0x01) && payloadOffset < TsPacketSize && psi)
+    {
+        // PSI must not be scrambled
+        if (scrambling != 0)
+        {
+            if (pid == 0)
+                counters.patErrors++;
+            else
+                counters.pmtErrors++;
+            return;
+        }
+        processPsi(pid, state, packet + payloadOffset, TsPacketSize - payloadOffset, unitStart);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The PES header is checked only in the clear packets (it can't be read in the
+// scrambled ones); the streams without the optional PES header (padding, private
+// stream 2, ECM/EMM, DSM-CC...) don't have the flag.
+void TsAnalyzer::processScrambling(int pid, PidState &state, const uint8_t *payload, int size,
+                                   int scrambling, bool unitStart)
+{
+    state.transportScrambled = scrambling != 0;
+    if (!state.transportScrambled && unitStart && size >= 7
+            && payload[0] == 0x00 && payload[1] == 0x00 && payload[2] == 0x01)
+    {
+        int streamId = payload[3];
+        bool optionalHeader = streamId != 0xBC && streamId != 0xBE && streamId != 0xBF
+                && streamId != 0xF0 && streamId != 0xF1 && streamId != 0xF2
+                && streamId != 0xF8 && streamId != 0xFF;
+        state.pesScrambled = optionalHeader && (payload[6] & 0x30) != 0;
+    }
+
+    bool scrambled = state.transportScrambled || state.pesScrambled;
+    if (scrambledPids[size_t(pid)].load(std::memory_order_relaxed) != scrambled)
+        scrambledPids[size_t(pid)].store(scrambled, std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------------------
+//   The accuracy is the difference of PCR from the value expected by the packet count
+// and the rate of the multiplex (the average of the previous PCR intervals).
+void TsAnalyzer::processPcr(int pid, PidState &state, int64_t pcr, bool discontinuity)
+{
+    if (clockPid == -1)
+        clockPid = pid;
+    bool reference = pid == clockPid;
+    state.pcr = true;
+
+    int64_t packets = packetCount - state.lastPcrPacket;
+    bool valid = false;
+    int64_t delta = 0;
+    if (state.lastPcr >= 0 && !discontinuity)
+    {
+        delta = pcr - state.lastPcr;
+        if (delta < -PcrPeriod / 2)
+            delta += PcrPeriod;
+
+        if (delta < 0 || delta > int64_t(MaxPcrDeltaMs) * 27000)
+        {
+            counters.pcrDiscontinuityErrors++;
+        }
+        else
+        {
+            valid = true;
+            int64_t intervalMs = delta / 27000;
+            counters.maxPcrIntervalMs = std::max(counters.maxPcrIntervalMs, intervalMs);
+            if (delta > int64_t(MaxPcrIntervalMs) * 27000)
+                counters.pcrRepetitionErrors++;
+
+            if (state.ticksPerPacket > 0.0 && packets > 0)
+            {
+                int64_t jitterNs = int64_t(std::abs(delta - packets * state.ticksPerPacket) * 1000.0 / 27.0);
+                counters.maxPcrJitterNs = std::max(counters.maxPcrJitterNs, jitterNs);
+                if (jitterNs > MaxPcrJitterNs)
+                    counters.pcrAccuracyErrors++;
+            }
+
+            if (packets > 0)
+            {
+                double ticksPerPacket = double(delta) / packets;
+                state.ticksPerPacket = state.ticksPerPacket > 0.0
+                        ? state.ticksPerPacket + (ticksPerPacket - state.ticksPerPacket) / 16.0
+                        : ticksPerPacket;
+            }
+        }
+    }
+
+    if (reference)
+    {
+        // the discontinuity is bridged by the packet count
+        if (valid)
+            clockTicks += delta;
+        else if (clockTicks >= 0)
+            clockTicks += int64_t((packetCount - clockPacket) * clockTicksPerPacket);
+        else
+            clockTicks = 0;
+        clockPacket = packetCount;
+        clockTicksPerPacket = state.ticksPerPacket;
+    }
+
+    state.lastPcr = pcr;
+    state.lastPcrPacket = packetCount;
+}
+
+//---------------------------------------------------------------------------------------
+//   The section may be split into several packets; the section which ends in the packet
+// starting the next one is completed by the bytes before the pointer.
+void TsAnalyzer::processPsi(int pid, PidState &state, const uint8_t *payload, int size, bool unitStart)
+{
+    auto complete = [this, pid, &state](){
+        if (state.section.size() < 3)
+            return;
+
+        int length = 3 + (((state.section[1] & 0x0F) << 8) | state.section[2]);
+        if (length > MaxSectionSize)
+        {
+            state.section.clear();
+        }
+        else if (int(state.section.size()) >= length)
+        {
+            std::vector<uint8_t> section;
+            section.swap(state.section);
+            processSection(pid, section.data(), length);
+        }
+    };
+
+    if (unitStart)
+    {
+        int pointer = payload[0];
+        if (1 + pointer >= size)
+        {
+            state.section.clear();
+            return;
+        }
+        if (!state.section.empty())
+        {
+            state.section.insert(state.section.end(), payload + 1, payload + 1 + pointer);
+            complete();
+        }
+        state.section.assign(payload + 1 + pointer, payload + size);
+    }
+    else
+    {
+        if (state.section.empty())
+            return;
+        state.section.insert(state.section.end(), payload, payload + size);
+    }
+    complete();
+}
+
+//---------------------------------------------------------------------------------------
+//   The tables are parsed again only if they are changed (the CRC is different).
+void TsAnalyzer::processSection(int pid, const uint8_t *section, int size)
+{
+    // stuffing
+    if (section[0] == 0xFF || size < 12)
+        return;
+
+    if (av_crc(av_crc_get_table(AV_CRC_32_IEEE), UINT32_MAX, section, size_t(size)) != 0)
+    {
+        counters.crcErrors++;
+        return;
+    }
+    uint32_t crc = (uint32_t(section[size - 4]) << 24) | (uint32_t(section[size - 3]) << 16)
+            | (uint32_t(section[size - 2]) << 8) | section[size - 1];
+
+    if (pid == 0)
+    {
+        if (section[0] != 0x00)
+        {
+            counters.patErrors++;
+            return;
+        }
+        checkTableInterval(pat, counters.patErrors, counters.maxPatIntervalMs);
+        if (crc != pat.crc)
+        {
+            pat.crc = crc;
+            processPat(section, size);
+        }
+        return;
+    }
+
+    auto it = pmts.find(pid);
+    if (section[0] != 0x02 || it == pmts.end())
+        return;
+
+    checkTableInterval(it->second, counters.pmtErrors, counters.maxPmtIntervalMs);
+    if (crc != it->second.crc && size >= 16)
+    {
+        it->second.crc = crc;
+        processPmt(pid, section, size);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::processPat(const uint8_t *section, int size)
+{
+    std::vector<int> pmtPids;
+    for (int i = 8; i + 4 <= size - 4; i += 4)
+    {
+        int programNumber = (section[i] << 8) | section[i + 1];
+        int pmtPid = ((section[i + 2] & 0x1F) << 8) | section[i + 3];
+        // the program 0 is NIT
+        if (programNumber != 0)
+            pmtPids.push_back(pmtPid);
+    }
+
+    for (auto it = pmts.begin(); it != pmts.end();)
+    {
+        if (std::find(pmtPids.begin(), pmtPids.end(), it->first) != pmtPids.end())
+        {
+            ++it;
+            continue;
+        }
+        for (int pid : it->second.pids)
+            pids[pid].references--;
+        pids[it->first].pmt = false;
+        pids[it->first].section.clear();
+        it = pmts.erase(it);
+    }
+
+    // the PMT which never comes is found by the interval from now
+    for (int pmtPid : pmtPids)
+    {
+        if (pmts.count(pmtPid))
+            continue;
+        pmts[pmtPid].lastTimeUs = getStreamTimeUs();
+        pids[pmtPid].pmt = true;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void TsAnalyzer::processPmt(int pid, const uint8_t *section, int size)
+{
+    TableState &table = pmts[pid];
+    int64_t nowUs = getStreamTimeUs();
+
+    std::vector<int> listed;
+    int pcrPid = ((section[8] & 0x1F) << 8) | section[9];
+    if (pcrPid != NullPid)
+        listed.push_back(pcrPid);
+
+    int infoLength = ((section[10] & 0x0F) << 8) | section[11];
+    for (int i = 12 + infoLength; i + 5 <= size - 4;)
+    {
+        listed.push_back(((section[i + 1] & 0x1F) << 8) | section[i + 2]);
+        i += 5 + (((section[i + 3] & 0x0F) << 8) | section[i + 4]);
+    }
+    std::sort(listed.begin(), listed.end());
+    listed.erase(std::unique(listed.begin(), listed.end()), listed.end());
+
+    for (int listedPid : table.pids)
+        pids[listedPid].references--;
+    for (int listedPid : listed)
+    {
+        PidState &state = pids[listedPid];
+        state.references++;
+        // the timeout of the PID which isn't received yet starts now
+        if (state.lastSeenUs < 0)
+            state.lastSeenUs = nowUs;
+    }
+    table.pids = std::move(listed);
+}
+
+//---------------------------------------------------------------------------------------
+//   The overdue table is counted once: when it's found by the window update, or when
+// it comes late.
+void TsAnalyzer::checkTableInterval(TableState &table, int64_t &errors, int64_t &maxIntervalMs)
+{
+    int64_t nowUs = getStreamTimeUs();
+    if (nowUs >= 0 && table.lastTimeUs >= 0)
+    {
+        int64_t intervalMs = (nowUs - table.lastTimeUs) / 1000;
+        maxIntervalMs = std::max(maxIntervalMs, intervalMs);
+        if (intervalMs > MaxPsiIntervalMs && !table.overdue)
+            errors++;
+    }
+    table.lastTimeUs = nowUs;
+    table.overdue = false;
+}
+
+//---------------------------------------------------------------------------------------
+//   Once per second of the stream time: the bitrates, the missing tables and PIDs.
+void TsAnalyzer::updateWindow(int64_t nowUs)
+{
+    if (windowStartUs >= 0 && nowUs > windowStartUs)
+    {
+        int64_t durationUs = nowUs - windowStartUs;
+        bitrate = (packetCount - windowPackets) * TsPacketSize * 8 * 1000000 / durationUs;
+        bitrateSamples.clear();
+
+        for (int pid = 0; pid < int(pids.size()); ++pid)
+        {
+            PidState &state = pids[pid];
+            if (state.packets != state.windowPackets || state.bitrate != 0)
+            {
+                state.bitrate = (state.packets - state.windowPackets) * TsPacketSize * 8 * 1000000 / durationUs;
+                state.windowPackets = state.packets;
+            }
+            if (state.packets > 0)
+                bitrateSamples.emplace_back(pid, state.bitrate);
+
+            if (state.references > 0 && state.lastSeenUs >= 0 && !state.missing
+                    && nowUs - state.lastSeenUs > int64_t(PidTimeoutMs) * 1000)
+            {
+                state.missing = true;
+                counters.pidErrors++;
+            }
+        }
+
+        auto checkOverdue = [nowUs](TableState &table, int64_t &errors){
+            if (table.lastTimeUs >= 0 && !table.overdue && nowUs - table.lastTimeUs > int64_t(MaxPsiIntervalMs) * 1000)
+            {
+                table.overdue = true;
+                errors++;
+            }
+        };
+        checkOverdue(pat, counters.patErrors);
+        for (auto &[pid, table] : pmts)
+            checkOverdue(table, counters.pmtErrors);
+
+        if (bitrateHistory)
+            bitrateHistory->addSamples(bitrateSamples);
+    }
+
+    windowStartUs = nowUs;
+    windowPackets = packetCount;
+}
+
+//---------------------------------------------------------------------------------------
+//   -1 until the first PCR of the reference PID.
+int64_t TsAnalyzer::getStreamTimeUs() const
+{
+    if (clockTicks < 0)
+        return -1;
+    return int64_t((clockTicks + (packetCount - clockPacket) * clockTicksPerPacket) / 27.0);
+}
+
+//---------------------------------------------------------------------------------------
+//   The candidates (0x47 bytes) are found by 16 bytes at once, each is confirmed by
+// the sync bytes of the following packets.
+int TsAnalyzer::findSync(const uint8_t *buffer, int size)
+{
+    int limit = size - (SyncConfirmations - 1) * TsPacketSize;
+    int i = 0;
+
+#ifdef PLAYER_SIMD_SSE2
+    const __m128i sync = _mm_set1_epi8(char(SyncByte));
+    for (; i + 16 <= limit; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + i));
+        unsigned int mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, sync)));
+        while (mask)
+        {
+            int position = i + countTrailingZeros(mask);
+            if (isSyncAt(buffer, position))
+                return position;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < limit; ++i)
+    {
+        if (buffer[i] == SyncByte && isSyncAt(buffer, i))
+            return i;
+    }
+    return -1;
+}
+
+//---------------------------------------------------------------------------------------
+bool TsAnalyzer::isSyncAt(const uint8_t *buffer, int position)
+{
+    for (int k = 0; k < SyncConfirmations; ++k)
+    {
+        if (buffer[position + k * TsPacketSize] != SyncByte)
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+int TsAnalyzer::readCallback(void *opaque, uint8_t *buf, int bufSize)
+{
+    TsAnalyzer *analyzer = static_cast<TsAnalyzer*>(opaque);
+
+    int count = avio_read_partial(analyzer->source, buf, bufSize);
+    if (count == 0)
+        return AVERROR_EOF;
+    if (count > 0)
+        analyzer->analyze(buf, count);
+    return count;
+}
+
+//---------------------------------------------------------------------------------------
+int64_t TsAnalyzer::seekCallback(void *opaque, int64_t offset, int whence)
+{
+    TsAnalyzer *analyzer = static_cast<TsAnalyzer*>(opaque);
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return avio_size(analyzer->source);
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += avio_tell(analyzer->source);
+        break;
+    case SEEK_END:
+        offset += avio_size(analyzer->source);
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    int64_t result = avio_seek(analyzer->source, offset, SEEK_SET);
+    if (result >= 0)
+    {
+        std::lock_guard<std::mutex> guard(analyzer->mutex);
+        analyzer->resync();
+    }
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
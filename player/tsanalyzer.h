@@ -0,0 +1,221 @@
+#ifndef TSANALYZER_H
+#define TSANALYZER_H
+
+#include <QObject>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "bitratehistory.h"
+#include "loggable.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct TsPidStatistics
+{
+    int pid{0};
+    int64_t packets{0};
+    int64_t continuityErrors{0};
+    // over the last second of the stream time
+    int64_t bitrate{0};
+    bool pcr{false};
+    bool scrambled{false};
+};
+
+//   The error counters are named by ETSI TR 101 290 (the priority 1 and 2 checks).
+struct TsAnalyzerStatistics
+{
+    bool active{false};
+    int64_t packets{0};
+    int64_t bitrate{0};
+
+    int64_t syncLosses{0};              // 1.1
+    int64_t syncByteErrors{0};          // 1.2
+    int64_t patErrors{0};               // 1.3
+    int64_t continuityErrors{0};        // 1.4
+    int64_t pmtErrors{0};               // 1.5
+    int64_t pidErrors{0};               // 1.6
+    int64_t transportErrors{0};         // 2.1
+    int64_t crcErrors{0};               // 2.2
+    int64_t pcrRepetitionErrors{0};     // 2.3a
+    int64_t pcrDiscontinuityErrors{0};  // 2.3b
+    int64_t pcrAccuracyErrors{0};       // 2.4
+
+    int64_t maxPatIntervalMs{0};
+    int64_t maxPmtIntervalMs{0};
+    int64_t maxPcrIntervalMs{0};
+    int64_t maxPcrJitterNs{0};
+
+    // sorted by PID
+    std::vector<TsPidStatistics> pids;
+};
+
+//---------------------------------------------------------------------------------------
+//   Transport stream analyser (ETSI TR 101 290 priority 1 and 2) of the raw input.
+//   The input of the demuxer is passed through the own AVIOContext, so every packet
+// is checked before libavformat gets it: the sync (the sync byte is searched with SSE2
+// while the sync is lost), the continuity counters, the transport errors, the PSI
+// (PAT/PMT) repetition and CRC, the PCR repetition and accuracy, and the bitrate of
+// each PID. The intervals are measured by the stream time (the PCR interpolated by
+// the packet count), so the checks give the same results for the live streams and
+// for the files read at any speed.
+//   The input which isn't a transport stream is only passed through.
+class TsAnalyzer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TsAnalyzer(QObject *parent = nullptr);
+    virtual ~TsAnalyzer();
+
+    static bool isSupported(const QString &url);
+
+    // the source opened by the caller (it must stay open until close)
+    bool open(AVIOContext *source);
+    // the source opened (and then closed) by the analyser itself; the protocol options
+    // are passed to avio_open2 (the unused ones are left in the dictionary)
+    bool open(const QString &url, const AVIOInterruptCB *interrupt, AVDictionary **options = nullptr);
+    void close();
+    bool isOpen() const;
+
+    AVIOContext *getIoContext() const;
+    // called when it turns out that the input isn't a transport stream
+    void stopAnalysis();
+    TsAnalyzerStatistics getStatistics() const;
+    // fed by the bitrates of the PIDs once per second of the stream time
+    void setBitrateHistory(std::shared_ptr<BitrateHistory> history);
+    // by the last payload of the PID (lock-free, called for each demuxed packet)
+    bool isScrambled(int pid) const;
+
+private:
+    struct PidState
+    {
+        int lastContinuityCounter{-1};
+        bool duplicated{false};
+        int64_t packets{0};
+        int64_t windowPackets{0};
+        int64_t bitrate{0};
+        int64_t continuityErrors{0};
+
+        int64_t lastPcr{-1};
+        int64_t lastPcrPacket{0};
+        // 27 MHz ticks per packet of the multiplex, found by the PCRs of the PID
+        double ticksPerPacket{0.0};
+        bool pcr{false};
+
+        // transport_scrambling_control of the last payload, PES_scrambling_control of
+        // the last PES header which isn't scrambled by itself
+        bool transportScrambled{false};
+        bool pesScrambled{false};
+
+        // PMT is carried by the PID (it's listed by PAT)
+        bool pmt{false};
+        // the number of PMTs which list the PID
+        int references{0};
+        int64_t lastSeenUs{-1};
+        bool missing{false};
+
+        // the PSI section being assembled (PAT/PMT PIDs)
+        std::vector<uint8_t> section;
+    };
+
+    // PAT, or PMT of one program
+    struct TableState
+    {
+        uint32_t crc{0};
+        int64_t lastTimeUs{-1};
+        bool overdue{false};
+        // the PMT PIDs (PAT) or the listed PIDs (PMT)
+        std::vector<int> pids;
+    };
+
+    bool createIoContext();
+    void resetState();
+    void resync();
+
+    void analyze(const uint8_t *data, int size);
+    void checkPacket(const uint8_t *packet);
+    void processPacket(const uint8_t *packet);
+    void processPcr(int pid, PidState &state, int64_t pcr, bool discontinuity);
+    void processScrambling(int pid, PidState &state, const uint8_t *payload, int size,
+                           int scrambling, bool unitStart);
+    void processPsi(int pid, PidState &state, const uint8_t *payload, int size, bool unitStart);
+    void processSection(int pid, const uint8_t *section, int size);
+    void processPat(const uint8_t *section, int size);
+    void processPmt(int pid, const uint8_t *section, int size);
+    void checkTableInterval(TableState &table, int64_t &errors, int64_t &maxIntervalMs);
+    void updateWindow(int64_t nowUs);
+
+    int64_t getStreamTimeUs() const;
+    static int findSync(const uint8_t *buffer, int size);
+    static bool isSyncAt(const uint8_t *buffer, int position);
+
+    static int readCallback(void *opaque, uint8_t *buf, int bufSize);
+    static int64_t seekCallback(void *opaque, int64_t offset, int whence);
+
+    enum {
+        TsPacketSize = 188,
+        SyncByte = 0x47,
+        NullPid = 0x1FFF,
+        PidCount = 8192,
+        // the sync is acquired by 5 sync bytes in a row, lost by 2 corrupted ones
+        SyncConfirmations = 5,
+        SyncLossThreshold = 2,
+        ReadBufferSize = 64 * 1024,
+        // the input not synchronised within this size isn't a transport stream
+        DetectionLimit = 1024 * 1024,
+        MaxSectionSize = 4096,
+        MaxPsiIntervalMs = 500,
+        MaxPcrIntervalMs = 40,
+        MaxPcrDeltaMs = 100,
+        MaxPcrJitterNs = 500,
+        PidTimeoutMs = 5000,
+        WindowMs = 1000
+    };
+
+    AVIOContext *source{nullptr};
+    bool sourceOwned{false};
+    AVIOContext *ioContext{nullptr};
+
+    mutable std::mutex mutex;
+    bool analysing{false};
+    bool detected{false};
+    int64_t receivedBytes{0};
+
+    bool synced{false};
+    int corruptedSyncBytes{0};
+    // the packet split between the reads, or the data searched for the sync
+    std::vector<uint8_t> carry;
+    std::vector<uint8_t> scratch;
+
+    std::vector<PidState> pids;
+    // the copy of the scrambled state which is read without the lock
+    std::array<std::atomic_bool, PidCount> scrambledPids;
+    TableState pat;
+    // key - PMT PID
+    std::unordered_map<int, TableState> pmts;
+
+    int64_t packetCount{0};
+    // the stream time: the reference PCR PID (the first one found) and its clock
+    int clockPid{-1};
+    // unwrapped 27 MHz ticks from the first PCR
+    int64_t clockTicks{-1};
+    int64_t clockPacket{0};
+    double clockTicksPerPacket{0.0};
+    int64_t windowStartUs{-1};
+    int64_t windowPackets{0};
+    int64_t bitrate{0};
+
+    TsAnalyzerStatistics counters;
+    std::shared_ptr<BitrateHistory> bitrateHistory;
+    std::vector<std::pair<int, int64_t>> bitrateSamples;
+
+    Loggable loggable;
+};
+
+#endif // TSANALYZER_H
@@ -69,10 +69,17 @@ constexpr AVPixelFormat mapPixelFormat(QVideoFrameFormat::PixelFormat pixelForma
 
     case QVideoFrameFormat::Format_YUYV:     return AV_PIX_FMT_YUYV422;
     case QVideoFrameFormat::Format_YUV420P:  return AV_PIX_FMT_YUV420P;
+    case QVideoFrameFormat::Format_YUV422P:  return AV_PIX_FMT_YUV422P;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+    case QVideoFrameFormat::Format_YUV420P10: return AV_PIX_FMT_YUV420P10LE;
+#endif
 
     case QVideoFrameFormat::Format_NV12:     return AV_PIX_FMT_NV12;
     case QVideoFrameFormat::Format_NV21:     return AV_PIX_FMT_NV21;
 
+    case QVideoFrameFormat::Format_P010:     return AV_PIX_FMT_P010LE;
+    case QVideoFrameFormat::Format_P016:     return AV_PIX_FMT_P016LE;
+
     case QVideoFrameFormat::Format_Y8:       return AV_PIX_FMT_GRAY8;
     case QVideoFrameFormat::Format_Y16:      return AV_PIX_FMT_GRAY16LE;
     case QVideoFrameFormat::Format_Jpeg:     return AV_PIX_FMT_YUVJ422P;
@@ -99,12 +106,21 @@ constexpr QVideoFrameFormat::PixelFormat mapPixelFormat(AVPixelFormat avFormat)
     case AV_PIX_FMT_YUVJ420P:
     case AV_PIX_FMT_YUV420P:  return QVideoFrameFormat::Format_YUV420P;
 
+    // the full range of the JPEG formats is passed by the colour details of the frame
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUV422P:  return QVideoFrameFormat::Format_YUV422P;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+    case AV_PIX_FMT_YUV420P10LE: return QVideoFrameFormat::Format_YUV420P10;
+#endif
+
     case AV_PIX_FMT_NV12:     return QVideoFrameFormat::Format_NV12;
     case AV_PIX_FMT_NV21:     return QVideoFrameFormat::Format_NV21;
 
+    case AV_PIX_FMT_P010LE:   return QVideoFrameFormat::Format_P010;
+    case AV_PIX_FMT_P016LE:   return QVideoFrameFormat::Format_P016;
+
     case AV_PIX_FMT_GRAY8:    return QVideoFrameFormat::Format_Y8;
     case AV_PIX_FMT_GRAY16LE: return QVideoFrameFormat::Format_Y16;
-    case AV_PIX_FMT_YUVJ422P: return QVideoFrameFormat::Format_Jpeg;
 
     default:
         return QVideoFrameFormat::Format_Invalid;
@@ -114,6 +130,78 @@ constexpr QVideoFrameFormat::PixelFormat mapPixelFormat(AVPixelFormat avFormat)
 //---------------------------------------------------------------------------------------
 QString mapAVActiveFormatDescriptionToString(AVActiveFormatDescription afd);
 
+//=======================================================================================
+// Colour metadata...
+
+//---------------------------------------------------------------------------------------
+//   The JPEG formats are the same as the YUV formats with the full range.
+constexpr AVPixelFormat mapJpegPixelFormat(AVPixelFormat avFormat)
+{
+    switch (avFormat)
+    {
+    case AV_PIX_FMT_YUVJ420P: return AV_PIX_FMT_YUV420P;
+    case AV_PIX_FMT_YUVJ422P: return AV_PIX_FMT_YUV422P;
+    case AV_PIX_FMT_YUVJ444P: return AV_PIX_FMT_YUV444P;
+    default:
+        return avFormat;
+    }
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+//---------------------------------------------------------------------------------------
+constexpr QVideoFrameFormat::ColorSpace mapColorSpace(AVColorSpace colorSpace)
+{
+    switch (colorSpace)
+    {
+    case AVCOL_SPC_BT709:      return QVideoFrameFormat::ColorSpace_BT709;
+
+    case AVCOL_SPC_FCC:
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:  return QVideoFrameFormat::ColorSpace_BT601;
+
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:  return QVideoFrameFormat::ColorSpace_BT2020;
+
+    default:
+        return QVideoFrameFormat::ColorSpace_Undefined;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+constexpr QVideoFrameFormat::ColorTransfer mapColorTransfer(AVColorTransferCharacteristic transfer)
+{
+    switch (transfer)
+    {
+    case AVCOL_TRC_BT709:
+    case AVCOL_TRC_BT2020_10:
+    case AVCOL_TRC_BT2020_12:    return QVideoFrameFormat::ColorTransfer_BT709;
+
+    case AVCOL_TRC_SMPTE170M:    return QVideoFrameFormat::ColorTransfer_BT601;
+    case AVCOL_TRC_LINEAR:       return QVideoFrameFormat::ColorTransfer_Linear;
+    case AVCOL_TRC_GAMMA22:      return QVideoFrameFormat::ColorTransfer_Gamma22;
+    case AVCOL_TRC_GAMMA28:      return QVideoFrameFormat::ColorTransfer_Gamma28;
+    case AVCOL_TRC_SMPTE2084:    return QVideoFrameFormat::ColorTransfer_ST2084;
+    case AVCOL_TRC_ARIB_STD_B67: return QVideoFrameFormat::ColorTransfer_STD_B67;
+
+    default:
+        return QVideoFrameFormat::ColorTransfer_Unknown;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+constexpr QVideoFrameFormat::ColorRange mapColorRange(AVColorRange range)
+{
+    switch (range)
+    {
+    case AVCOL_RANGE_MPEG: return QVideoFrameFormat::ColorRange_Video;
+    case AVCOL_RANGE_JPEG: return QVideoFrameFormat::ColorRange_Full;
+
+    default:
+        return QVideoFrameFormat::ColorRange_Unknown;
+    }
+}
+#endif
+
 //=======================================================================================
 // Audio formats...
 
@@ -0,0 +1,145 @@
+#include "videobufferpool.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+}
+
+//---------------------------------------------------------------------------------------
+VideoBufferPool::VideoBufferPool()
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+VideoBufferPool::~VideoBufferPool()
+{
+    for (auto& [sizeClass, blocks] : freeBlocks)
+    {
+        for (Block &block : blocks)
+            av_free(block.data);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+AVBufferRef *VideoBufferPool::acquire(size_t size)
+{
+    size_t sizeClass = (size + SizeClassGranularity - 1) / SizeClassGranularity * SizeClassGranularity;
+    int64_t now = av_gettime_relative();
+
+    Block block;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        auto it = freeBlocks.find(sizeClass);
+        if (it != freeBlocks.end() && !it->second.empty())
+        {
+            block = it->second.back();
+            it->second.pop_back();
+        }
+        trim(now);
+    }
+
+    if (!block.data)
+    {
+        // av_malloc() provides the alignment required by the SIMD code of the FFmpeg
+        block.data = static_cast<uint8_t*>(av_malloc(sizeClass));
+        if (!block.data)
+            return nullptr;
+        block.size = sizeClass;
+
+        std::lock_guard<std::mutex> guard(mutex);
+        allocatedSize += sizeClass;
+    }
+
+    Lease *lease = new Lease{shared_from_this(), block};
+    AVBufferRef *ref = av_buffer_create(block.data, size, &VideoBufferPool::releaseBuffer, lease, 0);
+    if (!ref)
+    {
+        release(block);
+        delete lease;
+    }
+    return ref;
+}
+
+//---------------------------------------------------------------------------------------
+size_t VideoBufferPool::getAllocatedSize() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return allocatedSize;
+}
+
+//---------------------------------------------------------------------------------------
+size_t VideoBufferPool::getFreeBlocksCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    size_t count = 0;
+    for (auto& [sizeClass, blocks] : freeBlocks)
+        count += blocks.size();
+    return count;
+}
+
+//---------------------------------------------------------------------------------------
+//   Called by the FFmpeg when the last reference to the buffer is released (it may be
+// any thread, e.g. the GUI thread when the video sink drops the frame).
+void VideoBufferPool::releaseBuffer(void *opaque, uint8_t *data)
+{
+    Lease *lease = static_cast<Lease*>(opaque);
+    lease->pool->release(lease->block);
+    delete lease;
+}
+
+//---------------------------------------------------------------------------------------
+void VideoBufferPool::release(Block block)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+
+    int64_t now = av_gettime_relative();
+    block.releaseTime = now;
+
+    std::vector<Block> &blocks = freeBlocks[block.size];
+    if (blocks.size() < MaxFreeBlocksPerClass)
+    {
+        blocks.push_back(block);
+    }
+    else
+    {
+        allocatedSize -= block.size;
+        av_free(block.data);
+    }
+
+    trim(now);
+}
+
+//---------------------------------------------------------------------------------------
+//   Must be called with the locked mutex.
+void VideoBufferPool::trim(int64_t now)
+{
+    if (now - lastTrimTime < IdleTimeoutUs / 4)
+        return;
+    lastTrimTime = now;
+
+    for (auto it = freeBlocks.begin(); it != freeBlocks.end(); )
+    {
+        std::vector<Block> &blocks = it->second;
+        // the oldest released blocks are at the beginning
+        auto idleEnd = std::find_if(blocks.begin(), blocks.end(), [now](const Block &block){
+            return now - block.releaseTime < IdleTimeoutUs;
+        });
+        for (auto blockIt = blocks.begin(); blockIt != idleEnd; ++blockIt)
+        {
+            allocatedSize -= blockIt->size;
+            av_free(blockIt->data);
+        }
+        blocks.erase(blocks.begin(), idleEnd);
+
+        if (blocks.empty())
+            it = freeBlocks.erase(it);
+        else
+            ++it;
+    }
+}
+
+//---------------------------------------------------------------------------------------
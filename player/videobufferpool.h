@@ -0,0 +1,62 @@
+#ifndef VIDEOBUFFERPOOL_H
+#define VIDEOBUFFERPOOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/buffer.h>
+}
+
+//---------------------------------------------------------------------------------------
+//   Pool of the picture buffers for the decoder's get_buffer2() callback.
+//   Buffers are grouped by size classes (rounded up to the page size) and reused
+// across frames. The returned AVBufferRef keeps the pool alive, so the frames wrapped
+// into the QVideoFrame may outlive the decoder. The blocks which were not used
+// during IdleTimeoutUs are released, so the pool shrinks after the resolution change
+// or when the playback is stopped.
+class VideoBufferPool : public std::enable_shared_from_this<VideoBufferPool>
+{
+public:
+    VideoBufferPool();
+    ~VideoBufferPool();
+
+    AVBufferRef *acquire(size_t size);
+
+    size_t getAllocatedSize() const;
+    size_t getFreeBlocksCount() const;
+
+private:
+    struct Block
+    {
+        uint8_t *data{nullptr};
+        size_t size{0};
+        int64_t releaseTime{0};
+    };
+
+    struct Lease
+    {
+        std::shared_ptr<VideoBufferPool> pool;
+        Block block;
+    };
+
+    static void releaseBuffer(void *opaque, uint8_t *data);
+    void release(Block block);
+    void trim(int64_t now);
+
+    enum {
+        SizeClassGranularity = 4096,
+        IdleTimeoutUs = 3000000,
+        MaxFreeBlocksPerClass = 16
+    };
+
+    mutable std::mutex mutex;
+    // key - size class
+    std::map<size_t, std::vector<Block>> freeBlocks;
+    size_t allocatedSize{0};
+    int64_t lastTrimTime{0};
+};
+
+#endif // VIDEOBUFFERPOOL_H
@@ -0,0 +1,288 @@
+#include "videoconverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "pixelrepack.h"
+#include "utils.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+//---------------------------------------------------------------------------------------
+bool VideoConverter::ScalerKey::operator<(const ScalerKey &other) const
+{
+    return std::tie(srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, flags, colorSpace, range)
+            < std::tie(other.srcWidth, other.srcHeight, other.srcFormat,
+                       other.dstWidth, other.dstHeight, other.dstFormat,
+                       other.flags, other.colorSpace, other.range);
+}
+
+//---------------------------------------------------------------------------------------
+VideoConverter::VideoConverter()
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+VideoConverter::~VideoConverter()
+{
+    for (auto& [key, scaler] : scalers)
+        sws_freeContext(scaler.context);
+}
+
+//---------------------------------------------------------------------------------------
+//   Empty rectangle means the whole frame.
+void VideoConverter::setSourceRect(const QRect &rect)
+{
+    sourceRect = rect;
+}
+
+//---------------------------------------------------------------------------------------
+//   The picture is downscaled to fit into this size (in the device pixels), but never
+// upscaled: the video sink does it better. Empty size means the full resolution.
+void VideoConverter::setMaxOutputSize(const QSize &size)
+{
+    maxOutputSize = size;
+}
+
+//---------------------------------------------------------------------------------------
+//   Returns a new reference to the frame with the applied crop, must be freed by the
+// caller.
+AVFrame *VideoConverter::crop(const AVFrame *avFrame) const
+{
+    AVFrame *cropped = av_frame_clone(avFrame);
+    if (!cropped)
+        return nullptr;
+
+    QRect area = sourceRect.intersected(QRect(0, 0, avFrame->width, avFrame->height));
+    if (sourceRect.isEmpty() || area.isEmpty())
+        return cropped;
+
+    cropped->crop_left = area.left();
+    cropped->crop_top = area.top();
+    cropped->crop_right = avFrame->width - 1 - area.right();
+    cropped->crop_bottom = avFrame->height - 1 - area.bottom();
+
+    // unaligned: the pointers may be offset by any number of pixels
+    if (av_frame_apply_cropping(cropped, AV_FRAME_CROP_UNALIGNED) < 0)
+    {
+        av_frame_unref(cropped);
+        av_frame_ref(cropped, avFrame);
+    }
+    return cropped;
+}
+
+//---------------------------------------------------------------------------------------
+//   Size of the picture with square pixels, fitted into the maximal output size.
+QSize VideoConverter::getOutputSize(const AVFrame *avFrame) const
+{
+    double width = avFrame->width;
+    double height = avFrame->height;
+
+    AVRational sar = avFrame->sample_aspect_ratio;
+    if (sar.num > 0 && sar.den > 0 && sar.num != sar.den)
+        width = width * sar.num / sar.den;
+
+    if (maxOutputSize.width() > 0 && maxOutputSize.height() > 0)
+    {
+        double scale = std::min({1.0, maxOutputSize.width() / width, maxOutputSize.height() / height});
+        width *= scale;
+        height *= scale;
+    }
+
+    if (int(width) == avFrame->width && int(height) == avFrame->height)
+        return QSize(avFrame->width, avFrame->height);
+
+    // even sizes for the subsampled chroma
+    int outputWidth = std::max(2, int(std::lround(width / 2)) * 2);
+    int outputHeight = std::max(2, int(std::lround(height / 2)) * 2);
+    return QSize(outputWidth, outputHeight);
+}
+
+//---------------------------------------------------------------------------------------
+//   Scales and converts the frame into the new video frame in one pass.
+//   The output keeps the colour matrix and the range of the source (the sink is told
+// about them), so the scaler doesn't do any extra colour conversion.
+bool VideoConverter::convert(const AVFrame *avFrame, const QSize &outputSize,
+                             QVideoFrameFormat::PixelFormat pixelFormat, QVideoFrame &videoFrame)
+{
+    ScalerKey key;
+    key.srcWidth = avFrame->width;
+    key.srcHeight = avFrame->height;
+    key.srcFormat = mapJpegPixelFormat(static_cast<AVPixelFormat>(avFrame->format));
+    key.dstWidth = outputSize.width();
+    key.dstHeight = outputSize.height();
+    key.dstFormat = mapPixelFormat(pixelFormat);
+    if (key.dstFormat == AV_PIX_FMT_NONE)
+        return false;
+
+    // enlarging (aspect ratio correction) needs better interpolation than the downscaling
+    key.flags = outputSize.width() > avFrame->width ? SWS_BICUBIC : SWS_BILINEAR;
+
+    ColorDetails details = getColorDetails(avFrame);
+    key.colorSpace = details.colorSpace;
+    key.range = details.range;
+
+    SwsContext *swsContext = getScaler(key);
+    if (!swsContext)
+        return false;
+
+    QVideoFrameFormat format(outputSize, pixelFormat);
+    applyColorDetails(format, details);
+
+    videoFrame = QVideoFrame(format);
+    if (!videoFrame.map(QVideoFrame::WriteOnly))
+        return false;
+
+    uint8_t *dstData[4] = {};
+    int dstLinesize[4] = {};
+    for (int i = 0; i < videoFrame.planeCount() && i < 4; ++i)
+    {
+        dstData[i] = videoFrame.bits(i);
+        dstLinesize[i] = videoFrame.bytesPerLine(i);
+    }
+
+    sws_scale(swsContext, avFrame->data, avFrame->linesize, 0, avFrame->height, dstData, dstLinesize);
+
+    videoFrame.unmap();
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+//   Repacks the high bit depth planar frame to P010/P016 without scaling (see
+// pixelrepack.h); it's much cheaper than the generic conversion.
+bool VideoConverter::repack(const AVFrame *avFrame, QVideoFrame &videoFrame)
+{
+    AVPixelFormat dstFormat = getSemiPlanar16Format(static_cast<AVPixelFormat>(avFrame->format));
+    if (dstFormat == AV_PIX_FMT_NONE)
+        return false;
+
+    QVideoFrameFormat format(QSize(avFrame->width, avFrame->height), mapPixelFormat(dstFormat));
+    applyColorDetails(format, getColorDetails(avFrame));
+
+    videoFrame = QVideoFrame(format);
+    if (!videoFrame.map(QVideoFrame::WriteOnly))
+        return false;
+
+    uint8_t *dstData[2] = {videoFrame.bits(0), videoFrame.bits(1)};
+    int dstLinesize[2] = {videoFrame.bytesPerLine(0), videoFrame.bytesPerLine(1)};
+    bool ok = repackToSemiPlanar16(avFrame, dstData, dstLinesize);
+
+    videoFrame.unmap();
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------
+//   Pixel format of the converted pictures: the same format if the sink supports it,
+// P010/P016 for the other high bit depth YUV formats (to keep the precision), YUV420P
+// for the rest.
+QVideoFrameFormat::PixelFormat VideoConverter::getOutputPixelFormat(AVPixelFormat format)
+{
+    QVideoFrameFormat::PixelFormat pixelFormat = mapPixelFormat(format);
+    if (pixelFormat != QVideoFrameFormat::Format_Invalid && pixelFormat != QVideoFrameFormat::Format_Jpeg)
+        return pixelFormat;
+
+    AVPixelFormat semiPlanar = getSemiPlanar16Format(format);
+    if (semiPlanar != AV_PIX_FMT_NONE)
+        return mapPixelFormat(semiPlanar);
+
+    return QVideoFrameFormat::Format_YUV420P;
+}
+
+//---------------------------------------------------------------------------------------
+//   Colour details of the frame with the defaults for the unspecified values: BT.709
+// for HD and BT.601 for SD, the full range for the JPEG formats.
+ColorDetails VideoConverter::getColorDetails(const AVFrame *avFrame)
+{
+    ColorDetails details;
+
+    switch (avFrame->colorspace)
+    {
+    case AVCOL_SPC_BT709:
+    case AVCOL_SPC_FCC:
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+    case AVCOL_SPC_SMPTE240M:
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        details.colorSpace = avFrame->colorspace;
+        break;
+    default:
+        details.colorSpace = avFrame->height > 576 ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+        break;
+    }
+
+    AVPixelFormat format = static_cast<AVPixelFormat>(avFrame->format);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    bool rgb = desc && (desc->flags & AV_PIX_FMT_FLAG_RGB);
+
+    if (rgb || avFrame->color_range == AVCOL_RANGE_JPEG || mapJpegPixelFormat(format) != format)
+        details.range = AVCOL_RANGE_JPEG;
+    else
+        details.range = AVCOL_RANGE_MPEG;
+
+    details.transfer = avFrame->color_trc;
+    return details;
+}
+
+//---------------------------------------------------------------------------------------
+void VideoConverter::applyColorDetails(QVideoFrameFormat &format, const ColorDetails &details)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+    format.setColorSpace(mapColorSpace(details.colorSpace));
+    format.setColorTransfer(mapColorTransfer(details.transfer));
+    format.setColorRange(mapColorRange(details.range));
+#else
+    if (details.range == AVCOL_RANGE_JPEG)
+        format.setYCbCrColorSpace(QVideoFrameFormat::YCbCr_JPEG);
+    else if (details.colorSpace == AVCOL_SPC_BT709)
+        format.setYCbCrColorSpace(QVideoFrameFormat::YCbCr_BT709);
+    else if (details.colorSpace == AVCOL_SPC_BT2020_NCL || details.colorSpace == AVCOL_SPC_BT2020_CL)
+        format.setYCbCrColorSpace(QVideoFrameFormat::YCbCr_BT2020);
+    else
+        format.setYCbCrColorSpace(QVideoFrameFormat::YCbCr_BT601);
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+//   The least recently used scaler is released when the cache is full.
+SwsContext *VideoConverter::getScaler(const ScalerKey &key)
+{
+    auto it = scalers.find(key);
+    if (it != scalers.end())
+    {
+        it->second.lastUse = ++useCounter;
+        return it->second.context;
+    }
+
+    SwsContext *context = sws_getContext(key.srcWidth, key.srcHeight, static_cast<AVPixelFormat>(key.srcFormat),
+                                         key.dstWidth, key.dstHeight, static_cast<AVPixelFormat>(key.dstFormat),
+                                         key.flags, nullptr, nullptr, nullptr);
+    if (!context)
+        return nullptr;
+
+    // the same matrix and range on both sides: no colour conversion, only the correct
+    // coefficients for the RGB output and for the chroma interpolation
+    int fullRange = key.range == AVCOL_RANGE_JPEG ? 1 : 0;
+    const int *coefficients = sws_getCoefficients(key.colorSpace);
+    sws_setColorspaceDetails(context, coefficients, fullRange, coefficients, fullRange,
+                             0, 1 << 16, 1 << 16);
+
+    if (scalers.size() >= MaxCachedScalers)
+    {
+        auto oldest = std::min_element(scalers.begin(), scalers.end(), [](const auto &a, const auto &b){
+            return a.second.lastUse < b.second.lastUse;
+        });
+        sws_freeContext(oldest->second.context);
+        scalers.erase(oldest);
+    }
+
+    scalers[key] = Scaler{context, ++useCounter};
+    return context;
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,90 @@
+#ifndef VIDEOCONVERTER_H
+#define VIDEOCONVERTER_H
+
+#include <QRect>
+#include <QSize>
+#include <QVideoFrame>
+
+#include <map>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+//---------------------------------------------------------------------------------------
+//   Output stage of the video decoder: crop, aspect ratio correction, scaling to the
+// size of the video widget and conversion to the pixel format of the video sink.
+//   The crop is done by the offsets of the plane pointers (no copying), the scaling and
+// the conversion are done by one sws_scale() call with a cached context. If nothing
+// but the crop is needed, the cropped frame is passed to the sink without copying.
+//   The colour matrix and the range of each frame are passed to the scaler; the
+// scalers are cached per combination of the sizes, the formats and the colour details,
+// so the coefficient tables are calculated only once.
+struct ColorDetails
+{
+    AVColorSpace colorSpace{AVCOL_SPC_UNSPECIFIED};
+    AVColorRange range{AVCOL_RANGE_UNSPECIFIED};
+    AVColorTransferCharacteristic transfer{AVCOL_TRC_UNSPECIFIED};
+};
+
+class VideoConverter
+{
+public:
+    VideoConverter();
+    ~VideoConverter();
+
+    void setSourceRect(const QRect &rect);
+    void setMaxOutputSize(const QSize &size);
+
+    AVFrame *crop(const AVFrame *avFrame) const;
+    QSize getOutputSize(const AVFrame *avFrame) const;
+
+    bool convert(const AVFrame *avFrame, const QSize &outputSize,
+                 QVideoFrameFormat::PixelFormat pixelFormat, QVideoFrame &videoFrame);
+    bool repack(const AVFrame *avFrame, QVideoFrame &videoFrame);
+
+    static QVideoFrameFormat::PixelFormat getOutputPixelFormat(AVPixelFormat format);
+
+    static ColorDetails getColorDetails(const AVFrame *avFrame);
+    static void applyColorDetails(QVideoFrameFormat &format, const ColorDetails &details);
+
+private:
+    VideoConverter(const VideoConverter&) = delete;
+    VideoConverter& operator=(const VideoConverter&) = delete;
+
+    struct ScalerKey
+    {
+        bool operator<(const ScalerKey &other) const;
+
+        int srcWidth{0};
+        int srcHeight{0};
+        int srcFormat{-1};
+        int dstWidth{0};
+        int dstHeight{0};
+        int dstFormat{-1};
+        int flags{0};
+        int colorSpace{AVCOL_SPC_UNSPECIFIED};
+        int range{AVCOL_RANGE_UNSPECIFIED};
+    };
+
+    struct Scaler
+    {
+        SwsContext *context{nullptr};
+        int64_t lastUse{0};
+    };
+
+    SwsContext *getScaler(const ScalerKey &key);
+
+    enum {
+        MaxCachedScalers = 4
+    };
+
+    QRect sourceRect;
+    QSize maxOutputSize;
+
+    std::map<ScalerKey, Scaler> scalers;
+    int64_t useCounter{0};
+};
+
+#endif // VIDEOCONVERTER_H
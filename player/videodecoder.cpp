@@ -5,40 +5,113 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
 #define FFMPEG_ALIGNMENT (32)
+#define FFMPEG_PADDING (16 + 64 - 1)
 
 //---------------------------------------------------------------------------------------
 VideoDecoder::VideoDecoder(const QString &name, QObject *parent)
     : Decoder{name, parent}
 {
-
+    bufferPool = std::make_shared<VideoBufferPool>();
 }
 
 //---------------------------------------------------------------------------------------
 VideoDecoder::~VideoDecoder()
 {
-    if (deinterlacer)
-        delete deinterlacer;
-
-    if (cropper)
-        delete cropper;
+    if (filter)
+        delete filter;
 }
 
 //---------------------------------------------------------------------------------------
+//   While the output isn't visible the frames are only decoded (to keep the reference
+// frames valid), the filtering and the conversion are skipped.
 int VideoDecoder::outputFrame(AVFrame *avFrame)
 {
-    int size = 0;
-    if (!avFrame->interlaced_frame)
-    {   // not interlaced
-        size = outputVideoFrame(avFrame);
+    if (presentationStart != AV_NOPTS_VALUE)
+    {
+        int64_t pts = avFrame->best_effort_timestamp;
+        if (pts != AV_NOPTS_VALUE && pts < presentationStart)
+        {
+            skippedFrames++;
+            return 0;
+        }
+        presentationStart = AV_NOPTS_VALUE;
+    }
+
+    if (!outputVisible.load())
+    {
+        skippedFrames++;
+        return 0;
+    }
+
+    if (activePictureDetection.load())
+    {
+        if (activePictureDetector.analyse(avFrame))
+        {
+            QRect area = activePictureDetector.getActiveArea();
+            loggable.logMessage(objectName(), QtDebugMsg,
+                                QString("Active picture: %1x%2 at (%3, %4) of %5x%6.")
+                                .arg(area.width()).arg(area.height()).arg(area.x()).arg(area.y())
+                                .arg(avFrame->width).arg(avFrame->height));
+        }
     }
     else
     {
-        if (!deinterlacer || !cropper)
-            createDeinterlacingFiltersQueue(avFrame);
-        size = convertFrame(avFrame, deinterlacer);
+        activePictureDetector.reset();
     }
-    return size;
+
+    QRect activeArea;
+    if (activePictureDetection.load() && activePictureDetector.hasActiveArea())
+        activeArea = activePictureDetector.getActiveArea();
+
+    // without other filters the crop is done by the output stage
+    QString description = getFilterDescription(avFrame);
+    if (description.isEmpty())
+    {
+        setFiltering(false);
+        converter.setSourceRect(activeArea);
+        return outputVideoFrame(avFrame);
+    }
+    setFiltering(true);
+
+    converter.setSourceRect(QRect());
+    if (activeArea.isValid())
+        description.prepend(QString("crop=w=%1:h=%2:x=%3:y=%4,")
+                            .arg(activeArea.width()).arg(activeArea.height())
+                            .arg(activeArea.x()).arg(activeArea.y()));
+
+    if (!filter)
+        filter = new FFmpegFilter("Video Filter");
+
+    AVRational timeBase = codecContext->pkt_timebase;
+    filter->setTimeBase(timeBase.num ? timeBase : AVRational{1, AV_TIME_BASE});
+    filter->setThreadCount(DecoderThreadingPolicy::getInstance()->getFilterThreadCount(this));
+    filter->setDescription(description);
+
+    {
+        std::lock_guard<std::mutex> guard(filterSettingsMutex);
+        activeFilterDescription = description;
+    }
+    filterThreads.store(filter->getThreadCount());
+
+    return filterFrame(avFrame);
+}
+
+//---------------------------------------------------------------------------------------
+//   The filters (e.g. the deinterlacer) keep the previous pictures too, so the graph is
+// rebuilt on the next frame.
+void VideoDecoder::flush()
+{
+    Decoder::flush();
+
+    if (filter)
+        filter->reset();
 }
 
 //---------------------------------------------------------------------------------------
@@ -48,152 +121,358 @@ QSize VideoDecoder::getPictureSize() const
 }
 
 //---------------------------------------------------------------------------------------
-int VideoDecoder::convertFrame(AVFrame *avFrame, FFmpegFilter *filter)
+//   Additional filters (libavfilter syntax) appended to the end of the filter chain,
+// e.g. "scale=1280:-2,format=yuv420p". Empty string disables them.
+void VideoDecoder::setUserFilters(const QString &filters)
 {
-    int size = 0;
-    int result;
+    std::lock_guard<std::mutex> guard(filterSettingsMutex);
+    userFilters = filters.trimmed();
+}
 
-    /// FIXME: remove hardcoded crop filter setting
-    if (avFrame->interlaced_frame && isNeedCropLineTo704px(avFrame))
-        filter->setNextFilter(cropper);
+//---------------------------------------------------------------------------------------
+//   The field rate mode outputs one picture per field (e.g. 50p from 50i), the frame
+// rate mode - one picture per frame.
+void VideoDecoder::setDeinterlacer(const QString &algorithm, bool fieldRateOutput)
+{
+    std::lock_guard<std::mutex> guard(filterSettingsMutex);
+
+    if (getDeinterlacers().contains(algorithm))
+        deinterlacer = algorithm;
     else
-        filter->setNextFilter(nullptr);
+        loggable.logMessage(objectName(), QtWarningMsg, QString("Unknown deinterlacer: %1.").arg(algorithm));
+    fieldRate = fieldRateOutput;
+}
 
-    if (!filter->isReady())
-    {
-        if (filter == cropper)
-            initCropper(avFrame);
+//---------------------------------------------------------------------------------------
+//   The output pictures are downscaled to fit into this size (usually the size of the
+// video widget). Empty size means the full resolution.
+void VideoDecoder::setOutputSize(const QSize &size)
+{
+    std::lock_guard<std::mutex> guard(filterSettingsMutex);
+    outputSize = size;
+}
 
-        if (filter == deinterlacer)
-            initDeinterlacer(avFrame);
-    }
+//---------------------------------------------------------------------------------------
+void VideoDecoder::setOutputVisible(bool visible)
+{
+    outputVisible.store(visible);
+}
 
-    result = filter->feedGraph(avFrame);
-    if (result < 0)
+//---------------------------------------------------------------------------------------
+void VideoDecoder::setPresentationStart(int64_t pts)
+{
+    presentationStart = pts;
+}
+
+//---------------------------------------------------------------------------------------
+VideoOutputStatistics VideoDecoder::getOutputStatistics() const
+{
+    VideoOutputStatistics stat;
+    stat.visible = outputVisible.load();
     {
-        loggable.logAvError(objectName(), QtWarningMsg,
-                        QString("Error while feeding the filter graph for %1.").arg(filter->objectName()),
-                        result);
-        return 0;
+        std::lock_guard<std::mutex> guard(filterSettingsMutex);
+        stat.outputSize = lastOutputSize;
     }
+    stat.presentedFrames = presentedFrames.load();
+    stat.skippedFrames = skippedFrames.load();
+    return stat;
+}
 
-    while (true)
+//---------------------------------------------------------------------------------------
+//   When enabled, the blanking around the active picture is cropped before all other
+// filters.
+void VideoDecoder::setActivePictureDetection(bool enabled)
+{
+    activePictureDetection.store(enabled);
+}
+
+//---------------------------------------------------------------------------------------
+QStringList VideoDecoder::getDeinterlacers()
+{
+    return {"yadif", "bwdif", "w3fdif"};
+}
+
+//---------------------------------------------------------------------------------------
+FilterStatistics VideoDecoder::getFilterStatistics() const
+{
+    FilterStatistics stat;
     {
-        AVFrame *totalFrame{nullptr};
+        std::lock_guard<std::mutex> guard(filterSettingsMutex);
+        stat.description = activeFilterDescription;
+    }
+    stat.threadCount = filterThreads.load();
+    stat.filteringTimeUs = filteringTimeNs.load() / 1000;
+    stat.filteredFrames = filteredFrames.load();
+    stat.elapsedTimeUs = openTimer.isValid() ? openTimer.nsecsElapsed() / 1000 : 0;
+    return stat;
+}
 
-        result = filter->getOutputFrame(&totalFrame);
+//---------------------------------------------------------------------------------------
+//   The audio is never degraded, so only the video decoder has the levels. The skipping
+// options are applied to the open context before the next packet, the lowres needs
+// the new context, so it's applied at the next key frame.
+void VideoDecoder::setDegradationLevel(int level)
+{
+    degradationLevel.store(std::clamp(level, int(LoadGovernor::Full), int(LoadGovernor::KeyFramesOnly)));
+}
 
-        if (result == AVERROR(EAGAIN) || result == AVERROR(AVERROR_EOF))
-            break;
-        if (result < 0)
-            return 0;
+//---------------------------------------------------------------------------------------
+int VideoDecoder::getDegradationLevel() const
+{
+    return degradationLevel.load();
+}
 
-        FFmpegFilter *next = filter->getNextFilter();
-        if (next)
-            size = convertFrame(totalFrame, next);
-        else
-            size = outputVideoFrame(totalFrame);
+//---------------------------------------------------------------------------------------
+bool VideoDecoder::isLowresSupported() const
+{
+    return codec && codec->max_lowres > 0;
+}
 
-        av_frame_unref(totalFrame);
-        av_frame_unref(avFrame);
+//---------------------------------------------------------------------------------------
+void VideoDecoder::configureCodecContext()
+{
+    if (codec->capabilities & AV_CODEC_CAP_DR1)
+    {
+        codecContext->opaque = this;
+        codecContext->get_buffer2 = &VideoDecoder::getBuffer2;
     }
-    return size;
+
+    appliedDegradationLevel = degradationLevel.load();
+    applyDegradationLevel();
+    codecContext->lowres = appliedDegradationLevel >= LoadGovernor::Lowres ? std::min(1, int(codec->max_lowres)) : 0;
 }
 
 //---------------------------------------------------------------------------------------
-int VideoDecoder::outputVideoFrame(AVFrame *avFrame)
+void VideoDecoder::updateCodecContext()
 {
-    std::shared_ptr<VideoFrame> videoFrame(new VideoFrame(avFrame->pts));
+    int level = degradationLevel.load();
+    if (level == appliedDegradationLevel || !codecContext)
+        return;
 
-    int size = videoFrame->fromAvFrame(avFrame);
+    bool lowresChanged = (level >= LoadGovernor::Lowres) != (appliedDegradationLevel >= LoadGovernor::Lowres);
 
-    if (size)
-        emit videoFrameReady(videoFrame);
+    loggable.logMessage(objectName(), QtDebugMsg,
+                        QString("Decoding level: %1 -> %2.")
+                        .arg(LoadGovernor::levelToString(appliedDegradationLevel), LoadGovernor::levelToString(level)));
 
-    return size;
+    appliedDegradationLevel = level;
+    applyDegradationLevel();
+
+    if (lowresChanged && isLowresSupported())
+        reopenRequested.store(true);
 }
 
 //---------------------------------------------------------------------------------------
-void VideoDecoder::createDeinterlacingFiltersQueue(AVFrame *avFrame)
+void VideoDecoder::applyDegradationLevel()
 {
-    loggable.logMessage(objectName(), QtDebugMsg, "Create deinterlacing filters queue...");
+    int level = appliedDegradationLevel;
 
-    deinterlacer = new FFmpegFilter("Deinterlacer");
-    cropper = new FFmpegFilter("Predeinterlace Cropper");
+    codecContext->skip_loop_filter = level >= LoadGovernor::SkipLoopFilter ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+
+    if (level >= LoadGovernor::KeyFramesOnly)
+        codecContext->skip_frame = AVDISCARD_NONKEY;
+    else if (level >= LoadGovernor::SkipNonReference)
+        codecContext->skip_frame = AVDISCARD_NONREF;
+    else
+        codecContext->skip_frame = AVDISCARD_DEFAULT;
 }
 
 //---------------------------------------------------------------------------------------
-void VideoDecoder::initDeinterlacer(AVFrame *frame)
+//   Allocates all planes of the picture in one buffer from the pool.
+//   Line sizes and plane heights are aligned as the libavcodec requires (see
+// avcodec_align_dimensions2()), so the frame may be passed to the video sink without
+// the copying. May be called from the decoder's worker threads.
+int VideoDecoder::getBuffer2(AVCodecContext *context, AVFrame *avFrame, int flags)
 {
-    if (!deinterlacer)
-        deinterlacer = new FFmpegFilter("Deinterlacer");
+    VideoDecoder *decoder = static_cast<VideoDecoder*>(context->opaque);
+    AVPixelFormat format = static_cast<AVPixelFormat>(avFrame->format);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+
+    if (!decoder || !desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+        return avcodec_default_get_buffer2(context, avFrame, flags);
+
+    int width = avFrame->width;
+    int height = avFrame->height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width, &height, linesizeAlign);
+
+    // increase the width until all line sizes are aligned (as the libavcodec does)
+    int linesizes[4] = {};
+    int unaligned;
+    do
+    {
+        int result = av_image_fill_linesizes(linesizes, format, width);
+        if (result < 0)
+            return result;
+        width += width & ~(width - 1);
 
-    if (deinterlacer->isReady())
-        return;
+        unaligned = 0;
+        for (int i = 0; i < 4; ++i)
+            unaligned |= (linesizes[i] % linesizeAlign[i]) | (linesizes[i] % FFMPEG_ALIGNMENT);
+    }
+    while (unaligned);
+
+    uint8_t *data[4] = {};
+    int size = av_image_fill_pointers(data, format, height, nullptr, linesizes);
+    if (size < 0)
+        return size;
 
-    QString filter{"yadif"};
-    QString filterParams{"0:-1:1"};
+    AVBufferRef *buffer = decoder->bufferPool->acquire(size + FFMPEG_PADDING);
+    if (!buffer)
+        return AVERROR(ENOMEM);
 
-    char args[512];
-    snprintf(args, sizeof(args),
-             "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
-             frame->width,
-             frame->height,
-             frame->format,
-             codecContext->time_base.num,
-             codecContext->time_base.den,
-             codecContext->sample_aspect_ratio.num,
-             codecContext->sample_aspect_ratio.den);
+    for (int i = 0; i < 4; ++i)
+    {
+        avFrame->linesize[i] = linesizes[i];
+        avFrame->data[i] = data[i] ? buffer->data + (data[i] - data[0]) : nullptr;
+    }
+    avFrame->buf[0] = buffer;
+    avFrame->extended_data = avFrame->data;
 
-    QString inputParams{args};
-    deinterlacer->init(filter, filterParams, inputParams);
+    return 0;
 }
 
 //---------------------------------------------------------------------------------------
-void VideoDecoder::initCropper(AVFrame *frame)
+//   The change of the thread share reopens the codec context, so the state is switched
+// only when that many frames in a row agree (the mixed PAFF and progressive content
+// would flip it with every frame).
+void VideoDecoder::setFiltering(bool enabled)
 {
-    if (!cropper)
-        cropper = new FFmpegFilter("Cropper");
-
-    if (cropper->isReady())
+    if (filtering == enabled)
+    {
+        filteringSwitchFrames = 0;
         return;
+    }
+    if (++filteringSwitchFrames < FilteringSwitchFrames)
+        return;
+
+    filteringSwitchFrames = 0;
+    filtering = enabled;
+    DecoderThreadingPolicy::getInstance()->setFiltering(this, enabled);
+}
+
+//---------------------------------------------------------------------------------------
+//   In the field rate mode one input frame gives two output pictures. They are output
+// at once with their own PTS, the second one carries the field interval as its
+// presentation delay (the demuxer shows it then, the worker doesn't wait).
+int VideoDecoder::filterFrame(AVFrame *avFrame)
+{
+    int size = 0;
+    int result;
+
+    QElapsedTimer filteringTimer;
+    filteringTimer.start();
 
-    int frameFix = 0; // fix bad width on some streams
-    if (frame->height == 576)
+    result = filter->feedGraph(avFrame);
+    if (result < 0)
     {
-        if (frame->width < 704)
-            frameFix = 2;
-        else if (frame->width > 704)
-            frameFix = -16;
+        filteringTimeNs += filteringTimer.nsecsElapsed();
+
+        // the graph can't be configured for this frame (the error is already logged)
+        if (!filter->isReady())
+            return outputVideoFrame(avFrame);
+
+        loggable.logAvError(objectName(), QtWarningMsg,
+                        QString("Error while feeding the filter graph %1.").arg(filter->getDescription()),
+                        result);
+        return 0;
     }
 
-    QString filter{"crop"};
-    QString filterParams = QString("w=%1:h=%2:x=0:y=0").arg(frame->width + frameFix).arg(frame->height);
+    AVRational outputTimeBase = filter->getOutputTimeBase();
+    AVRational timeBase = codecContext->pkt_timebase.num ? codecContext->pkt_timebase : AVRational{1, AV_TIME_BASE};
+    int64_t previousPts = AV_NOPTS_VALUE;
+
+    while (true)
+    {
+        AVFrame *filteredFrame{nullptr};
+
+        result = filter->getOutputFrame(&filteredFrame);
+        filteringTimeNs += filteringTimer.nsecsElapsed();
+
+        if (result == AVERROR(EAGAIN) || result == AVERROR_EOF)
+            break;
+        if (result < 0)
+            break;
+
+        filteredFrames++;
+
+        int64_t pts = filteredFrame->pts;
+        int64_t presentationDelayUs = 0;
+        if (pts != AV_NOPTS_VALUE)
+        {
+            if (previousPts != AV_NOPTS_VALUE)
+            {
+                int64_t interval = av_rescale_q(pts - previousPts, outputTimeBase, AVRational{1, AV_TIME_BASE});
+                presentationDelayUs = std::clamp<int64_t>(interval, 0, MaxFieldIntervalUs);
+            }
+            previousPts = pts;
+            filteredFrame->pts = av_rescale_q(pts, outputTimeBase, timeBase);
+        }
+
+        size += outputVideoFrame(filteredFrame, presentationDelayUs);
+
+        av_frame_unref(filteredFrame);
+        filteringTimer.restart();
+    }
+    return size;
+}
+
+//---------------------------------------------------------------------------------------
+int VideoDecoder::outputVideoFrame(AVFrame *avFrame, int64_t presentationDelayUs)
+{
+    std::shared_ptr<VideoFrame> videoFrame(new VideoFrame(avFrame->pts));
+    videoFrame->setPresentationDelay(presentationDelayUs);
 
-    char args[512];
-    snprintf(args, sizeof(args),
-             "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
-             frame->width,
-             frame->height,
-             frame->format,
-             codecContext->time_base.num,
-             codecContext->time_base.den,
-             codecContext->sample_aspect_ratio.num,
-             codecContext->sample_aspect_ratio.den);
+    {
+        std::lock_guard<std::mutex> guard(filterSettingsMutex);
+        converter.setMaxOutputSize(outputSize);
+    }
+    int size = videoFrame->fromAvFrame(avFrame, converter);
 
-    QString inputParams{args};
-    cropper->init(filter, filterParams, inputParams);
+    if (size)
+    {
+        presentedFrames++;
+        {
+            std::lock_guard<std::mutex> guard(filterSettingsMutex);
+            lastOutputSize = videoFrame->getVideoFrame()->size();
+        }
+        emit videoFrameReady(videoFrame);
+    }
+
+    return size;
 }
 
 //---------------------------------------------------------------------------------------
-bool VideoDecoder::isNeedCropLineTo704px(AVFrame *avFrame)
+//   Builds the filter chain for the frame: deinterlace the interlaced pictures, then
+// the user filters. Empty description means the frame goes to the output stage as is.
+QString VideoDecoder::getFilterDescription(const AVFrame *avFrame)
 {
-    return avFrame->width == 720 &&
-            avFrame->height == 576 &&
-            avFrame->sample_aspect_ratio.num == 16 &&
-            avFrame->sample_aspect_ratio.den == 11;
+    QStringList filters;
+
+    if (avFrame->interlaced_frame)
+        filters << getDeinterlacerDescription();
+
+    std::lock_guard<std::mutex> guard(filterSettingsMutex);
+    if (!userFilters.isEmpty())
+        filters << userFilters;
+
+    return filters.join(',');
 }
 
 //---------------------------------------------------------------------------------------
+//   All supported deinterlacers process only the frames marked as interlaced and use
+// the slice threading of the filter graph.
+QString VideoDecoder::getDeinterlacerDescription()
+{
+    std::lock_guard<std::mutex> guard(filterSettingsMutex);
+
+    if (deinterlacer == "w3fdif")
+        return QString("w3fdif=filter=complex:mode=%1:parity=auto:deint=interlaced")
+                .arg(fieldRate ? "field" : "frame");
 
+    // yadif and bwdif have the same options
+    return QString("%1=mode=%2:parity=auto:deint=interlaced")
+            .arg(deinterlacer, fieldRate ? "send_field" : "send_frame");
+}
 
+//---------------------------------------------------------------------------------------
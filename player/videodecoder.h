@@ -1,8 +1,12 @@
 #ifndef VIDEODECODER_H
 #define VIDEODECODER_H
 
+#include "activepicturedetector.h"
 #include "decoder.h"
 #include "ffmpegfilter.h"
+#include "loadgovernor.h"
+#include "videobufferpool.h"
+#include "videoconverter.h"
 #include "videoframe.h"
 
 #include <QVideoFrame>
@@ -14,6 +18,23 @@ extern "C" {
 #include <libavutil/frame.h>
 }
 
+struct FilterStatistics
+{
+    QString description;
+    int threadCount{1};
+    int64_t filteringTimeUs{0};
+    int64_t filteredFrames{0};
+    int64_t elapsedTimeUs{0};
+};
+
+struct VideoOutputStatistics
+{
+    bool visible{true};
+    QSize outputSize;
+    int64_t presentedFrames{0};
+    int64_t skippedFrames{0};
+};
+
 class VideoDecoder : public Decoder
 {
     Q_OBJECT
@@ -22,27 +43,88 @@ public:
     virtual ~VideoDecoder();
 
     int outputFrame(AVFrame *avFrame) override;
+    void flush() override;
 
     QSize getPictureSize() const;
 
+    void setUserFilters(const QString &filters);
+    void setDeinterlacer(const QString &algorithm, bool fieldRate);
+    void setActivePictureDetection(bool enabled);
+    void setOutputSize(const QSize &size);
+    void setOutputVisible(bool visible);
+    // the frames before the pts (after the seeking) are decoded but not shown,
+    // it's called by the task of the decoding strand
+    void setPresentationStart(int64_t pts);
+    static QStringList getDeinterlacers();
+
+    // see LoadGovernor::Level
+    void setDegradationLevel(int level);
+    int getDegradationLevel() const;
+    bool isLowresSupported() const;
+
+    FilterStatistics getFilterStatistics() const;
+    VideoOutputStatistics getOutputStatistics() const;
+
 signals:
     void videoFrameReady(const std::shared_ptr<VideoFrame> videoFrame);
 
+protected:
+    void configureCodecContext() override;
+    void updateCodecContext() override;
+
 private:
-    int convertFrame(AVFrame *avFrame, FFmpegFilter *filter);
-    int outputVideoFrame(AVFrame *avFrame);
+    static int getBuffer2(AVCodecContext *context, AVFrame *avFrame, int flags);
 
-    void createDeinterlacingFiltersQueue(AVFrame *avFrame);
-    void initDeinterlacer(AVFrame *frame);
-    void initCropper(AVFrame *frame);
+    int filterFrame(AVFrame *avFrame);
+    void setFiltering(bool enabled);
+    int outputVideoFrame(AVFrame *avFrame, int64_t presentationDelayUs = 0);
 
-    bool isNeedCropLineTo704px(AVFrame *avFrame);
+    QString getFilterDescription(const AVFrame *avFrame);
+    QString getDeinterlacerDescription();
+    void applyDegradationLevel();
 
     QVideoFrame m_videoFrame;
     QVideoFrameFormat::PixelFormat m_pixelFormat;
 
-    FFmpegFilter *deinterlacer{nullptr};
-    FFmpegFilter *cropper{nullptr};
+    FFmpegFilter *filter{nullptr};
+
+    mutable std::mutex filterSettingsMutex;
+    QString userFilters;
+    QString deinterlacer{"yadif"};
+    bool fieldRate{false};
+
+    std::atomic_bool activePictureDetection{true};
+    ActivePictureDetector activePictureDetector;
+
+    QSize outputSize;
+    QSize lastOutputSize;
+    std::atomic_bool outputVisible{true};
+    VideoConverter converter;
+
+    std::atomic<int64_t> presentedFrames{0};
+    std::atomic<int64_t> skippedFrames{0};
+    int64_t presentationStart{AV_NOPTS_VALUE};
+
+    enum {
+        // the longest delay between the fields of one picture (50 Hz interlaced: 20 ms)
+        MaxFieldIntervalUs = 40000,
+        // the consecutive frames needed to switch the filtering state
+        FilteringSwitchFrames = 50
+    };
+
+    QString activeFilterDescription;
+    std::atomic<int> filterThreads{1};
+    // the graph is counted in the thread share of the decoder
+    bool filtering{false};
+    int filteringSwitchFrames{0};
+    std::atomic<int64_t> filteringTimeNs{0};
+    std::atomic<int64_t> filteredFrames{0};
+
+    std::shared_ptr<VideoBufferPool> bufferPool;
+
+    std::atomic<int> degradationLevel{LoadGovernor::Full};
+    // the level applied to the codec context (in the decoding thread)
+    int appliedDegradationLevel{LoadGovernor::Full};
 
 };
 
@@ -1,10 +1,10 @@
 #include "videoframe.h"
+#include "avframevideobuffer.h"
+#include "pixelrepack.h"
 #include "utils.h"
 
 #include <QDebug>
 
-#define FFMPEG_ALIGNMENT (32)
-
 //---------------------------------------------------------------------------------------
 VideoFrame::VideoFrame(int64_t pts) : Frame(pts)
 {
@@ -21,58 +21,75 @@ VideoFrame::~VideoFrame()
 //---------------------------------------------------------------------------------------
 int VideoFrame::fromAvFrame(const AVFrame *avFrame)
 {
-    SwsContext *swsCtx = nullptr;
-    int size = 0;
-    uint8_t *dstData[AV_NUM_DATA_POINTERS] = {};
-    int dstLinesize[AV_NUM_DATA_POINTERS] = {};
+    VideoConverter converter;
+    return fromAvFrame(avFrame, converter);
+}
 
+//---------------------------------------------------------------------------------------
+//   The frame is cropped by the converter, then passed to the sink as is if its format
+// is supported and no scaling is needed. Otherwise the high bit depth formats without
+// the scaling are repacked to P010/P016, the rest is scaled and converted in one pass.
+int VideoFrame::fromAvFrame(const AVFrame *avFrame, VideoConverter &converter)
+{
     if (!avFrame)
         return 0;
 
-    AVPixelFormat srcAVFormat = static_cast<AVPixelFormat>(avFrame->format);
-    AVPixelFormat dstAVFormat = srcAVFormat;
+    AVFrame *source = converter.crop(avFrame);
+    if (!source)
+        return 0;
+
+    int size = 0;
+    QSize outputSize = converter.getOutputSize(source);
 
-    pixelFormat = mapPixelFormat(srcAVFormat);
+    AVPixelFormat sourceFormat = static_cast<AVPixelFormat>(source->format);
+    pixelFormat = mapPixelFormat(sourceFormat);
+    bool sameSize = outputSize == QSize(source->width, source->height);
 
-    if (pixelFormat == QVideoFrameFormat::Format_Invalid)
+    if (pixelFormat != QVideoFrameFormat::Format_Invalid && sameSize)
     {
-        pixelFormat = QVideoFrameFormat::Format_YUV420P;
-        dstAVFormat = mapPixelFormat(pixelFormat);
+        size = wrapAvFrame(source);
     }
-    int dstHeight = avFrame->height;
-    int dstWidth = avFrame->width;
-
-    if (avFrame->sample_aspect_ratio.num != avFrame->sample_aspect_ratio.den)
-        dstWidth = (avFrame->width * avFrame->sample_aspect_ratio.num) / avFrame->sample_aspect_ratio.den;
-
-    swsCtx = sws_getContext(avFrame->width, avFrame->height, srcAVFormat,
-                            dstWidth, dstHeight, dstAVFormat,
-                            SWS_BICUBIC, nullptr, nullptr, nullptr);
-
-    size = av_image_fill_arrays(dstData, dstLinesize, nullptr, dstAVFormat,
-                                dstWidth, dstHeight, FFMPEG_ALIGNMENT);
-
-    QVideoFrameFormat frameFormat(QSize(dstWidth, dstHeight), pixelFormat);
-    videoFrame = new QVideoFrame(frameFormat);
-    if (videoFrame->map(QVideoFrame::WriteOnly))
+    else
     {
-        if (swsCtx)
+        pixelFormat = VideoConverter::getOutputPixelFormat(sourceFormat);
+
+        QVideoFrame convertedFrame;
+        bool ok = sameSize && getSemiPlanar16Format(sourceFormat) != AV_PIX_FMT_NONE
+                ? converter.repack(source, convertedFrame)
+                : converter.convert(source, outputSize, pixelFormat, convertedFrame);
+        if (ok)
         {
-            int i = 0;
-            while (videoFrame->bits(i))
-            {
-                dstData[i] = videoFrame->bits(i);
-                ++i;
-            }
-
-            sws_scale(swsCtx, avFrame->data, avFrame->linesize, 0, avFrame->height, dstData, dstLinesize);
-            sws_freeContext(swsCtx);
+            videoFrame = new QVideoFrame(convertedFrame);
+            size = av_image_get_buffer_size(mapPixelFormat(pixelFormat),
+                                            outputSize.width(), outputSize.height(), 1);
         }
-        videoFrame->unmap();
     }
+
+    av_frame_free(&source);
     return size;
 }
 
+//---------------------------------------------------------------------------------------
+//   No conversion is needed, so the decoded planes are passed to the video sink as is.
+int VideoFrame::wrapAvFrame(const AVFrame *avFrame)
+{
+    QVideoFrameFormat frameFormat(QSize(avFrame->width, avFrame->height), pixelFormat);
+    VideoConverter::applyColorDetails(frameFormat, VideoConverter::getColorDetails(avFrame));
+
+    auto buffer = std::make_unique<AvFrameVideoBuffer>(avFrame, frameFormat);
+    if (!buffer->isValid())
+        return 0;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    videoFrame = new QVideoFrame(std::move(buffer));
+#else
+    videoFrame = new QVideoFrame(buffer.release(), frameFormat);
+#endif
+
+    return av_image_get_buffer_size(static_cast<AVPixelFormat>(avFrame->format),
+                                    avFrame->width, avFrame->height, 1);
+}
+
 //---------------------------------------------------------------------------------------
 const QVideoFrame *VideoFrame::getVideoFrame() const
 {
@@ -80,3 +97,15 @@ const QVideoFrame *VideoFrame::getVideoFrame() const
 }
 
 //---------------------------------------------------------------------------------------
+void VideoFrame::setPresentationDelay(int64_t delayUs)
+{
+    presentationDelayUs = delayUs;
+}
+
+//---------------------------------------------------------------------------------------
+int64_t VideoFrame::getPresentationDelay() const
+{
+    return presentationDelayUs;
+}
+
+//---------------------------------------------------------------------------------------
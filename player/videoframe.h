@@ -2,6 +2,7 @@
 #define VIDEOFRAME_H
 
 #include "frame.h"
+#include "videoconverter.h"
 
 #include <QVideoFrame>
 
@@ -22,11 +23,20 @@ public:
     virtual ~VideoFrame();
 
     int fromAvFrame(const AVFrame *avFrame) override;
+    int fromAvFrame(const AVFrame *avFrame, VideoConverter &converter);
     const QVideoFrame* getVideoFrame() const;
 
+    // the picture is shown this time after the previous one (the second field of the
+    // interlaced frame), 0 - as soon as it's received
+    void setPresentationDelay(int64_t delayUs);
+    int64_t getPresentationDelay() const;
+
 private:
+    int wrapAvFrame(const AVFrame *avFrame);
+
     QVideoFrame *videoFrame{nullptr};
     QVideoFrameFormat::PixelFormat pixelFormat;
+    int64_t presentationDelayUs{0};
 };
 
 #endif // VIDEOFRAME_H
@@ -0,0 +1,274 @@
+#include "workerpool.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+#include "decoderthreadingpolicy.h"
+
+WorkerPool *WorkerPool::instance = nullptr;
+std::once_flag WorkerPool::initInstanceFlag;
+
+// index of the worker running in this thread, -1 outside of the pool
+static thread_local int currentWorkerIndex = -1;
+
+//---------------------------------------------------------------------------------------
+WorkerPool::Strand::Strand(const QString &name)
+    : name{name}
+{
+
+}
+
+//---------------------------------------------------------------------------------------
+QString WorkerPool::Strand::getName() const
+{
+    return name;
+}
+
+//---------------------------------------------------------------------------------------
+size_t WorkerPool::Strand::getQueuedCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return tasks.size();
+}
+
+//---------------------------------------------------------------------------------------
+bool WorkerPool::Strand::isIdle() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return tasks.empty() && !running;
+}
+
+//---------------------------------------------------------------------------------------
+int64_t WorkerPool::Strand::getBusyTimeUs() const
+{
+    return busyTimeNs.load() / 1000;
+}
+
+//---------------------------------------------------------------------------------------
+void WorkerPool::Strand::clear()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    tasks.clear();
+    changed.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+//   Must not be called from the task of this strand.
+void WorkerPool::Strand::waitForIdle()
+{
+    std::unique_lock<std::mutex> locker(mutex);
+    changed.wait(locker, [this](){return tasks.empty() && !running;});
+}
+
+//---------------------------------------------------------------------------------------
+bool WorkerPool::Strand::waitForQueuedBelow(size_t count, const std::function<bool()> &interrupted)
+{
+    std::unique_lock<std::mutex> locker(mutex);
+    while (tasks.size() >= count)
+    {
+        if (interrupted && interrupted())
+            return false;
+        changed.wait_for(locker, std::chrono::milliseconds(InterruptCheckIntervalMs));
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+WorkerPool *WorkerPool::getInstance()
+{
+    std::call_once(initInstanceFlag, &WorkerPool::initInstance);
+
+    return instance;
+}
+
+//---------------------------------------------------------------------------------------
+//   One worker per core of the decoder budget (at the moment of the creation).
+WorkerPool::WorkerPool(QObject *parent)
+    : QObject{parent}
+{
+    setObjectName("WorkerPool");
+
+    int threadCount = std::max(1, DecoderThreadingPolicy::getInstance()->getCoreBudget());
+    loggable.logMessage(objectName(), QtDebugMsg, QString("Start %1 worker thread(s).").arg(threadCount));
+
+    for (int i = 0; i < threadCount; ++i)
+        workers.push_back(std::make_unique<Worker>());
+
+    startTimer.start();
+    for (int i = 0; i < threadCount; ++i)
+        threads.emplace_back(&WorkerPool::run, this, i);
+
+    // the pool lives until the end of the application
+    for (std::thread &thread : threads)
+        thread.detach();
+}
+
+//---------------------------------------------------------------------------------------
+void WorkerPool::initInstance()
+{
+    instance = new WorkerPool();
+}
+
+//---------------------------------------------------------------------------------------
+std::shared_ptr<WorkerPool::Strand> WorkerPool::createStrand(const QString &name)
+{
+    auto strand = std::make_shared<Strand>(name);
+
+    std::lock_guard<std::mutex> guard(strandsMutex);
+    strands.erase(std::remove_if(strands.begin(), strands.end(), [](const auto &item){
+        return item.expired();
+    }), strands.end());
+    strands.push_back(strand);
+
+    return strand;
+}
+
+//---------------------------------------------------------------------------------------
+void WorkerPool::post(const std::shared_ptr<Strand> &strand, Task task)
+{
+    {
+        std::lock_guard<std::mutex> guard(strand->mutex);
+        strand->tasks.push_back(std::move(task));
+        if (strand->scheduled)
+            return;
+        strand->scheduled = true;
+    }
+    schedule(strand);
+}
+
+//---------------------------------------------------------------------------------------
+int WorkerPool::getThreadCount() const
+{
+    return int(threads.size());
+}
+
+//---------------------------------------------------------------------------------------
+WorkerPoolStatistics WorkerPool::getStatistics() const
+{
+    WorkerPoolStatistics stat;
+    stat.threadCount = getThreadCount();
+    {
+        std::lock_guard<std::mutex> guard(strandsMutex);
+        stat.strandCount = int(std::count_if(strands.begin(), strands.end(), [](const auto &item){
+            return !item.expired();
+        }));
+    }
+    stat.executedTasks = executedTasks.load();
+    stat.stolenStrands = stolenStrands.load();
+    stat.busyTimeUs = busyTimeNs.load() / 1000;
+    stat.elapsedTimeUs = startTimer.nsecsElapsed() / 1000;
+    return stat;
+}
+
+//---------------------------------------------------------------------------------------
+void WorkerPool::schedule(const std::shared_ptr<Strand> &strand)
+{
+    int index = currentWorkerIndex >= 0
+            ? currentWorkerIndex
+            : int(nextWorker.fetch_add(1) % workers.size());
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->mutex);
+        workers[index]->readyStrands.push_back(strand);
+    }
+
+    {
+        // the sleeping worker checks the counter under this lock, so the wake up isn't lost
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        readyCount++;
+    }
+    readyChanged.notify_one();
+}
+
+//---------------------------------------------------------------------------------------
+//   The own queue is processed from the front (in the scheduling order), the strands are
+// stolen from the back of the other queues.
+std::shared_ptr<WorkerPool::Strand> WorkerPool::takeStrand(int workerIndex)
+{
+    int count = int(workers.size());
+    for (int i = 0; i < count; ++i)
+    {
+        Worker *worker = workers[(workerIndex + i) % count].get();
+
+        std::lock_guard<std::mutex> guard(worker->mutex);
+        if (worker->readyStrands.empty())
+            continue;
+
+        std::shared_ptr<Strand> strand;
+        if (i == 0)
+        {
+            strand = worker->readyStrands.front();
+            worker->readyStrands.pop_front();
+        }
+        else
+        {
+            strand = worker->readyStrands.back();
+            worker->readyStrands.pop_back();
+            stolenStrands++;
+        }
+        readyCount--;
+        return strand;
+    }
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+void WorkerPool::run(int workerIndex)
+{
+    currentWorkerIndex = workerIndex;
+
+    while (true)
+    {
+        std::shared_ptr<Strand> strand = takeStrand(workerIndex);
+        if (!strand)
+        {
+            std::unique_lock<std::mutex> locker(sleepMutex);
+            readyChanged.wait(locker, [this](){return readyCount.load() > 0;});
+            continue;
+        }
+
+        QElapsedTimer busyTimer;
+        busyTimer.start();
+        int64_t taskStartNs = 0;
+
+        bool reschedule = false;
+        for (int executed = 0; ; ++executed)
+        {
+            Task task;
+            {
+                std::lock_guard<std::mutex> guard(strand->mutex);
+                if (strand->tasks.empty())
+                {
+                    strand->scheduled = false;
+                    strand->running = false;
+                    strand->changed.notify_all();
+                    break;
+                }
+                if (executed == MaxTasksPerTurn)
+                {
+                    strand->running = false;
+                    reschedule = true;
+                    break;
+                }
+                task = std::move(strand->tasks.front());
+                strand->tasks.pop_front();
+                strand->running = true;
+                strand->changed.notify_all();
+            }
+
+            task();
+            executedTasks++;
+
+            int64_t nowNs = busyTimer.nsecsElapsed();
+            strand->busyTimeNs += nowNs - taskStartNs;
+            taskStartNs = nowNs;
+        }
+
+        busyTimeNs += busyTimer.nsecsElapsed();
+
+        if (reschedule)
+            schedule(strand);
+    }
+}
+
+//---------------------------------------------------------------------------------------
@@ -0,0 +1,131 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <QObject>
+
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "loggable.h"
+
+struct WorkerPoolStatistics
+{
+    int threadCount{0};
+    int strandCount{0};
+    int64_t executedTasks{0};
+    int64_t stolenStrands{0};
+    int64_t busyTimeUs{0};
+    int64_t elapsedTimeUs{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Pool of the worker threads shared by the decoders of all sessions (the decoding,
+// the filtering and the audio metering run in the pool, only the reading of the input
+// has its own thread per source). The tasks are posted to strands: the tasks of one
+// strand are executed one by one in the posting order, the tasks of different strands
+// run in parallel. A strand is executed by one worker at a time; after MaxTasksPerTurn
+// tasks it's moved to the end of the queue, so one busy strand can't starve the others.
+//   Each worker has its own queue of the ready strands. The strands scheduled from
+// outside of the pool are distributed round robin, the strands rescheduled by a worker
+// stay in its queue (the data is still in its cache). An idle worker steals the
+// strand from the end of the queue of another worker before it goes to sleep.
+class WorkerPool : public QObject
+{
+    Q_OBJECT
+public:
+    using Task = std::function<void()>;
+
+    class Strand
+    {
+    public:
+        explicit Strand(const QString &name);
+
+        QString getName() const;
+        // number of the queued tasks (without the running one)
+        size_t getQueuedCount() const;
+        bool isIdle() const;
+        // total execution time of the tasks
+        int64_t getBusyTimeUs() const;
+
+        // drops the queued tasks, the running one is finished
+        void clear();
+        void waitForIdle();
+        // blocks the producer while the strand is overloaded; false - the waiting was
+        // interrupted (checked periodically, the tasks may be blocked)
+        bool waitForQueuedBelow(size_t count, const std::function<bool()> &interrupted);
+
+    private:
+        friend class WorkerPool;
+
+        QString name;
+
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Task> tasks;
+        bool scheduled{false};
+        bool running{false};
+        std::atomic<int64_t> busyTimeNs{0};
+    };
+
+    static WorkerPool *getInstance();
+
+    std::shared_ptr<Strand> createStrand(const QString &name);
+    void post(const std::shared_ptr<Strand> &strand, Task task);
+
+    int getThreadCount() const;
+    WorkerPoolStatistics getStatistics() const;
+
+private:
+    explicit WorkerPool(QObject *parent = nullptr);
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Strand>> readyStrands;
+    };
+
+    void run(int workerIndex);
+    void schedule(const std::shared_ptr<Strand> &strand);
+    std::shared_ptr<Strand> takeStrand(int workerIndex);
+
+    static void initInstance();
+    static WorkerPool *instance;
+    static std::once_flag initInstanceFlag;
+
+    enum {
+        MaxTasksPerTurn = 8,
+        InterruptCheckIntervalMs = 20
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> nextWorker{0};
+
+    // the sleeping workers wait for the ready strands
+    std::mutex sleepMutex;
+    std::condition_variable readyChanged;
+    std::atomic<int> readyCount{0};
+
+    mutable std::mutex strandsMutex;
+    std::vector<std::weak_ptr<Strand>> strands;
+
+    std::atomic<int64_t> executedTasks{0};
+    std::atomic<int64_t> stolenStrands{0};
+    std::atomic<int64_t> busyTimeNs{0};
+    QElapsedTimer startTimer;
+
+    Loggable loggable;
+};
+
+#endif // WORKERPOOL_H
@@ -0,0 +1,13 @@
+# FFmpeg of the player (the tools are built against the same shared build)
+FFMPEG_DIR = $$PWD/../ffmpeg-5.1.2-full_build-shared
+
+INCLUDEPATH += $$FFMPEG_DIR/include
+LIBS += $$FFMPEG_DIR/lib/avcodec.lib \
+        $$FFMPEG_DIR/lib/avformat.lib \
+        $$FFMPEG_DIR/lib/avutil.lib
+
+LIBS += -L$$FFMPEG_DIR/lib
+LIBS += -L$$FFMPEG_DIR/bin
+LIBS += -lavcodec \
+        -lavformat \
+        -lavutil
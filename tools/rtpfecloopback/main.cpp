@@ -0,0 +1,370 @@
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "rtpinput.h"
+
+extern "C" {
+#include <libavformat/avio.h>
+#include <libavutil/time.h>
+}
+
+// the 2022-1 matrix: L columns, D rows
+static const int Columns = 5;
+static const int Rows = 5;
+static const int MatrixSize = Columns * Rows;
+static const int Matrices = 24;
+static const int TsPacketSize = 188;
+static const int TsPacketsPerDatagram = 7;
+static const int PayloadSize = TsPacketSize * TsPacketsPerDatagram;
+static const int RtpHeaderSize = 12;
+static const int FecHeaderSize = 16;
+static const int MediaPayloadType = 33;
+static const int FecPayloadType = 96;
+// the sequence numbers wrap in the first matrices
+static const int FirstSequence = 65500;
+// the stray packet is sent in the middle of the matrix, far behind the sequence
+static const int StrayMatrix = 2;
+static const int StrayPosition = 3;
+static const int StraySequenceOffset = 30000;
+static const uint32_t StrayIndex = 0xFFFFFFFF;
+static const int DefaultPort = 5004;
+// the packets which aren't released are given up after the input's hold time
+static const int DrainTimeoutMs = 2000;
+static const int TotalTimeoutMs = 30000;
+
+//---------------------------------------------------------------------------------------
+static void writeUint16(uint8_t *data, uint16_t value)
+{
+    data[0] = uint8_t(value >> 8);
+    data[1] = uint8_t(value);
+}
+
+//---------------------------------------------------------------------------------------
+static void writeUint32(uint8_t *data, uint32_t value)
+{
+    writeUint16(data, uint16_t(value >> 16));
+    writeUint16(data + 2, uint16_t(value));
+}
+
+//---------------------------------------------------------------------------------------
+static uint32_t readUint32(const uint8_t *data)
+{
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+//---------------------------------------------------------------------------------------
+//   The positions in the matrix (row * L + column) which aren't sent. The patterns go
+// round after two clean matrices; the last two matrices are clean, so the last gap is
+// closed by the window and not by the hold time.
+static std::vector<int> getDroppedPositions(int matrix)
+{
+    if (matrix < 2 || matrix >= Matrices - 2)
+        return {};
+
+    switch ((matrix - 2) % 5)
+    {
+    case 1:
+        // the only one of its row and of its column
+        return {7};
+    case 2:
+        // two of the row, each recovered by its column
+        return {10, 11};
+    case 3:
+        // two in two rows and two columns, nothing can be recovered
+        return {0, 1, 5, 6};
+    case 4:
+        // the row recovery completes the columns of the other two
+        return {12, 13, 17};
+    default:
+        return {};
+    }
+}
+
+//---------------------------------------------------------------------------------------
+//   The recovery of the receiver: the only missing packet of a row or of a column is
+// recovered, until nothing changes. Adds the recovered and the lost packets.
+static void countRecovery(const std::vector<int> &dropped, int &recovered, int &lost)
+{
+    bool missing[MatrixSize] = {};
+    for (int position : dropped)
+        missing[position] = true;
+
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (int line = 0; line < Rows + Columns; line++)
+        {
+            // the rows first, then the columns
+            int start = line < Rows ? line * Columns : line - Rows;
+            int step = line < Rows ? 1 : Columns;
+            int count = line < Rows ? Columns : Rows;
+            int missingCount = 0;
+            int last = -1;
+            for (int i = 0; i < count; i++)
+            {
+                if (missing[start + i * step])
+                {
+                    missingCount++;
+                    last = start + i * step;
+                }
+            }
+            if (missingCount == 1)
+            {
+                missing[last] = false;
+                recovered++;
+                progress = true;
+            }
+        }
+    }
+
+    for (bool isMissing : missing)
+        lost += isMissing ? 1 : 0;
+}
+
+//---------------------------------------------------------------------------------------
+//   The TS packets of the datagram carry its index in the stream (the null PID, so the
+// stream stays valid), the rest of the payload is derived from it.
+static std::vector<uint8_t> makePayload(uint32_t index)
+{
+    std::vector<uint8_t> payload(PayloadSize);
+    for (int packet = 0; packet < TsPacketsPerDatagram; packet++)
+    {
+        uint8_t *ts = payload.data() + packet * TsPacketSize;
+        ts[0] = 0x47;
+        ts[1] = 0x1F;
+        ts[2] = 0xFF;
+        ts[3] = uint8_t(0x10 | ((index * TsPacketsPerDatagram + packet) & 0x0F));
+        writeUint32(ts + 4, index);
+        for (int i = 8; i < TsPacketSize; i++)
+            ts[i] = uint8_t(index * 31 + packet * 7 + i);
+    }
+    return payload;
+}
+
+//---------------------------------------------------------------------------------------
+static std::vector<uint8_t> makeRtpPacket(int payloadType, uint16_t sequence, uint32_t timestamp,
+                                          const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> packet(RtpHeaderSize);
+    packet[0] = 0x80;
+    packet[1] = uint8_t(payloadType);
+    writeUint16(&packet[2], sequence);
+    writeUint32(&packet[4], timestamp);
+    writeUint32(&packet[8], 0x2022);
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    return packet;
+}
+
+//---------------------------------------------------------------------------------------
+//   The FEC packet of SMPTE 2022-1 protecting count media packets from base by the offset
+// (column: offset L, NA D; row: offset 1, NA L).
+static std::vector<uint8_t> makeFecPacket(uint16_t fecSequence, const std::vector<std::vector<uint8_t>> &media,
+                                          int base, int offset, int count, bool row)
+{
+    std::vector<uint8_t> payload(FecHeaderSize + PayloadSize, 0);
+    uint16_t lengthRecovery = 0;
+    uint8_t payloadTypeRecovery = 0;
+    uint32_t timestampRecovery = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const std::vector<uint8_t> &packet = media[size_t(base + i * offset)];
+        lengthRecovery ^= uint16_t(packet.size() - RtpHeaderSize);
+        payloadTypeRecovery ^= packet[1] & 0x7F;
+        timestampRecovery ^= readUint32(&packet[4]);
+        for (size_t j = RtpHeaderSize; j < packet.size(); j++)
+            payload[FecHeaderSize + j - RtpHeaderSize] ^= packet[j];
+    }
+
+    uint16_t baseSequence = uint16_t(FirstSequence + base);
+    writeUint16(&payload[0], baseSequence);
+    writeUint16(&payload[2], lengthRecovery);
+    payload[4] = uint8_t(0x80 | payloadTypeRecovery);
+    writeUint32(&payload[8], timestampRecovery);
+    payload[12] = row ? 0x40 : 0x00;
+    payload[13] = uint8_t(offset);
+    payload[14] = uint8_t(count);
+    payload[15] = 0;
+    return makeRtpPacket(FecPayloadType, fecSequence, 0, payload);
+}
+
+//---------------------------------------------------------------------------------------
+class Sender
+{
+public:
+    bool open(int port)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            QString url = QString("udp://127.0.0.1:%1?pkt_size=1500").arg(port + channel * 2);
+            if (avio_open2(&outputs[channel], url.toUtf8().data(), AVIO_FLAG_WRITE, nullptr, nullptr) < 0)
+            {
+                fprintf(stderr, "Could not open '%s'.\n", qPrintable(url));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ~Sender()
+    {
+        for (AVIOContext *&output : outputs)
+        {
+            if (output)
+                avio_closep(&output);
+        }
+    }
+
+    // the media to the port, the column FEC to the port + 2, the row FEC to the port + 4
+    void send(int channel, const std::vector<uint8_t> &packet)
+    {
+        avio_write(outputs[channel], packet.data(), int(packet.size()));
+        avio_flush(outputs[channel]);
+        // paced, so the loopback doesn't drop anything itself
+        if (++sentDatagrams % 8 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+private:
+    AVIOContext *outputs[3]{};
+    int sentDatagrams{0};
+};
+
+//---------------------------------------------------------------------------------------
+//   Loopback check of the RTP input with the SMPTE 2022-1 FEC:
+//       rtpfecloopback [port]
+//   The stream is sent to 127.0.0.1 (the port, the port + 2 and the port + 4) with
+// some media packets dropped on purpose and one stray packet far behind the sequence; the
+// input receives it, and its recovered, lost and late counts and the delivered stream
+// are compared with the expected ones. The exit code is 0 if they match, 2 if not.
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QStringList arguments = application.arguments();
+    int port = arguments.size() > 1 ? arguments.at(1).toInt() : DefaultPort;
+    if (port <= 0 || port > 65535 - 4)
+    {
+        fprintf(stderr, "Usage: rtpfecloopback [port]\n");
+        return 1;
+    }
+
+    int packetCount = Matrices * MatrixSize;
+    std::vector<std::vector<uint8_t>> media;
+    std::vector<bool> sent(size_t(packetCount), true);
+    int dropped = 0;
+    int expectedRecovered = 0;
+    int expectedLost = 0;
+    for (int matrix = 0; matrix < Matrices; matrix++)
+    {
+        std::vector<int> positions = getDroppedPositions(matrix);
+        for (int position : positions)
+            sent[size_t(matrix * MatrixSize + position)] = false;
+        dropped += int(positions.size());
+        countRecovery(positions, expectedRecovered, expectedLost);
+    }
+    for (int index = 0; index < packetCount; index++)
+        media.push_back(makeRtpPacket(MediaPayloadType, uint16_t(FirstSequence + index), uint32_t(index * 3003),
+                                      makePayload(uint32_t(index))));
+
+    std::atomic_bool senderDone{false};
+    std::atomic<int64_t> deadlineUs{av_gettime_relative() + int64_t(TotalTimeoutMs) * 1000};
+    RtpInput input;
+    if (!input.open(QString("rtp://127.0.0.1:%1?fec=1").arg(port),
+                    [&]{ return av_gettime_relative() > deadlineUs.load(); }))
+    {
+        fprintf(stderr, "Could not open the RTP input.\n");
+        return 1;
+    }
+
+    Sender sender;
+    if (!sender.open(port))
+        return 1;
+
+    std::thread senderThread([&]{
+        uint16_t fecSequence = 0;
+        for (int matrix = 0; matrix < Matrices; matrix++)
+        {
+            int matrixStart = matrix * MatrixSize;
+            for (int row = 0; row < Rows; row++)
+            {
+                for (int column = 0; column < Columns; column++)
+                {
+                    int index = matrixStart + row * Columns + column;
+                    if (sent[size_t(index)])
+                        sender.send(0, media[size_t(index)]);
+                    if (matrix == StrayMatrix && index - matrixStart == StrayPosition)
+                        sender.send(0, makeRtpPacket(MediaPayloadType, uint16_t(FirstSequence + index - StraySequenceOffset),
+                                                     0, makePayload(StrayIndex)));
+                }
+                sender.send(2, makeFecPacket(fecSequence++, media, matrixStart + row * Columns, 1, Columns, true));
+            }
+            // the column FEC after the whole matrix
+            for (int column = 0; column < Columns; column++)
+                sender.send(1, makeFecPacket(fecSequence++, media, matrixStart + column, Columns, Rows, false));
+        }
+        deadlineUs.store(std::min(deadlineUs.load(), av_gettime_relative() + int64_t(DrainTimeoutMs) * 1000));
+        senderDone.store(true);
+    });
+
+    // the delivered datagrams must come in the order, complete and unchanged
+    std::vector<uint8_t> ts(TsPacketSize);
+    std::vector<uint8_t> datagram;
+    int delivered = 0;
+    int corrupted = 0;
+    int outOfOrder = 0;
+    int stray = 0;
+    int64_t lastIndex = -1;
+    int expectedDelivered = packetCount - expectedLost;
+    while (avio_read(input.getIoContext(), ts.data(), TsPacketSize) == TsPacketSize)
+    {
+        datagram.insert(datagram.end(), ts.begin(), ts.end());
+        if (datagram.size() < size_t(PayloadSize))
+            continue;
+
+        uint32_t index = readUint32(&datagram[4]);
+        if (index == StrayIndex)
+            stray++;
+        else if (index >= uint32_t(packetCount) || datagram != makePayload(index))
+            corrupted++;
+        else
+        {
+            delivered++;
+            if (int64_t(index) <= lastIndex)
+                outOfOrder++;
+            lastIndex = index;
+        }
+        datagram.clear();
+        if (delivered == expectedDelivered && senderDone.load())
+            break;
+    }
+
+    senderThread.join();
+    RtpInputStatistics statistics = input.getStatistics();
+    input.close();
+
+    printf("sent %d media packet(s) in %d matrices of %dx%d, %d dropped, 1 stray\n",
+           packetCount - dropped, Matrices, Columns, Rows, dropped);
+    printf("expected: recovered %d, lost %d, late 1, delivered %d\n",
+           expectedRecovered, expectedLost, expectedDelivered);
+    printf("input:    recovered %lld, lost %lld, late %lld, delivered %d "
+           "(column FEC %lld, row FEC %lld, discontinuities %lld)\n",
+           static_cast<long long>(statistics.recoveredPackets), static_cast<long long>(statistics.lostPackets),
+           static_cast<long long>(statistics.latePackets), delivered,
+           static_cast<long long>(statistics.columnFecPackets), static_cast<long long>(statistics.rowFecPackets),
+           static_cast<long long>(statistics.discontinuities));
+    printf("stream:   %d out of order, %d corrupted, %d stray\n", outOfOrder, corrupted, stray);
+
+    bool matches = statistics.recoveredPackets == expectedRecovered && statistics.lostPackets == expectedLost
+            && statistics.latePackets == 1 && statistics.discontinuities == 0 && delivered == expectedDelivered
+            && outOfOrder == 0 && corrupted == 0 && stray == 0;
+    printf("%s\n", matches ? "OK" : "MISMATCH");
+    return matches ? 0 : 2;
+}
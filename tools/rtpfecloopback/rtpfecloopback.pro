@@ -0,0 +1,23 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = rtpfecloopback
+
+INCLUDEPATH += ../../logger \
+    ../../player
+
+SOURCES += \
+    ../../logger/loggable.cpp \
+    ../../logger/logger.cpp \
+    ../../player/rtpinput.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../logger/loggable.h \
+    ../../logger/logger.h \
+    ../../player/rtpinput.h
+
+include(../ffmpeg.pri)
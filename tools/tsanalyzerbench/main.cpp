@@ -0,0 +1,137 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "bitratehistory.h"
+#include "tsanalyzer.h"
+
+extern "C" {
+#include <libavformat/avio.h>
+#include <libavutil/mem.h>
+}
+
+// the rate of the live inputs the analyser has to keep up with
+static const double TargetMbitPerSecond = 200.0;
+static const int DefaultPasses = 5;
+static const int SourceBufferSize = 64 * 1024;
+// the demuxer reads by the size of its IO buffer, the analyser gets the same reads
+static const int DemuxerReadSize = 32 * 1024;
+
+//---------------------------------------------------------------------------------------
+//   The recorded stream is held in memory, so only the analysis is measured (not the
+// disk or the network).
+struct MemorySource
+{
+    const QByteArray *data{nullptr};
+    int64_t position{0};
+};
+
+//---------------------------------------------------------------------------------------
+static int readMemory(void *opaque, uint8_t *buf, int bufSize)
+{
+    MemorySource *source = static_cast<MemorySource*>(opaque);
+
+    int64_t count = std::min<int64_t>(bufSize, source->data->size() - source->position);
+    if (count <= 0)
+        return AVERROR_EOF;
+
+    memcpy(buf, source->data->constData() + source->position, size_t(count));
+    source->position += count;
+    return int(count);
+}
+
+//---------------------------------------------------------------------------------------
+//   One pass of the whole stream through the analyser's read callback; the elapsed time
+// in nanoseconds, or -1.
+static int64_t runPass(const QByteArray &data, TsAnalyzerStatistics &statistics)
+{
+    MemorySource source{&data, 0};
+    unsigned char *buffer = static_cast<unsigned char*>(av_malloc(SourceBufferSize));
+    AVIOContext *sourceContext = buffer ? avio_alloc_context(buffer, SourceBufferSize, 0, &source,
+                                                             &readMemory, nullptr, nullptr)
+                                        : nullptr;
+    if (!sourceContext)
+    {
+        av_free(buffer);
+        return -1;
+    }
+
+    int64_t elapsedNs = -1;
+    {
+        TsAnalyzer analyzer;
+        analyzer.setBitrateHistory(std::make_shared<BitrateHistory>());
+        if (analyzer.open(sourceContext))
+        {
+            std::vector<uint8_t> readBuffer(DemuxerReadSize);
+            QElapsedTimer timer;
+            timer.start();
+            while (avio_read(analyzer.getIoContext(), readBuffer.data(), DemuxerReadSize) > 0)
+                ;
+            elapsedNs = timer.nsecsElapsed();
+            statistics = analyzer.getStatistics();
+            analyzer.close();
+        }
+    }
+
+    av_freep(&sourceContext->buffer);
+    avio_context_free(&sourceContext);
+    return elapsedNs;
+}
+
+//---------------------------------------------------------------------------------------
+//   Throughput check of the transport stream analyser:
+//       tsanalyzerbench <recorded.ts> [passes]
+//   The exit code is 0 if the best pass is above the target rate, 2 if it's below.
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QStringList arguments = application.arguments();
+    if (arguments.size() < 2)
+    {
+        fprintf(stderr, "Usage: tsanalyzerbench <recorded.ts> [passes]\n");
+        return 1;
+    }
+
+    QFile file(arguments.at(1));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        fprintf(stderr, "Could not open '%s'.\n", qPrintable(arguments.at(1)));
+        return 1;
+    }
+    QByteArray data = file.readAll();
+    int passes = arguments.size() > 2 ? std::max(1, arguments.at(2).toInt()) : DefaultPasses;
+
+    int64_t bestNs = -1;
+    TsAnalyzerStatistics statistics;
+    for (int pass = 1; pass <= passes; ++pass)
+    {
+        int64_t elapsedNs = runPass(data, statistics);
+        if (elapsedNs <= 0)
+        {
+            fprintf(stderr, "Could not run the analyser.\n");
+            return 1;
+        }
+        double megabytesPerSecond = data.size() / 1048576.0 / (elapsedNs / 1e9);
+        printf("pass %d: %lld byte(s) in %.3f s, %.1f MB/s (%.0f Mbit/s)\n", pass,
+               static_cast<long long>(data.size()), elapsedNs / 1e9, megabytesPerSecond,
+               data.size() * 8.0 / 1e6 / (elapsedNs / 1e9));
+        if (bestNs < 0 || elapsedNs < bestNs)
+            bestNs = elapsedNs;
+    }
+
+    double mbitPerSecond = data.size() * 8.0 / 1e6 / (bestNs / 1e9);
+    printf("packets %lld, sync losses %lld, continuity errors %lld, PIDs %d\n",
+           static_cast<long long>(statistics.packets), static_cast<long long>(statistics.syncLosses),
+           static_cast<long long>(statistics.continuityErrors), int(statistics.pids.size()));
+    printf("best %.0f Mbit/s, target %.0f Mbit/s: %s\n", mbitPerSecond, TargetMbitPerSecond,
+           mbitPerSecond >= TargetMbitPerSecond ? "OK" : "BELOW TARGET");
+
+    return mbitPerSecond >= TargetMbitPerSecond ? 0 : 2;
+}
@@ -0,0 +1,26 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tsanalyzerbench
+
+INCLUDEPATH += ../../logger \
+    ../../player
+
+SOURCES += \
+    ../../logger/loggable.cpp \
+    ../../logger/logger.cpp \
+    ../../player/bitratehistory.cpp \
+    ../../player/tsanalyzer.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../logger/loggable.h \
+    ../../logger/logger.h \
+    ../../player/bitratehistory.h \
+    ../../player/simd.h \
+    ../../player/tsanalyzer.h
+
+include(../ffmpeg.pri)
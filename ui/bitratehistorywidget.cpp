@@ -0,0 +1,150 @@
+#include "bitratehistorywidget.h"
+
+#include <QPaintEvent>
+
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------
+BitrateHistoryWidget::BitrateHistoryWidget(QWidget *parent)
+    : QWidget{parent}
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Minimum);
+    setMinimumHeight(RowHeight);
+
+    refreshTimer.setInterval(RefreshIntervalMs);
+    connect(&refreshTimer, &QTimer::timeout, this, &BitrateHistoryWidget::refresh);
+}
+
+//---------------------------------------------------------------------------------------
+void BitrateHistoryWidget::setBitrateHistory(std::shared_ptr<const BitrateHistory> history)
+{
+    bitrateHistory = std::move(history);
+    refresh();
+}
+
+//---------------------------------------------------------------------------------------
+void BitrateHistoryWidget::setResolution(int resolution)
+{
+    this->resolution = std::clamp(resolution, 0, BitrateHistory::ResolutionCount - 1);
+    update();
+}
+
+//---------------------------------------------------------------------------------------
+void BitrateHistoryWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    refreshTimer.start();
+}
+
+//---------------------------------------------------------------------------------------
+void BitrateHistoryWidget::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    refreshTimer.stop();
+}
+
+//---------------------------------------------------------------------------------------
+//   The hidden widget doesn't read the history at all.
+void BitrateHistoryWidget::refresh()
+{
+    if (!isVisible())
+        return;
+
+    pids = bitrateHistory ? bitrateHistory->getPids() : std::vector<int>{};
+
+    int height = std::max(1, int(pids.size())) * RowHeight;
+    if (minimumHeight() != height)
+        setMinimumHeight(height);
+
+    update();
+}
+
+//---------------------------------------------------------------------------------------
+void BitrateHistoryWidget::paintEvent(QPaintEvent *event)
+{
+    painter.begin(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    if (pids.empty())
+    {
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(rect(), Qt::AlignCenter, tr("No bitrate history"));
+    }
+    else
+    {
+        // only the rows in the exposed area
+        int firstRow = std::max(0, event->rect().top() / RowHeight);
+        int lastRow = std::min(int(pids.size()) - 1, event->rect().bottom() / RowHeight);
+        for (int row = firstRow; row <= lastRow; ++row)
+            drawRow(row, pids[size_t(row)]);
+    }
+
+    painter.end();
+}
+
+//---------------------------------------------------------------------------------------
+//   Each row is scaled by its own maximum; the newest bucket is at the right edge, the
+// empty part of the ring is left blank.
+void BitrateHistoryWidget::drawRow(int row, int pid)
+{
+    std::vector<BitrateBucket> buckets = bitrateHistory->getBuckets(pid, resolution);
+    int64_t current = buckets.empty() ? 0 : buckets.back().avg;
+
+    QRect rowRect(0, row * RowHeight, width(), RowHeight);
+    QRect labelRect(rowRect.left() + Margin, rowRect.top(), LabelWidth - Margin, RowHeight);
+    QRectF chartRect(rowRect.left() + LabelWidth, rowRect.top() + Margin,
+                     rowRect.width() - LabelWidth - Margin, RowHeight - 2 * Margin);
+
+    painter.setPen(palette().color(QPalette::WindowText));
+    painter.drawText(labelRect, Qt::AlignLeft | Qt::AlignVCenter,
+                     QString("PID %1  %2").arg(pid, 4, 10, QChar('0')).arg(formatBitrate(current)));
+
+    painter.setPen(gridColor);
+    painter.drawLine(chartRect.bottomLeft(), chartRect.bottomRight());
+
+    if (buckets.empty() || chartRect.width() <= 0)
+        return;
+
+    int64_t maximum = 1;
+    for (const BitrateBucket &bucket : buckets)
+        maximum = std::max(maximum, bucket.max);
+
+    int capacity = BitrateHistory::getBucketCount(resolution);
+    double step = chartRect.width() / std::max(1, capacity - 1);
+    double startX = chartRect.right() - step * (int(buckets.size()) - 1);
+    auto toY = [&chartRect, maximum](int64_t value){
+        return chartRect.bottom() - chartRect.height() * double(value) / double(maximum);
+    };
+
+    QPolygonF band;
+    QPolygonF line;
+    band.reserve(qsizetype(buckets.size()) * 2);
+    line.reserve(qsizetype(buckets.size()));
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        double x = startX + step * double(i);
+        band.append(QPointF(x, toY(buckets[i].max)));
+        line.append(QPointF(x, toY(buckets[i].avg)));
+    }
+    for (size_t i = buckets.size(); i-- > 0;)
+        band.append(QPointF(startX + step * double(i), toY(buckets[i].min)));
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(bandColor);
+    painter.drawPolygon(band);
+
+    painter.setPen(lineColor);
+    painter.setBrush(Qt::NoBrush);
+    painter.drawPolyline(line);
+}
+
+//---------------------------------------------------------------------------------------
+QString BitrateHistoryWidget::formatBitrate(int64_t bitrate)
+{
+    if (bitrate >= 1000000)
+        return QString("%1 Mbit/s").arg(double(bitrate) / 1000000.0, 0, 'f', 2);
+    return QString("%1 kbit/s").arg(bitrate / 1000);
+}
+
+//---------------------------------------------------------------------------------------
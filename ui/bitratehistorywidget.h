@@ -0,0 +1,59 @@
+#ifndef BITRATEHISTORYWIDGET_H
+#define BITRATEHISTORYWIDGET_H
+
+#include <QWidget>
+
+#include <QPainter>
+#include <QTimer>
+
+#include <memory>
+
+#include "bitratehistory.h"
+
+//---------------------------------------------------------------------------------------
+//   Sparklines of the bitrate history: one row per PID, the min/max band and the average
+// line at the selected resolution. The history is read only while the widget is
+// shown, once per second.
+class BitrateHistoryWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit BitrateHistoryWidget(QWidget *parent = nullptr);
+
+    void setBitrateHistory(std::shared_ptr<const BitrateHistory> history);
+
+public slots:
+    void setResolution(int resolution);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    void refresh();
+    void drawRow(int row, int pid);
+
+    static QString formatBitrate(int64_t bitrate);
+
+    enum {
+        RowHeight = 28,
+        LabelWidth = 130,
+        Margin = 3,
+        RefreshIntervalMs = 1000
+    };
+
+    std::shared_ptr<const BitrateHistory> bitrateHistory;
+    int resolution{BitrateHistory::Seconds};
+    std::vector<int> pids;
+
+    QTimer refreshTimer;
+
+    QColor bandColor {QColorConstants::Svg::lightsteelblue};
+    QColor lineColor {QColorConstants::Svg::steelblue};
+    QColor gridColor {QColorConstants::Svg::lightgray};
+
+    QPainter painter;
+};
+
+#endif // BITRATEHISTORYWIDGET_H
@@ -1,6 +1,10 @@
 #include "detailsdockwidget.h"
 
-
+#include <QLabel>
+#include <QScrollArea>
+#include <QScrollBar>
+#include <QSplitter>
+#include <QVBoxLayout>
 
 //---------------------------------------------------------------------------------------
 DetailsDockWidget::DetailsDockWidget(QWidget *parent) : QDockWidget(parent)
@@ -8,15 +12,92 @@ DetailsDockWidget::DetailsDockWidget(QWidget *parent) : QDockWidget(parent)
     setWindowTitle(tr("Details"));
 
     textEdit = new QTextEdit();
+    textEdit->setReadOnly(true);
+
+    resolutionField = new QComboBox();
+    resolutionField->addItem(tr("Last 5 minutes (1 s)"), int(BitrateHistory::Seconds));
+    resolutionField->addItem(tr("Last 30 minutes (10 s)"), int(BitrateHistory::TenSeconds));
+    resolutionField->addItem(tr("Last 4 hours (1 min)"), int(BitrateHistory::Minutes));
+
+    bitrateHistoryWidget = new BitrateHistoryWidget();
+    connect(resolutionField, &QComboBox::currentIndexChanged, this, [this](int index){
+        bitrateHistoryWidget->setResolution(resolutionField->itemData(index).toInt());
+    });
 
+    QScrollArea *historyScrollArea = new QScrollArea();
+    historyScrollArea->setWidgetResizable(true);
+    historyScrollArea->setWidget(bitrateHistoryWidget);
 
-    setWidget(textEdit);
+    QWidget *historyPanel = new QWidget();
+    QVBoxLayout *historyLayout = new QVBoxLayout(historyPanel);
+    historyLayout->setContentsMargins(0, 0, 0, 0);
+    historyLayout->addWidget(new QLabel(tr("Bitrate history")));
+    historyLayout->addWidget(resolutionField);
+    historyLayout->addWidget(historyScrollArea);
 
+    QSplitter *splitter = new QSplitter(Qt::Vertical);
+    splitter->addWidget(textEdit);
+    splitter->addWidget(historyPanel);
+    splitter->setStretchFactor(0, 2);
+    splitter->setStretchFactor(1, 1);
+
+    setWidget(splitter);
 
     setMinimumWidth(300);
     setMinimumHeight(500);
+}
+
+//---------------------------------------------------------------------------------------
+void DetailsDockWidget::setBitrateHistory(std::shared_ptr<const BitrateHistory> history)
+{
+    bitrateHistoryWidget->setBitrateHistory(std::move(history));
+}
+
+//---------------------------------------------------------------------------------------
+void DetailsDockWidget::updateSection(const QString &section, const std::map<QString, QString> &values)
+{
+    if (values.empty())
+        sections.erase(section);
+    else
+        sections[section] = values;
 
+    // the hidden widget is rendered when it will be shown
+    if (isVisible())
+        render();
+}
+
+//---------------------------------------------------------------------------------------
+void DetailsDockWidget::clear()
+{
+    sections.clear();
+    render();
+}
+
+//---------------------------------------------------------------------------------------
+void DetailsDockWidget::showEvent(QShowEvent *event)
+{
+    QDockWidget::showEvent(event);
+    render();
+}
+
+//---------------------------------------------------------------------------------------
+void DetailsDockWidget::render()
+{
+    QString html;
+    for (auto& [title, values] : sections)
+    {
+        html.append(QString("<h4>%1</h4><table>").arg(title.toHtmlEscaped()));
+        for (auto& [key, val] : values)
+        {
+            html.append(QString("<tr><td>%1</td><td>&nbsp;&nbsp;%2</td></tr>")
+                        .arg(key.toHtmlEscaped(), val.toHtmlEscaped()));
+        }
+        html.append("</table>");
+    }
 
+    int scrollPos = textEdit->verticalScrollBar()->value();
+    textEdit->setHtml(html);
+    textEdit->verticalScrollBar()->setValue(scrollPos);
 }
 
 //---------------------------------------------------------------------------------------
@@ -1,17 +1,39 @@
 #ifndef DETAILSDOCKWIDGET_H
 #define DETAILSDOCKWIDGET_H
 
+#include <QComboBox>
 #include <QDockWidget>
 #include <QTextEdit>
 
+#include <map>
+#include <memory>
+
+#include "bitratehistorywidget.h"
+
 class DetailsDockWidget : public QDockWidget
 {
     Q_OBJECT
 public:
     explicit DetailsDockWidget(QWidget *parent = nullptr);
 
+    void setBitrateHistory(std::shared_ptr<const BitrateHistory> history);
+
+public slots:
+    void updateSection(const QString &section, const std::map<QString, QString> &values);
+    void clear();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
 private:
+    void render();
+
     QTextEdit *textEdit{nullptr};
+    QComboBox *resolutionField{nullptr};
+    BitrateHistoryWidget *bitrateHistoryWidget{nullptr};
+
+    // key - section title, value - list of the "parameter - value" pairs
+    std::map<QString, std::map<QString, QString>> sections;
 };
 
 #endif // DETAILSDOCKWIDGET_H
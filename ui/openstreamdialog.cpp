@@ -2,6 +2,7 @@
 #include "ui_openstreamdialog.h"
 
 static const int UdpBufferPageSize = 4096;
+static const int RtpEncapsulation = 1;
 
 //---------------------------------------------------------------------------------------
 OpenStreamDialog::OpenStreamDialog(QWidget *parent) :
@@ -16,6 +17,9 @@ OpenStreamDialog::OpenStreamDialog(QWidget *parent) :
     ui->udpPortField->setValue(2022);
     ui->udpLocalInterfaceAddressField->setText("192.168.1.232");
     ui->udpBufferSizeField->setValue(70);
+
+    connect(ui->udpEncapsulationField, &QComboBox::currentIndexChanged, this, &OpenStreamDialog::updateRtpFields);
+    updateRtpFields();
 }
 
 //---------------------------------------------------------------------------------------
@@ -41,7 +45,9 @@ void OpenStreamDialog::prepareOutputAndAccept()
 {
     ///TODO: validate input
 
-    uri = QString("udp://%1:%2?fifo_size=%3")
+    bool rtp = ui->udpEncapsulationField->currentIndex() == RtpEncapsulation;
+    uri = QString("%1://%2:%3?fifo_size=%4")
+            .arg(rtp ? "rtp" : "udp")
             .arg(ui->udpAddressField->text().trimmed())
             .arg(ui->udpPortField->value())
             .arg(ui->udpBufferSizeField->value() * UdpBufferPageSize);
@@ -57,7 +63,23 @@ void OpenStreamDialog::prepareOutputAndAccept()
         uri.insert(uri.indexOf("//")+2, '@');
     }
 
+    // the options of the RTP input (the others are passed to its UDP sockets)
+    if (rtp)
+    {
+        uri += QString("&reorder_window=%1").arg(ui->rtpReorderWindowField->value());
+        if (ui->rtpFecField->isChecked())
+            uri += "&fec=1";
+    }
+
     accept();
 }
 
 //---------------------------------------------------------------------------------------
+void OpenStreamDialog::updateRtpFields()
+{
+    bool rtp = ui->udpEncapsulationField->currentIndex() == RtpEncapsulation;
+    ui->rtpReorderWindowField->setEnabled(rtp);
+    ui->rtpFecField->setEnabled(rtp);
+}
+
+//---------------------------------------------------------------------------------------
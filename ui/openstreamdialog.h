@@ -21,6 +21,9 @@ public:
 public slots:
     void prepareOutputAndAccept();
 
+private slots:
+    void updateRtpFields();
+
 private:
     Ui::OpenStreamDialog *ui;
 
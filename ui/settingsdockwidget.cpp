@@ -0,0 +1,177 @@
+#include "settingsdockwidget.h"
+
+#include <QThread>
+
+//---------------------------------------------------------------------------------------
+SettingsDockWidget::SettingsDockWidget(QWidget *parent) : QDockWidget(parent)
+{
+    setWindowTitle(tr("Settings"));
+
+    coreBudgetField = new QSpinBox();
+    coreBudgetField->setRange(1, 4 * QThread::idealThreadCount());
+    coreBudgetField->setValue(QThread::idealThreadCount());
+    coreBudgetField->setToolTip(tr("Number of CPU cores shared among all open decoders"));
+
+    videoFiltersField = new QLineEdit();
+    videoFiltersField->setPlaceholderText("scale=1280:-2,format=yuv420p");
+    videoFiltersField->setToolTip(tr("Additional FFmpeg video filters appended to the filter chain"));
+
+    deinterlacerField = new QComboBox();
+    deinterlacerField->setToolTip(tr("Deinterlacing algorithm for the interlaced video"));
+
+    fieldRateField = new QCheckBox(tr("Field rate output (50i -> 50p)"));
+    fieldRateField->setToolTip(tr("Output one picture per field instead of one picture per frame"));
+
+    activePictureField = new QCheckBox(tr("Crop blanking around the active picture"));
+    activePictureField->setChecked(true);
+    activePictureField->setToolTip(tr("Detect black borders of the picture and crop them before the other filters"));
+
+    loadGovernorField = new QCheckBox(tr("Degrade video decoding under CPU load"));
+    loadGovernorField->setChecked(true);
+    loadGovernorField->setToolTip(tr("Skip the loop filter, non-reference frames, resolution or all but key frames "
+                                     "while the decoder can't keep up (the audio is never degraded)"));
+
+    timeshiftField = new QCheckBox(tr("Timeshift for UDP sources"));
+    timeshiftField->setToolTip(tr("Keep receiving the UDP stream while paused, allow to jump back and catch up "
+                                  "the live (applied to the next opened source)"));
+
+    timeshiftDurationField = new QSpinBox();
+    timeshiftDurationField->setRange(10, 4 * 3600);
+    timeshiftDurationField->setValue(300);
+    timeshiftDurationField->setSuffix(tr(" s"));
+    timeshiftDurationField->setToolTip(tr("How long the received stream is kept for the seeking back"));
+
+    timeshiftCapacityField = new QSpinBox();
+    timeshiftCapacityField->setRange(16, 16384);
+    timeshiftCapacityField->setValue(512);
+    timeshiftCapacityField->setSuffix(tr(" MB"));
+    timeshiftCapacityField->setToolTip(tr("Size of the timeshift ring (limits the duration for the high bitrates)"));
+
+    timeshiftStorageField = new QComboBox();
+    timeshiftStorageField->addItem(tr("RAM"));
+    timeshiftStorageField->addItem(tr("File"));
+    timeshiftStorageField->setToolTip(tr("Keep the ring in the memory or in the pre-allocated temporary file"));
+
+    fastStartField = new QCheckBox(tr("Fast start for MPEG-TS streams"));
+    fastStartField->setToolTip(tr("Take the stream parameters from the cache of the previous opening of the same "
+                                  "source, or probe only until they are found (applied to the next opened source)"));
+
+    probeSizeField = new QSpinBox();
+    probeSizeField->setRange(32, 16384);
+    probeSizeField->setValue(512);
+    probeSizeField->setSuffix(tr(" KB"));
+    probeSizeField->setToolTip(tr("How much of the stream may be read to find PAT/PMT and the stream parameters"));
+
+    analyzeDurationField = new QSpinBox();
+    analyzeDurationField->setRange(100, 10000);
+    analyzeDurationField->setSingleStep(100);
+    analyzeDurationField->setValue(500);
+    analyzeDurationField->setSuffix(tr(" ms"));
+    analyzeDurationField->setToolTip(tr("How long the stream may be analyzed to find the stream parameters"));
+
+    tsAnalysisField = new QCheckBox(tr("Transport stream analysis (TR 101 290)"));
+    tsAnalysisField->setChecked(true);
+    tsAnalysisField->setToolTip(tr("Check the sync, continuity, PSI and PCR of the received packets and measure "
+                                   "the bitrates of PIDs (applied to the next opened source)"));
+
+    clockRecoveryField = new QCheckBox(tr("Clock recovery for live UDP streams"));
+    clockRecoveryField->setToolTip(tr("Lock the playback to the PCR of the sender, so the latency stays the same "
+                                      "however long the stream is played (applied to the next opened source)"));
+
+    latencyProfileField = new QComboBox();
+    latencyProfileField->addItem(tr("Normal"));
+    latencyProfileField->addItem(tr("Low latency"));
+    latencyProfileField->setToolTip(tr("Low latency: decode the live stream as it arrives, without the frame delay "
+                                       "of the decoders and with the short queues and audio buffer"));
+
+    formLayout = new QFormLayout();
+    formLayout->addRow(tr("Decoder core budget:"), coreBudgetField);
+    formLayout->addRow("", loadGovernorField);
+    formLayout->addRow(tr("Deinterlacer:"), deinterlacerField);
+    formLayout->addRow("", fieldRateField);
+    formLayout->addRow("", activePictureField);
+    formLayout->addRow(tr("Video filters:"), videoFiltersField);
+    formLayout->addRow("", timeshiftField);
+    formLayout->addRow(tr("Timeshift duration:"), timeshiftDurationField);
+    formLayout->addRow(tr("Timeshift size:"), timeshiftCapacityField);
+    formLayout->addRow(tr("Timeshift storage:"), timeshiftStorageField);
+    formLayout->addRow("", fastStartField);
+    formLayout->addRow(tr("Probe size:"), probeSizeField);
+    formLayout->addRow(tr("Analyze duration:"), analyzeDurationField);
+    formLayout->addRow("", tsAnalysisField);
+    formLayout->addRow("", clockRecoveryField);
+    formLayout->addRow(tr("Latency profile:"), latencyProfileField);
+
+    QWidget *wgt = new QWidget(this);
+    wgt->setLayout(formLayout);
+    setWidget(wgt);
+
+    setMinimumWidth(300);
+
+    connect(coreBudgetField, &QSpinBox::valueChanged, this, &SettingsDockWidget::coreBudgetChanged);
+    connect(videoFiltersField, &QLineEdit::editingFinished, this, [this](){
+        emit videoFiltersChanged(videoFiltersField->text());
+    });
+    connect(deinterlacerField, &QComboBox::currentIndexChanged, this, &SettingsDockWidget::notifyDeinterlacerChange);
+    connect(fieldRateField, &QCheckBox::toggled, this, &SettingsDockWidget::notifyDeinterlacerChange);
+    connect(activePictureField, &QCheckBox::toggled, this, &SettingsDockWidget::activePictureDetectionChanged);
+    connect(loadGovernorField, &QCheckBox::toggled, this, &SettingsDockWidget::loadGovernorChanged);
+    connect(timeshiftField, &QCheckBox::toggled, this, &SettingsDockWidget::notifyTimeshiftChange);
+    connect(timeshiftDurationField, &QSpinBox::valueChanged, this, &SettingsDockWidget::notifyTimeshiftChange);
+    connect(timeshiftCapacityField, &QSpinBox::valueChanged, this, &SettingsDockWidget::notifyTimeshiftChange);
+    connect(timeshiftStorageField, &QComboBox::currentIndexChanged, this, &SettingsDockWidget::notifyTimeshiftChange);
+    connect(fastStartField, &QCheckBox::toggled, this, &SettingsDockWidget::notifyFastStartChange);
+    connect(probeSizeField, &QSpinBox::valueChanged, this, &SettingsDockWidget::notifyFastStartChange);
+    connect(analyzeDurationField, &QSpinBox::valueChanged, this, &SettingsDockWidget::notifyFastStartChange);
+    connect(tsAnalysisField, &QCheckBox::toggled, this, &SettingsDockWidget::tsAnalysisChanged);
+    connect(clockRecoveryField, &QCheckBox::toggled, this, &SettingsDockWidget::clockRecoveryChanged);
+    connect(latencyProfileField, &QComboBox::currentIndexChanged, this, [this](int index){
+        emit lowLatencyChanged(index == 1);
+    });
+}
+
+//---------------------------------------------------------------------------------------
+void SettingsDockWidget::setCoreBudget(int cores)
+{
+    coreBudgetField->setValue(cores);
+}
+
+//---------------------------------------------------------------------------------------
+void SettingsDockWidget::setVideoFilters(const QString &filters)
+{
+    videoFiltersField->setText(filters);
+}
+
+//---------------------------------------------------------------------------------------
+void SettingsDockWidget::setDeinterlacers(const QStringList &algorithms)
+{
+    deinterlacerField->clear();
+    for (const QString &algorithm : algorithms)
+        deinterlacerField->addItem(algorithm);
+}
+
+//---------------------------------------------------------------------------------------
+void SettingsDockWidget::notifyDeinterlacerChange()
+{
+    if (deinterlacerField->currentIndex() < 0)
+        return;
+
+    emit deinterlacerChanged(deinterlacerField->currentText(), fieldRateField->isChecked());
+}
+
+//---------------------------------------------------------------------------------------
+void SettingsDockWidget::notifyTimeshiftChange()
+{
+    emit timeshiftChanged(timeshiftField->isChecked(),
+                          timeshiftDurationField->value(),
+                          timeshiftCapacityField->value(),
+                          timeshiftStorageField->currentIndex() == 1);
+}
+
+//---------------------------------------------------------------------------------------
+void SettingsDockWidget::notifyFastStartChange()
+{
+    emit fastStartChanged(fastStartField->isChecked(), probeSizeField->value(), analyzeDurationField->value());
+}
+
+//---------------------------------------------------------------------------------------
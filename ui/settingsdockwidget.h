@@ -0,0 +1,59 @@
+#ifndef SETTINGSDOCKWIDGET_H
+#define SETTINGSDOCKWIDGET_H
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDockWidget>
+#include <QFormLayout>
+#include <QLineEdit>
+#include <QSpinBox>
+
+class SettingsDockWidget : public QDockWidget
+{
+    Q_OBJECT
+public:
+    explicit SettingsDockWidget(QWidget *parent = nullptr);
+
+    void setCoreBudget(int cores);
+    void setVideoFilters(const QString &filters);
+    void setDeinterlacers(const QStringList &algorithms);
+
+signals:
+    void coreBudgetChanged(int cores);
+    void videoFiltersChanged(const QString &filters);
+    void deinterlacerChanged(const QString &algorithm, bool fieldRate);
+    void activePictureDetectionChanged(bool enabled);
+    void loadGovernorChanged(bool enabled);
+    void timeshiftChanged(bool enabled, int durationSeconds, int capacityMegabytes, bool fileStorage);
+    void fastStartChanged(bool enabled, int probeSizeKilobytes, int analyzeDurationMs);
+    void tsAnalysisChanged(bool enabled);
+    void clockRecoveryChanged(bool enabled);
+    void lowLatencyChanged(bool enabled);
+
+private slots:
+    void notifyDeinterlacerChange();
+    void notifyTimeshiftChange();
+    void notifyFastStartChange();
+
+private:
+    QFormLayout *formLayout{nullptr};
+
+    QSpinBox *coreBudgetField{nullptr};
+    QLineEdit *videoFiltersField{nullptr};
+    QComboBox *deinterlacerField{nullptr};
+    QCheckBox *fieldRateField{nullptr};
+    QCheckBox *activePictureField{nullptr};
+    QCheckBox *loadGovernorField{nullptr};
+    QCheckBox *timeshiftField{nullptr};
+    QSpinBox *timeshiftDurationField{nullptr};
+    QSpinBox *timeshiftCapacityField{nullptr};
+    QComboBox *timeshiftStorageField{nullptr};
+    QCheckBox *fastStartField{nullptr};
+    QSpinBox *probeSizeField{nullptr};
+    QSpinBox *analyzeDurationField{nullptr};
+    QCheckBox *tsAnalysisField{nullptr};
+    QCheckBox *clockRecoveryField{nullptr};
+    QComboBox *latencyProfileField{nullptr};
+};
+
+#endif // SETTINGSDOCKWIDGET_H